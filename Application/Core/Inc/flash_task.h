@@ -0,0 +1,70 @@
+/*
+ * flash_task.h
+ *
+ * Flash driver task for the application: the one place that erases and
+ * bulk-programs internal flash while the application keeps running.
+ *
+ * Jobs are queued and run one at a time on the event loop (sched.h):
+ *
+ *   flash_task_erase()    erases a partition sector by sector with the
+ *                         HAL's interrupt-driven erase. Between sectors,
+ *                         and during each one if the sector is in the
+ *                         other bank from the code, timers keep running.
+ *   flash_task_program()  calls a step function, flash unlocked, once
+ *                         per pass of the loop until it reports done, so
+ *                         a long program is spread across many passes.
+ *
+ * When the job finishes, its done callback runs with 0 or -1. Sectors
+ * and steps are paced by the OTA governor (ota_governor.h): when flash
+ * has been busy too long, or erases come too fast, the next one waits
+ * on a timer instead of being posted straight away.
+ *
+ * Code that programs a word or two directly (boot_trial_confirm()) needs
+ * no queue: the HAL's flash lock makes it fail with HAL_BUSY while an
+ * erase is in flight, and it retries.
+ *
+ * Erasing a sector in the bank the CPU is executing from still stalls
+ * instruction fetch for the whole sector erase; that is the hardware,
+ * not something a driver can hide. Targets in the other bank are the
+ * ones that erase with no visible stall.
+ */
+
+#ifndef INC_FLASH_TASK_H_
+#define INC_FLASH_TASK_H_
+
+#include <stdint.h>
+#include "flash_layout.h"
+
+#define FLASH_TASK_QUEUE_DEPTH  4
+
+typedef void (*flash_task_done_t)(int status, void *arg);
+
+// Program the next piece; return 1 for more, 0 when finished, -1 on error
+typedef int (*flash_task_step_t)(void *arg);
+
+/**
+ * @brief Enable the flash interrupt (call once, after sched_init())
+ */
+void flash_task_init(void);
+
+/**
+ * @brief Queue an erase of the sectors covering a partition's first bytes
+ * @param part Partition to erase
+ * @param size Bytes that will be programmed (0 or oversize = whole partition)
+ * @return 0 if queued, -1 if the queue is full
+ */
+int flash_task_erase(const flash_partition_t *part, uint32_t size,
+                     flash_task_done_t done, void *arg);
+
+/**
+ * @brief Queue a stepped program job
+ * @return 0 if queued, -1 if the queue is full
+ */
+int flash_task_program(flash_task_step_t step, flash_task_done_t done, void *arg);
+
+/**
+ * @brief Non-zero while a job is running or queued
+ */
+int flash_task_busy(void);
+
+#endif /* INC_FLASH_TASK_H_ */
@@ -0,0 +1,61 @@
+/*
+ * ota_staging.h
+ *
+ * Optional SDRAM staging for OTA transfers.
+ *
+ * When enabled, DATA chunks are copied into the external 8MB SDRAM
+ * (FMC bank 2) instead of being programmed into flash while the link is
+ * live. The whole image is CRC-checked in SDRAM at END, and only then is
+ * the target slot erased and programmed, in the background, with the
+ * link idle.
+ * A transfer that fails or is aborted never touches flash.
+ */
+
+#ifndef INC_OTA_STAGING_H_
+#define INC_OTA_STAGING_H_
+
+#include <stdint.h>
+#include "ota_reloc.h"
+#include "flash_task.h"
+#include "ota_config.h"         // OTA_STAGING_ENABLED: 0 writes chunks straight to flash
+
+// SDRAM on the F429I-DISC1 is mapped at 0xD0000000 (FMC SDRAM bank 2).
+// The first 4MB are left to LTDC framebuffers; OTA stages in the upper half.
+#define SDRAM_BASE_ADDRESS      0xD0000000
+#define SDRAM_SIZE              (8 * 1024 * 1024)
+#define OTA_STAGING_ADDRESS     (SDRAM_BASE_ADDRESS + (4 * 1024 * 1024))
+#define OTA_STAGING_SIZE        (4 * 1024 * 1024)
+
+/**
+ * @brief Run the SDRAM device power-up sequence (once)
+ * @return 0 on success, -1 if the SDRAM did not accept a command
+ *
+ * MX_FMC_Init() only configures the controller; the IS42S16400J still
+ * needs its clock-enable / precharge / auto-refresh / mode-register
+ * sequence before it can hold data.
+ */
+int ota_staging_init(void);
+
+/**
+ * @brief Copy one chunk into the staging buffer
+ * @param offset Byte offset from the start of the image
+ * @param data   Chunk data
+ * @param size   Chunk size in bytes
+ * @return 0 on success, -1 if the chunk does not fit
+ */
+int ota_staging_write(uint32_t offset, const uint8_t *data, uint16_t size);
+
+/**
+ * @brief Program the staged image into the (already erased) target slot
+ * @param reloc Relocation state; reloc->target_address is the destination
+ * @param size  Staged stream size in bytes
+ * @param done  Called with 0 or -1 once the last chunk is programmed
+ * @return 0 if the job was queued, -1 otherwise
+ *
+ * Runs as a flash_task.h program job, one chunk per step. The staged
+ * stream is replayed through ota_reloc_feed(), so relocatable containers
+ * are rebased exactly as on the write-through path.
+ */
+int ota_staging_commit(ota_reloc_state_t *reloc, uint32_t size, flash_task_done_t done, void *arg);
+
+#endif /* INC_OTA_STAGING_H_ */
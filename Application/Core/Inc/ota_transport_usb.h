@@ -0,0 +1,28 @@
+/*
+ * ota_transport_usb.h
+ *
+ * OTA transport over USB: the OTG HS port runs as a CDC host (see the
+ * .ioc), and a USB-serial adapter or any CDC-ACM device plugged into it
+ * carries the OTA stream. The link is the adapter's serial side, so the
+ * adapter's line coding is set to OTA_USB_LINE_BAUD at open().
+ *
+ * open() brings the USB host up on demand (periph_init.h) and fails if
+ * no CDC device has enumerated within OTA_USB_ENUM_TIMEOUT_MS, so
+ * ota_link_pick() falls back to a UART when nothing is plugged in.
+ *
+ * Application only: the bootloader has no USB stack.
+ */
+
+#ifndef INC_OTA_TRANSPORT_USB_H_
+#define INC_OTA_TRANSPORT_USB_H_
+
+#include "ota_transport.h"
+
+#define OTA_USB_LINE_BAUD           921600
+#define OTA_USB_ENUM_TIMEOUT_MS     1500
+#define OTA_USB_PACKET_SIZE         64      // CDC bulk endpoint (full speed)
+#define OTA_USB_RX_RING_SIZE        4096    // Power of 2
+
+extern ota_transport_t ota_usb;
+
+#endif /* INC_OTA_TRANSPORT_USB_H_ */
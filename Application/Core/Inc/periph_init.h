@@ -0,0 +1,87 @@
+/*
+ * periph_init.h
+ *
+ * Dependency-ordered, deferred peripheral bring-up for the application.
+ *
+ * Each peripheral is described once (main.c) with its init function, the
+ * peripherals it needs first and when it should come up:
+ *
+ *   PERIPH_CRITICAL    before anything else runs (GPIO, debug/OTA UARTs)
+ *   PERIPH_BACKGROUND  one per periph_init_background_step(), called from
+ *                      the main loop once the critical path is up
+ *   PERIPH_ON_DEMAND   only when something calls periph_require()
+ *
+ * periph_require() brings up a peripheral's dependencies, then the
+ * peripheral itself, and is a no-op if it is already up, so code that
+ * needs e.g. SDRAM just asks for PERIPH_FMC wherever it is. Every init is
+ * timed with DWT; periph_init_report() prints what dominated startup.
+ */
+
+#ifndef INC_PERIPH_INIT_H_
+#define INC_PERIPH_INIT_H_
+
+#include <stdint.h>
+
+typedef enum {
+    PERIPH_GPIO = 0,
+    PERIPH_CRC,
+    PERIPH_USART1,      // Debug VCP (printf)
+    PERIPH_USART2,      // HM-10 OTA link
+    PERIPH_FMC,         // SDRAM (OTA staging, LCD framebuffer)
+    PERIPH_SPI5,        // LCD controller
+    PERIPH_LTDC,
+    PERIPH_DMA2D,
+    PERIPH_I2C3,        // Touch panel
+    PERIPH_TIM1,
+    PERIPH_USB_HOST,
+    PERIPH_COUNT
+} periph_id_t;
+
+#define PERIPH_BIT(id)  (1UL << (id))
+
+typedef enum {
+    PERIPH_CRITICAL = 0,
+    PERIPH_BACKGROUND,
+    PERIPH_ON_DEMAND
+} periph_policy_t;
+
+typedef struct {
+    const char *name;
+    void (*init)(void);
+    uint32_t deps;              // PERIPH_BIT() mask
+    periph_policy_t policy;
+} periph_desc_t;
+
+/**
+ * @brief Install the peripheral table (indexed by periph_id_t)
+ */
+void periph_init_register(const periph_desc_t table[PERIPH_COUNT]);
+
+/**
+ * @brief Bring up a peripheral and, first, everything it depends on
+ * @return 0 when it is up, -1 on a dependency cycle or unknown id
+ */
+int periph_require(periph_id_t id);
+
+/**
+ * @brief Is this peripheral initialised?
+ */
+int periph_is_ready(periph_id_t id);
+
+/**
+ * @brief Bring up every PERIPH_CRITICAL peripheral
+ */
+void periph_init_critical(void);
+
+/**
+ * @brief Bring up the next PERIPH_BACKGROUND peripheral, if any
+ * @return 1 if one was initialised, 0 when the background set is done
+ */
+int periph_init_background_step(void);
+
+/**
+ * @brief Print per-peripheral init cost, in init order
+ */
+void periph_init_report(void);
+
+#endif /* INC_PERIPH_INIT_H_ */
@@ -0,0 +1,211 @@
+/*
+ * flash_task.c
+ * Queued, interrupt-driven flash erase and stepped programming (see flash_task.h)
+ */
+
+#include "flash_task.h"
+#include "sched.h"
+#include "ota_governor.h"
+#include "main.h"
+#include <stdio.h>
+
+#define SECTOR_ERASE_ERROR  0xFFFFFFFFU
+
+typedef enum {
+    JOB_ERASE,
+    JOB_PROGRAM
+} flash_job_type_t;
+
+typedef struct {
+    flash_job_type_t type;
+    const flash_partition_t *part;  // JOB_ERASE
+    uint32_t size;
+    flash_task_step_t step;         // JOB_PROGRAM
+    flash_task_done_t done;
+    void *arg;
+} flash_job_t;
+
+static flash_job_t queue[FLASH_TASK_QUEUE_DEPTH];
+static uint32_t queue_head;
+static uint32_t queue_count;
+
+static flash_job_t job;             // Running job
+static uint8_t running;
+static uint32_t job_start_ms;
+
+static uint32_t sector;             // Next sector to erase
+static uint32_t last_sector;
+static volatile uint32_t sector_result;  // From the flash interrupt
+
+static sched_timer_t resume_timer;  // Next step, once the governor allows it
+
+static void run_next(void *arg);
+
+// Run fn now, or once the OTA budget has room for more flash work
+static void pace(sched_fn_t fn, int erase) {
+    uint32_t delay = ota_gov_flash_delay(erase);
+
+    if (delay == 0) {
+        sched_post(fn, NULL);
+    } else {
+        sched_timer_init(&resume_timer, fn, NULL);
+        sched_timer_start(&resume_timer, delay, 0);
+    }
+}
+
+static int submit(const flash_job_t *j) {
+    if (queue_count == FLASH_TASK_QUEUE_DEPTH) {
+        return -1;
+    }
+    queue[(queue_head + queue_count) % FLASH_TASK_QUEUE_DEPTH] = *j;
+    queue_count++;
+
+    if (!running) {
+        sched_post(run_next, NULL);
+    }
+    return 0;
+}
+
+static void finish(int status) {
+    HAL_FLASH_Lock();
+    running = 0;
+
+    printf("Flash %s: %s in %lu ms\r\n", job.type == JOB_ERASE ? "erase" : "program",
+           status == 0 ? "done" : "FAILED", HAL_GetTick() - job_start_ms);
+
+    if (job.done != NULL) {
+        job.done(status, job.arg);
+    }
+    if (queue_count > 0 && !running) {
+        sched_post(run_next, NULL);
+    }
+}
+
+/* ---- Erase ---- */
+
+static void erase_sector(void *arg) {
+    FLASH_EraseInitTypeDef erase_config;
+    erase_config.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase_config.VoltageRange = FLASH_VOLTAGE_RANGE_3;  // 2.7V to 3.6V
+    erase_config.Sector = sector;
+    erase_config.NbSectors = 1;
+
+    // Someone may have locked flash between sectors (boot_trial_confirm)
+    HAL_FLASH_Unlock();
+    ota_gov_erase_begin();
+    if (HAL_FLASHEx_Erase_IT(&erase_config) != HAL_OK) {
+        printf("ERROR: Erase of sector %lu did not start\r\n", sector);
+        finish(-1);
+    }
+}
+
+static void erase_sector_done(void *arg) {
+    ota_gov_erase_end();
+
+    if (sector_result == SECTOR_ERASE_ERROR) {
+        printf("ERROR: Erase failed! Sector error: %lu\r\n", sector);
+        finish(-1);
+        return;
+    }
+
+    if (sector++ == last_sector) {
+        finish(0);
+        return;
+    }
+    pace(erase_sector, 1);
+}
+
+static void erase_start(void) {
+    const flash_partition_t *part = job.part;
+    uint32_t size = (job.size == 0 || job.size > part->size) ? part->size : job.size;
+
+    // Count sectors until the data is covered
+    uint32_t num_sectors = 0;
+    uint32_t covered = 0;
+    while (covered < size) {
+        covered += FLASH_SECTOR_SIZE(part->first_sector + num_sectors);
+        num_sectors++;
+    }
+
+    sector = part->first_sector;
+    last_sector = part->first_sector + num_sectors - 1;
+
+    printf("Erasing %s: sectors %lu-%lu (%lu KB) in the background\r\n", part->name,
+           sector, last_sector, covered / 1024);
+    pace(erase_sector, 1);
+}
+
+// Called from HAL_FLASH_IRQHandler(); the HAL still holds its lock here,
+// so the next sector is started from the event loop
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue) {
+    if (running && job.type == JOB_ERASE) {
+        sector_result = 0;
+        sched_post(erase_sector_done, NULL);
+    }
+}
+
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue) {
+    if (running && job.type == JOB_ERASE) {
+        sector_result = SECTOR_ERASE_ERROR;
+        sched_post(erase_sector_done, NULL);
+    }
+}
+
+/* ---- Program ---- */
+
+static void program_step(void *arg) {
+    uint32_t start = ota_gov_begin();
+
+    HAL_FLASH_Unlock();
+    int result = job.step(job.arg);
+    HAL_FLASH_Lock();
+
+    ota_gov_end_flash(start);
+    ota_gov_end_cpu(start);
+
+    if (result > 0) {
+        pace(program_step, 0);
+    } else {
+        finish(result);
+    }
+}
+
+/* ---- Queue ---- */
+
+static void run_next(void *arg) {
+    if (running || queue_count == 0) {
+        return;
+    }
+
+    job = queue[queue_head];
+    queue_head = (queue_head + 1) % FLASH_TASK_QUEUE_DEPTH;
+    queue_count--;
+    running = 1;
+    job_start_ms = HAL_GetTick();
+
+    if (job.type == JOB_ERASE) {
+        erase_start();
+    } else {
+        pace(program_step, 0);
+    }
+}
+
+void flash_task_init(void) {
+    HAL_NVIC_SetPriority(FLASH_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(FLASH_IRQn);
+}
+
+int flash_task_erase(const flash_partition_t *part, uint32_t size,
+                     flash_task_done_t done, void *arg) {
+    flash_job_t j = { .type = JOB_ERASE, .part = part, .size = size, .done = done, .arg = arg };
+    return submit(&j);
+}
+
+int flash_task_program(flash_task_step_t step, flash_task_done_t done, void *arg) {
+    flash_job_t j = { .type = JOB_PROGRAM, .step = step, .done = done, .arg = arg };
+    return submit(&j);
+}
+
+int flash_task_busy(void) {
+    return running || queue_count > 0;
+}
@@ -5,10 +5,10 @@
   * @brief          : Application with OTA Update Support
   * 
   * This application:
-  * 1. Waits 5 seconds for OTA START packet on USART2 (HM-10)
-  * 2. If OTA packet received -> Enter OTA mode and update firmware
-  * 3. If timeout -> Run normal application (LED blink)
-  * 4. After OTA completes -> Reset to boot new firmware
+  * 1. Runs its normal work (LED blink) on the event loop (sched.h)
+  * 2. Listens for OTA packets on USART2 (HM-10) in the background
+  * 3. Keeps running while the new image is received and written
+  * 4. After OTA completes -> Reset to boot new firmware (activation)
   ******************************************************************************
   */
 /* USER CODE END Header */
@@ -23,13 +23,32 @@
 /* USER CODE BEGIN Includes */
 #include "ota_protocol.h"
 #include "ota_manager.h"
-#include "ota_uart.h"
+#include "ota_link.h"
+#include "ota_transport_uart.h"
+#include "ota_transport_usb.h"
+#include "ota_crc.h"
 #include "boot_state.h"
+#include "image_header.h"
+#include "boot_trial.h"
+#include "boot_handoff.h"
+#include "periph_init.h"
+#include "sched.h"
+#include "flash_task.h"
+#include "ota_governor.h"
 /* USER CODE END Includes */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-#define OTA_WAIT_TIMEOUT_MS  5000
+#define APP_CONFIRM_AFTER_MS 10000  /* Healthy this long in the main loop -> confirm */
+#define APP_WATCHDOG_KICK_MS 1000
+#define APP_LED_PERIOD_MS    300
+#define APP_STATS_PERIOD_MS  30000  /* CPU/idle/jitter report on the debug UART */
+#define APP_PROBE_PERIOD_MS  10     /* Latency probe timer */
+#define APP_ACTIVATE_DELAY_MS 3000  /* Installed image -> reset into it */
+#define APP_FW_VERSION       0x01020000  /* 1.2.0 (Major.Minor.Patch) */
+#define APP_SYSCLK_HZ        72000000    /* SystemClock_Config(): HSI PLL */
+#define APP_DEBUG_BAUD       115200
+#define APP_OTA_OVER_USB     0      /* 1: prefer a USB-serial adapter on the OTG HS port */
 /* USER CODE END PD */
 
 /* Private variables ---------------------------------------------------------*/
@@ -43,6 +62,18 @@ UART_HandleTypeDef huart1; // ST-Link VCP Debug
 UART_HandleTypeDef huart2; // HM-10 OTA
 SDRAM_HandleTypeDef hsdram1;
 
+/* Size, CRCs and load address are patched in by ota_image_tool.py */
+__attribute__((section(".image_header"), used))
+const image_header_t app_image_header = {
+    .magic = IMAGE_HEADER_MAGIC,
+    .header_size = sizeof(image_header_t),
+    .fw_version = APP_FW_VERSION,
+    .install_address = 0xFFFFFFFF,
+    .install_crc32 = 0xFFFFFFFF,
+    .install_check = 0xFFFFFFFF,
+    .reserved = 0xFFFFFFFF,
+};
+
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
@@ -58,9 +89,7 @@ static void MX_USART2_UART_Init(void);
 void MX_USB_HOST_Process(void);
 
 /* USER CODE BEGIN PFP */
-static int check_for_ota_start_packet(uint32_t timeout_ms, ota_context_t *ctx);
 static void run_normal_application(void);
-static void enter_ota_mode(ota_context_t *ctx);
 /* USER CODE END PFP */
 
 /* USER CODE BEGIN 0 */
@@ -72,194 +101,243 @@ int _write(int file, char *ptr, int len)
 }
 
 /**
- * @brief Send ACK response over USART2 (HM-10)
- * @param last_chunk Last successfully processed chunk (0xFFFFFFFF = none yet)
+ * @brief Take over the CRC unit the bootloader left running
+ * @return 1 if adopted, 0 if MX_CRC_Init() is still needed
  */
-static void send_ack(uint32_t last_chunk) {
-    uint8_t response[10];
-    uint32_t magic = OTA_MAGIC_START;
-    uint8_t pkt_type = OTA_PKT_ACK;
-    uint8_t error_code = OTA_ERR_NONE;
-    memcpy(response, &magic, 4);
-    response[4] = pkt_type;
-    response[5] = error_code;
-    memcpy(response + 6, &last_chunk, 4);
-    HAL_UART_Transmit(&huart2, response, 10, 1000);
+static int adopt_crc(const boot_handoff_t *handoff) {
+    if (handoff == NULL || !(handoff->peripherals & BOOT_HANDOFF_PERIPH_CRC)) {
+        return 0;
+    }
+    hcrc.Instance = CRC;
+    hcrc.State = HAL_CRC_STATE_READY;
+    hcrc.Lock = HAL_UNLOCKED;
+    return 1;
 }
 
 /**
- * @brief Send NACK response over USART2 (HM-10)
- * @param error_code OTA_ERR_* error code
- * @param last_chunk Last successfully processed chunk (0xFFFFFFFF = none yet)
+ * @brief Take over USART1 (debug VCP) as the bootloader configured it
+ * @return 1 if adopted, 0 if MX_USART1_UART_Init() is still needed
+ *
+ * Fills the handle exactly as MX_USART1_UART_Init() would, without
+ * touching the peripheral or the pins.
  */
-static void send_nack(uint8_t error_code, uint32_t last_chunk) {
-    uint8_t response[10];
-    uint32_t magic = OTA_MAGIC_START;
-    uint8_t pkt_type = OTA_PKT_NACK;
-    memcpy(response, &magic, 4);
-    response[4] = pkt_type;
-    response[5] = error_code;
-    memcpy(response + 6, &last_chunk, 4);
-    HAL_UART_Transmit(&huart2, response, 10, 1000);
+static int adopt_debug_uart(const boot_handoff_t *handoff) {
+    if (handoff == NULL || !(handoff->peripherals & BOOT_HANDOFF_PERIPH_USART1) ||
+        handoff->usart1_baud != APP_DEBUG_BAUD || !(USART1->CR1 & USART_CR1_UE)) {
+        return 0;
+    }
+    huart1.Instance = USART1;
+    huart1.Init.BaudRate = APP_DEBUG_BAUD;
+    huart1.Init.WordLength = UART_WORDLENGTH_8B;
+    huart1.Init.StopBits = UART_STOPBITS_1;
+    huart1.Init.Parity = UART_PARITY_NONE;
+    huart1.Init.Mode = UART_MODE_TX_RX;
+    huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart1.Init.OverSampling = UART_OVERSAMPLING_16;
+    huart1.ErrorCode = HAL_UART_ERROR_NONE;
+    huart1.gState = HAL_UART_STATE_READY;
+    huart1.RxState = HAL_UART_STATE_READY;
+    huart1.Lock = HAL_UNLOCKED;
+    return 1;
 }
 
-/**
- * @brief Wait for and validate an OTA START packet
- *
- * Receives the full START packet, validates all fields, sends ACK/NACK,
- * and populates the OTA context so enter_ota_mode() can proceed directly
- * to DATA packets without re-processing START.
- *
- * @param timeout_ms How long to wait for each receive attempt
- * @param ctx        OTA context to populate on success
- * @return 1 if valid START packet received and ACK sent, 0 otherwise
- */
-static int check_for_ota_start_packet(uint32_t timeout_ms, ota_context_t *ctx) {
-    uint8_t buf[sizeof(ota_start_packet_t)];
-    ota_start_packet_t *pkt = (ota_start_packet_t*)buf;
+static const boot_handoff_t *app_handoff;  /* NULL without a bootloader jump */
+static int uart_adopted;
 
-    printf("Waiting %lu ms for OTA START packet...\r\n", timeout_ms);
+static void init_crc(void) {
+    if (!adopt_crc(app_handoff)) {
+        MX_CRC_Init();
+    }
+}
 
-    int max_retries = 3;
+static void init_debug_uart(void) {
+    uart_adopted = adopt_debug_uart(app_handoff);
+    if (!uart_adopted) {
+        MX_USART1_UART_Init();
+    }
+}
 
-    for (int attempt = 0; attempt < max_retries; attempt++) {
+/* Only what the OTA check and printf need is on the critical path. The
+   LCD stack comes up in the background; USB host, which once hung the
+   whole startup and has no user yet, only on request. */
+static const periph_desc_t app_periphs[PERIPH_COUNT] = {
+    [PERIPH_GPIO]     = { "GPIO",   MX_GPIO_Init,         0,                        PERIPH_CRITICAL },
+    [PERIPH_CRC]      = { "CRC",    init_crc,             0,                        PERIPH_CRITICAL },
+    [PERIPH_USART1]   = { "USART1", init_debug_uart,      PERIPH_BIT(PERIPH_GPIO),  PERIPH_CRITICAL },
+    [PERIPH_USART2]   = { "USART2", MX_USART2_UART_Init,  PERIPH_BIT(PERIPH_GPIO),  PERIPH_CRITICAL },
+    [PERIPH_FMC]      = { "FMC",    MX_FMC_Init,          PERIPH_BIT(PERIPH_GPIO),  PERIPH_BACKGROUND },
+    [PERIPH_SPI5]     = { "SPI5",   MX_SPI5_Init,         PERIPH_BIT(PERIPH_GPIO),  PERIPH_BACKGROUND },
+    [PERIPH_LTDC]     = { "LTDC",   MX_LTDC_Init,
+                          PERIPH_BIT(PERIPH_FMC) | PERIPH_BIT(PERIPH_SPI5),     PERIPH_BACKGROUND },
+    [PERIPH_DMA2D]    = { "DMA2D",  MX_DMA2D_Init,        PERIPH_BIT(PERIPH_FMC),   PERIPH_BACKGROUND },
+    [PERIPH_I2C3]     = { "I2C3",   MX_I2C3_Init,         PERIPH_BIT(PERIPH_GPIO),  PERIPH_BACKGROUND },
+    [PERIPH_TIM1]     = { "TIM1",   MX_TIM1_Init,         0,                        PERIPH_BACKGROUND },
+    [PERIPH_USB_HOST] = { "USBH",   MX_USB_HOST_Init,     PERIPH_BIT(PERIPH_GPIO),  PERIPH_ON_DEMAND },
+};
+
+static ota_context_t ota_ctx;  /* Owned by the background receiver */
+
+OTA_TRANSPORT_UART(ota_usart2, "USART2", &huart2, USART2_IRQn);  /* HM-10 */
+
+/* Links this build can take updates on; ota_link_pick() uses the fastest
+   one that opens */
+static ota_transport_t *const ota_links[] = {
+#if APP_OTA_OVER_USB
+    &ota_usb,
+#endif
+    &ota_usart2,
+};
+
+static sched_timer_t watchdog_timer;
+static sched_timer_t led_timer;
+static sched_timer_t confirm_timer;
+static sched_timer_t stats_timer;
+static sched_timer_t probe_timer;
+static sched_timer_t activate_timer;
+static sched_timer_t activate_led_timer;
+
+/* Period deviation of the latency probe, kept apart for the normal case
+   and for an update in progress, so the cost of OTA on the application's
+   own timers is visible in the stats report */
+typedef struct {
+    uint32_t samples;
+    uint32_t total_us;
+    uint32_t max_us;
+} jitter_stats_t;
+
+static jitter_stats_t jitter[2];  /* [0] idle link, [1] OTA in progress */
+static uint32_t probe_last_cycles;
+
+static void watchdog_tick(void *arg) {
+    boot_watchdog_kick();
+}
 
-        HAL_StatusTypeDef status = HAL_UART_Receive(&huart2, buf, sizeof(buf), timeout_ms);
+static void led_toggle(void *arg) {
+    HAL_GPIO_TogglePin(GPIOG, GPIO_PIN_13);
+}
 
-        if (status == HAL_TIMEOUT) {
-            /* No data at all within the window - give up immediately,
-               don't waste more timeout cycles */
-            printf("No OTA packet detected (timeout). Starting normal app...\r\n");
-            return 0;
-        }
+static void activate_led_toggle(void *arg) {
+    HAL_GPIO_TogglePin(GPIOG, GPIO_PIN_14);
+}
 
-        if (status != HAL_OK) {
-            printf("UART error during OTA check.\r\n");
-            send_nack(OTA_ERR_SEQUENCE, 0xFFFFFFFF);
-            continue;
-        }
+/* A new image boots on trial under the IWDG (see boot_trial.h). Once the
+   application has run cleanly for a while, tell the bootloader to keep
+   it; until then a hang or reset rolls back to the old image. */
+static void confirm_image(void *arg) {
+    if (boot_trial_confirm() != 0) {
+        sched_timer_start(&confirm_timer, 1000, 0);  /* Flash busy; retry */
+    }
+}
 
-        /* --- Validate magic and packet type --- */
-        if (pkt->magic != OTA_MAGIC_START || pkt->packet_type != OTA_PKT_START) {
-            printf("Invalid magic/type (magic: 0x%08lX, type: 0x%02X)\r\n",
-                   pkt->magic, pkt->packet_type);
-            send_nack(OTA_ERR_SEQUENCE, 0xFFFFFFFF);
-            continue;
-        }
+/* One deferred peripheral per pass, so timers still run in between */
+static void background_init(void *arg) {
+    if (periph_init_background_step()) {
+        sched_post(background_init, NULL);
+    } else {
+        periph_init_report();
+    }
+}
 
-        /* --- Validate firmware_size --- */
-        if (pkt->firmware_size == 0 || pkt->firmware_size > BANK_SIZE) {
-            printf("Invalid firmware size: %lu\r\n", pkt->firmware_size);
-            send_nack(OTA_ERR_SIZE, 0xFFFFFFFF);
-            continue;
-        }
+static void latency_probe(void *arg) {
+    uint32_t now = DWT->CYCCNT;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
 
-        /* --- Validate total_chunks --- */
-        uint32_t expected_chunks =
-            (pkt->firmware_size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
-        if (pkt->total_chunks == 0 || pkt->total_chunks != expected_chunks) {
-            printf("Invalid total_chunks: %lu (expected %lu)\r\n",
-                   pkt->total_chunks, expected_chunks);
-            send_nack(OTA_ERR_SIZE, 0xFFFFFFFF);
-            continue;
-        }
+    if (probe_last_cycles != 0) {
+        int32_t deviation = (int32_t)(now - probe_last_cycles) -
+                            (int32_t)(APP_PROBE_PERIOD_MS * 1000 * cycles_per_us);
+        uint32_t deviation_us = (uint32_t)(deviation < 0 ? -deviation : deviation) / cycles_per_us;
+        jitter_stats_t *j = &jitter[ota_link_busy() ? 1 : 0];
 
-        /* --- Validate target bank --- */
-        if (pkt->target_bank != BANK_A && pkt->target_bank != BANK_B) {
-            printf("Invalid target bank: 0x%02X\r\n", pkt->target_bank);
-            send_nack(OTA_ERR_SEQUENCE, 0xFFFFFFFF);
-            continue;
+        j->samples++;
+        j->total_us += deviation_us;
+        if (deviation_us > j->max_us) {
+            j->max_us = deviation_us;
         }
+    }
+    probe_last_cycles = now;
+}
 
-        /* --- All checks passed: populate context and process START --- */
-        printf("OTA START packet valid! Processing...\r\n");
-        ota_process_start_packet(ctx, pkt);
-
-        if (ctx->state != OTA_STATE_RECEIVING_DATA) {
-            /* ota_process_start_packet already sent a NACK internally */
-            printf("START processing failed (state: %d)\r\n", ctx->state);
-            continue;
-        }
+static void stats_tick(void *arg) {
+    static const char *const labels[2] = { "idle link", "OTA in progress" };
 
-        /* ota_process_start_packet sends its own ACK on success,
-           so we don't send a duplicate here */
-        printf("OTA START accepted. Ready for DATA packets.\r\n");
+    sched_report();
 
-        /* Visual confirmation: fast blink after successful handshake */
-        for (int i = 0; i < 6; i++) {
-            HAL_GPIO_TogglePin(GPIOG, GPIO_PIN_14);
-            HAL_Delay(100);
+    for (int i = 0; i < 2; i++) {
+        if (jitter[i].samples > 0) {
+            printf("     %lu ms timer jitter (%s): avg %lu us, max %lu us over %lu periods\r\n",
+                   (uint32_t)APP_PROBE_PERIOD_MS, labels[i], jitter[i].total_us / jitter[i].samples,
+                   jitter[i].max_us, jitter[i].samples);
         }
-
-        return 1;
     }
+    memset(jitter, 0, sizeof(jitter));
 
-    printf("OTA START failed after %d attempts.\r\n", max_retries);
-    return 0;
+    ota_gov_report();
+    ota_transport_uart_report(&ota_usart2);
 }
 
-/**
- * @brief Run normal application (LED blink)
- */
-static void run_normal_application(void) {
+static void system_reset(void *arg) {
+    NVIC_SystemReset();
+}
+
+/* ota_link.h: the new image is installed; this is the only reset an
+   update causes */
+static void activate_update(void) {
     printf("\r\n");
     printf("========================================\r\n");
-    printf("  NORMAL APPLICATION MODE\r\n");
+    printf("  OTA UPDATE COMPLETED!\r\n");
     printf("========================================\r\n");
-    printf("Application v1.0 running from Bank A\r\n");
-    printf("LED blinking on PG13...\r\n");
+    printf("Rebooting into the new image in %lu ms...\r\n", (uint32_t)APP_ACTIVATE_DELAY_MS);
 
-    while (1) {
-        HAL_GPIO_WritePin(GPIOG, GPIO_PIN_13, GPIO_PIN_SET);
-        HAL_Delay(300);
-        HAL_GPIO_WritePin(GPIOG, GPIO_PIN_13, GPIO_PIN_RESET);
-        HAL_Delay(300);
-    }
+    stats_tick(NULL);
+
+    sched_timer_init(&activate_led_timer, activate_led_toggle, NULL);
+    sched_timer_start(&activate_led_timer, 0, 150);
+
+    sched_timer_init(&activate_timer, system_reset, NULL);
+    sched_timer_start(&activate_timer, APP_ACTIVATE_DELAY_MS, 0);
 }
 
 /**
- * @brief Enter OTA update mode
- *
- * Called after check_for_ota_start_packet() has already:
- *   - Received and validated the START packet
- *   - Populated ctx via ota_process_start_packet()
- *   - Erased the target bank
- *   - Sent the ACK
- *
- * This function only needs to handle DATA and END packets.
- *
- * @param ctx Pre-populated OTA context (state == OTA_STATE_RECEIVING_DATA)
+ * @brief Run normal application (LED blink) with OTA in the background
  */
-static void enter_ota_mode(ota_context_t *ctx) {
+static void run_normal_application(void) {
     printf("\r\n");
     printf("========================================\r\n");
-    printf("  ENTERING OTA UPDATE MODE\r\n");
+    printf("  NORMAL APPLICATION MODE\r\n");
     printf("========================================\r\n");
+    printf("Application v%lu.%lu.%lu running from slot %d\r\n",
+           (app_image_header.fw_version >> 24) & 0xFF,
+           (app_image_header.fw_version >> 16) & 0xFF,
+           app_image_header.fw_version & 0xFFFF,
+           flash_slot_index(SCB->VTOR));
+    printf("LED blinking on PG13...\r\n");
 
-    /* Receive DATA and END packets until complete */
-    ota_uart_receive_loop(ctx);
+    sched_timer_init(&led_timer, led_toggle, NULL);
+    sched_timer_start(&led_timer, APP_LED_PERIOD_MS, APP_LED_PERIOD_MS);
 
-    /* ota_uart_receive_loop returns only on OTA_STATE_COMPLETE or abort.
-       Boot state has already been updated inside ota_process_end_packet(). */
-    if (ctx->state == OTA_STATE_COMPLETE) {
-        printf("\r\n");
-        printf("========================================\r\n");
-        printf("  OTA UPDATE COMPLETED!\r\n");
-        printf("========================================\r\n");
+    sched_timer_init(&confirm_timer, confirm_image, NULL);
+    sched_timer_start(&confirm_timer, APP_CONFIRM_AFTER_MS, 0);
 
-        for (int i = 0; i < 10; i++) {
-            HAL_GPIO_TogglePin(GPIOG, GPIO_PIN_14);
-            HAL_Delay(150);
-        }
+    sched_timer_init(&probe_timer, latency_probe, NULL);
+    sched_timer_start(&probe_timer, APP_PROBE_PERIOD_MS, APP_PROBE_PERIOD_MS);
 
-        printf("Rebooting in 3 seconds...\r\n");
-        HAL_Delay(3000);
-    } else {
-        printf("OTA failed or aborted. Rebooting...\r\n");
-        HAL_Delay(1000);
+    sched_timer_init(&stats_timer, stats_tick, NULL);
+    sched_timer_start(&stats_timer, APP_STATS_PERIOD_MS, APP_STATS_PERIOD_MS);
+
+    sched_post(background_init, NULL);
+
+    /* Updates arrive on the OTA link at any time and are written by the flash
+       task between the application's own callbacks, within the
+       governor's default budget */
+    ota_gov_init(NULL);
+    flash_task_init();
+    if (ota_link_pick(&ota_ctx, ota_links, sizeof(ota_links) / sizeof(ota_links[0]),
+                      activate_update) == NULL) {
+        printf("WARNING: No OTA link, updates disabled\r\n");
     }
 
-    NVIC_SystemReset();
+    /* Everything from here on is timers and work; the core sleeps between */
+    sched_run();
 }
 
 /* USER CODE END 0 */
@@ -269,44 +347,72 @@ static void enter_ota_mode(ota_context_t *ctx) {
   */
 int main(void)
 {
+    /* The bootloader starts DWT at reset, so this is reset -> main */
+    uint32_t main_cycles = DWT->CYCCNT;
+
     /* MCU Configuration */
     HAL_Init();
-    SystemClock_Config();
-
-    /* Initialize peripherals */
-    MX_GPIO_Init();
-    MX_CRC_Init();
-    MX_DMA2D_Init();
-    MX_FMC_Init();
-    MX_I2C3_Init();
-    MX_LTDC_Init();
-    MX_SPI5_Init();
-    MX_TIM1_Init();
-    MX_USART1_UART_Init();
-    MX_USART2_UART_Init();
-    MX_USB_HOST_Init();
+
+    /* Clocks, CRC and the debug UART are kept from the bootloader when it
+       handed them over and they check out (boot_handoff.h) */
+    const boot_handoff_t *handoff = boot_handoff_get();
+    app_handoff = handoff;
+    int clocks_adopted = (boot_handoff_adopt_clocks(handoff, APP_SYSCLK_HZ) == 0);
+    if (!clocks_adopted) {
+        SystemClock_Config();
+    }
+
+    sched_init();
+
+    /* Critical path only; the rest comes up later (periph_init.h) */
+    periph_init_register(app_periphs);
+    periph_init_critical();
+
+    uint32_t init_cycles = DWT->CYCCNT - main_cycles;
 
     printf("\r\n");
     printf("========================================\r\n");
     printf("  STM32F429 APPLICATION STARTUP\r\n");
     printf("========================================\r\n");
-    printf("Firmware Version: 1.2\r\n");
-    printf("Running from: Bank A (0x%08X)\r\n", BANK_A_ADDRESS);
+    printf("Firmware Version: %lu.%lu.%lu\r\n",
+           (app_image_header.fw_version >> 24) & 0xFF,
+           (app_image_header.fw_version >> 16) & 0xFF,
+           app_image_header.fw_version & 0xFFFF);
+    /* The same relocatable image runs from any slot; the bootloader
+       points VTOR at whichever slot it jumped to. */
+    printf("Running from: slot %d (0x%08lX)\r\n", flash_slot_index(SCB->VTOR), SCB->VTOR);
     printf("USART1 Baud Rate: 115200 (VCP)\r\n");
-    printf("USART2 Baud Rate: 9600 (HM-10)\r\n\r\n");
-
-    /* Initialize OTA context before the check so we can pass it through */
-    ota_context_t ota_ctx;
-    ota_init(&ota_ctx);
-
-    /* Check for OTA request */
-    if (check_for_ota_start_packet(OTA_WAIT_TIMEOUT_MS, &ota_ctx)) {
-        enter_ota_mode(&ota_ctx);
-        /* Never returns - resets inside enter_ota_mode */
+    printf("USART2 Baud Rate: 9600 (HM-10)\r\n");
+
+    /* Startup cost. Cycles run at 16 MHz (HSI) until the bootloader's
+       SystemClock_Config() and at SYSCLK after it. These lines are the
+       measurement the handoff was meant to be judged by; no figures have
+       been taken on hardware yet, before or after. "Critical init" with
+       clocks and USART1 "configured" is the full-init baseline. */
+    if (handoff != NULL) {
+        printf("Boot: %s reset, slot %lu%s, trial %lu\r\n",
+               boot_handoff_reason_name(handoff->boot_reason), handoff->slot,
+               handoff->slot_status == BANK_STATUS_TESTING ? " (testing)" : "",
+               handoff->trial_attempt);
+        printf("Reset -> jump: %lu cycles, jump -> main: %lu cycles\r\n",
+               handoff->jump_cycles, main_cycles - handoff->jump_cycles);
     } else {
-        run_normal_application();
-        /* Never returns - infinite loop */
+        printf("Boot: no handoff from bootloader\r\n");
     }
+    printf("Critical init: %lu cycles (clocks %s, USART1 %s)\r\n\r\n", init_cycles,
+           clocks_adopted ? "adopted" : "configured", uart_adopted ? "adopted" : "configured");
+
+#ifdef OTA_CRC_BENCHMARK
+    /* CPU vs DMA CRC over the running image (128KB fits either bank) */
+    ota_crc_benchmark(SCB->VTOR, 128 * 1024);
+#endif
+
+    /* Kicked from the event loop (boot_trial.h) */
+    sched_timer_init(&watchdog_timer, watchdog_tick, NULL);
+    sched_timer_start(&watchdog_timer, APP_WATCHDOG_KICK_MS, APP_WATCHDOG_KICK_MS);
+
+    run_normal_application();
+    /* Never returns - event loop */
 
     while (1) { }
 }
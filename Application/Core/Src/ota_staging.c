@@ -0,0 +1,129 @@
+/*
+ * ota_staging.c
+ * Receive-into-SDRAM, program-at-END staging for OTA transfers
+ */
+
+#include "ota_staging.h"
+#include "ota_manager.h"
+#include "periph_init.h"
+#include "flash_task.h"
+#include "flash_layout.h"
+#include "ota_log.h"
+#include "main.h"
+#include <string.h>
+
+extern SDRAM_HandleTypeDef hsdram1;
+
+// SDRAM mode register (IS42S16400J): burst length 1, sequential,
+// CAS latency 3, standard mode, single write burst
+#define SDRAM_MODEREG_BURST_LENGTH_1             0x0000
+#define SDRAM_MODEREG_BURST_TYPE_SEQUENTIAL      0x0000
+#define SDRAM_MODEREG_CAS_LATENCY_3              0x0030
+#define SDRAM_MODEREG_OPERATING_MODE_STANDARD    0x0000
+#define SDRAM_MODEREG_WRITEBURST_MODE_SINGLE     0x0200
+
+// 64ms / 4096 rows = 15.62us per row at SDCLK = HCLK/2 = 36MHz,
+// minus the 20-cycle safety margin from RM0090
+#define SDRAM_REFRESH_COUNT     542
+#define SDRAM_CMD_TIMEOUT       0xFFFF
+
+static uint8_t staging_ready = 0;
+
+static int sdram_send(uint32_t mode, uint32_t refresh_count, uint32_t mode_reg) {
+    FMC_SDRAM_CommandTypeDef cmd;
+
+    cmd.CommandMode = mode;
+    cmd.CommandTarget = FMC_SDRAM_CMD_TARGET_BANK2;
+    cmd.AutoRefreshNumber = refresh_count;
+    cmd.ModeRegisterDefinition = mode_reg;
+
+    return (HAL_SDRAM_SendCommand(&hsdram1, &cmd, SDRAM_CMD_TIMEOUT) == HAL_OK) ? 0 : -1;
+}
+
+int ota_staging_init(void) {
+    if (staging_ready) {
+        return 0;
+    }
+
+    // FMC may still be waiting for background init
+    if (periph_require(PERIPH_FMC) != 0) {
+        return -1;
+    }
+
+    if (sdram_send(FMC_SDRAM_CMD_CLK_ENABLE, 1, 0) != 0) return -1;
+    HAL_Delay(1);  // >= 100us power-up delay
+
+    if (sdram_send(FMC_SDRAM_CMD_PALL, 1, 0) != 0) return -1;
+    if (sdram_send(FMC_SDRAM_CMD_AUTOREFRESH_MODE, 4, 0) != 0) return -1;
+    if (sdram_send(FMC_SDRAM_CMD_LOAD_MODE, 1,
+                   SDRAM_MODEREG_BURST_LENGTH_1 |
+                   SDRAM_MODEREG_BURST_TYPE_SEQUENTIAL |
+                   SDRAM_MODEREG_CAS_LATENCY_3 |
+                   SDRAM_MODEREG_OPERATING_MODE_STANDARD |
+                   SDRAM_MODEREG_WRITEBURST_MODE_SINGLE) != 0) return -1;
+
+    if (HAL_SDRAM_ProgramRefreshRate(&hsdram1, SDRAM_REFRESH_COUNT) != HAL_OK) {
+        return -1;
+    }
+
+    // Quick read-back so a missing/unpowered SDRAM falls back to direct writes
+    volatile uint32_t *probe = (volatile uint32_t*)OTA_STAGING_ADDRESS;
+    *probe = 0xA5A5F00D;
+    if (*probe != 0xA5A5F00D) {
+        OTA_LOG_ERROR("ERROR: SDRAM read-back failed at 0x%08lX\r\n", (uint32_t)OTA_STAGING_ADDRESS);
+        return -1;
+    }
+
+    staging_ready = 1;
+    OTA_LOG_INFO("SDRAM staging ready at 0x%08lX (%lu KB)\r\n",
+                 (uint32_t)OTA_STAGING_ADDRESS, (uint32_t)(OTA_STAGING_SIZE / 1024));
+    return 0;
+}
+
+int ota_staging_write(uint32_t offset, const uint8_t *data, uint16_t size) {
+    if (!staging_ready || offset + size > OTA_STAGING_SIZE) {
+        return -1;
+    }
+
+    memcpy((uint8_t*)(OTA_STAGING_ADDRESS + offset), data, size);
+    return 0;
+}
+
+// ota_reloc_feed()'s writer, run inside a flash task step
+static int staging_program(uint32_t address, const void *data, uint16_t size) {
+    if (flash_program(address, data, size) != 0) {
+        OTA_LOG_ERROR("ERROR: Program failed at 0x%08lX\r\n", address);
+        return -1;
+    }
+    return 0;
+}
+
+static ota_reloc_state_t *commit_reloc;
+static uint32_t commit_size;
+static uint32_t commit_offset;
+
+// One chunk per flash task step; the source is SDRAM, so the link is no
+// longer waiting on flash and the application runs between chunks
+static int commit_step(void *arg) {
+    const uint8_t *stream = (const uint8_t*)OTA_STAGING_ADDRESS;
+    uint32_t remaining = commit_size - commit_offset;
+    uint16_t n = (remaining > OTA_CHUNK_SIZE) ? OTA_CHUNK_SIZE : (uint16_t)remaining;
+
+    if (ota_reloc_feed(commit_reloc, commit_offset, &stream[commit_offset], n, staging_program) != 0) {
+        return -1;
+    }
+    commit_offset += n;
+    return (commit_offset < commit_size) ? 1 : 0;
+}
+
+int ota_staging_commit(ota_reloc_state_t *reloc, uint32_t size, flash_task_done_t done, void *arg) {
+    if (!staging_ready || size == 0 || size > OTA_STAGING_SIZE) {
+        return -1;
+    }
+
+    commit_reloc = reloc;
+    commit_size = size;
+    commit_offset = 0;
+
+    return flash_task_program(commit_step, done, arg);
+}
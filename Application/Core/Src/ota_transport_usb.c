@@ -0,0 +1,151 @@
+/*
+ * ota_transport_usb.c
+ * OTA transport over the USB CDC host class (see ota_transport_usb.h)
+ */
+
+#include "ota_transport_usb.h"
+#include "periph_init.h"
+#include "sched.h"
+#include "main.h"
+#include "usb_host.h"
+#include "usbh_cdc.h"
+#include <stdio.h>
+#include <string.h>
+
+extern USBH_HandleTypeDef hUsbHostHS;
+extern ApplicationTypeDef Appli_state;
+
+static int usb_open(ota_transport_t *t);
+static void usb_close(ota_transport_t *t);
+static int usb_send(ota_transport_t *t, const void *data, uint16_t size);
+static int usb_recv(ota_transport_t *t, void *buf, uint16_t size);
+
+ota_transport_t ota_usb = {
+    .name = "USB CDC",
+    .mtu = OTA_USB_PACKET_SIZE,
+    .bytes_per_sec = OTA_USB_LINE_BAUD / 10,
+    .rx_window = OTA_USB_RX_RING_SIZE,
+    .open = usb_open,
+    .close = usb_close,
+    .send = usb_send,
+    .recv = usb_recv,
+};
+
+static uint8_t opened;
+static sched_timer_t process_timer;
+
+// Filled by the receive callback, drained by recv()
+static uint8_t rx_packet[OTA_USB_PACKET_SIZE];
+static uint8_t rx_ring[OTA_USB_RX_RING_SIZE];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+static uint32_t rx_dropped;
+
+static uint8_t tx_packet[OTA_USB_PACKET_SIZE];
+static volatile uint8_t tx_busy;
+
+// The host stack is a state machine; it only moves when this runs
+static void usb_process(void *arg) {
+    MX_USB_HOST_Process();
+}
+
+static int usb_open(ota_transport_t *t) {
+    if (periph_require(PERIPH_USB_HOST) != 0) {
+        return -1;
+    }
+
+    sched_timer_init(&process_timer, usb_process, NULL);
+    sched_timer_start(&process_timer, 0, 1);
+
+    uint32_t start = HAL_GetTick();
+    while (Appli_state != APPLICATION_READY) {
+        if (HAL_GetTick() - start > OTA_USB_ENUM_TIMEOUT_MS) {
+            sched_timer_stop(&process_timer);
+            return -1;
+        }
+        MX_USB_HOST_Process();
+        sched_sleep();
+    }
+
+    CDC_LineCodingTypeDef coding = {0};
+    coding.b.dwDTERate = OTA_USB_LINE_BAUD;
+    coding.b.bCharFormat = 0;   // 1 stop bit
+    coding.b.bParityType = 0;
+    coding.b.bDataBits = 8;
+    USBH_CDC_SetLineCoding(&hUsbHostHS, &coding);
+
+    rx_head = rx_tail = rx_dropped = 0;
+    tx_busy = 0;
+    opened = 1;
+
+    USBH_CDC_Receive(&hUsbHostHS, rx_packet, sizeof(rx_packet));
+    return 0;
+}
+
+static void usb_close(ota_transport_t *t) {
+    opened = 0;
+    USBH_CDC_Stop(&hUsbHostHS);
+    sched_timer_stop(&process_timer);
+
+    if (rx_dropped) {
+        printf("%s: %lu bytes dropped\r\n", t->name, rx_dropped);
+    }
+}
+
+static int usb_send(ota_transport_t *t, const void *data, uint16_t size) {
+    if (!opened || Appli_state != APPLICATION_READY) {
+        return -1;  // Unplugged
+    }
+    if (tx_busy) {
+        return 0;
+    }
+
+    uint16_t n = (size > sizeof(tx_packet)) ? sizeof(tx_packet) : size;
+    memcpy(tx_packet, data, n);
+
+    tx_busy = 1;
+    if (USBH_CDC_Transmit(&hUsbHostHS, tx_packet, n) != USBH_OK) {
+        tx_busy = 0;
+        return 0;
+    }
+    return n;
+}
+
+static int usb_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    uint8_t *bytes = buf;
+    uint16_t n = 0;
+
+    if (!opened || Appli_state != APPLICATION_READY) {
+        return -1;
+    }
+    while (n < size && rx_tail != rx_head) {
+        bytes[n++] = rx_ring[rx_tail % OTA_USB_RX_RING_SIZE];
+        rx_tail++;
+    }
+    return n;
+}
+
+// Called from MX_USB_HOST_Process(), i.e. from the event loop
+void USBH_CDC_TransmitCallback(USBH_HandleTypeDef *phost) {
+    tx_busy = 0;
+}
+
+void USBH_CDC_ReceiveCallback(USBH_HandleTypeDef *phost) {
+    uint16_t n = USBH_CDC_GetLastReceivedDataSize(phost);
+
+    for (uint16_t i = 0; i < n; i++) {
+        if (rx_head - rx_tail < OTA_USB_RX_RING_SIZE) {
+            rx_ring[rx_head % OTA_USB_RX_RING_SIZE] = rx_packet[i];
+            rx_head++;
+        } else {
+            rx_dropped++;
+        }
+    }
+
+    if (opened) {
+        USBH_CDC_Receive(phost, rx_packet, sizeof(rx_packet));
+        if (n > 0 && ota_usb.rx_ready != NULL) {
+            ota_usb.rx_ready();
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * periph_init.c
+ * Dependency resolution, deferral and timing for peripheral init
+ */
+
+#include "periph_init.h"
+#include "main.h"
+#include <stdio.h>
+
+typedef enum {
+    PERIPH_STATE_OFF = 0,
+    PERIPH_STATE_BUSY,          // Resolving dependencies (cycle detection)
+    PERIPH_STATE_READY
+} periph_state_t;
+
+typedef enum {
+    PHASE_CRITICAL = 0,
+    PHASE_BACKGROUND,
+    PHASE_ON_DEMAND
+} periph_phase_t;
+
+typedef struct {
+    periph_state_t state;
+    uint8_t order;              // Init sequence number, 1-based
+    uint8_t phase;              // periph_phase_t it came up in
+    uint32_t cycles;            // Own init time, dependencies excluded
+    uint32_t at_ms;             // HAL tick when it finished
+} periph_status_t;
+
+static const char *const phase_names[] = { "critical", "background", "on demand" };
+
+static const periph_desc_t *periphs;
+static periph_status_t status[PERIPH_COUNT];
+static uint8_t next_order = 1;
+static periph_phase_t current_phase = PHASE_ON_DEMAND;
+
+void periph_init_register(const periph_desc_t table[PERIPH_COUNT]) {
+    periphs = table;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+int periph_is_ready(periph_id_t id) {
+    return id < PERIPH_COUNT && status[id].state == PERIPH_STATE_READY;
+}
+
+int periph_require(periph_id_t id) {
+    if (periphs == NULL || id >= PERIPH_COUNT) {
+        return -1;
+    }
+
+    periph_status_t *st = &status[id];
+    if (st->state == PERIPH_STATE_READY) {
+        return 0;
+    }
+    if (st->state == PERIPH_STATE_BUSY) {
+        printf("ERROR: periph %s: dependency cycle\r\n", periphs[id].name);
+        return -1;
+    }
+
+    st->state = PERIPH_STATE_BUSY;
+    for (uint32_t dep = 0; dep < PERIPH_COUNT; dep++) {
+        if ((periphs[id].deps & PERIPH_BIT(dep)) && periph_require((periph_id_t)dep) != 0) {
+            st->state = PERIPH_STATE_OFF;
+            return -1;
+        }
+    }
+
+    uint32_t start = DWT->CYCCNT;
+    periphs[id].init();
+    st->cycles = DWT->CYCCNT - start;
+    st->at_ms = HAL_GetTick();
+    st->order = next_order++;
+    st->phase = current_phase;
+    st->state = PERIPH_STATE_READY;
+    return 0;
+}
+
+void periph_init_critical(void) {
+    current_phase = PHASE_CRITICAL;
+    for (uint32_t id = 0; id < PERIPH_COUNT; id++) {
+        if (periphs[id].policy == PERIPH_CRITICAL) {
+            periph_require((periph_id_t)id);
+        }
+    }
+    current_phase = PHASE_ON_DEMAND;
+}
+
+int periph_init_background_step(void) {
+    for (uint32_t id = 0; id < PERIPH_COUNT; id++) {
+        if (periphs[id].policy == PERIPH_BACKGROUND && status[id].state == PERIPH_STATE_OFF) {
+            current_phase = PHASE_BACKGROUND;
+            periph_require((periph_id_t)id);
+            current_phase = PHASE_ON_DEMAND;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void periph_init_report(void) {
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    uint32_t total = 0;
+
+    printf("\r\n--- Peripheral init (%lu MHz) ---\r\n", cycles_per_us);
+    printf("  #  %-9s %-10s %10s %8s %8s\r\n", "periph", "phase", "cycles", "us", "at ms");
+
+    for (uint8_t order = 1; order < next_order; order++) {
+        for (uint32_t id = 0; id < PERIPH_COUNT; id++) {
+            const periph_status_t *st = &status[id];
+            if (st->state != PERIPH_STATE_READY || st->order != order) {
+                continue;
+            }
+            printf(" %2u  %-9s %-10s %10lu %8lu %8lu\r\n", order, periphs[id].name,
+                   phase_names[st->phase], st->cycles, st->cycles / cycles_per_us, st->at_ms);
+            total += st->cycles;
+        }
+    }
+
+    for (uint32_t id = 0; id < PERIPH_COUNT; id++) {
+        if (status[id].state != PERIPH_STATE_READY) {
+            printf("     %-9s %-10s not initialised\r\n", periphs[id].name,
+                   periphs[id].policy == PERIPH_ON_DEMAND ? "on demand" : "background");
+        }
+    }
+    printf("  total %lu cycles (%lu us)\r\n", total, total / cycles_per_us);
+}
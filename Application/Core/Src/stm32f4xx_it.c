@@ -22,6 +22,8 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "ota_crc.h"
+#include "ota_transport_uart.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -64,6 +66,7 @@ extern TIM_HandleTypeDef htim6;
 // Debug counter to verify SysTick_Handler is being called
 volatile uint32_t systick_call_count = 0;
 volatile uint32_t *uwtick_addr_isr = 0;  // Address of uwTick in ISR
+extern ota_transport_t ota_usart2;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -262,4 +265,28 @@ void DMA2D_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA2 stream0 global interrupt (OTA CRC feed).
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  ota_crc_irq_handler();
+}
+
+/**
+  * @brief This function handles USART2 global interrupt (background OTA link).
+  */
+void USART2_IRQHandler(void)
+{
+  ota_transport_uart_irq(&ota_usart2);
+}
+
+/**
+  * @brief This function handles FLASH global interrupt (flash_task erases).
+  */
+void FLASH_IRQHandler(void)
+{
+  HAL_FLASH_IRQHandler();
+}
+
 /* USER CODE END 1 */
@@ -1,15 +1,44 @@
 #!/usr/bin/env python3
 """
 BLE OTA Firmware Uploader for STM32F429
+
+DATA packets go out in a window: every ACK carries a credit grant (how
+many packets the device can queue, see ota_protocol.h) and the sender
+keeps up to that many unanswered. Writes without response are paced at
+the delivery rate measured from the ACKs instead of a fixed sleep, so
+the HM-10's buffer is kept fed but not overrun. A NACK or a silent link
+rewinds to the device's last_chunk_received; the live line shows
+goodput, pace, window, RTT and retries.
+
+    python ble_ota_uploader_v3.py Debug/Basic-Application.bin
+    python ble_ota_uploader_v3.py firmware.bin --simulate --loss 0.01
+    python ble_ota_uploader_v3.py firmware.bin --window 1    (stop-and-wait)
+    python ble_ota_uploader_v3.py firmware.bin --fec 4       (PARITY per 4 chunks)
+
+--fec K follows every K chunks with a PARITY packet, from which the
+device rebuilds one lost or damaged chunk per group instead of NACKing
+it; it costs 1/K more bytes and saves a round trip per repaired loss.
+
+--simulate runs against ota_sim_device.py instead of the HM-10 and
+does not need bleak. Firmware that predates credits sends 0 in an ACK,
+which the sender treats as a window of 1.
 """
 
+import argparse
 import asyncio
-from bleak import BleakClient, BleakScanner
+from collections import deque
 import struct
 import zlib
 import sys
 import os
 
+from ota_wire_layout import (DATA_HEADER_FORMAT, DATA_HEADER_SIZE, DATA_PACKET_SIZE, END_FORMAT,
+                             OTA_BUSY_RETRY_MS, OTA_CHUNK_SIZE, OTA_ERR_BUSY, OTA_ERR_CRC,
+                             OTA_ERR_SEQUENCE, OTA_FEC_MAX_GROUP, OTA_MAGIC_DATA, OTA_MAGIC_START,
+                             OTA_MAX_CREDITS, OTA_PKT_ACK, OTA_PKT_DATA, OTA_PKT_END, OTA_PKT_NACK,
+                             OTA_PKT_PARITY, OTA_PKT_START, OTA_TARGET_AUTO as TARGET_AUTO,
+                             RESPONSE_FORMAT, RESPONSE_PACKET_SIZE, START_FORMAT)
+
 # --- CONFIGURATION ---
 UART_SERVICE_UUID = "0000FFE0-0000-1000-8000-00805F9B34FB"
 UART_TX_CHAR_UUID = "0000FFE1-0000-1000-8000-00805F9B34FB"
@@ -17,30 +46,35 @@ UART_TX_CHAR_UUID = "0000FFE1-0000-1000-8000-00805F9B34FB"
 HM10_ADDRESS = "68:5E:1C:2B:63:2A"
 FIRMWARE_FILE = "Debug/Basic-Bootloader.bin"
 
-# Protocol Constants (must match ota_protocol.h)
-OTA_MAGIC_START = 0xAA55AA55
-OTA_MAGIC_DATA  = 0x55AA55AA
-
-OTA_PKT_START = 0x01
-OTA_PKT_DATA  = 0x02
-OTA_PKT_END   = 0x03
-OTA_PKT_ACK   = 0x04
-OTA_PKT_NACK  = 0x05
-
-OTA_CHUNK_SIZE = 1024
-
+OTA_BUSY_MAX_RETRIES = 200   # ~20 s of back-pressure before giving up
+RESPONSE_MAGIC = struct.pack('<I', OTA_MAGIC_START)
+
+# Sender tuning
+BLE_WRITE_SIZE = 20          # ATT payload of a BLE 4.0 write (HM-10)
+INITIAL_RATE = 900           # Bytes/s until ACKs say otherwise (9600 baud UART = 960)
+MIN_RATE = 200
+MIN_RTO = 1.0                # Seconds
+INITIAL_RTO = 5.0
+MAX_RTO = 30.0
+START_WORK = 5.0             # START and END wait for flash work on top of the RTO
+END_WORK = 10.0
+MAX_TIMEOUTS = 6             # In a row, without progress
+MAX_REWINDS = 20             # In a row, without progress
+
+# target_bank is a slot index (0 = bank A, 1 = bank B, 2.. = extra slots)
+# or TARGET_AUTO to let the device overwrite its least valuable slot
 BANK_A = 0x00
 BANK_B = 0x01
 
 
-def create_start_packet(firmware_data, target_bank=BANK_B):
+def create_start_packet(firmware_data, target_bank=TARGET_AUTO):
     firmware_size = len(firmware_data)
     firmware_crc = zlib.crc32(firmware_data) & 0xFFFFFFFF
     total_chunks = (firmware_size + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE
     firmware_version = 0x02000100  # Version 2.0.1
 
     packet = struct.pack(
-        '<I B I I I I B',
+        START_FORMAT,
         OTA_MAGIC_START,
         OTA_PKT_START,
         firmware_size,
@@ -54,7 +88,7 @@ def create_start_packet(firmware_data, target_bank=BANK_B):
     print(f"  Firmware Size: {firmware_size} bytes")
     print(f"  Firmware CRC32: 0x{firmware_crc:08X}")
     print(f"  Total Chunks: {total_chunks}")
-    print(f"  Target Bank: {'Bank B' if target_bank == BANK_B else 'Bank A'}")
+    print(f"  Target Slot: {'auto' if target_bank == TARGET_AUTO else target_bank}")
     print(f"  Packet Size: {len(packet)} bytes")
 
     return packet
@@ -67,7 +101,7 @@ def create_data_packet(chunk_number, chunk_data):
     padded_data = chunk_data + b'\xFF' * (OTA_CHUNK_SIZE - chunk_size)
 
     packet = struct.pack(
-        '<I B I H I',
+        DATA_HEADER_FORMAT,
         OTA_MAGIC_DATA,
         OTA_PKT_DATA,
         chunk_number,
@@ -78,166 +112,463 @@ def create_data_packet(chunk_number, chunk_data):
     return packet, chunk_crc
 
 
+def create_parity_packet(first, group, packets):
+    """XOR of the group's DATA data fields, as sent (see ota_protocol.h)"""
+    parity = 0
+    for packet in packets:
+        parity ^= int.from_bytes(packet[DATA_HEADER_SIZE:], 'little')
+    data = parity.to_bytes(OTA_CHUNK_SIZE, 'little')
+    return struct.pack(DATA_HEADER_FORMAT, OTA_MAGIC_DATA, OTA_PKT_PARITY, first, group,
+                       zlib.crc32(data) & 0xFFFFFFFF) + data
+
+
 def create_end_packet():
-    return struct.pack('<I B', OTA_MAGIC_START, OTA_PKT_END)
+    return struct.pack(END_FORMAT, OTA_MAGIC_START, OTA_PKT_END)
 
 
 def parse_response_packet(data):
-    if len(data) < 10:
+    if len(data) < RESPONSE_PACKET_SIZE:
         return None
     try:
-        magic, pkt_type, error_code, last_chunk = struct.unpack('<I B B I', data[:10])
+        magic, pkt_type, error_code, last_chunk = struct.unpack(RESPONSE_FORMAT, data[:RESPONSE_PACKET_SIZE])
         return {
             'magic': magic,
             'type': pkt_type,
             'error_code': error_code,
+            'credits': error_code,      # Same byte; meaningful in an ACK
             'last_chunk': last_chunk
         }
     except Exception:
         return None
 
 
+class Pacer:
+    """
+    Spaces writes without response so the HM-10 is kept fed but its
+    buffer never overruns. Anything written faster than its UART drains
+    waits in that buffer, and shows up as round trip time above the
+    quickest seen: (rtt - min_rtt) x delivery rate is how many bytes are
+    queued there. While fewer than QUEUE_LOW are, the pace rises by STEP
+    per ACK (to at most twice the delivery rate, which only matters
+    where the radio rather than the UART is the limit); up to QUEUE_HIGH
+    it matches the delivery rate, and past that drops below it so the
+    queue drains. A lost write says nothing about the rate, so losses do
+    not slow it down.
+    """
+    QUEUE_LOW = 100         # Bytes; an HM-10 holds a few hundred
+    QUEUE_HIGH = 300
+    STEP = 1.1
+    DRAIN = 0.9
+    RATE_WINDOW_S = 2.0
+    SLACK_S = 0.01          # Sleeps that overrun by this much are made up
+
+    def __init__(self, rate, max_rate):
+        self.rate = rate
+        self.max_rate = max_rate
+        self.next_time = 0.0
+        self.min_rtt = None
+        self.queued = 0
+        self.acks = deque()     # (time, bytes acknowledged so far)
+        self.delivered = 0
+
+    async def wait(self, size):
+        loop = asyncio.get_running_loop()
+        now = loop.time()
+        if self.next_time > now:
+            await asyncio.sleep(self.next_time - now)
+        self.next_time = max(self.next_time, now - self.SLACK_S) + size / self.rate
+
+    @property
+    def delivery_rate(self):
+        if len(self.acks) < 2 or self.acks[-1][0] <= self.acks[0][0]:
+            return None
+        return (self.acks[-1][1] - self.acks[0][1]) / (self.acks[-1][0] - self.acks[0][0])
+
+    def on_delivered(self, now, size, rtt):
+        """size more bytes acknowledged; rtt is None for a resent packet"""
+        self.delivered += size
+        self.acks.append((now, self.delivered))
+        while len(self.acks) > 2 and self.acks[0][0] < now - self.RATE_WINDOW_S:
+            self.acks.popleft()
+        if rtt is None:
+            return
+
+        delivered = self.delivery_rate or self.rate
+        self.min_rtt = rtt if self.min_rtt is None else min(self.min_rtt, rtt)
+        self.queued = (rtt - self.min_rtt) * delivered
+
+        if self.queued > self.QUEUE_HIGH:
+            self.rate = max(MIN_RATE, min(self.rate, delivered * self.DRAIN))
+        elif self.queued > self.QUEUE_LOW:
+            self.rate = max(MIN_RATE, min(self.rate, delivered))
+        else:
+            ceiling = min(self.max_rate, 2 * delivered)
+            self.rate = max(self.rate, min(ceiling, self.rate * self.STEP))
+
+
 class OTAUploader:
-    def __init__(self, client, characteristic_uuid):
+    def __init__(self, client, characteristic_uuid, write_size=BLE_WRITE_SIZE,
+                 rate=INITIAL_RATE, max_rate=1e9, max_window=OTA_MAX_CREDITS, fec=0):
         self.client = client
         self.char_uuid = characteristic_uuid
+        self.write_size = write_size
+        self.max_window = max_window
+        self.fec = fec                  # Chunks per PARITY packet, 0 = none
+        self.pacer = Pacer(rate, max_rate)
+
         self.response_data = bytearray()
-        self.response_event = asyncio.Event()
+        self.responses = asyncio.Queue()
+        self.credits = 1
+
+        self.busy_count = 0
+        self.nack_count = 0
+        self.timeout_count = 0
+        self.retransmitted = 0
+        self.srtt = None
+        self.rttvar = None
+        self.rto = INITIAL_RTO
 
     def notification_handler(self, sender, data):
         self.response_data.extend(data)
-        if len(self.response_data) >= 10:
-            self.response_event.set()
+        while True:
+            start = self.response_data.find(RESPONSE_MAGIC)
+            if start < 0:
+                del self.response_data[:-3]     # Keep a partial magic
+                return
+            del self.response_data[:start]
+            if len(self.response_data) < RESPONSE_PACKET_SIZE:
+                return
+            response = parse_response_packet(self.response_data)
+            response['time'] = asyncio.get_running_loop().time()    # RTT ends here, not when read
+            self.responses.put_nowait(response)
+            del self.response_data[:RESPONSE_PACKET_SIZE]
+
+    async def write(self, packet):
+        """Write without response, paced"""
+        for offset in range(0, len(packet), self.write_size):
+            piece = packet[offset:offset + self.write_size]
+            await self.pacer.wait(len(piece))
+            await self.client.write_gatt_char(self.char_uuid, piece, response=False)
 
     async def send_packet(self, packet, packet_name, wait_for_ack=False, timeout=10.0):
-        MAX_BLE_WRITE_SIZE = 20
+        """Send a packet; while the device answers BUSY, wait and resend it"""
+        for _ in range(OTA_BUSY_MAX_RETRIES):
+            result = await self.send_packet_once(packet, packet_name, wait_for_ack, timeout)
+            if result != OTA_ERR_BUSY:
+                return result
+            self.busy_count += 1
+            await asyncio.sleep(OTA_BUSY_RETRY_MS / 1000)
+
+        print(f"  ✗ Device stayed busy")
+        return False
 
+    async def send_packet_once(self, packet, packet_name, wait_for_ack, timeout):
         print(f"Sending {packet_name} ({len(packet)} bytes)...", end="", flush=True)
 
-        self.response_data.clear()
-        self.response_event.clear()
-
-        offset = 0
-        while offset < len(packet):
-            chunk = packet[offset:offset + MAX_BLE_WRITE_SIZE]
-            await self.client.write_gatt_char(self.char_uuid, chunk, response=False)
-            offset += MAX_BLE_WRITE_SIZE
-            await asyncio.sleep(0.01)
+        while not self.responses.empty():
+            self.responses.get_nowait()
 
+        await self.write(packet)
         print(" [SENT]")
 
         if wait_for_ack:
             try:
-                await asyncio.wait_for(self.response_event.wait(), timeout=timeout)
-
-                response = parse_response_packet(self.response_data)
-                if response:
-                    if response['type'] == OTA_PKT_ACK:
-                        print(f"  ✓ ACK received (last chunk: {response['last_chunk']})")
-                        return True
-                    elif response['type'] == OTA_PKT_NACK:
-                        print(f"  ✗ NACK received (error: {response['error_code']})")
-                        return False
-                else:
-                    print(f"  ? Invalid response: {self.response_data.hex()}")
-                    return False
+                response = await asyncio.wait_for(self.responses.get(), timeout=timeout)
             except asyncio.TimeoutError:
                 print(f"  ⏱ Timeout waiting for ACK")
                 return False
 
+            if response['type'] == OTA_PKT_ACK:
+                self.credits = max(1, response['credits'])
+                print(f"  ✓ ACK received (last chunk: {response['last_chunk']}, "
+                      f"credits: {response['credits']})")
+                return True
+            elif response['type'] == OTA_PKT_NACK and response['error_code'] == OTA_ERR_BUSY:
+                print(f"  … BUSY, resending in {OTA_BUSY_RETRY_MS} ms")
+                return OTA_ERR_BUSY
+            elif response['type'] == OTA_PKT_NACK:
+                print(f"  ✗ NACK received (error: {response['error_code']})")
+                return False
+            print(f"  ? Invalid response: {response}")
+            return False
+
         return True
 
+    def window(self):
+        return max(1, min(self.credits, self.max_window))
+
+    async def send_data(self, firmware_data):
+        """
+        Go-back-N over the credit window. last_chunk_received is
+        cumulative, so any response moves base; a NACK (or a timeout)
+        sends everything from base again. The packets already in flight
+        when that happens will be answered with NACKs too, and those are
+        not counted as new losses.
+
+        With fec set, each group of that many chunks is followed by its
+        PARITY packet, from which the device rebuilds one lost chunk
+        without a NACK; chunks it holds meanwhile are answered with ACKs
+        that do not move base, so the window counts unanswered packets.
+        """
+        loop = asyncio.get_running_loop()
+        packets = [create_data_packet(n, firmware_data[n * OTA_CHUNK_SIZE:(n + 1) * OTA_CHUNK_SIZE])[0]
+                   for n in range((len(firmware_data) + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE)]
+        total = len(packets)
+
+        # Send order: (chunk, packet), chunk None for PARITY; item_of[chunk] is its index
+        items, item_of = [], []
+        for n, packet in enumerate(packets):
+            item_of.append(len(items))
+            items.append((n, packet))
+            if self.fec and ((n + 1) % self.fec == 0 or n + 1 == total):
+                first = n - n % self.fec
+                items.append((None, create_parity_packet(first, self.fec, packets[first:n + 1])))
+        item_of.append(len(items))
+
+        base = 0            # First chunk the device has not acknowledged
+        next_item = 0       # Next to write
+        sent_at = {}        # Chunk -> when its first transmission finished (Karn)
+        resent = set()
+        unanswered = 0      # Packets written and not yet answered
+        stale = 0           # Of those, ones written before the last rewind
+        hold_until = 0.0    # BUSY back-off
+        idle_since = loop.time()
+        timeouts = rewinds = 0
+        start = report_at = loop.time()
+
+        def advance(last, now):
+            nonlocal base, next_item, timeouts, rewinds
+            if last <= base:
+                return
+            rtt = None
+            if last - 1 in sent_at:
+                rtt = now - sent_at[last - 1]
+                if self.srtt is None:
+                    self.srtt, self.rttvar = rtt, rtt / 2
+                else:
+                    self.rttvar += (abs(rtt - self.srtt) - self.rttvar) / 4
+                    self.srtt += (rtt - self.srtt) / 8
+                self.rto = min(MAX_RTO, max(MIN_RTO, self.srtt + 4 * self.rttvar))
+            self.pacer.on_delivered(now, (item_of[last] - item_of[base]) * DATA_PACKET_SIZE, rtt)
+            for c in range(base, last):
+                sent_at.pop(c, None)
+            base = last
+            next_item = max(next_item, item_of[base])
+            timeouts = rewinds = 0
+
+        def rewind():
+            nonlocal next_item, stale, rewinds
+            for c in range(base, total):
+                if item_of[c] >= next_item:
+                    break
+                resent.add(c)
+                sent_at.pop(c, None)
+            self.retransmitted += next_item - item_of[base]
+            next_item = item_of[base]
+            stale = unanswered
+            rewinds += 1
+
+        def handle(response):
+            nonlocal unanswered, stale, hold_until, idle_since
+            now = response['time']
+            idle_since = now
+            unanswered = max(0, unanswered - 1)
+            was_stale = stale > 0
+            stale = max(0, stale - 1)
+
+            advance(response['last_chunk'], now)
+            if response['type'] == OTA_PKT_ACK:
+                self.credits = max(1, response['credits'])
+                return True
+
+            self.nack_count += 1
+            code = response['error_code']
+            if code == OTA_ERR_BUSY:
+                self.busy_count += 1
+                hold_until = now + OTA_BUSY_RETRY_MS / 1000
+                if not was_stale:
+                    rewind()
+                return True
+            if code in (OTA_ERR_CRC, OTA_ERR_SEQUENCE):
+                if not was_stale:
+                    rewind()
+                return rewinds <= MAX_REWINDS
+            print(f"\n  ✗ NACK received (error: {code}) at chunk {base}")
+            return False
+
+        while base < total:
+            now = loop.time()
+            while not self.responses.empty():
+                if not handle(self.responses.get_nowait()):
+                    return False
+            if base >= total:
+                break
+
+            if now - report_at >= 0.5:
+                self.report(base, total, unanswered, now - start)
+                report_at = now
+
+            if next_item < len(items) and unanswered < self.window() and now >= hold_until:
+                chunk, packet = items[next_item]
+                await self.write(packet)
+                now = loop.time()
+                if chunk is not None and chunk not in resent:
+                    sent_at[chunk] = now
+                next_item += 1
+                unanswered += 1
+                idle_since = now
+                continue
+
+            # The next answer needs a whole packet to cross the link first
+            deadline = idle_since + self.rto + DATA_PACKET_SIZE / (self.pacer.delivery_rate or self.pacer.rate)
+            wake = min(deadline, hold_until) if now < hold_until else deadline
+            try:
+                response = await asyncio.wait_for(self.responses.get(),
+                                                  timeout=min(max(0.01, wake - now), 0.5))
+            except asyncio.TimeoutError:
+                now = loop.time()
+                if unanswered and now >= deadline:
+                    self.timeout_count += 1
+                    timeouts += 1
+                    if timeouts > MAX_TIMEOUTS:
+                        print(f"\n  ⏱ No answer for chunk {base} after {timeouts - 1} resends")
+                        return False
+                    rewind()
+                    stale = unanswered = 0
+                    self.rto = min(MAX_RTO, self.rto * 2)
+                    idle_since = now
+                continue
+            if not handle(response):
+                return False
 
-async def upload_firmware(address, firmware_path):
-    print(f"\n{'='*50}")
-    print(f"  BLE OTA FIRMWARE UPLOADER")
-    print(f"{'='*50}\n")
+        # Answers still owed for resent packets would be taken as END's
+        while unanswered > 0:
+            try:
+                await asyncio.wait_for(self.responses.get(), timeout=self.rto)
+            except asyncio.TimeoutError:
+                break
+            unanswered -= 1
+
+        elapsed = loop.time() - start
+        self.report(total, total, 0, elapsed)
+        print()
+        print(f"  {total} chunks in {elapsed:.1f} s: {len(firmware_data) / elapsed / 1024:.2f} KB/s goodput, "
+              f"{self.retransmitted} resent, {self.nack_count} NACKs "
+              f"({self.busy_count} busy), {self.timeout_count} timeouts")
+        return True
 
-    if not os.path.exists(firmware_path):
-        print(f"ERROR: Firmware file not found: {firmware_path}")
+    def report(self, done, total, in_flight, elapsed):
+        goodput = done * OTA_CHUNK_SIZE / elapsed / 1024 if elapsed > 0 else 0
+        rtt = f"{self.srtt * 1000:.0f} ms" if self.srtt is not None else "-"
+        print(f"\r  {done / total * 100:5.1f}% {done}/{total}  {goodput:.2f} KB/s  "
+              f"pace {self.pacer.rate / 1024:.2f} KB/s  queued {self.pacer.queued:.0f} B  "
+              f"window {in_flight}/{self.window()}  "
+              f"rtt {rtt}  resent {self.retransmitted}  nack {self.nack_count}  "
+              f"t/o {self.timeout_count}   ", end="", flush=True)
+
+
+async def run_upload(client, firmware_data, args):
+    uploader = OTAUploader(client, UART_TX_CHAR_UUID,
+                           write_size=min(args.write_size, client.mtu_size - 3),
+                           rate=args.rate, max_rate=args.max_rate, max_window=args.window,
+                           fec=args.fec)
+
+    await client.start_notify(UART_TX_CHAR_UUID, uploader.notification_handler)
+    print("✓ Notifications enabled\n")
+
+    if not args.simulate:
+        print("Waiting for STM32 to enter OTA mode...")
+        await asyncio.sleep(2)
+
+    # --- START packet with retry ---
+    print("--- SENDING START PACKET ---")
+    start_packet = create_start_packet(firmware_data)
+
+    success = False
+    max_retries = 3
+    for attempt in range(max_retries):
+        success = await uploader.send_packet(
+            start_packet, "START", wait_for_ack=True, timeout=START_WORK + uploader.rto)
+        if success:
+            break
+        print(f"  ✗ START attempt {attempt + 1}/{max_retries} failed")
+        uploader.rto = min(MAX_RTO, uploader.rto * 2)
+
+    if not success:
+        print("✗ Failed to send START packet after all retries")
         return False
 
-    with open(firmware_path, 'rb') as f:
-        firmware_data = f.read()
+    print()
 
-    print(f"Loaded firmware: {firmware_path}")
-    print(f"Size: {len(firmware_data)} bytes\n")
-
-    print(f"Connecting to HM-10 at {address}...")
-
-    try:
-        async with BleakClient(address, timeout=20.0) as client:
-            print(f"✓ Connected: {client.is_connected}\n")
+    # --- DATA packets ---
+    total_chunks = (len(firmware_data) + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE
+    fec = f", PARITY every {args.fec}" if args.fec else ""
+    print(f"--- SENDING DATA PACKETS ({total_chunks} chunks, window {uploader.window()}{fec}) ---")
 
-            uploader = OTAUploader(client, UART_TX_CHAR_UUID)
-
-            await client.start_notify(UART_TX_CHAR_UUID, uploader.notification_handler)
-            print("✓ Notifications enabled\n")
-
-            print("Waiting for STM32 to enter OTA mode...")
-            await asyncio.sleep(2)
+    if not await uploader.send_data(firmware_data):
+        print("\n✗ Failed to send DATA packets")
+        return False
 
-            # --- START packet with retry ---
-            print("--- SENDING START PACKET ---")
-            start_packet = create_start_packet(firmware_data, target_bank=BANK_B)
+    print()
 
-            success = False
-            max_retries = 3
-            for attempt in range(max_retries):
-                success = await uploader.send_packet(
-                    start_packet, "START", wait_for_ack=True, timeout=10.0)
-                if success:
-                    break
-                print(f"  ✗ START attempt {attempt + 1}/{max_retries} failed")
+    # --- END packet ---
+    print("--- SENDING END PACKET ---")
+    end_packet = create_end_packet()
+    success = await uploader.send_packet(
+        end_packet, "END", wait_for_ack=True, timeout=END_WORK + uploader.rto)
 
-            if not success:
-                print("✗ Failed to send START packet after all retries")
-                return False
+    if not success:
+        print("\n✗ Failed to send END packet")
+        return False
 
-            print()
+    print()
+    print(f"{'='*50}")
+    print(f"  ✓ OTA UPDATE COMPLETED SUCCESSFULLY!")
+    print(f"{'='*50}")
+    if uploader.busy_count:
+        print(f"Device pushed back {uploader.busy_count} times (OTA budget)")
+    print("STM32 will now reset and boot new firmware.")
 
-            # --- DATA packets ---
-            total_chunks = (len(firmware_data) + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE
-            print(f"--- SENDING DATA PACKETS ({total_chunks} chunks) ---")
+    await client.stop_notify(UART_TX_CHAR_UUID)
+    return True
 
-            for chunk_num in range(total_chunks):
-                start_idx = chunk_num * OTA_CHUNK_SIZE
-                end_idx = min(start_idx + OTA_CHUNK_SIZE, len(firmware_data))
-                chunk_data = firmware_data[start_idx:end_idx]
 
-                data_packet, chunk_crc = create_data_packet(chunk_num, chunk_data)
-                packet_name = f"DATA #{chunk_num + 1}/{total_chunks} (CRC: 0x{chunk_crc:08X})"
+async def upload_firmware(address, firmware_path, args):
+    print(f"\n{'='*50}")
+    print(f"  BLE OTA FIRMWARE UPLOADER")
+    print(f"{'='*50}\n")
 
-                success = await uploader.send_packet(
-                    data_packet, packet_name, wait_for_ack=True, timeout=15.0)
+    if not os.path.exists(firmware_path):
+        print(f"ERROR: Firmware file not found: {firmware_path}")
+        return False
 
-                if not success:
-                    print(f"\n✗ Failed at chunk {chunk_num + 1}")
-                    return False
+    with open(firmware_path, 'rb') as f:
+        firmware_data = f.read()
 
-                progress = (chunk_num + 1) / total_chunks * 100
-                print(f"  Progress: {progress:.1f}%")
+    print(f"Loaded firmware: {firmware_path}")
+    print(f"Size: {len(firmware_data)} bytes\n")
 
-            print()
+    if args.simulate:
+        from ota_sim_device import SimBleClient
 
-            # --- END packet ---
-            print("--- SENDING END PACKET ---")
-            end_packet = create_end_packet()
-            success = await uploader.send_packet(
-                end_packet, "END", wait_for_ack=True, timeout=15.0)
+        client = SimBleClient(baud=args.baud, loss=args.loss)
+        print(f"Simulated HM-10 at {args.baud} baud, {args.loss * 100:.1f}% write loss\n")
+        async with client:
+            success = await run_upload(client, firmware_data, args)
+        print(client.report())
+        if success and client.device.image != firmware_data:
+            print("✗ Simulated device holds a different image")
+            return False
+        return success
 
-            if not success:
-                print("\n✗ Failed to send END packet")
-                return False
+    from bleak import BleakClient
 
-            print()
-            print(f"{'='*50}")
-            print(f"  ✓ OTA UPDATE COMPLETED SUCCESSFULLY!")
-            print(f"{'='*50}")
-            print("STM32 will now reset and boot new firmware.")
+    print(f"Connecting to HM-10 at {address}...")
 
-            await client.stop_notify(UART_TX_CHAR_UUID)
-            return True
+    try:
+        async with BleakClient(address, timeout=20.0) as client:
+            print(f"✓ Connected: {client.is_connected}\n")
+            return await run_upload(client, firmware_data, args)
 
     except Exception as e:
         print(f"\n✗ Connection error: {e}")
@@ -245,6 +576,8 @@ async def upload_firmware(address, firmware_path):
 
 
 async def scan_for_hm10():
+    from bleak import BleakScanner
+
     print("Scanning for BLE devices...")
     devices = await BleakScanner.discover(timeout=5.0)
     print("\nFound devices:")
@@ -253,13 +586,28 @@ async def scan_for_hm10():
 
 
 if __name__ == "__main__":
-    if "XX" in HM10_ADDRESS or HM10_ADDRESS == "00:00:00:00:00:00":
+    parser = argparse.ArgumentParser(description="BLE OTA firmware uploader")
+    parser.add_argument('firmware', nargs='?', default=FIRMWARE_FILE)
+    parser.add_argument('--address', default=HM10_ADDRESS)
+    parser.add_argument('--window', type=int, default=OTA_MAX_CREDITS,
+                        help="most DATA packets in flight (the device's credits cap it; 1 = stop-and-wait)")
+    parser.add_argument('--rate', type=float, default=INITIAL_RATE, help="starting pace, bytes/s")
+    parser.add_argument('--max-rate', type=float, default=1e9, help="pace ceiling, bytes/s")
+    parser.add_argument('--write-size', type=int, default=BLE_WRITE_SIZE)
+    parser.add_argument('--simulate', action='store_true', help="upload to ota_sim_device.py")
+    parser.add_argument('--baud', type=int, default=9600, help="simulated HM-10 UART baud")
+    parser.add_argument('--loss', type=float, default=0.0, help="simulated write loss, 0..1")
+    parser.add_argument('--fec', type=int, default=0, metavar='K',
+                        help=f"follow every K chunks with a PARITY packet (2..{OTA_FEC_MAX_GROUP}, 0 = off)")
+    args = parser.parse_args()
+
+    if args.fec and not 2 <= args.fec <= OTA_FEC_MAX_GROUP:
+        parser.error(f"--fec takes 2..{OTA_FEC_MAX_GROUP}")
+
+    if not args.simulate and ("XX" in args.address or args.address == "00:00:00:00:00:00"):
         print("ERROR: Please set HM10_ADDRESS to your HM-10's MAC address!")
         asyncio.run(scan_for_hm10())
         sys.exit(1)
 
-    if len(sys.argv) > 1:
-        FIRMWARE_FILE = sys.argv[1]
-
-    success = asyncio.run(upload_firmware(HM10_ADDRESS, FIRMWARE_FILE))
+    success = asyncio.run(upload_firmware(args.address, args.firmware, args))
     sys.exit(0 if success else 1)
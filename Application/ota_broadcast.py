@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+Broadcast OTA sender for STM32F429
+
+Sends an image as OTA_PKT_SYMBOL packets (see ota_protocol.h) to every
+device listening on one link at once - a radio bridge in transparent
+mode, or a serial bus - and listens to none of them. Each device starts
+on the first symbol it hears, decodes the image segment by segment from
+whichever symbols arrive (ota_fountain.c) and installs it, silently.
+
+    python ota_broadcast.py app.bin /dev/ttyUSB0 --passes 5
+    python ota_broadcast.py app.bin --output symbols.bin
+
+The carousel sends, pass after pass, every segment's chunks plus
+--repair coded symbols, never the same symbol twice. A device that
+misses too much of a segment finishes it on a later pass, so run as many
+passes as the worst link needs; Host/ota_fountain_sim.c shows the trade
+between --repair and passes for a loss rate. --output writes the stream
+to a file instead, which the simulation can decode as a check.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+from ota_sender import FIRMWARE_VERSION, SerialPort
+from ota_wire_layout import (OTA_CHUNK_SIZE, OTA_FOUNTAIN_SEGMENT, OTA_MAGIC_DATA, OTA_PKT_SYMBOL,
+                             SYMBOL_HEADER_FORMAT, SYMBOL_PACKET_SIZE)
+
+
+def symbol_mask(symbol_id, chunks):
+    """Chunks of a segment XORed into a symbol, as ota_fountain_mask()"""
+    sequence = symbol_id & 0xFFFF
+    if sequence < chunks:
+        return 1 << sequence
+
+    every = (1 << chunks) - 1
+    x = (symbol_id * 0x9E3779B1) & 0xFFFFFFFF or 1
+    while True:
+        x ^= (x << 13) & 0xFFFFFFFF
+        x ^= x >> 17
+        x ^= (x << 5) & 0xFFFFFFFF
+        if x & every:
+            return x & every
+
+
+class Carousel:
+    """The symbols of one image, pass by pass"""
+
+    def __init__(self, firmware, version=FIRMWARE_VERSION, repair=4):
+        self.size = len(firmware)
+        self.crc = zlib.crc32(firmware) & 0xFFFFFFFF
+        self.version = version
+        self.repair = repair
+        total = (len(firmware) + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE
+        self.segments = (total + OTA_FOUNTAIN_SEGMENT - 1) // OTA_FOUNTAIN_SEGMENT
+
+        # Chunks as integers, so a symbol is a few big XORs; padded with 0xFF
+        padded = firmware + b'\xFF' * (total * OTA_CHUNK_SIZE - len(firmware))
+        self.chunks = [int.from_bytes(padded[n * OTA_CHUNK_SIZE:(n + 1) * OTA_CHUNK_SIZE], 'little')
+                       for n in range(total)]
+
+    def segment_chunks(self, segment):
+        return self.chunks[segment * OTA_FOUNTAIN_SEGMENT:(segment + 1) * OTA_FOUNTAIN_SEGMENT]
+
+    def symbol(self, segment, sequence):
+        chunks = self.segment_chunks(segment)
+        symbol_id = segment << 16 | sequence
+        mask = symbol_mask(symbol_id, len(chunks))
+        data = 0
+        for i, chunk in enumerate(chunks):
+            if mask >> i & 1:
+                data ^= chunk
+
+        packet = struct.pack(SYMBOL_HEADER_FORMAT, OTA_MAGIC_DATA, OTA_PKT_SYMBOL, self.size,
+                             self.version, self.crc, symbol_id)
+        packet += data.to_bytes(OTA_CHUNK_SIZE, 'little')
+        return packet + struct.pack('<I', zlib.crc32(packet) & 0xFFFFFFFF)
+
+    def passes(self, count):
+        """Every symbol of count passes, in the order they go out"""
+        for p in range(count):
+            for segment in range(self.segments):
+                per_pass = len(self.segment_chunks(segment)) + self.repair
+                for j in range(per_pass):
+                    yield self.symbol(segment, p * per_pass + j)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Broadcast OTA firmware sender")
+    parser.add_argument('firmware')
+    parser.add_argument('port', nargs='?', default='/dev/ttyUSB0')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--version', type=lambda v: int(v, 0), default=FIRMWARE_VERSION,
+                        help="a device with a slot record of this version ignores the broadcast")
+    parser.add_argument('--repair', type=int, default=4,
+                        help="coded symbols per segment per pass, past its chunks")
+    parser.add_argument('--passes', type=int, default=3)
+    parser.add_argument('--output', help="write the symbols to this file instead of a port")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.firmware):
+        print(f"ERROR: Firmware file not found: {args.firmware}")
+        return False
+    with open(args.firmware, 'rb') as f:
+        firmware = f.read()
+
+    carousel = Carousel(firmware, args.version, args.repair)
+    per_pass = len(carousel.chunks) + carousel.segments * args.repair
+    print(f"Loaded {args.firmware}: {len(firmware)} bytes, CRC32 0x{carousel.crc:08X}, "
+          f"{carousel.segments} segments, {per_pass} symbols per pass")
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            for packet in carousel.passes(args.passes):
+                f.write(packet)
+        print(f"Wrote {args.passes * per_pass} symbols to {args.output}")
+        return True
+
+    port = SerialPort(args.port, args.baud)
+    t = time.monotonic()
+    try:
+        for n, packet in enumerate(carousel.passes(args.passes), 1):
+            port.write(packet)
+            if n % per_pass == 0:
+                print(f"Pass {n // per_pass}/{args.passes} sent ({time.monotonic() - t:.1f} s)")
+    finally:
+        port.close()
+    airtime = args.passes * per_pass * SYMBOL_PACKET_SIZE * 10 / args.baud
+    print(f"Done: {args.passes * per_pass} symbols in {time.monotonic() - t:.1f} s "
+          f"(line time {airtime:.1f} s)")
+    return True
+
+
+if __name__ == "__main__":
+    sys.exit(0 if main() else 1)
@@ -0,0 +1,502 @@
+#!/usr/bin/env python3
+"""
+Fleet OTA updater: one image to many boards at once
+
+One asyncio event loop runs a session per serial port (the ST-Link VCP
+of each board on the bench, or its USB CDC port), each with its own
+state machine:
+
+    queued -> handshake -> erase wait -> transfer -> verify -> done
+                 ^                                      |
+                 +------ next attempt (--attempts) -----+--> failed
+
+A session speaks the same protocol as ota_sender.py: credit-windowed
+go-back-N DATA, responses picked out of the boot log by magic. The image
+is read, CRC'd and cut into packets once (ota_sender.Packets); every
+session writes from that one read-only buffer, so fifty boards cost no
+more preparation than one.
+
+    python ota_fleet.py app.bin                         (every /dev/ttyACM*, /dev/ttyUSB*)
+    python ota_fleet.py app.bin /dev/ttyACM0 /dev/ttyACM3 --jobs 8
+    python ota_fleet.py app.bin --simulate 24
+
+Each board is offered the aligned v2 packet layout first and goes on
+in v1 if it ignores it (ota_sender.py), so one run can cover boards on
+old and new firmware; --simulate-v1 K makes K of the simulated boards
+the old kind.
+
+--simulate N starts N ota_sim_device.py --pty processes and checks the
+image each of them ends up with. While it runs, a dashboard shows each
+board's state, progress and rate, and the fleet's aggregate throughput.
+POSIX only (termios).
+"""
+
+import argparse
+import asyncio
+import glob
+import os
+import re
+import sys
+import time
+
+from ota_sender import (END_WORK_S, INITIAL_RTO_S, MAX_BUSY, MAX_REWINDS, MAX_TIMEOUTS, PHASES,
+                        QUIET_MAX_S, QUIET_S, START_WORK_S, FIRMWARE_VERSION, Packets,
+                        ResponseReader, RttEstimator, SerialPort)
+from ota_wire_layout import (DATA_PACKET_SIZE, OTA_BUSY_RETRY_MS, OTA_CHUNK_SIZE, OTA_ERR_BUSY,
+                             OTA_ERR_CRC, OTA_ERR_SEQUENCE, OTA_MAX_CREDITS, OTA_PKT_ACK,
+                             OTA_TARGET_AUTO as TARGET_AUTO)
+
+PORT_PATTERNS = ('/dev/ttyACM*', '/dev/ttyUSB*', '/dev/cu.usbmodem*')
+REFRESH_S = 0.5
+SIM_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'ota_sim_device.py')
+
+
+class AsyncPort:
+    """SerialPort driven by the event loop: add_reader in, non-blocking writes out"""
+
+    def __init__(self, path, baud):
+        self.loop = asyncio.get_running_loop()
+        self.serial = SerialPort(path, baud)
+        self.fd = self.serial.fd
+        os.set_blocking(self.fd, False)
+        self.reader = ResponseReader(None)
+        self.arrived = asyncio.Event()
+        self.lost = False
+        self.loop.add_reader(self.fd, self.on_readable)
+
+    def on_readable(self):
+        try:
+            data = os.read(self.fd, 4096)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b''
+        if not data:                # Unplugged
+            self.lost = True
+            self.loop.remove_reader(self.fd)
+        self.reader.buffer += data
+        self.arrived.set()
+
+    async def write(self, data):
+        view = memoryview(data)
+        while view:
+            try:
+                view = view[os.write(self.fd, view):]
+            except BlockingIOError:
+                pass
+            if view:
+                ready = self.loop.create_future()
+                self.loop.add_writer(self.fd, lambda: ready.done() or ready.set_result(None))
+                try:
+                    await ready
+                finally:
+                    self.loop.remove_writer(self.fd)
+
+    async def get(self, timeout):
+        """The next response, or None after timeout seconds"""
+        deadline = self.loop.time() + timeout
+        while True:
+            response = self.reader.frame()
+            if response is not None:
+                return response
+            remaining = deadline - self.loop.time()
+            if remaining <= 0 or self.lost:
+                return None
+            self.arrived.clear()
+            try:
+                await asyncio.wait_for(self.arrived.wait(), remaining)
+            except asyncio.TimeoutError:
+                pass
+
+    async def wait_quiet(self, quiet, limit):
+        """Let the boot log finish: until quiet seconds pass with nothing (at most limit)"""
+        deadline = self.loop.time() + limit
+        while self.loop.time() < deadline and not self.lost:
+            self.arrived.clear()
+            try:
+                await asyncio.wait_for(self.arrived.wait(), min(quiet, deadline - self.loop.time()))
+            except asyncio.TimeoutError:
+                break
+        self.reader.skip(len(self.reader.buffer))
+
+    def close(self):
+        if not self.lost:
+            self.loop.remove_reader(self.fd)
+        self.serial.close()
+
+
+class Session:
+    """One board's update; state and counters are what the dashboard shows"""
+
+    def __init__(self, name, path, packets, args, check=None):
+        self.name = name
+        self.path = path
+        self.packets = packets
+        self.args = args
+        self.check = check          # Coroutine: did the board get the image? (simulated boards)
+
+        self.state = 'queued'
+        self.attempt = 0
+        self.error = ''
+        self.base = 0
+        self.credits = 1
+        self.phases = {}
+        self.transfer_started = None
+        self.retransmitted = self.nack_count = self.busy_count = self.timeout_count = 0
+        self.rtt = None             # Per attempt: a board's link can change between them
+        self.wire = args.wire       # DATA layout; 1 once the board ignores a v2 START
+        self.refused = False
+
+    def window(self):
+        return max(1, min(self.credits, self.args.window))
+
+    def acked_bytes(self):
+        return min(self.base * OTA_CHUNK_SIZE, self.packets.size)
+
+    def rate(self, now):
+        if 'transfer' in self.phases:
+            return self.packets.size / self.phases['transfer']
+        if self.transfer_started is None:
+            return 0.0
+        return self.acked_bytes() / max(1e-3, now - self.transfer_started)
+
+    async def run(self, slots):
+        async with slots:
+            loop = asyncio.get_running_loop()
+            for self.attempt in range(1, self.args.attempts + 1):
+                try:
+                    port = AsyncPort(self.path, self.args.baud)
+                except (OSError, ValueError) as e:
+                    self.error = str(e)
+                    continue
+                try:
+                    ok = await self.upload(port, loop)
+                except OSError as e:
+                    self.error, ok = str(e), False
+                finally:
+                    port.close()
+                if ok and self.check is not None and not await self.check():
+                    self.error, ok = 'board holds a different image', False
+                if ok:
+                    self.state, self.error = 'done', ''
+                    return True
+            self.state = 'failed'
+            return False
+
+    async def exchange(self, port, packet, name, work, waiting, retries=3):
+        """ota_sender.Sender.exchange(); state is waiting once packet is out"""
+        busy = 0
+        attempt = 0
+        sent_at = None
+        self.refused = False
+        while True:
+            await port.write(packet)
+            sent_at = sent_at or port.loop.time()
+            self.state = waiting
+            response = await port.get(work + self.rtt.rto)
+            if response is None:
+                attempt += 1
+                if attempt >= retries or port.lost:
+                    self.error = f"no answer to {name}"
+                    return None
+                self.rtt.backoff()
+                continue
+            if response['type'] == OTA_PKT_ACK:
+                return response, sent_at
+            if response['error_code'] == OTA_ERR_BUSY and busy < MAX_BUSY:
+                busy += 1
+                self.busy_count += 1
+                await asyncio.sleep(OTA_BUSY_RETRY_MS / 1000)
+                continue
+            self.error = f"{name} NACKed (error {response['error_code']})"
+            self.refused = True
+            return None
+
+    async def handshake(self, port):
+        """ota_sender.Sender.handshake(): v2 START, then v1 if it was ignored"""
+        if self.wire == 2:
+            result = await self.exchange(port, self.packets.start[2], "START (v2)", START_WORK_S,
+                                         'erase wait', retries=1)
+            if result is not None or self.refused or port.lost:
+                return result
+            self.wire = 1
+        return await self.exchange(port, self.packets.start[1], "START", START_WORK_S, 'erase wait')
+
+    async def upload(self, port, loop):
+        self.base = 0
+        self.phases = {}
+        self.transfer_started = None
+        self.rtt = RttEstimator(INITIAL_RTO_S + DATA_PACKET_SIZE * 10 / self.args.baud)
+        self.state = 'handshake'
+        t0 = loop.time()
+        await port.wait_quiet(QUIET_S, QUIET_MAX_S)
+
+        result = await self.handshake(port)
+        if result is None:
+            return False
+        response, t1 = result
+        self.credits = max(1, response['credits'])
+        t2 = loop.time()
+        self.phases['handshake'] = t1 - t0
+        self.phases['erase wait'] = t2 - t1
+
+        self.state = 'transfer'
+        self.transfer_started = t2
+        if not await self.send_data(port):
+            return False
+        t3 = loop.time()
+        self.phases['transfer'] = t3 - t2
+
+        if await self.exchange(port, self.packets.end, "END", END_WORK_S, 'verify') is None:
+            return False
+        self.phases['verify'] = loop.time() - t3
+        return True
+
+    async def send_data(self, port):
+        """Go-back-N over the credit window, as ota_sender.Sender.send_data()"""
+        total = self.packets.total
+        next_chunk = 0
+        unanswered = stale = 0
+        timeouts = rewinds = 0
+        resent_to = 0
+        sent_at = {}
+
+        def rewind():
+            nonlocal next_chunk, stale, rewinds
+            stale = unanswered
+            next_chunk = self.base
+            rewinds += 1
+
+        while self.base < total:
+            while next_chunk < total and next_chunk - self.base < self.window():
+                await port.write(self.packets.data(next_chunk, self.wire))
+                if next_chunk < resent_to:
+                    self.retransmitted += 1
+                    sent_at.pop(next_chunk, None)
+                else:
+                    sent_at[next_chunk] = port.loop.time()
+                next_chunk += 1
+                resent_to = max(resent_to, next_chunk)
+                unanswered += 1
+
+            response = await port.get(self.rtt.rto)
+            if response is None:
+                self.timeout_count += 1
+                timeouts += 1
+                if timeouts > MAX_TIMEOUTS or port.lost:
+                    self.error = f"no answer for chunk {self.base}"
+                    return False
+                rewind()
+                stale = unanswered = 0
+                self.rtt.backoff()
+                continue
+
+            unanswered = max(0, unanswered - 1)
+            was_stale = stale > 0
+            stale = max(0, stale - 1)
+            if response['last_chunk'] > self.base:
+                last = response['last_chunk']
+                if last - 1 in sent_at:
+                    self.rtt.sample(port.loop.time() - sent_at[last - 1])
+                for c in range(self.base, last):
+                    sent_at.pop(c, None)
+                self.base = last
+                next_chunk = max(next_chunk, self.base)
+                timeouts = rewinds = 0
+
+            if response['type'] == OTA_PKT_ACK:
+                self.credits = max(1, response['credits'])
+                continue
+
+            self.nack_count += 1
+            code = response['error_code']
+            if code == OTA_ERR_BUSY:
+                self.busy_count += 1
+                await asyncio.sleep(OTA_BUSY_RETRY_MS / 1000)
+            elif code not in (OTA_ERR_CRC, OTA_ERR_SEQUENCE):
+                self.error = f"NACK (error {code}) at chunk {self.base}"
+                return False
+            if not was_stale:
+                rewind()
+                if rewinds > MAX_REWINDS:
+                    self.error = f"chunk {self.base} rejected {rewinds - 1} times"
+                    return False
+
+        # Answers still owed for resent packets would be taken as END's
+        while unanswered > 0 and await port.get(self.rtt.rto) is not None:
+            unanswered -= 1
+        return True
+
+
+class Dashboard:
+    """Redraws one line per board and an aggregate line every REFRESH_S"""
+
+    def __init__(self, sessions, interactive):
+        self.sessions = sessions
+        self.interactive = interactive
+        self.lines = 0
+        self.start = None
+        self.last = None            # (time, bytes) at the previous redraw
+        self.peak = 0.0
+
+    def aggregate(self, now):
+        acked = sum(s.acked_bytes() for s in self.sessions)
+        current = 0.0
+        if self.last is not None and now > self.last[0]:
+            current = (acked - self.last[1]) / (now - self.last[0])
+        self.last = (now, acked)
+        self.peak = max(self.peak, current)
+        return acked, current
+
+    def render(self, now):
+        acked, current = self.aggregate(now)
+        counts = {}
+        for s in self.sessions:
+            counts[s.state] = counts.get(s.state, 0) + 1
+        states = ', '.join(f"{n} {state}" for state, n in counts.items())
+        lines = [f"{len(self.sessions)} boards: {states}",
+                 f"fleet {acked / 1024:8.1f} KB acknowledged  now {current / 1024:7.1f} KB/s  "
+                 f"peak {self.peak / 1024:7.1f} KB/s  {now - self.start:6.1f} s"]
+        if self.interactive:
+            for s in self.sessions:
+                pct = s.base * 100 // s.packets.total
+                lines.append(f"  {s.name:<14} {s.state:<10} {pct:3d}%  {s.rate(now) / 1024:6.1f} KB/s  "
+                             f"try {s.attempt}  resent {s.retransmitted}  nack {s.nack_count}  "
+                             f"t/o {s.timeout_count}  {s.rtt.describe() if s.rtt else ''}  {s.error}")
+        return lines
+
+    def draw(self, now):
+        lines = self.render(now)
+        if self.interactive:
+            if self.lines:
+                sys.stdout.write(f"\x1b[{self.lines}F")
+            sys.stdout.write(''.join(f"{line}\x1b[K\n" for line in lines))
+            self.lines = len(lines)
+        else:
+            print(lines[1])
+        sys.stdout.flush()
+
+    async def run(self, every):
+        loop = asyncio.get_running_loop()
+        self.start = loop.time()
+        while True:
+            await asyncio.sleep(every)
+            self.draw(loop.time())
+
+
+async def start_simulators(count, baud, v1_count=0):
+    """
+    count ota_sim_device.py --pty processes, the last v1_count of them
+    without the v2 layouts; returns them and their pty paths
+    """
+    procs, paths = [], []
+    for i in range(count):
+        wire = '1' if i >= count - v1_count else '2'
+        proc = await asyncio.create_subprocess_exec(
+            sys.executable, '-u', SIM_SCRIPT, '--pty', '--baud', str(baud), '--wire', wire,
+            stdout=asyncio.subprocess.PIPE)
+        line = (await proc.stdout.readline()).decode()
+        match = re.search(r' on (\S+) ', line)
+        if match is None:
+            raise RuntimeError(f"simulator did not start: {line.strip()}")
+        procs.append(proc)
+        paths.append(match.group(1))
+    return procs, paths
+
+
+def image_check(proc, packets):
+    """Reads the simulator's 'image N: ... CRC32 0x...' line after END"""
+    async def check():
+        try:
+            line = (await asyncio.wait_for(proc.stdout.readline(), 2.0)).decode()
+        except asyncio.TimeoutError:
+            return False
+        match = re.search(r'(\d+) bytes, CRC32 0x([0-9A-F]{8})', line)
+        return (match is not None and int(match.group(1)) == packets.size
+                and int(match.group(2), 16) == packets.crc)
+    return check
+
+
+def print_results(sessions, wall, prepare_s):
+    print(f"\n{'board':<14} {'result':<7}" + ''.join(f" {p:>10}" for p in PHASES) + "   KB/s")
+    for s in sessions:
+        row = f"{s.name:<14} {s.state:<7}"
+        if s.state == 'done':
+            row += ''.join(f" {s.phases[p]:9.2f}s" for p in PHASES)
+            row += f" {s.packets.size / s.phases['transfer'] / 1024:6.1f}  v{s.wire}"
+        else:
+            row += f" {s.error} (after {s.attempt} attempts)"
+        print(row)
+
+    done = [s for s in sessions if s.state == 'done']
+    one_by_one = sum(sum(s.phases.values()) for s in done)
+    print(f"\n{len(done)}/{len(sessions)} boards updated in {wall:.1f} s "
+          f"({one_by_one:.1f} s of sessions, {one_by_one / wall if wall else 0:.1f}x overlap); "
+          f"packets built once in {prepare_s * 1000:.1f} ms")
+
+
+async def run_fleet(args):
+    with open(args.firmware, 'rb') as f:
+        firmware = f.read()
+    t = time.monotonic()
+    packets = Packets(firmware, args.version, args.target)
+    prepare_s = time.monotonic() - t
+    print(f"Loaded {args.firmware}: {len(firmware)} bytes, CRC32 0x{packets.crc:08X}, "
+          f"{packets.total} chunks")
+
+    procs = []
+    try:
+        if args.simulate:
+            procs, paths = await start_simulators(args.simulate, args.baud, args.simulate_v1)
+            sessions = [Session(f"sim{i}", path, packets, args, image_check(proc, packets))
+                        for i, (proc, path) in enumerate(zip(procs, paths))]
+        else:
+            paths = args.ports or sorted(p for pattern in PORT_PATTERNS for p in glob.glob(pattern))
+            if not paths:
+                print("ERROR: No serial ports found; name them on the command line")
+                return False
+            sessions = [Session(os.path.basename(p), p, packets, args) for p in paths]
+        print(f"Updating {len(sessions)} boards, {args.jobs or len(sessions)} at a time\n")
+
+        loop = asyncio.get_running_loop()
+        slots = asyncio.Semaphore(args.jobs or len(sessions))
+        dashboard = Dashboard(sessions, sys.stdout.isatty() and not args.plain)
+        dashboard_task = asyncio.create_task(dashboard.run(REFRESH_S))
+        start = loop.time()
+        results = await asyncio.gather(*(s.run(slots) for s in sessions))
+        wall = loop.time() - start
+        dashboard_task.cancel()
+        dashboard.draw(loop.time())
+    finally:
+        for proc in procs:
+            proc.terminate()
+            await proc.wait()
+
+    print_results(sessions, wall, prepare_s)
+    return all(results)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Update many boards over serial at once")
+    parser.add_argument('firmware')
+    parser.add_argument('ports', nargs='*', help="default: every USB serial port found")
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--jobs', type=int, default=0, help="sessions at a time (default: all)")
+    parser.add_argument('--attempts', type=int, default=3, help="per board")
+    parser.add_argument('--window', type=int, default=OTA_MAX_CREDITS,
+                        help="most DATA packets in flight per board (1 = stop-and-wait)")
+    parser.add_argument('--target', type=lambda v: int(v, 0), default=TARGET_AUTO)
+    parser.add_argument('--version', type=lambda v: int(v, 0), default=FIRMWARE_VERSION)
+    parser.add_argument('--wire', type=int, choices=(1, 2), default=2,
+                        help="packet layout to offer (2 falls back to 1 per board)")
+    parser.add_argument('--simulate', type=int, default=0, metavar='N',
+                        help="update N ota_sim_device.py processes instead")
+    parser.add_argument('--simulate-v1', type=int, default=0, metavar='K',
+                        help="of those, K run firmware from before the v2 layouts")
+    parser.add_argument('--plain', action='store_true', help="aggregate lines only, no redrawing")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.firmware):
+        print(f"ERROR: Firmware file not found: {args.firmware}")
+        sys.exit(1)
+    sys.exit(0 if asyncio.run(run_fleet(args)) else 1)
@@ -0,0 +1,382 @@
+#!/usr/bin/env python3
+"""
+OTA image post-link tool for STM32F429
+
+Commands:
+  header Fill in the image header (see image_header.h) of a linked .bin
+  reloc  Wrap a linked .bin in a relocatable container (see ota_reloc.h)
+  crc    Print the STM32 hardware CRC32 of a file (what the device computes)
+  size   Fail if a linked bootloader ELF overflows its flash partition
+
+The relocation table is taken from the ELF, so the application must be
+linked with relocations kept in the output:
+
+    Project Properties > C/C++ Build > Settings > MCU GCC Linker >
+    Miscellaneous > Other flags:  -Wl,--emit-relocs
+
+Example (post-build steps):
+    python ota_image_tool.py header Debug/Basic-Application.bin
+    python ota_image_tool.py reloc Debug/Basic-Application.elf \\
+        Debug/Basic-Application.bin -o Debug/Basic-Application.img
+
+'reloc' fills in the header itself (with IMAGE_FLAG_RELOCATABLE), so the
+first step is only needed for plain images. It rebases whole words only:
+an image that loads one of its own addresses any other way (MOVW/MOVT,
+as -mslow-flash-data and -mpure-code build) is refused, with the
+relocations named, rather than wrapped into a container that would
+break once moved.
+
+The bootloader's partition is one 16KB sector (four with
+BOOT_RECOVERY_OTA, see flash_layout.h), which the CubeIDE linker script
+does not know about. Add a post-build step to the bootloader project so
+an overflow fails the build instead of spilling into the next sector:
+    python ../Application/ota_image_tool.py size Debug/Bootloader.elf
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+# Must match ota_reloc.h
+OTA_RELOC_MAGIC = 0x434C4552  # "RELC"
+RELOC_HEADER_FORMAT = '<I I I I'
+
+LINK_ADDRESS = 0x08010000  # Bank A, where the application is linked
+
+# Must match flash_layout.h
+FLASH_BASE_ADDRESS = 0x08000000
+FLASH_TOTAL_SIZE = 2 * 1024 * 1024
+BOOTLOADER_SECTOR_SIZE = 0x4000  # Sectors 0-3
+FLASH_LAYOUT_H = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              '..', 'Common', 'OTA', 'Inc', 'flash_layout.h')
+
+# Must match image_header.h
+IMAGE_HEADER_OFFSET = 0x200
+IMAGE_HEADER_MAGIC = 0x474D4953  # "SIMG"
+IMAGE_HEADER_FORMAT = '<I I I I I I I I I I I I'
+IMAGE_HEADER_SIZE = struct.calcsize(IMAGE_HEADER_FORMAT)
+IMAGE_HEADER_TOOL_WORDS = 7
+IMAGE_FLAG_RELOCATABLE = 0x00000001
+
+# ELF constants
+SHT_REL = 9
+SHF_ALLOC = 0x2
+PT_LOAD = 1
+SHT_SYMTAB = 2
+STT_SECTION = 3
+R_ARM_ABS32 = 2
+R_ARM_TARGET1 = 38
+
+# Other absolute relocations: an address split into an instruction or a
+# short field, which the device's word bitmap cannot rebase
+R_ARM_OTHER_ABSOLUTE = {
+    5: 'R_ARM_ABS16',
+    6: 'R_ARM_ABS12',
+    7: 'R_ARM_THM_ABS5',
+    8: 'R_ARM_ABS8',
+    43: 'R_ARM_MOVW_ABS_NC',
+    44: 'R_ARM_MOVT_ABS',
+    47: 'R_ARM_THM_MOVW_ABS_NC',
+    48: 'R_ARM_THM_MOVT_ABS',
+    132: 'R_ARM_THM_ALU_ABS_G0_NC',
+    133: 'R_ARM_THM_ALU_ABS_G1_NC',
+    134: 'R_ARM_THM_ALU_ABS_G2_NC',
+    135: 'R_ARM_THM_ALU_ABS_G3',
+}
+
+
+def _crc_table():
+    table = []
+    for i in range(256):
+        crc = i << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+        table.append(crc & 0xFFFFFFFF)
+    return table
+
+
+_CRC_TABLE = _crc_table()
+
+
+def stm32_crc32(data, crc=0xFFFFFFFF):
+    """CRC32 as computed by calculate_crc32() on the device.
+
+    The F4 CRC unit takes 32-bit little-endian words MSB first (poly
+    0x04C11DB7, init 0xFFFFFFFF, no reflection, no final XOR). A trailing
+    partial word is zero padded, as in calculate_crc32(). This is NOT
+    zlib.crc32.
+    """
+    data = bytes(data)
+    if len(data) % 4:
+        data += b'\x00' * (4 - len(data) % 4)
+    table = _CRC_TABLE
+    for (word,) in struct.iter_unpack('<I', data):
+        for shift in (24, 16, 8, 0):
+            crc = ((crc << 8) & 0xFFFFFFFF) ^ table[((crc >> 24) ^ (word >> shift)) & 0xFF]
+    return crc
+
+
+def image_crc32(image):
+    """CRC of the image with the header cut out (image_crc32() on the device)."""
+    end = IMAGE_HEADER_OFFSET + IMAGE_HEADER_SIZE
+    return stm32_crc32(image[:IMAGE_HEADER_OFFSET] + image[end:])
+
+
+def patch_image_header(image, link_address, flags=0):
+    """Fill in size, CRCs, load address and flags. Returns the patched image,
+    or None if the image has no header."""
+    image = bytearray(image)
+    if len(image) < IMAGE_HEADER_OFFSET + IMAGE_HEADER_SIZE:
+        return None
+
+    fields = list(struct.unpack_from(IMAGE_HEADER_FORMAT, image, IMAGE_HEADER_OFFSET))
+    if fields[0] != IMAGE_HEADER_MAGIC or fields[1] != IMAGE_HEADER_SIZE:
+        return None
+
+    fields[2] = len(image)
+    fields[5] = link_address
+    fields[6] = flags
+    fields[8:12] = [0xFFFFFFFF] * 4  # install words stay erased
+    fields[3] = 0
+    fields[7] = 0
+    struct.pack_into(IMAGE_HEADER_FORMAT, image, IMAGE_HEADER_OFFSET, *fields)
+
+    fields[3] = image_crc32(image)
+    fields[7] = stm32_crc32(struct.pack('<7I', *fields[:IMAGE_HEADER_TOOL_WORDS]))
+    struct.pack_into(IMAGE_HEADER_FORMAT, image, IMAGE_HEADER_OFFSET, *fields)
+    return bytes(image)
+
+
+class ElfFile:
+    """Just enough of ELF32 little-endian to find absolute relocations."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError(f"{path}: not a 32-bit little-endian ELF")
+
+        e_phoff, e_shoff = struct.unpack_from('<I I', self.data, 0x1C)
+        e_phentsize, e_phnum, e_shentsize, e_shnum, e_shstrndx = struct.unpack_from(
+            '<H H H H H', self.data, 0x2A)
+
+        self.segments = []
+        for i in range(e_phnum):
+            p_type, p_offset, p_vaddr, p_paddr, p_filesz, p_memsz = struct.unpack_from(
+                '<I I I I I I', self.data, e_phoff + i * e_phentsize)
+            if p_type == PT_LOAD and p_filesz > 0:
+                self.segments.append((p_vaddr, p_paddr, p_filesz))
+
+        self.sections = []
+        for i in range(e_shnum):
+            fields = struct.unpack_from('<I I I I I I I I I I', self.data, e_shoff + i * e_shentsize)
+            self.sections.append({
+                'name': fields[0], 'type': fields[1], 'flags': fields[2], 'addr': fields[3],
+                'offset': fields[4], 'size': fields[5], 'link': fields[6], 'info': fields[7],
+            })
+        for sec in self.sections:
+            sec['name'] = self._string(self.sections[e_shstrndx], sec['name'])
+
+    def _string(self, strtab, index):
+        start = strtab['offset'] + index
+        return self.data[start:self.data.index(b'\0', start)].decode(errors='replace')
+
+    def _symbol(self, symtab, index):
+        """(name, value) of entry index of a symbol table section"""
+        st_name, st_value, _, st_info, _, st_shndx = struct.unpack_from(
+            '<I I I B B H', self.data, symtab['offset'] + index * 16)
+        if st_info & 0xF == STT_SECTION and st_shndx < len(self.sections):
+            return self.sections[st_shndx]['name'], st_value
+        return self._string(self.sections[symtab['link']], st_name), st_value
+
+    def vma_to_lma(self, vma):
+        """Load address of an initialised byte (e.g. .data lives in RAM, loads from flash)."""
+        for vaddr, paddr, filesz in self.segments:
+            if vaddr <= vma < vaddr + filesz:
+                return paddr + (vma - vaddr)
+        return None
+
+    def relocations(self):
+        """Yield (VMA, type, symbol name, symbol value) of every relocation in loaded code or data."""
+        for sec in self.sections:
+            if sec['type'] != SHT_REL:
+                continue
+            target = self.sections[sec['info']]
+            if not target['flags'] & SHF_ALLOC:
+                continue  # debug info
+            symtab = self.sections[sec['link']]
+            for off in range(sec['offset'], sec['offset'] + sec['size'], 8):
+                r_offset, r_info = struct.unpack_from('<I I', self.data, off)
+                name, value = self._symbol(symtab, r_info >> 8) if symtab['type'] == SHT_SYMTAB else ('?', 0)
+                yield r_offset, r_info & 0xFF, name, value
+
+
+def build_reloc_container(elf_path, bin_path, link_address=LINK_ADDRESS):
+    with open(bin_path, 'rb') as f:
+        image = f.read()
+
+    patched_image = patch_image_header(image, link_address, IMAGE_FLAG_RELOCATABLE)
+    if patched_image is not None:
+        image = patched_image
+
+    elf = ElfFile(elf_path)
+    image_end = link_address + len(image)
+
+    num_words = (len(image) + 3) // 4
+    bitmap_size = (((num_words + 7) // 8) + 3) & ~3
+    bitmap = bytearray(bitmap_size)
+    patched = set()
+
+    unmovable = []
+
+    for vma, r_type, symbol, symbol_value in elf.relocations():
+        if r_type in R_ARM_OTHER_ABSOLUTE:
+            # Code built with -mslow-flash-data or -mpure-code loads
+            # addresses with MOVW/MOVT; rebasing only words would leave it
+            # pointing at the link address
+            if link_address <= symbol_value <= image_end:
+                unmovable.append(f"{R_ARM_OTHER_ABSOLUTE[r_type]} at 0x{vma:08X} against {symbol}")
+            continue
+        if r_type not in (R_ARM_ABS32, R_ARM_TARGET1):
+            continue
+        lma = elf.vma_to_lma(vma)
+        if lma is None or lma % 4 or not (link_address <= lma < image_end - 3):
+            continue  # .bss, unaligned or outside the image
+        offset = lma - link_address
+        (value,) = struct.unpack_from('<I', image, offset)
+        # Only words pointing into the image move with it; RAM and
+        # peripheral addresses stay put
+        if link_address <= value <= image_end:
+            patched.add(offset // 4)
+
+    if unmovable:
+        raise ValueError(f"{elf_path}: {len(unmovable)} image address(es) the container cannot rebase "
+                         "(build without -mslow-flash-data/-mpure-code):\n  " + "\n  ".join(unmovable))
+
+    # The header holds plain numbers; never rebase it
+    header_words = range(IMAGE_HEADER_OFFSET // 4, (IMAGE_HEADER_OFFSET + IMAGE_HEADER_SIZE) // 4)
+    patched.difference_update(header_words)
+
+    for word in patched:
+        bitmap[word // 8] |= 1 << (word % 8)
+
+    header = struct.pack(RELOC_HEADER_FORMAT, OTA_RELOC_MAGIC, link_address, len(image), bitmap_size)
+    return header + bytes(bitmap) + image, len(patched)
+
+
+def cmd_reloc(args):
+    try:
+        container, count = build_reloc_container(args.elf, args.bin, int(args.link_address, 0))
+    except ValueError as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+    with open(args.output, 'wb') as f:
+        f.write(container)
+
+    print(f"Relocatable image: {args.output}")
+    print(f"  Link address:   0x{int(args.link_address, 0):08X}")
+    print(f"  Rebased words:  {count}")
+    print(f"  Container size: {len(container)} bytes")
+    print(f"  STM32 CRC32:    0x{stm32_crc32(container):08X}")
+    return 0
+
+
+def cmd_header(args):
+    with open(args.bin, 'rb') as f:
+        image = f.read()
+
+    link_address = int(args.link_address, 0)
+    patched = patch_image_header(image, link_address)
+    if patched is None:
+        print(f"{args.bin}: no image header at 0x{IMAGE_HEADER_OFFSET:X}", file=sys.stderr)
+        return 1
+
+    with open(args.output or args.bin, 'wb') as f:
+        f.write(patched)
+
+    fields = struct.unpack_from(IMAGE_HEADER_FORMAT, patched, IMAGE_HEADER_OFFSET)
+    version = fields[4]
+    print(f"Image header: {args.output or args.bin}")
+    print(f"  Version:      {version >> 24}.{(version >> 16) & 0xFF}.{version & 0xFFFF}")
+    print(f"  Size:         {fields[2]} bytes")
+    print(f"  Load address: 0x{fields[5]:08X}")
+    print(f"  Image CRC32:  0x{fields[3]:08X}")
+    print(f"  File CRC32:   0x{stm32_crc32(patched):08X}")
+    return 0
+
+
+def bootloader_size_limit(path=FLASH_LAYOUT_H):
+    """PART_BOOTLOADER size for the BOOT_RECOVERY_OTA setting in flash_layout.h"""
+    with open(path) as f:
+        text = f.read()
+    recovery = re.search(r'#define\s+BOOT_RECOVERY_OTA\s+(\d+)', text)
+    sectors = re.search(r'#if BOOT_RECOVERY_OTA\b.*?PART_BOOTLOADER_NUM_SECTORS\s+(\d+)'
+                        r'.*?#else.*?PART_BOOTLOADER_NUM_SECTORS\s+(\d+)', text, re.S)
+    if recovery is None or sectors is None:
+        raise ValueError(f"{path}: bootloader partition not found")
+    count = sectors.group(1) if int(recovery.group(1)) else sectors.group(2)
+    return int(count) * BOOTLOADER_SECTOR_SIZE
+
+
+def cmd_size(args):
+    try:
+        elf = ElfFile(args.elf)
+        limit = int(args.limit, 0) if args.limit else bootloader_size_limit()
+    except (OSError, ValueError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    # Everything programmed into flash, .data initialisers included
+    ends = [paddr + filesz for _, paddr, filesz in elf.segments
+            if FLASH_BASE_ADDRESS <= paddr < FLASH_BASE_ADDRESS + FLASH_TOTAL_SIZE]
+    used = max(ends) - FLASH_BASE_ADDRESS if ends else 0
+
+    print(f"{args.elf}: {used} of {limit} bytes of flash ({100 * used // limit}%)")
+    if used > limit:
+        print(f"error: {used - limit} bytes over the bootloader partition", file=sys.stderr)
+        return 1
+    return 0
+
+
+def cmd_crc(args):
+    with open(args.file, 'rb') as f:
+        data = f.read()
+    print(f"0x{stm32_crc32(data):08X}  {args.file} ({len(data)} bytes)")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="OTA image post-link tool")
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('header', help="fill in the image header of a .bin")
+    p.add_argument('bin', help="objcopy -O binary output (patched in place)")
+    p.add_argument('-o', '--output', help="write here instead of in place")
+    p.add_argument('--link-address', default=hex(LINK_ADDRESS))
+    p.set_defaults(func=cmd_header)
+
+    p = sub.add_parser('reloc', help="build a relocatable OTA container")
+    p.add_argument('elf', help="linked ELF (built with -Wl,--emit-relocs)")
+    p.add_argument('bin', help="objcopy -O binary output of the same ELF")
+    p.add_argument('-o', '--output', required=True)
+    p.add_argument('--link-address', default=hex(LINK_ADDRESS))
+    p.set_defaults(func=cmd_reloc)
+
+    p = sub.add_parser('crc', help="print the STM32 CRC32 of a file")
+    p.add_argument('file')
+    p.set_defaults(func=cmd_crc)
+
+    p = sub.add_parser('size', help="check a bootloader ELF fits its partition")
+    p.add_argument('elf', help="linked bootloader ELF")
+    p.add_argument('--limit', help="bytes (default: PART_BOOTLOADER in flash_layout.h)")
+    p.set_defaults(func=cmd_size)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
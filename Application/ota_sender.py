@@ -0,0 +1,573 @@
+#!/usr/bin/env python3
+"""
+Serial OTA uploader for STM32F429
+
+Sends an image over a serial port with the ota_protocol.h framing: to
+the bootloader's recovery mode on USART1 (the ST-Link's virtual COM
+port), or to the application's USB CDC port.
+
+    python ota_sender.py app.bin /dev/ttyACM0
+    python ota_sender.py app.bin /dev/ttyACM0 --window 1    (stop-and-wait)
+    python ota_sender.py app.bin --simulate --runs 5
+
+Every packet is built once, up front, into one buffer, and DATA packets
+are written straight out of it. Up to the device's credit grant (see
+ota_protocol.h) of them are kept unanswered; a NACK or a silent link
+rewinds to the device's last_chunk_received. The bootloader's printf
+shares USART1, so responses are picked out of its log text by magic.
+
+START and DATA go in the aligned v2 layout (ota_protocol.h), which the
+device reads without copying each chunk. A device that does not answer
+a v2 START is taken for older firmware, and the upload goes on in v1;
+--wire 1 skips the v2 START, and with it that first START timeout.
+
+A silent link is noticed after a retransmit timeout learnt from the
+round trips of DATA packets (RttEstimator), not a fixed one: a few
+times the link's own round trip, doubled on each timeout in a row, and
+kept above any stall the link has been caught making.
+
+Timings are reported per phase:
+  handshake   open the port, let the boot log go quiet, send START
+  erase wait  START to its ACK; the device erases before answering
+  transfer    first DATA to the last one acknowledged
+  verify      END to its ACK; image CRC and boot state write
+
+--simulate uploads to ota_sim_device.py over a pty, and --runs repeats
+the upload to benchmark it. POSIX only (termios).
+"""
+
+import argparse
+import os
+import select
+import statistics
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+from ota_wire_layout import (DATA_HEADER_FORMAT, DATA_HEADER_SIZE, DATA_PACKET_SIZE,
+                             DATA_V2_HEADER_FORMAT, DATA_V2_HEADER_SIZE, END_FORMAT,
+                             OTA_BUSY_RETRY_MS, OTA_CHUNK_SIZE, OTA_ERR_BUSY, OTA_ERR_CRC,
+                             OTA_ERR_SEQUENCE, OTA_MAGIC_DATA, OTA_MAGIC_START, OTA_MAX_CREDITS,
+                             OTA_PKT_ACK, OTA_PKT_DATA, OTA_PKT_DATA_V2, OTA_PKT_END, OTA_PKT_NACK,
+                             OTA_PKT_START, OTA_PKT_START_V2, OTA_TARGET_AUTO as TARGET_AUTO,
+                             RESPONSE_FORMAT, RESPONSE_PACKET_SIZE, START_FORMAT, START_V2_FORMAT)
+
+RESPONSE_MAGIC = struct.pack('<I', OTA_MAGIC_START)
+
+# Sender tuning
+FIRMWARE_VERSION = 0x02000100   # Version 2.0.1
+QUIET_S = 0.1                   # Boot log silence that counts as ready
+QUIET_MAX_S = 2.0
+START_WORK_S = 15.0             # Erase of the largest slot, on top of the RTO
+END_WORK_S = 10.0               # Image check and boot state write
+MIN_RTO_S = 1.0                 # RFC 6298; rides out short USB host stalls
+INITIAL_RTO_S = 1.0             # Plus a DATA packet's line time, until measured
+MAX_RTO_S = 8.0
+STALL_MARGIN = 0.25             # RTO over the longest stall seen, as a fraction of it
+MAX_TIMEOUTS = 5                # In a row, without progress
+MAX_REWINDS = 20
+MAX_BUSY = 200                  # ~20 s of back-pressure before giving up
+
+PHASES = ('handshake', 'erase wait', 'transfer', 'verify')
+
+
+class RttEstimator:
+    """
+    Retransmit timeout from measured round trips, as TCP's (RFC 6298):
+    SRTT and RTTVAR smoothed over samples from packets sent only once
+    (Karn), RTO = SRTT + 4 * RTTVAR within MIN_RTO_S..MAX_RTO_S, doubled
+    on each timeout until a new sample comes in.
+
+    A link that stalls for longer than that (a missed BLE connection
+    event, a USB host that looks away) makes the timeout fire with the
+    answer still on its way. Once send_data() has caught one doing so,
+    the RTO stays above the silence it fired into, plus STALL_MARGIN.
+    """
+
+    def __init__(self, initial=INITIAL_RTO_S):
+        self.srtt = None
+        self.rttvar = None
+        self.min_rtt = None
+        self.stall_floor = 0.0
+        self.rto = min(MAX_RTO_S, max(MIN_RTO_S, initial))
+
+    def sample(self, rtt):
+        if self.srtt is None:
+            self.srtt, self.rttvar, self.min_rtt = rtt, rtt / 2, rtt
+        else:
+            self.rttvar += (abs(rtt - self.srtt) - self.rttvar) / 4
+            self.srtt += (rtt - self.srtt) / 8
+            self.min_rtt = min(self.min_rtt, rtt)
+        self.rto = min(MAX_RTO_S, max(MIN_RTO_S, self.stall_floor, self.srtt + 4 * self.rttvar))
+
+    def backoff(self):
+        self.rto = min(MAX_RTO_S, self.rto * 2)
+
+    def stalled(self, silence):
+        """A timeout fired spuriously, silence seconds into a stall"""
+        self.stall_floor = max(self.stall_floor, min(MAX_RTO_S, silence * (1 + STALL_MARGIN)))
+        self.rto = max(self.rto, self.stall_floor)
+
+    def describe(self):
+        rtt = f"{self.srtt * 1000:.0f} ms" if self.srtt is not None else "-"
+        stall = f" stall {self.stall_floor * 1000:.0f} ms" if self.stall_floor else ""
+        return f"rtt {rtt} rto {self.rto * 1000:.0f} ms{stall}"
+
+
+class Packets:
+    """
+    All of an image's packets, built once per layout (wire 1 or 2, the v1
+    stream only if a device needs it); DATA n is a view into one buffer
+    """
+
+    def __init__(self, firmware, version=FIRMWARE_VERSION, target=TARGET_AUTO):
+        self.firmware = firmware
+        self.size = len(firmware)
+        self.total = (len(firmware) + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE
+        self.crc = zlib.crc32(firmware) & 0xFFFFFFFF
+        self.start = {
+            1: struct.pack(START_FORMAT, OTA_MAGIC_START, OTA_PKT_START, len(firmware),
+                           version, self.crc, self.total, target),
+            2: struct.pack(START_V2_FORMAT, OTA_MAGIC_START, OTA_PKT_START_V2, target, 0,
+                           len(firmware), version, self.crc, self.total),
+        }
+        self.end = struct.pack(END_FORMAT, OTA_MAGIC_START, OTA_PKT_END)
+        self.views = {}
+        self.build(2)
+
+    def build(self, wire):
+        # The last chunk is padded with 0xFF, as ble_ota_uploader_v3.py does
+        header_size = DATA_V2_HEADER_SIZE if wire == 2 else DATA_HEADER_SIZE
+        size = header_size + OTA_CHUNK_SIZE
+        stream = bytearray(b'\xFF' * (self.total * size))
+        source = memoryview(self.firmware)
+        for n in range(self.total):
+            chunk = source[n * OTA_CHUNK_SIZE:(n + 1) * OTA_CHUNK_SIZE]
+            offset = n * size
+            crc = zlib.crc32(chunk) & 0xFFFFFFFF
+            if wire == 2:
+                struct.pack_into(DATA_V2_HEADER_FORMAT, stream, offset, OTA_MAGIC_DATA,
+                                 OTA_PKT_DATA_V2, 0, len(chunk), n, crc)
+            else:
+                struct.pack_into(DATA_HEADER_FORMAT, stream, offset, OTA_MAGIC_DATA,
+                                 OTA_PKT_DATA, n, len(chunk), crc)
+            stream[offset + header_size:offset + header_size + len(chunk)] = chunk
+        self.views[wire] = (memoryview(stream), size)
+
+    def data(self, n, wire=2):
+        if wire not in self.views:
+            self.build(wire)
+        view, size = self.views[wire]
+        return view[n * size:(n + 1) * size]
+
+
+class SerialPort:
+    """A raw 8N1 serial port, without pyserial"""
+
+    def __init__(self, path, baud):
+        speed = getattr(termios, f'B{baud}', None)
+        if speed is None:
+            raise ValueError(f"unsupported baud rate {baud}")
+        self.baud = baud
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[2] = (attrs[2] & ~termios.CRTSCTS) | termios.CLOCAL | termios.CREAD
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            view = view[os.write(self.fd, view):]
+
+    def read(self, timeout):
+        """Whatever has arrived, waiting up to timeout for the first byte"""
+        ready, _, _ = select.select([self.fd], [], [], max(0.0, timeout))
+        return os.read(self.fd, 4096) if ready else b''
+
+    def close(self):
+        os.close(self.fd)
+
+
+class ResponseReader:
+    """Picks ACK/NACK frames out of the device's console text"""
+
+    def __init__(self, port, echo=False):
+        self.port = port
+        self.echo = echo
+        self.buffer = bytearray()
+        self.console_bytes = 0
+
+    def skip(self, n):
+        if self.echo and n:
+            sys.stdout.write(self.buffer[:n].decode('ascii', 'replace').replace('\r', ''))
+        self.console_bytes += n
+        del self.buffer[:n]
+
+    def frame(self):
+        while True:
+            i = self.buffer.find(RESPONSE_MAGIC)
+            if i < 0:
+                # Keep a tail that may be the start of a magic
+                self.skip(max(0, len(self.buffer) - (len(RESPONSE_MAGIC) - 1)))
+                return None
+            self.skip(i)
+            if len(self.buffer) < RESPONSE_PACKET_SIZE:
+                return None
+            _, kind, code, last = struct.unpack_from(RESPONSE_FORMAT, self.buffer)
+            if kind in (OTA_PKT_ACK, OTA_PKT_NACK):
+                del self.buffer[:RESPONSE_PACKET_SIZE]
+                return {'type': kind, 'error_code': code, 'credits': code, 'last_chunk': last}
+            self.skip(1)
+
+    def get(self, timeout):
+        """The next response, or None after timeout seconds"""
+        deadline = time.monotonic() + timeout
+        while True:
+            response = self.frame()
+            if response is not None:
+                return response
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None
+            self.buffer += self.port.read(remaining)
+
+    def wait_quiet(self, quiet, limit):
+        """Read until the line has been silent for quiet seconds (at most limit)"""
+        deadline = time.monotonic() + limit
+        while time.monotonic() < deadline:
+            data = self.port.read(min(quiet, deadline - time.monotonic()))
+            if not data:
+                break
+            self.buffer += data
+        self.skip(len(self.buffer))
+
+
+class Sender:
+    def __init__(self, port, packets, max_window=OTA_MAX_CREDITS, echo=False, wire=2):
+        self.port = port
+        self.packets = packets
+        self.wire = wire                # DATA layout; 1 once a device ignores a v2 START
+        self.refused = False            # The last exchange was NACKed, not unanswered
+        self.reader = ResponseReader(port, echo)
+        self.max_window = max_window
+        self.credits = 1
+        self.rtt = RttEstimator(INITIAL_RTO_S + DATA_PACKET_SIZE * 10 / port.baud)
+
+        self.phases = {}
+        self.retransmitted = 0
+        self.nack_count = 0
+        self.busy_count = 0
+        self.timeout_count = 0
+        self.most_in_flight = 0
+
+    def window(self):
+        return max(1, min(self.credits, self.max_window))
+
+    def exchange(self, packet, name, work, retries=3):
+        """
+        Send START or END and wait for its ACK: the RTO plus work seconds
+        of flash work, backing off on each silence; BUSY NACKs are
+        retried. Returns the ACK and when the packet was first written,
+        or None.
+        """
+        busy = 0
+        attempt = 0
+        sent_at = None
+        self.refused = False
+        while True:
+            self.port.write(packet)
+            sent_at = sent_at or time.monotonic()
+            response = self.reader.get(work + self.rtt.rto)
+            if response is None:
+                attempt += 1
+                print(f"  ⏱ No answer to {name} ({attempt}/{retries})")
+                if attempt >= retries:
+                    return None
+                self.rtt.backoff()
+                continue
+            if response['type'] == OTA_PKT_ACK:
+                return response, sent_at
+            if response['error_code'] == OTA_ERR_BUSY and busy < MAX_BUSY:
+                busy += 1
+                self.busy_count += 1
+                time.sleep(OTA_BUSY_RETRY_MS / 1000)
+                continue
+            print(f"  ✗ {name} NACKed (error: {response['error_code']})")
+            self.refused = True
+            return None
+
+    def handshake(self):
+        """
+        START, offering the v2 layout first: a device that ignores it is
+        running firmware from before it, and gets a v1 START instead
+        """
+        if self.wire == 2:
+            result = self.exchange(self.packets.start[2], "START (v2)", START_WORK_S, retries=1)
+            if result is not None or self.refused:
+                return result
+            print("  Device ignored the v2 START; going on in v1")
+            self.wire = 1
+        return self.exchange(self.packets.start[1], "START", START_WORK_S)
+
+    def send_data(self):
+        """
+        Go-back-N over the credit window, as ble_ota_uploader_v3.py: any
+        response moves base to last_chunk_received, and a NACK or a
+        timeout sends everything from base again. NACKs for packets
+        written before that rewind are not counted as new losses. The
+        round trip of each chunk sent once, to the response that takes
+        base past it, is an RTT sample.
+
+        A timeout was spurious if base moves sooner after it than the
+        resend could have been answered (the originals got through) and
+        an ACK then fails to move it (the device got a chunk twice, RFC
+        3708); the silence it fired into is then a stall to wait out.
+        """
+        total = self.packets.total
+        base = next_chunk = 0
+        unanswered = stale = 0
+        timeouts = rewinds = 0
+        resent_to = 0       # Chunks below this have been sent before
+        sent_at = {}        # Chunk -> when it was written, if only once
+        silent_from = None  # Start of the silence a first timeout in a row fired into
+        resent_at = None    # ...when base went out again after it
+        quiet = None        # ...and how long the link was really silent
+        start = report_at = time.monotonic()
+
+        def rewind():
+            nonlocal next_chunk, stale, rewinds
+            stale = unanswered
+            next_chunk = base
+            rewinds += 1
+
+        while base < total:
+            while next_chunk < total and next_chunk - base < self.window():
+                self.port.write(self.packets.data(next_chunk, self.wire))
+                if next_chunk < resent_to:
+                    self.retransmitted += 1
+                    sent_at.pop(next_chunk, None)
+                    if next_chunk == base and silent_from is not None and resent_at is None:
+                        resent_at = time.monotonic()
+                else:
+                    sent_at[next_chunk] = time.monotonic()
+                next_chunk += 1
+                resent_to = max(resent_to, next_chunk)
+                unanswered += 1
+                self.most_in_flight = max(self.most_in_flight, next_chunk - base)
+
+            now = time.monotonic()
+            if now - report_at >= 0.5:
+                self.report(base, total, now - start)
+                report_at = now
+
+            response = self.reader.get(self.rtt.rto)
+            if response is None:
+                self.timeout_count += 1
+                timeouts += 1
+                if timeouts > MAX_TIMEOUTS:
+                    print(f"\n  ⏱ No answer for chunk {base} after {timeouts - 1} resends")
+                    return False
+                # Only the first timeout in a row can have fired into a stall
+                silent_from = time.monotonic() - self.rtt.rto if timeouts == 1 else None
+                resent_at = quiet = None
+                rewind()
+                stale = unanswered = 0
+                self.rtt.backoff()
+                continue
+
+            now = time.monotonic()
+            if silent_from is not None and quiet is None and response['last_chunk'] > base:
+                min_rtt = self.rtt.min_rtt
+                if resent_at is None or (min_rtt is not None and now - resent_at < min_rtt):
+                    quiet = now - silent_from
+                else:
+                    silent_from = None
+            if quiet is not None and response['type'] == OTA_PKT_ACK and response['last_chunk'] <= base:
+                self.rtt.stalled(quiet)
+                silent_from = quiet = None
+
+            unanswered = max(0, unanswered - 1)
+            was_stale = stale > 0
+            stale = max(0, stale - 1)
+            if response['last_chunk'] > base:
+                last = response['last_chunk']
+                if last - 1 in sent_at:
+                    self.rtt.sample(time.monotonic() - sent_at[last - 1])
+                for c in range(base, last):
+                    sent_at.pop(c, None)
+                base = last
+                next_chunk = max(next_chunk, base)
+                timeouts = rewinds = 0
+
+            if response['type'] == OTA_PKT_ACK:
+                self.credits = max(1, response['credits'])
+                continue
+
+            self.nack_count += 1
+            code = response['error_code']
+            if code == OTA_ERR_BUSY:
+                self.busy_count += 1
+                time.sleep(OTA_BUSY_RETRY_MS / 1000)
+            elif code not in (OTA_ERR_CRC, OTA_ERR_SEQUENCE):
+                print(f"\n  ✗ NACK received (error: {code}) at chunk {base}")
+                return False
+            if not was_stale:
+                rewind()
+                if rewinds > MAX_REWINDS:
+                    print(f"\n  ✗ Chunk {base} rejected {rewinds - 1} times")
+                    return False
+
+        # Answers still owed for resent packets would be taken as END's
+        while unanswered > 0 and self.reader.get(self.rtt.rto) is not None:
+            unanswered -= 1
+
+        self.report(total, total, time.monotonic() - start)
+        print()
+        return True
+
+    def report(self, done, total, elapsed):
+        if self.reader.echo:
+            return      # The device's log would overwrite the line
+        rate = done * OTA_CHUNK_SIZE / elapsed / 1024 if elapsed > 0 else 0.0
+        print(f"\r  {done}/{total} chunks ({done * 100 // total}%)  {rate:.1f} KB/s  "
+              f"window {self.window()}  resent {self.retransmitted}  "
+              f"nack {self.nack_count}  t/o {self.timeout_count}  {self.rtt.describe()}   ",
+              end="", flush=True)
+
+    def upload(self):
+        """Run every phase; False as soon as one fails"""
+        t0 = time.monotonic()
+        self.reader.wait_quiet(QUIET_S, QUIET_MAX_S)
+        result = self.handshake()
+        if result is None:
+            print("✗ Device did not accept START")
+            return False
+        response, t1 = result
+        self.credits = max(1, response['credits'])
+        t2 = time.monotonic()
+        self.phases['handshake'] = t1 - t0
+        self.phases['erase wait'] = t2 - t1
+
+        if not self.send_data():
+            return False
+        t3 = time.monotonic()
+        self.phases['transfer'] = t3 - t2
+
+        if self.exchange(self.packets.end, "END", END_WORK_S) is None:
+            return False
+        self.phases['verify'] = time.monotonic() - t3
+        return True
+
+
+def print_phases(phases, size, baud):
+    total = sum(phases.values())
+    for name in PHASES:
+        line = f"  {name:<11} {phases[name]:7.3f} s"
+        if name == 'transfer':
+            rate = size / phases[name]
+            line += f"   {rate / 1024:6.1f} KB/s ({rate * 100 / (baud / 10):.0f}% of {baud} baud)"
+        print(line)
+    print(f"  {'total':<11} {total:7.3f} s   {size / total / 1024:6.1f} KB/s")
+
+
+def print_summary(runs, size):
+    print(f"\n{len(runs)} runs        min      median   max")
+    for name in PHASES + ('total',):
+        values = [sum(r.values()) if name == 'total' else r[name] for r in runs]
+        print(f"  {name:<11} {min(values):7.3f}  {statistics.median(values):7.3f}  "
+              f"{max(values):7.3f} s")
+    best = min(r['transfer'] for r in runs)
+    print(f"  best transfer {size / best / 1024:.1f} KB/s")
+
+
+def upload(port_path, firmware, packets, args):
+    try:
+        port = SerialPort(port_path, args.baud)
+    except (OSError, ValueError) as e:
+        print(f"ERROR: {port_path}: {e}")
+        return None
+    try:
+        sender = Sender(port, packets, max_window=args.window, echo=args.console, wire=args.wire)
+        success = sender.upload()
+    finally:
+        port.close()
+    if not success:
+        return None
+
+    print_phases(sender.phases, len(firmware), args.baud)
+    print(f"  v{sender.wire} DATA, at most {sender.most_in_flight} in flight, "
+          f"{sender.retransmitted} resent, {sender.nack_count} NACKs "
+          f"({sender.busy_count} busy), {sender.timeout_count} timeouts ({sender.rtt.describe()}), "
+          f"{sender.reader.console_bytes} bytes of console text skipped")
+    return sender.phases
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serial OTA firmware uploader")
+    parser.add_argument('firmware')
+    parser.add_argument('port', nargs='?', default='/dev/ttyACM0')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--window', type=int, default=OTA_MAX_CREDITS,
+                        help="most DATA packets in flight (the device's credits cap it; 1 = stop-and-wait)")
+    parser.add_argument('--target', type=lambda v: int(v, 0), default=TARGET_AUTO,
+                        help="slot index (default: let the device choose)")
+    parser.add_argument('--version', type=lambda v: int(v, 0), default=FIRMWARE_VERSION)
+    parser.add_argument('--wire', type=int, choices=(1, 2), default=2,
+                        help="packet layout to offer (2 falls back to 1 for older firmware)")
+    parser.add_argument('--console', action='store_true', help="show the device's log text")
+    parser.add_argument('--simulate', action='store_true', help="upload to ota_sim_device.py over a pty")
+    parser.add_argument('--runs', type=int, default=1, help="upload this many times and summarise")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.firmware):
+        print(f"ERROR: Firmware file not found: {args.firmware}")
+        return False
+    with open(args.firmware, 'rb') as f:
+        firmware = f.read()
+
+    t = time.monotonic()
+    packets = Packets(firmware, args.version, args.target)
+    print(f"Loaded {args.firmware}: {len(firmware)} bytes, CRC32 0x{packets.crc:08X}, "
+          f"{packets.total} chunks ({(time.monotonic() - t) * 1000:.1f} ms to build)")
+
+    sim = None
+    port_path = args.port
+    if args.simulate:
+        from ota_sim_device import SimSerialPort
+
+        sim = SimSerialPort(baud=args.baud).start()
+        port_path = sim.path
+        print(f"Simulated device at {args.baud} baud on {port_path}")
+
+    runs = []
+    try:
+        for run in range(args.runs):
+            print(f"\n--- Upload {run + 1}/{args.runs} to {port_path} ---")
+            if sim:
+                sim.device.image = None
+            phases = upload(port_path, firmware, packets, args)
+            if phases is None:
+                print("✗ Upload failed")
+                return False
+            if sim and sim.device.image != firmware:
+                print("✗ Simulated device holds a different image")
+                return False
+            runs.append(phases)
+    finally:
+        if sim:
+            print(sim.report())
+            sim.stop()
+
+    if len(runs) > 1:
+        print_summary(runs, len(firmware))
+    return True
+
+
+if __name__ == "__main__":
+    sys.exit(0 if main() else 1)
@@ -0,0 +1,722 @@
+#!/usr/bin/env python3
+"""
+Simulated OTA device for running the uploaders without a board
+
+SimDevice     The receiving end of ota_link.c and ota_manager.c: the
+              resynchronising framer (header checks, and a short packet
+              given up at a packet start inside it) for both the v1 and
+              the aligned v2 layouts, or v1 only as older firmware
+              (wire=1), which drops v2 packets as noise; the stalled-packet
+              gap learnt from pauses inside whole packets, START/DATA/END
+              checks, in-order chunks with a cumulative last_chunk_received,
+              the credit grant in every ACK (rx_window / DATA packet), and
+              ota_fec.c's repair of a group's lost chunk from its PARITY.
+              Bytes arrive in a receive ring of rx_window bytes, as the
+              UART driver's, and are dropped when it is full.
+
+              START answers after the erase and END after the check and
+              boot state write, with the device deaf meanwhile; with log
+              set it prints around its responses, as the bootloader's
+              printf does on USART1.
+
+SimBleClient  A BleakClient stand-in for an HM-10 in front of the device:
+              writes without response go over the air at ble_rate, into
+              the module's buffer (dropped past hm10_buffer bytes, or at
+              random with probability loss), and out of its UART at
+              baud / 10 bytes per second. Responses come back as
+              notifications one connection interval later.
+
+SimSerialPort The device behind a pty, as the bootloader is behind the
+              ST-Link's virtual COM port: bytes are taken from the pty
+              no faster than the UART carries them (the writer blocks
+              once the pty is full), responses and log text go back the
+              same way.
+
+Used by ble_ota_uploader_v3.py --simulate and ota_sender.py --simulate.
+On its own it uploads a random image with a stop-and-wait sender as a
+smoke test, or serves a pty for an uploader in another process:
+
+    python ota_sim_device.py
+    python ota_sim_device.py --pty --baud 115200
+"""
+
+import argparse
+import asyncio
+import os
+import random
+import select
+import struct
+import threading
+import time
+import tty
+import zlib
+
+from ota_wire_layout import (DATA_HEADER_FORMAT, DATA_HEADER_SIZE, DATA_OFFSETS, DATA_PACKET_SIZE,
+                             DATA_V2_HEADER_FORMAT, DATA_V2_HEADER_SIZE, DATA_V2_OFFSETS,
+                             DATA_V2_PACKET_SIZE, END_FORMAT, END_PACKET_SIZE, OTA_CHUNK_SIZE,
+                             OTA_ERR_CRC, OTA_ERR_NONE, OTA_ERR_SEQUENCE, OTA_ERR_SIZE,
+                             OTA_FEC_MAX_GROUP, OTA_MAGIC_DATA, OTA_MAGIC_START, OTA_MAX_CREDITS,
+                             OTA_PKT_ABORT, OTA_PKT_ACK, OTA_PKT_DATA, OTA_PKT_DATA_V2, OTA_PKT_END,
+                             OTA_PKT_NACK, OTA_PKT_PARITY, OTA_PKT_PARITY_V2, OTA_PKT_START,
+                             OTA_PKT_START_V2, OTA_PKT_V2, RESPONSE_FORMAT, START_FORMAT,
+                             START_PACKET_SIZE, START_V2_FORMAT, START_V2_PACKET_SIZE)
+
+PACKET_LENGTHS = {
+    OTA_PKT_START: START_PACKET_SIZE,
+    OTA_PKT_DATA: DATA_PACKET_SIZE,
+    OTA_PKT_PARITY: DATA_PACKET_SIZE,
+    OTA_PKT_END: END_PACKET_SIZE,
+    OTA_PKT_ABORT: END_PACKET_SIZE,
+    OTA_PKT_START_V2: START_V2_PACKET_SIZE,
+    OTA_PKT_DATA_V2: DATA_V2_PACKET_SIZE,
+    OTA_PKT_PARITY_V2: DATA_V2_PACKET_SIZE,
+}
+MAGICS = (struct.pack('<I', OTA_MAGIC_START), struct.pack('<I', OTA_MAGIC_DATA))
+MAGIC_FIRST_BYTES = {m[0] for m in MAGICS}
+SIZE_OFFSET = DATA_OFFSETS['chunk_size']   # Checked once it is in
+V2_SIZE_OFFSET = DATA_V2_OFFSETS['chunk_size']
+
+OTA_LINK_GAP_MIN_S = 0.1     # ota_link.h OTA_LINK_GAP_MIN_MS
+OTA_LINK_GAP_MAX_S = 2.0     # ota_link.h OTA_LINK_GAP_MAX_MS
+OTA_UART_RX_RING_SIZE = 4096  # ota_transport_uart.h
+HM10_BAUD = 9600             # USART2 in the application
+USART1_BAUD = 115200         # Bootloader recovery, on the ST-Link VCP
+
+# Rough F429 flash timings: sector erase runs at about 128 KB/s, and END
+# rewrites the 16 KB boot state sector
+ERASE_MS_PER_KB = 8.0
+END_MS = 250.0
+
+
+def prefix_valid(packet, v2=True):
+    """Could these bytes still be the start of a packet? (ota_link.c)"""
+    n = min(len(packet), 4)
+    magic = next((m for m in MAGICS if packet[:n] == m[:n]), None)
+    if magic is None:
+        return False
+    if len(packet) < 5:
+        return True
+    kind = packet[4]
+    if kind not in PACKET_LENGTHS or (kind & OTA_PKT_V2 and not v2):
+        return False
+    base = kind & ~OTA_PKT_V2
+    if base == OTA_PKT_ABORT:
+        return True
+    if base in (OTA_PKT_START, OTA_PKT_END):
+        return magic == MAGICS[0]
+    if magic != MAGICS[1]:
+        return False
+    at = V2_SIZE_OFFSET if kind & OTA_PKT_V2 else SIZE_OFFSET
+    if len(packet) < at + 2:
+        return True
+    size = struct.unpack_from('<H', packet, at)[0]
+    return 0 < size <= (OTA_CHUNK_SIZE if base == OTA_PKT_DATA else OTA_FEC_MAX_GROUP)
+
+
+def next_start(packet, v2=True):
+    """Where a packet start shows up inside a frame, or 0"""
+    for i in range(1, len(packet)):
+        if packet[i] in MAGIC_FIRST_BYTES and prefix_valid(packet[i:i + DATA_HEADER_SIZE], v2):
+            return i
+    return 0
+
+
+def as_v1(packet):
+    """A v2 START, DATA or PARITY in the v1 layout, as ota_link.c hands it on"""
+    kind = packet[4]
+    if kind == OTA_PKT_START_V2:
+        magic, _, target, _, size, version, crc, chunks = struct.unpack(START_V2_FORMAT, packet)
+        return struct.pack(START_FORMAT, magic, OTA_PKT_START, size, version, crc, chunks, target)
+    if kind in (OTA_PKT_DATA_V2, OTA_PKT_PARITY_V2):
+        magic, _, _, size, number, crc = struct.unpack_from(DATA_V2_HEADER_FORMAT, packet)
+        return (struct.pack(DATA_HEADER_FORMAT, magic, kind & ~OTA_PKT_V2, number, size, crc) +
+                bytes(packet[DATA_V2_HEADER_SIZE:]))
+    return bytes(packet)
+
+
+def frame_intact(packet):
+    """Does a whole frame pass the CRC its type carries?"""
+    packet = as_v1(packet)
+    if packet[4] not in (OTA_PKT_DATA, OTA_PKT_PARITY):
+        return True
+    _, kind, _, size, crc = struct.unpack_from(DATA_HEADER_FORMAT, packet)
+    data = packet[DATA_HEADER_SIZE:]
+    return zlib.crc32(data[:size] if kind == OTA_PKT_DATA else data) & 0xFFFFFFFF == crc
+
+
+class SimDevice:
+    """What the board does with the bytes its OTA UART receives"""
+
+    def __init__(self, send, bytes_per_sec=HM10_BAUD // 10, rx_window=OTA_UART_RX_RING_SIZE,
+                 chunk_ms=5.0, erase_ms_per_kb=ERASE_MS_PER_KB, end_ms=END_MS, log=False, wire=2):
+        self.send = send                # Called with each response (and log text)
+        self.v2 = wire > 1              # Knows the v2 layouts
+        self.bytes_per_sec = bytes_per_sec
+        self.rx_window = rx_window
+        self.chunk_s = chunk_ms / 1000  # Flash write per DATA packet
+        self.erase_s_per_kb = erase_ms_per_kb / 1000
+        self.end_s = end_ms / 1000
+        self.log = log
+        self.outbox = []                # (when, bytes): answers wait for the flash
+
+        self.ring = bytearray()
+        self.packet = bytearray()
+        self.packet_time = 0.0
+        self.packet_pause = 0.0         # Longest wait for the packet's next bytes
+        self.busy_until = 0.0
+        self.gap_max_s = max(OTA_LINK_GAP_MAX_S, 2 * DATA_PACKET_SIZE / bytes_per_sec)
+        self.gap_s = self.gap_max_s     # Until a packet comes through whole
+        self.gap_srtt = None
+        self.gap_rttvar = 0.0
+        self.gap_backoff = 0
+
+        self.state = 'idle'
+        self.firmware = bytearray()
+        self.firmware_size = 0
+        self.firmware_crc = 0
+        self.total_chunks = 0
+        self.chunks_received = 0
+        self.error_code = OTA_ERR_NONE
+        self.image = None               # Set once END checks out
+
+        self.fec_reset()
+        self.replaying = False
+        self.replay_response = None
+
+        self.stats = {'packets': 0, 'v2_packets': 0, 'resync_bytes': 0, 'stalled_packets': 0, 'broken_frames': 0,
+                      'ring_dropped': 0, 'nacks': 0, 'fec_held': 0, 'fec_repaired': 0,
+                      'fec_unrepairable': 0}
+
+    def credits(self):
+        return max(1, min(OTA_MAX_CREDITS, self.rx_window // DATA_PACKET_SIZE))
+
+    def respond(self, packet_type):
+        second = self.credits() if packet_type == OTA_PKT_ACK else self.error_code
+        if packet_type == OTA_PKT_NACK:
+            self.stats['nacks'] += 1
+        response = struct.pack(RESPONSE_FORMAT, OTA_MAGIC_START, packet_type, second,
+                               self.chunks_received)
+        if self.replaying:
+            self.replay_response = response     # Only the last of a repair goes out
+        else:
+            self.outbox.append((self.busy_until, response))
+        if packet_type == OTA_PKT_ACK:
+            self.print(f"Sent ACK (chunks received: {self.chunks_received})\r\n")
+        else:
+            self.print(f"Sent NACK (error code: {self.error_code})\r\n")
+
+    def print(self, text):
+        if self.log:
+            self.outbox.append((self.busy_until, text.encode()))
+
+    def nack(self, error_code, fatal=False):
+        self.error_code = error_code
+        if fatal:
+            self.state = 'error'
+        self.respond(OTA_PKT_NACK)
+
+    # ---- UART side ----
+
+    def gap_update(self):
+        gap = max(OTA_LINK_GAP_MIN_S, self.gap_srtt + 4 * self.gap_rttvar)
+        self.gap_s = min(self.gap_max_s, gap * 2 ** self.gap_backoff)
+
+    def gap_sample(self, pause):
+        """ota_link.c's gap_sample(): a packet came through whole"""
+        if self.gap_srtt is None:
+            self.gap_srtt, self.gap_rttvar = pause, pause / 2
+        else:
+            self.gap_rttvar += (abs(pause - self.gap_srtt) - self.gap_rttvar) / 4
+            self.gap_srtt += (pause - self.gap_srtt) / 8
+        self.gap_backoff = 0
+        self.gap_update()
+
+    def receive(self, data):
+        """Bytes off the UART into the receive ring"""
+        room = self.rx_window - len(self.ring)
+        self.ring += data[:room]
+        self.stats['ring_dropped'] += max(0, len(data) - room)
+
+    def run(self, now):
+        """The rx task: frame what is in the ring unless a packet is being written"""
+        while self.outbox and self.outbox[0][0] <= now:
+            self.send(self.outbox.pop(0)[1])
+        if now < self.busy_until:
+            return
+        if self.packet and not self.ring and now - self.packet_time >= self.gap_s:
+            self.stats['stalled_packets'] += 1
+            self.packet.clear()
+            self.packet_pause = 0.0
+            if self.gap_srtt is not None and self.gap_s < self.gap_max_s:
+                self.gap_backoff += 1
+                self.gap_update()
+
+        if self.ring and self.packet:
+            self.packet_pause = max(self.packet_pause, now - self.packet_time)
+        while self.ring and now >= self.busy_until:
+            self.packet_time = now
+            if len(self.packet) >= DATA_HEADER_SIZE:
+                # Header checked: the rest of the packet in one go
+                need = PACKET_LENGTHS[self.packet[4]] - len(self.packet)
+                self.packet += self.ring[:need]
+                del self.ring[:need]
+            else:
+                self.packet.append(self.ring.pop(0))
+                while self.packet and not prefix_valid(self.packet, self.v2):
+                    del self.packet[0]
+                    self.stats['resync_bytes'] += 1
+            while len(self.packet) >= 5 and len(self.packet) == PACKET_LENGTHS[self.packet[4]]:
+                # A short packet runs on into the next: it is still answered
+                # for, and framing carries on from a packet start inside it
+                start = next_start(self.packet, self.v2)
+                broken = start and not frame_intact(self.packet)
+                if self.packet[4] & OTA_PKT_V2:
+                    self.stats['v2_packets'] += 1
+                self.dispatch(as_v1(self.packet), now)
+                if not broken:
+                    self.gap_sample(self.packet_pause)
+                    self.packet.clear()
+                    self.packet_pause = 0.0
+                    break
+                del self.packet[:start]
+                self.packet_pause = 0.0
+                self.stats['broken_frames'] += 1
+
+    # ---- ota_manager ----
+
+    def dispatch(self, pkt, now):
+        self.stats['packets'] += 1
+        self.busy_until = now
+        kind = pkt[4]
+
+        if kind == OTA_PKT_START:
+            _, _, size, _, crc, chunks, _ = struct.unpack(START_FORMAT, pkt)
+            self.print("\r\n=== OTA START Packet   ===\r\n")
+            if size == 0 or chunks != (size + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE:
+                self.nack(OTA_ERR_SIZE)
+                return
+            self.busy_until = now + size / 1024 * self.erase_s_per_kb
+            self.print("Bank erased successfully!\r\n")
+            self.firmware = bytearray(b'\xFF' * size)
+            self.firmware_size, self.firmware_crc, self.total_chunks = size, crc, chunks
+            self.chunks_received = 0
+            self.error_code = OTA_ERR_NONE
+            self.image = None
+            self.state = 'receiving'
+            self.fec_reset()
+            self.respond(OTA_PKT_ACK)
+
+        elif kind == OTA_PKT_DATA:
+            if self.fec_data(pkt):
+                self.respond(OTA_PKT_ACK)
+            else:
+                before = self.chunks_received
+                self.data(pkt, now)
+                if self.chunks_received != before:
+                    self.fec_written(pkt)
+
+        elif kind == OTA_PKT_PARITY:
+            self.parity(pkt)
+
+        elif kind == OTA_PKT_END:
+            if self.state != 'verifying':
+                self.nack(OTA_ERR_SEQUENCE, fatal=True)
+            elif zlib.crc32(self.firmware) & 0xFFFFFFFF != self.firmware_crc:
+                self.nack(OTA_ERR_CRC, fatal=True)
+            else:
+                self.busy_until = now + self.end_s
+                self.state = 'complete'
+                self.image = bytes(self.firmware)
+                self.respond(OTA_PKT_ACK)
+
+        elif kind == OTA_PKT_ABORT:
+            self.state = 'idle'
+            self.fec_reset()
+
+    def data(self, pkt, now):
+        magic, _, number, size, crc = struct.unpack_from(DATA_HEADER_FORMAT, pkt)
+        data = pkt[DATA_HEADER_SIZE:][:size]
+        if self.state in ('receiving', 'verifying') and number < self.chunks_received:
+            self.respond(OTA_PKT_ACK)   # Resent by a window: already have it
+        elif self.state != 'receiving' or magic != OTA_MAGIC_DATA:
+            self.nack(OTA_ERR_SEQUENCE, fatal=True)
+        elif number != self.chunks_received:
+            self.nack(OTA_ERR_SEQUENCE)
+        elif size == 0 or size > OTA_CHUNK_SIZE or number * OTA_CHUNK_SIZE + size > self.firmware_size:
+            self.nack(OTA_ERR_SIZE, fatal=True)
+        elif zlib.crc32(data) & 0xFFFFFFFF != crc:
+            self.nack(OTA_ERR_CRC)
+        else:
+            offset = number * OTA_CHUNK_SIZE
+            self.firmware[offset:offset + size] = data
+            self.chunks_received += 1
+            self.busy_until = now + self.chunk_s
+            if self.chunks_received == self.total_chunks:
+                self.state = 'verifying'
+            self.respond(OTA_PKT_ACK)
+
+    # ---- ota_fec ----
+
+    def fec_reset(self):
+        self.fec_group = 0              # Chunks per PARITY; 0 = FEC off
+        self.fec_first = None           # First chunk of the group being collected
+        self.fec_present = set()        # Positions XORed into fec_acc
+        self.fec_held = {}              # Position -> packet held past a gap
+        self.fec_partial = False        # Chunks were written before tracking began
+        self.fec_acc = 0                # XOR of the present data fields, as an int
+
+    def fec_sync(self):
+        first = self.chunks_received - self.chunks_received % self.fec_group
+        if first != self.fec_first:
+            self.fec_first = first
+            self.fec_present = set(range(self.chunks_received - first))
+            self.fec_held = {}
+            self.fec_partial = bool(self.fec_present)
+            self.fec_acc = 0
+
+    def fec_drop_held(self):
+        for pos, pkt in self.fec_held.items():
+            self.fec_acc ^= int.from_bytes(pkt[DATA_HEADER_SIZE:], 'little')
+            self.fec_present.discard(pos)
+        self.fec_held = {}
+
+    def fec_intact(self, pkt):
+        magic, _, number, size, crc = struct.unpack_from(DATA_HEADER_FORMAT, pkt)
+        return (magic == OTA_MAGIC_DATA and 0 < size <= OTA_CHUNK_SIZE and
+                number * OTA_CHUNK_SIZE + size <= self.firmware_size and
+                zlib.crc32(pkt[DATA_HEADER_SIZE:][:size]) & 0xFFFFFFFF == crc)
+
+    def fec_data(self, pkt):
+        """True if the packet was taken for repair (answered with an ACK)"""
+        number = struct.unpack_from(DATA_HEADER_FORMAT, pkt)[2]
+        if not self.fec_group or self.state != 'receiving' or number < self.chunks_received:
+            return False
+        self.fec_sync()
+        pos = number - self.fec_first
+        if pos >= self.fec_group:
+            self.fec_drop_held()        # The next group before this one's parity
+            return False
+        if not self.fec_intact(pkt):
+            return True
+        if number == self.chunks_received:
+            return False
+        if pos not in self.fec_present:
+            self.fec_held[pos] = pkt
+            self.fec_acc ^= int.from_bytes(pkt[DATA_HEADER_SIZE:], 'little')
+            self.fec_present.add(pos)
+            self.stats['fec_held'] += 1
+        return True
+
+    def fec_written(self, pkt):
+        if not self.fec_group:
+            return
+        pos = struct.unpack_from(DATA_HEADER_FORMAT, pkt)[2] - self.fec_first
+        if 0 <= pos < self.fec_group:
+            if pos not in self.fec_present:
+                self.fec_acc ^= int.from_bytes(pkt[DATA_HEADER_SIZE:], 'little')
+                self.fec_present.add(pos)
+            self.fec_held.pop(pos, None)
+
+    def parity(self, pkt):
+        _, _, first, group, crc = struct.unpack_from(DATA_HEADER_FORMAT, pkt)
+        if self.state != 'receiving':
+            self.respond(OTA_PKT_ACK)
+            return
+        if not 2 <= group <= OTA_FEC_MAX_GROUP or first % group:
+            self.nack(OTA_ERR_SEQUENCE)
+            return
+        if group != self.fec_group:
+            self.fec_reset()
+            self.fec_group = group
+        self.fec_sync()
+
+        count = min(group, self.total_chunks - self.fec_first)
+        missing = [pos for pos in range(count) if pos not in self.fec_present]
+        if first != self.fec_first or not missing:
+            self.respond(OTA_PKT_ACK)
+            return
+        if (len(missing) > 1 or self.fec_partial or
+                zlib.crc32(pkt[DATA_HEADER_SIZE:]) & 0xFFFFFFFF != crc):
+            self.stats['fec_unrepairable'] += 1
+            self.fec_drop_held()
+            self.nack(OTA_ERR_SEQUENCE)
+            return
+
+        gap = missing[0]
+        number = self.fec_first + gap
+        size = min(OTA_CHUNK_SIZE, self.firmware_size - number * OTA_CHUNK_SIZE)
+        data = (self.fec_acc ^ int.from_bytes(pkt[DATA_HEADER_SIZE:], 'little')).to_bytes(
+            OTA_CHUNK_SIZE, 'little')
+        self.fec_held[gap] = struct.pack(DATA_HEADER_FORMAT, OTA_MAGIC_DATA, OTA_PKT_DATA, number,
+                                         size, zlib.crc32(data[:size]) & 0xFFFFFFFF) + data
+        self.stats['fec_repaired'] += 1
+        self.print(f"FEC: group at chunk {first} repaired from parity\r\n")
+
+        self.replaying = True
+        for pos in range(self.chunks_received - self.fec_first, count):
+            before = self.chunks_received
+            self.data(self.fec_held[pos], self.busy_until)
+            if self.chunks_received == before:
+                break
+        self.replaying = False
+        self.fec_held = {}
+        self.outbox.append((self.busy_until, self.replay_response))
+
+
+def fec_report(d):
+    if not d['fec_held'] and not d['fec_repaired'] and not d['fec_unrepairable']:
+        return ""
+    return (f", FEC {d['fec_repaired']} rebuilt, {d['fec_held']} held, "
+            f"{d['fec_unrepairable']} groups resent")
+
+
+class SimBleClient:
+    """Enough of BleakClient for the uploader, backed by an HM-10 and a SimDevice"""
+
+    def __init__(self, baud=HM10_BAUD, ble_rate=6000, hm10_buffer=600, loss=0.0,
+                 interval_ms=30.0, chunk_ms=5.0, rx_window=OTA_UART_RX_RING_SIZE, seed=1,
+                 host_queue=8):
+        self.uart_rate = baud / 10
+        self.ble_rate = ble_rate
+        self.host_queue = host_queue        # Writes the OS takes before blocking
+        self.hm10_buffer = hm10_buffer
+        self.loss = loss
+        self.interval_s = interval_ms / 1000
+        self.random = random.Random(seed)
+
+        self.device = SimDevice(self.notify, int(self.uart_rate), rx_window, chunk_ms)
+        self.mtu_size = 23                  # BLE 4.0: 20 bytes of payload per write
+        self.is_connected = False
+
+        self.hm10 = bytearray()             # Waiting for the UART
+        self.air_free_at = 0.0
+        self.callback = None
+        self.task = None
+        self.stats = {'writes': 0, 'lost_writes': 0, 'overflow_bytes': 0}
+
+    async def __aenter__(self):
+        await self.connect()
+        return self
+
+    async def __aexit__(self, *exc):
+        await self.disconnect()
+
+    async def connect(self):
+        self.is_connected = True
+        self.task = asyncio.create_task(self.pump())
+
+    async def disconnect(self):
+        self.is_connected = False
+        if self.task:
+            self.task.cancel()
+            try:
+                await self.task
+            except asyncio.CancelledError:
+                pass
+
+    async def start_notify(self, uuid, callback):
+        self.callback = callback
+
+    async def stop_notify(self, uuid):
+        self.callback = None
+
+    async def write_gatt_char(self, uuid, data, response=False):
+        loop = asyncio.get_running_loop()
+
+        # The radio takes writes no faster than ble_rate; the host stack
+        # queues a few and then makes the caller wait
+        now = loop.time()
+        self.air_free_at = max(self.air_free_at, now) + len(data) / self.ble_rate
+        backlog = self.air_free_at - now - self.host_queue * 20 / self.ble_rate
+        if backlog > 0:
+            await asyncio.sleep(backlog)
+
+        self.stats['writes'] += 1
+        if self.random.random() < self.loss:
+            self.stats['lost_writes'] += 1
+            return
+        room = self.hm10_buffer - len(self.hm10)
+        self.hm10 += data[:room]
+        self.stats['overflow_bytes'] += max(0, len(data) - room)
+
+    def notify(self, data):
+        loop = asyncio.get_running_loop()
+        for i in range(0, len(data), 20):
+            piece = bytearray(data[i:i + 20])
+            loop.call_later(self.interval_s, self.deliver, piece)
+
+    def deliver(self, piece):
+        if self.callback:
+            self.callback(None, piece)
+
+    async def pump(self):
+        """HM-10 UART into the device, and the device's rx task"""
+        loop = asyncio.get_running_loop()
+        last = loop.time()
+        owed = 0.0
+        while True:
+            await asyncio.sleep(0.002)
+            now = loop.time()
+            owed = min(owed + (now - last) * self.uart_rate, len(self.hm10))
+            last = now
+            n = int(owed)
+            if n:
+                self.device.receive(bytes(self.hm10[:n]))
+                del self.hm10[:n]
+                owed -= n
+            self.device.run(now)
+
+    def report(self):
+        s, d = self.stats, self.device.stats
+        return (f"simulated HM-10: {s['writes']} writes, {s['lost_writes']} lost, "
+                f"{s['overflow_bytes']} bytes overflowed; device: {d['packets']} packets, "
+                f"{d['nacks']} NACKs, {d['resync_bytes']} resync bytes, "
+                f"{d['broken_frames']} broken frames, {d['stalled_packets']} stalled, {d['ring_dropped']} ring drops" + fec_report(d))
+
+
+class SimSerialPort:
+    """A SimDevice on the far end of a pty; open .path as the serial port"""
+
+    def __init__(self, baud=USART1_BAUD, log=True, rx_window=OTA_UART_RX_RING_SIZE,
+                 chunk_ms=5.0, erase_ms_per_kb=ERASE_MS_PER_KB, end_ms=END_MS, wire=2):
+        self.uart_rate = baud / 10
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.slave)          # Held open so the master never sees EIO
+        self.path = os.ttyname(self.slave)
+        os.set_blocking(self.master, False)
+
+        self.device = SimDevice(self.output, int(self.uart_rate), rx_window, chunk_ms,
+                                erase_ms_per_kb, end_ms, log, wire)
+        self.tx = bytearray()
+        self.running = False
+        self.thread = None
+
+    def output(self, data):
+        self.tx += data
+
+    def start(self):
+        self.running = True
+        self.thread = threading.Thread(target=self.serve, daemon=True)
+        self.thread.start()
+        return self
+
+    def stop(self):
+        self.running = False
+        if self.thread:
+            self.thread.join()
+        os.close(self.master)
+        os.close(self.slave)
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, *exc):
+        self.stop()
+
+    def serve(self):
+        """The UART both ways at uart_rate, and the device's rx task"""
+        last = time.monotonic()
+        rx_owed = tx_owed = 0.0
+        backlog = False             # The pty holds more than the UART has carried
+        while self.running:
+            if backlog:
+                time.sleep(0.002)
+            else:
+                select.select([self.master], [], [], 0.002)
+            now = time.monotonic()
+            # A line that was idle has no bytes banked; allow a tick's worth
+            burst = max(1.0, 0.004 * self.uart_rate)
+            rx_owed = min(rx_owed + (now - last) * self.uart_rate, burst)
+            tx_owed = min(tx_owed + (now - last) * self.uart_rate, burst)
+            last = now
+
+            backlog = False
+            if int(rx_owed):
+                try:
+                    data = os.read(self.master, int(rx_owed))
+                except (BlockingIOError, OSError):
+                    data = b''
+                backlog = len(data) == int(rx_owed)
+                rx_owed -= len(data)
+                self.device.receive(data)
+            self.device.run(now)
+
+            n = min(int(tx_owed), len(self.tx))
+            if n:
+                try:
+                    n = os.write(self.master, self.tx[:n])
+                except BlockingIOError:
+                    n = 0
+                del self.tx[:n]
+                tx_owed -= n
+
+    def report(self):
+        d = self.device.stats
+        return (f"simulated device: {d['packets']} packets ({d['v2_packets']} v2), {d['nacks']} NACKs, "
+                f"{d['resync_bytes']} resync bytes, {d['broken_frames']} broken frames, "
+                f"{d['stalled_packets']} stalled, "
+                f"{d['ring_dropped']} ring drops" + fec_report(d))
+
+
+async def _smoke_test():
+    firmware = random.Random(2).randbytes(5000)
+    client = SimBleClient(baud=115200)
+    responses = asyncio.Queue()
+    await client.connect()
+    await client.start_notify(None, lambda _, data: responses.put_nowait(bytes(data)))
+
+    async def exchange(packet):
+        for i in range(0, len(packet), 20):
+            await client.write_gatt_char(None, packet[i:i + 20], response=False)
+        reply = b''
+        while len(reply) < 10:
+            reply += await asyncio.wait_for(responses.get(), 5.0)
+        return struct.unpack(RESPONSE_FORMAT, reply[:10])
+
+    chunks = (len(firmware) + OTA_CHUNK_SIZE - 1) // OTA_CHUNK_SIZE
+    print(await exchange(struct.pack(
+        START_FORMAT, OTA_MAGIC_START, OTA_PKT_START, len(firmware), 1,
+        zlib.crc32(firmware) & 0xFFFFFFFF, chunks, 0xFF)))
+    for n in range(chunks):
+        data = firmware[n * OTA_CHUNK_SIZE:(n + 1) * OTA_CHUNK_SIZE]
+        header = struct.pack(DATA_HEADER_FORMAT, OTA_MAGIC_DATA, OTA_PKT_DATA, n, len(data),
+                             zlib.crc32(data) & 0xFFFFFFFF)
+        print(await exchange(header + data.ljust(OTA_CHUNK_SIZE, b'\xFF')))
+    print(await exchange(struct.pack(END_FORMAT, OTA_MAGIC_START, OTA_PKT_END)))
+    await client.disconnect()
+
+    print(client.report())
+    print("image matches" if client.device.image == firmware else "IMAGE MISMATCH")
+    return client.device.image == firmware
+
+
+def _serve_pty(args):
+    with SimSerialPort(baud=args.baud, log=not args.quiet, wire=args.wire) as port:
+        print(f"Simulated v{args.wire} device at {args.baud} baud on {port.path} (Ctrl-C to stop)")
+        images = 0
+        try:
+            while True:
+                time.sleep(0.5)
+                if port.device.image is not None:
+                    images += 1
+                    print(f"image {images}: {len(port.device.image)} bytes, "
+                          f"CRC32 0x{zlib.crc32(port.device.image) & 0xFFFFFFFF:08X}; "
+                          f"{port.report()}")
+                    port.device.image = None
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Simulated OTA device")
+    parser.add_argument('--pty', action='store_true', help="serve on a pty until interrupted")
+    parser.add_argument('--baud', type=int, default=USART1_BAUD)
+    parser.add_argument('--quiet', action='store_true', help="no console text around responses")
+    parser.add_argument('--wire', type=int, choices=(1, 2), default=2,
+                        help="1: firmware from before the v2 layouts, which ignores them")
+    args = parser.parse_args()
+
+    if args.pty:
+        _serve_pty(args)
+    else:
+        raise SystemExit(0 if asyncio.run(_smoke_test()) else 1)
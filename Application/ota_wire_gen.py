@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Writes ota_wire_layout.py from Common/OTA/Inc/ota_wire.h and ota_protocol.h
+
+The Python tools take their packet layouts and protocol constants from
+the generated module instead of repeating them, so the table in
+ota_wire.h, which the firmware checks against its structs at compile
+time, is the only place a layout is written down.
+
+    python ota_wire_gen.py            # rewrite ota_wire_layout.py
+    python ota_wire_gen.py --check    # exit 1 if it is out of date
+
+For each packet NAME (START, DATA, SYMBOL, END, RESPONSE, START_V2,
+DATA_V2) the module has NAME_FORMAT, the struct format of the whole
+packet; NAME_PACKET_SIZE; NAME_OFFSETS, field name to offset; and, for
+the packets that carry a chunk, NAME_HEADER_FORMAT and NAME_HEADER_SIZE,
+the fields before it. The #define constants of ota_protocol.h are
+copied with their values.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+INC = os.path.join(HERE, '..', 'Common', 'OTA', 'Inc')
+OUTPUT = os.path.join(HERE, 'ota_wire_layout.py')
+
+KINDS = {'u8': ('B', 1), 'u16': ('H', 2), 'u32': ('I', 4)}
+
+
+def read(name):
+    with open(os.path.join(INC, name)) as f:
+        return f.read()
+
+
+def strip_comments(text):
+    text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+    return re.sub(r'//[^\n]*', '', text)
+
+
+def protocol_defines():
+    """ota_protocol.h's '#define NAME value' lines, evaluated, in order"""
+    defines = {}
+    for line in read('ota_protocol.h').splitlines():
+        m = re.match(r'#define\s+(OTA_\w+)\s+(.+)', strip_comments(line).strip())
+        if not m:
+            continue
+        expr = m.group(2)
+        expr = re.sub(r'\b(OTA_\w+)\b', lambda n: str(defines[n.group(1)]), expr)
+        if not re.fullmatch(r'[\s\w()|+*<>-]+', expr):
+            sys.exit(f"ota_protocol.h: can't evaluate {m.group(1)} = {m.group(2)}")
+        defines[m.group(1)] = eval(re.sub(r'\b(0x[0-9A-Fa-f]+|\d+)[uUlL]*\b', r'\1', expr))
+    return defines
+
+
+def wire_table(defines):
+    """ota_wire.h's OTA_WIRE_PACKETS and OTA_WIRE_FIELDS rows"""
+    text = strip_comments(read('ota_wire.h'))
+
+    def value(expr):
+        expr = re.sub(r'\b(OTA_\w+)\b', lambda n: str(defines[n.group(1)]), expr.strip())
+        if not re.fullmatch(r'[\s\d+]+', expr):
+            sys.exit(f"ota_wire.h: can't evaluate {expr}")
+        return eval(expr)
+
+    packets = {}
+    for name, ctype, size in re.findall(r'\bP\((\w+),\s*(\w+),\s*([^)]+)\)', text):
+        packets[name] = {'type': ctype, 'size': value(size), 'fields': []}
+    for pkt, field, offset, kind, size in re.findall(
+            r'\bF\((\w+),\s*(\w+),\s*([^,]+),\s*(\w+),\s*([^)]+)\)', text):
+        packets[pkt]['fields'].append((field, value(offset), kind, value(size)))
+    if not packets:
+        sys.exit("ota_wire.h: no packet table found")
+    return packets
+
+
+def layout(name, packet):
+    """The generated lines for one packet, after checking its table rows"""
+    at = 0
+    codes = []
+    header = None
+    for field, offset, kind, size in packet['fields']:
+        if offset != at:
+            sys.exit(f"ota_wire.h: {name}.{field} at {offset}, expected {at}")
+        if kind == 'bytes':
+            header = header or ' '.join(codes)
+            codes.append(f'{size}s')
+        elif kind in KINDS and KINDS[kind][1] == size:
+            codes.append(KINDS[kind][0])
+        else:
+            sys.exit(f"ota_wire.h: {name}.{field} has kind {kind} and size {size}")
+        at += size
+    if at != packet['size']:
+        sys.exit(f"ota_wire.h: {name} fields add up to {at}, not {packet['size']}")
+
+    fmt = '<' + ' '.join(codes)
+    assert struct.calcsize(fmt) == packet['size']
+    upper = name.upper()
+    lines = [f"# {packet['type']}",
+             f"{upper}_FORMAT = '{fmt}'",
+             f"{upper}_PACKET_SIZE = {packet['size']}"]
+    if header is not None:
+        lines += [f"{upper}_HEADER_FORMAT = '<{header}'",
+                  f"{upper}_HEADER_SIZE = {struct.calcsize('<' + header)}"]
+    lines.append(f"{upper}_OFFSETS = {{")
+    lines += [f"    '{field}': {offset}," for field, offset, _, _ in packet['fields']]
+    lines.append("}")
+    return lines
+
+
+def constant(name, value):
+    if name.startswith('OTA_MAGIC_'):
+        return f"{name} = 0x{value:08X}"
+    if name.startswith(('OTA_PKT_', 'OTA_ERR_', 'OTA_TARGET_')):
+        return f"{name} = 0x{value:02X}"
+    return f"{name} = {value}"
+
+
+def generate():
+    defines = protocol_defines()
+    lines = ['"""',
+             'Packet layouts and constants of ota_protocol.h, for the Python tools',
+             '',
+             'Generated by ota_wire_gen.py from Common/OTA/Inc/ota_wire.h and',
+             'ota_protocol.h; do not edit, run it again.',
+             '"""',
+             '']
+    lines += [constant(name, value) for name, value in defines.items()]
+    for name, packet in wire_table(defines).items():
+        lines.append('')
+        lines += layout(name, packet)
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate ota_wire_layout.py")
+    parser.add_argument('--check', action='store_true',
+                        help="only tell whether ota_wire_layout.py is current")
+    args = parser.parse_args()
+
+    text = generate()
+    try:
+        with open(OUTPUT) as f:
+            current = f.read() == text
+    except FileNotFoundError:
+        current = False
+
+    if args.check:
+        print(f"{os.path.basename(OUTPUT)} is {'current' if current else 'out of date'}")
+        return current
+    if not current:
+        with open(OUTPUT, 'w') as f:
+            f.write(text)
+    print(f"Wrote {OUTPUT}")
+    return True
+
+
+if __name__ == "__main__":
+    sys.exit(0 if main() else 1)
@@ -0,0 +1,126 @@
+"""
+Packet layouts and constants of ota_protocol.h, for the Python tools
+
+Generated by ota_wire_gen.py from Common/OTA/Inc/ota_wire.h and
+ota_protocol.h; do not edit, run it again.
+"""
+
+OTA_MAGIC_START = 0xAA55AA55
+OTA_MAGIC_DATA = 0x55AA55AA
+OTA_PKT_START = 0x01
+OTA_PKT_DATA = 0x02
+OTA_PKT_END = 0x03
+OTA_PKT_ACK = 0x04
+OTA_PKT_NACK = 0x05
+OTA_PKT_ABORT = 0x06
+OTA_PKT_PARITY = 0x07
+OTA_PKT_SYMBOL = 0x08
+OTA_PKT_V2 = 0x80
+OTA_PKT_START_V2 = 0x81
+OTA_PKT_DATA_V2 = 0x82
+OTA_PKT_PARITY_V2 = 0x87
+OTA_ERR_NONE = 0x00
+OTA_ERR_CRC = 0x01
+OTA_ERR_SIZE = 0x02
+OTA_ERR_FLASH = 0x03
+OTA_ERR_SEQUENCE = 0x04
+OTA_ERR_TIMEOUT = 0x05
+OTA_ERR_BUSY = 0x06
+OTA_CHUNK_SIZE = 1024
+OTA_MAX_RETRIES = 3
+OTA_TIMEOUT_MS = 5000
+OTA_BUSY_RETRY_MS = 100
+OTA_MAX_CREDITS = 8
+OTA_FEC_MAX_GROUP = 8
+OTA_FOUNTAIN_SEGMENT = 16
+OTA_TARGET_AUTO = 0xFF
+
+# ota_start_packet_t
+START_FORMAT = '<I B I I I I B'
+START_PACKET_SIZE = 22
+START_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+    'firmware_size': 5,
+    'firmware_version': 9,
+    'firmware_crc32': 13,
+    'total_chunks': 17,
+    'target_bank': 21,
+}
+
+# ota_data_packet_t
+DATA_FORMAT = '<I B I H I 1024s'
+DATA_PACKET_SIZE = 1039
+DATA_HEADER_FORMAT = '<I B I H I'
+DATA_HEADER_SIZE = 15
+DATA_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+    'chunk_number': 5,
+    'chunk_size': 9,
+    'chunk_crc32': 11,
+    'data': 15,
+}
+
+# ota_symbol_packet_t
+SYMBOL_FORMAT = '<I B I I I I 1024s I'
+SYMBOL_PACKET_SIZE = 1049
+SYMBOL_HEADER_FORMAT = '<I B I I I I'
+SYMBOL_HEADER_SIZE = 21
+SYMBOL_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+    'firmware_size': 5,
+    'firmware_version': 9,
+    'firmware_crc32': 13,
+    'symbol_id': 17,
+    'data': 21,
+    'packet_crc32': 1045,
+}
+
+# ota_end_packet_t
+END_FORMAT = '<I B'
+END_PACKET_SIZE = 5
+END_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+}
+
+# ota_response_packet_t
+RESPONSE_FORMAT = '<I B B I'
+RESPONSE_PACKET_SIZE = 10
+RESPONSE_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+    'error_code': 5,
+    'last_chunk_received': 6,
+}
+
+# ota_start_packet_v2_t
+START_V2_FORMAT = '<I B B H I I I I'
+START_V2_PACKET_SIZE = 24
+START_V2_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+    'target_bank': 5,
+    'reserved': 6,
+    'firmware_size': 8,
+    'firmware_version': 12,
+    'firmware_crc32': 16,
+    'total_chunks': 20,
+}
+
+# ota_data_packet_v2_t
+DATA_V2_FORMAT = '<I B B H I I 1024s'
+DATA_V2_PACKET_SIZE = 1040
+DATA_V2_HEADER_FORMAT = '<I B B H I I'
+DATA_V2_HEADER_SIZE = 16
+DATA_V2_OFFSETS = {
+    'magic': 0,
+    'packet_type': 4,
+    'reserved': 5,
+    'chunk_size': 6,
+    'chunk_number': 8,
+    'chunk_crc32': 12,
+    'data': 16,
+}
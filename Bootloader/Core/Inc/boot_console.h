@@ -0,0 +1,59 @@
+/*
+ * boot_console.h
+ *
+ * The bootloader's console: USART1 (ST-LINK VCP, PA9/PA10) driven
+ * through its registers, and a printf that knows the conversions the
+ * boot path uses. newlib's printf brings its formatter, stdio buffers and
+ * the heap, which on their own outweigh the rest of the boot path.
+ *
+ * boot_printf() takes %d %i %u %x %X %c %s and %%, with an optional '0'
+ * flag, a field width and 'l' (int and long are both 32 bits here).
+ * Output is polled: a call returns once its last character is in the
+ * transmit register, about 87 us a character at 115200 baud.
+ *
+ * The USART is left as MX_USART1_UART_Init() leaves it (8N1, TX/RX,
+ * oversampling by 16), so the application adopts it from the handoff
+ * block (boot_handoff.h) just the same.
+ */
+
+#ifndef INC_BOOT_CONSOLE_H_
+#define INC_BOOT_CONSOLE_H_
+
+#include <stdint.h>
+
+#define BOOT_CONSOLE_BAUD   115200
+
+/**
+ * @brief Clock and configure PA9/PA10 and USART1 at BOOT_CONSOLE_BAUD
+ *
+ * The baud rate divider comes from the APB2 clock running now, so call
+ * it after the clock tree is up.
+ */
+void boot_console_init(void);
+
+/**
+ * @brief Send bytes, polled
+ */
+void boot_console_write(const char *data, int len);
+
+/**
+ * @brief Wait until the last byte has left the shift register
+ */
+void boot_console_flush(void);
+
+/**
+ * @brief Have a function run before every write
+ * @param guard Function, or NULL for none
+ *
+ * Recovery OTA points this at the link, so console text waits for a
+ * response already queued on USART1 instead of cutting into it.
+ */
+void boot_console_set_guard(void (*guard)(void));
+
+/**
+ * @brief printf() onto the console, for the conversions above
+ * @return Characters written
+ */
+int boot_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif /* INC_BOOT_CONSOLE_H_ */
@@ -0,0 +1,49 @@
+/*
+ * boot_verify.h
+ *
+ * Image integrity check at boot, with the verdict cached in flash.
+ *
+ * The first boot after an update runs a full CRC32 of the slot against
+ * the size/CRC in the image header (image_header.h), or the boot state
+ * record for headerless images, then programs the slot's verdict word
+ * (see BOOT_VERDICT_ADDRESS) with a fingerprint of the image: the
+ * CRC of its first and last BOOT_FINGERPRINT_BYTES. Later boots only
+ * recompute the fingerprint and check the vector table, so the
+ * steady-state cost is a 2KB CRC instead of the whole image. Rewriting
+ * the record erases the verdicts, and reflashing a slot behind the
+ * bootloader's back changes the fingerprint, so both force a full check.
+ */
+
+#ifndef INC_BOOT_VERIFY_H_
+#define INC_BOOT_VERIFY_H_
+
+#include <stdint.h>
+#include "boot_state.h"
+
+#define BOOT_FINGERPRINT_BYTES  1024  // Covers the vector table and header
+
+// Initial stack pointer must land in SRAM1-3
+#define BOOT_SRAM_START         0x20000000
+#define BOOT_SRAM_END           0x20030000
+
+/**
+ * @brief Cheap structural check of a slot's vector table
+ * @param address Slot base address
+ * @param size    Image size in bytes
+ * @return 1 if SP points into SRAM and the reset vector is a Thumb
+ *         address inside the image, 0 otherwise
+ */
+int boot_vector_table_valid(uint32_t address, uint32_t size);
+
+/**
+ * @brief Decide whether a slot may be booted
+ * @param state Boot state record (already CRC-checked, or empty if none)
+ * @param slot  Slot index (0 = bank A, 1 = bank B, ...)
+ * @return 0 if the image is trusted, -1 otherwise
+ *
+ * Uses the cached verdict when the fingerprint still matches, otherwise
+ * runs the full CRC and caches the outcome (pass or fail).
+ */
+int boot_verify_slot(const boot_state_t *state, uint32_t slot);
+
+#endif /* INC_BOOT_VERIFY_H_ */
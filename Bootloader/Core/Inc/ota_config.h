@@ -0,0 +1,43 @@
+/*
+ * ota_config.h
+ *
+ * What the bootloader builds into the shared OTA modules. Those live
+ * once, in Common/OTA, and both projects compile them: Common/OTA/Src is
+ * a source folder and Common/OTA/Inc an include path after Core/Inc.
+ * This header (and main.c) is what differs between the two, and
+ * everything in it is decided at compile time, so code an image has no
+ * use for is not in it.
+ */
+
+#ifndef INC_OTA_CONFIG_H_
+#define INC_OTA_CONFIG_H_
+
+// 1: the image runs from the bootloader sector, never from a slot, so
+// every slot is a valid target. 0: it runs from the slot SCB->VTOR names,
+// which a transfer must not overwrite.
+#define OTA_ROLE_BOOTLOADER     1
+
+// 1: erase and program through flash_task.h, from the scheduler, with
+// the link still served; START is answered once the slot is blank.
+// 0: erase inline in START, blocking.
+#define OTA_BACKGROUND_FLASH    0
+
+// 1: stage chunks in SDRAM and program flash at END (ota_staging.h,
+// needs OTA_BACKGROUND_FLASH). 0: write chunks straight to flash.
+#define OTA_STAGING_ENABLED     0
+
+// 1: program flash and feed the CRC unit through the HAL, whose lock and
+// interrupt handling flash_task.h and the CRC DMA share. 0: through the
+// registers, blocking (flash_layout.c, ota_crc.c), so an image that never
+// starts the HAL links none of its flash, CRC or DMA code.
+#define OTA_HAL_DRIVERS         0
+
+// OTA_LOG_ERRORS, OTA_LOG_PROGRESS or OTA_LOG_PACKETS (ota_log.h)
+#define OTA_LOG_LEVEL           2
+
+// Log through the register console rather than printf(), which would
+// bring newlib's formatter and heap into the boot path
+#include "boot_console.h"
+#define OTA_LOG_PRINTF          boot_printf
+
+#endif /* INC_OTA_CONFIG_H_ */
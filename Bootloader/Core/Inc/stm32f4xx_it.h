@@ -60,6 +60,8 @@ void OTG_HS_IRQHandler(void);
 void LTDC_IRQHandler(void);
 void DMA2D_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void DMA2_Stream0_IRQHandler(void);
+void USART1_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -0,0 +1,175 @@
+/*
+ * boot_console.c
+ * Register-level USART1 console and the small printf of the boot path
+ */
+
+#include "boot_console.h"
+#include "main.h"
+#include <stdarg.h>
+#include <stddef.h>
+
+#define CONSOLE_CHUNK   32      // Bytes formatted per boot_console_write()
+
+typedef struct {
+    char buf[CONSOLE_CHUNK];
+    int len;
+    int total;
+} console_out_t;
+
+static void (*console_guard)(void);
+
+void boot_console_init(void) {
+    uint32_t pclk2 = SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos];
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+    (void)RCC->APB2ENR;             // Clocks running before the first access
+
+    // PA9 (TX) and PA10 (RX) as HAL_UART_MspInit() sets them: AF7,
+    // push-pull, no pull, very high speed
+    GPIOA->OSPEEDR |= 0xFU << 18;
+    GPIOA->AFR[1] = (GPIOA->AFR[1] & ~(0xFFU << 4)) | (0x77U << 4);
+    GPIOA->MODER = (GPIOA->MODER & ~(0xFU << 18)) | (0xAU << 18);
+
+    USART1->CR1 = 0;
+    USART1->CR2 = 0;                // 1 stop bit
+    USART1->CR3 = 0;                // No flow control
+    USART1->BRR = (pclk2 + BOOT_CONSOLE_BAUD / 2) / BOOT_CONSOLE_BAUD;  // Oversampling by 16
+    USART1->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+}
+
+void boot_console_write(const char *data, int len) {
+    if (console_guard != NULL) {
+        console_guard();
+    }
+    for (int i = 0; i < len; i++) {
+        while ((USART1->SR & USART_SR_TXE) == 0) {
+        }
+        USART1->DR = (uint8_t)data[i];
+    }
+}
+
+void boot_console_flush(void) {
+    while ((USART1->SR & USART_SR_TC) == 0) {
+    }
+}
+
+void boot_console_set_guard(void (*guard)(void)) {
+    console_guard = guard;
+}
+
+/* ---- boot_printf() ---- */
+
+static void out_char(console_out_t *out, char c) {
+    if (out->len == CONSOLE_CHUNK) {
+        boot_console_write(out->buf, out->len);
+        out->len = 0;
+    }
+    out->buf[out->len++] = c;
+    out->total++;
+}
+
+static void out_field(console_out_t *out, const char *s, int len, int width, char pad) {
+    while (width-- > len) {
+        out_char(out, pad);
+    }
+    while (len-- > 0) {
+        out_char(out, *s++);
+    }
+}
+
+int boot_printf(const char *format, ...) {
+    console_out_t out;
+    va_list args;
+
+    out.len = 0;
+    out.total = 0;
+    va_start(args, format);
+
+    for (const char *p = format; *p != '\0'; p++) {
+        if (*p != '%') {
+            out_char(&out, *p);
+            continue;
+        }
+
+        char pad = ' ';
+        int width = 0;
+        if (*++p == '0') {
+            pad = '0';
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            width = width * 10 + (*p++ - '0');
+        }
+        while (*p == 'l') {
+            p++;
+        }
+
+        char digits[11];
+        uint32_t value;
+        uint32_t base = 10;
+        int negative = 0;
+
+        switch (*p) {
+        case 's': {
+            const char *s = va_arg(args, const char*);
+            int len = 0;
+            if (s == NULL) {
+                s = "(null)";
+            }
+            while (s[len] != '\0') {
+                len++;
+            }
+            out_field(&out, s, len, width, ' ');
+            continue;
+        }
+        case 'c':
+            digits[0] = (char)va_arg(args, int);
+            out_field(&out, digits, 1, width, ' ');
+            continue;
+        case 'd':
+        case 'i': {
+            int v = va_arg(args, int);
+            negative = (v < 0);
+            value = negative ? 0U - (uint32_t)v : (uint32_t)v;
+            break;
+        }
+        case 'u':
+            value = va_arg(args, unsigned int);
+            break;
+        case 'x':
+        case 'X':
+            value = va_arg(args, unsigned int);
+            base = 16;
+            break;
+        case '\0':
+            p--;                    // A '%' ending the format: stop there
+            continue;
+        default:                    // "%%", and anything unknown as it is
+            out_char(&out, *p);
+            continue;
+        }
+
+        const char *digit_chars = (*p == 'X') ? "0123456789ABCDEF" : "0123456789abcdef";
+        char *s = digits + sizeof(digits);
+        do {
+            *--s = digit_chars[value % base];
+            value /= base;
+        } while (value != 0);
+
+        // The sign goes before zero padding, after space padding
+        if (negative && pad == '0') {
+            out_char(&out, '-');
+            width--;
+        } else if (negative) {
+            *--s = '-';
+        }
+        out_field(&out, s, (int)(digits + sizeof(digits) - s), width, pad);
+    }
+
+    va_end(args);
+    if (out.len > 0) {
+        boot_console_write(out.buf, out.len);
+    }
+    return out.total;
+}
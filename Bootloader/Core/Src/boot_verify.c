@@ -0,0 +1,119 @@
+/*
+ * boot_verify.c
+ * Full CRC once per update, fingerprint + vector table check afterwards
+ */
+
+#include "boot_verify.h"
+#include "ota_crc.h"
+#include "image_header.h"
+#include "ota_log.h"
+#include "main.h"
+
+static uint32_t image_fingerprint(uint32_t address, uint32_t size) {
+    uint32_t words = size / 4;
+    uint32_t span = BOOT_FINGERPRINT_BYTES / 4;
+
+    if (words <= 2 * span) {
+        ota_crc_words((const uint32_t*)address, words, 1);
+    } else {
+        ota_crc_words((const uint32_t*)address, span, 1);
+        ota_crc_words((const uint32_t*)(address + (words - span) * 4), span, 0);
+    }
+
+    // Mix in the size so a truncated/extended image can't alias
+    uint32_t fp = ota_crc_words(&size, 1, 0);
+
+    // Keep clear of the two reserved verdict values
+    if (fp == BOOT_VERDICT_NONE || fp == BOOT_VERDICT_FAILED) {
+        fp = 0x5A5A5A5A;
+    }
+    return fp;
+}
+
+int boot_vector_table_valid(uint32_t address, uint32_t size) {
+    uint32_t sp = *(volatile uint32_t*)address;
+    uint32_t reset = *(volatile uint32_t*)(address + 4);
+
+    if (sp < BOOT_SRAM_START || sp > BOOT_SRAM_END) {
+        return 0;
+    }
+    if ((reset & 1) == 0 || (reset & ~1U) < address || (reset & ~1U) >= address + size) {
+        return 0;
+    }
+    return 1;
+}
+
+int boot_verify_slot(const boot_state_t *state, uint32_t slot) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return -1;
+    }
+
+    uint32_t address = flash_slot_address(slot);
+    const flash_partition_t *part = flash_partition_at(address);
+    const char *name = part->name;
+    uint32_t size;
+    uint32_t expected_crc;
+
+    // Prefer the image's own header; fall back to the boot state record
+    // for headerless images
+    const image_header_t *hdr = (address != 0) ? image_header_get(address) : NULL;
+    if (hdr != NULL) {
+        size = hdr->image_size;
+        if (image_header_is_installed(hdr, address)) {
+            expected_crc = hdr->install_crc32;
+        } else if (hdr->load_address == address) {
+            expected_crc = hdr->image_crc32;  // Flashed as built
+        } else {
+            OTA_LOG_ERROR("%s: image linked for 0x%08lX, not installed here\r\n", name, hdr->load_address);
+            return -1;
+        }
+        OTA_LOG_INFO("%s: image v%lu.%lu.%lu, %lu bytes\r\n", name,
+                     (hdr->fw_version >> 24) & 0xFF, (hdr->fw_version >> 16) & 0xFF,
+                     hdr->fw_version & 0xFFFF, size);
+    } else {
+        size = state->slots[slot].image_size;
+        expected_crc = state->slots[slot].image_crc32;
+    }
+
+    if (address == 0 || size < 8 || size > flash_slot_size(address)) {
+        OTA_LOG_ERROR("%s: no image recorded\r\n", name);
+        return -1;
+    }
+
+    if (!boot_vector_table_valid(address, size)) {
+        OTA_LOG_ERROR("%s: vector table invalid\r\n", name);
+        return -1;
+    }
+
+    uint32_t verdict = boot_state_get_verdict(slot);
+    if (verdict == BOOT_VERDICT_FAILED) {
+        OTA_LOG_ERROR("%s: failed verification earlier, skipping\r\n", name);
+        return -1;
+    }
+
+    uint32_t fingerprint = image_fingerprint(address, size);
+    if (verdict == fingerprint) {
+        OTA_LOG_INFO("%s: verified (cached)\r\n", name);
+        return 0;
+    }
+
+    // First boot after an update, or the slot changed under us
+    OTA_LOG_INFO("%s: verifying %lu bytes...\r\n", name, size);
+    uint32_t start = DWT->CYCCNT;  // Running since boot_handoff_begin()
+    uint32_t crc = hdr ? image_crc32(address, size) : ota_crc_calculate(address, size);
+    uint32_t elapsed = (DWT->CYCCNT - start) / (SystemCoreClock / 1000);
+
+    if (crc != expected_crc) {
+        OTA_LOG_ERROR("%s: CRC32 mismatch (0x%08lX, expected 0x%08lX)\r\n", name, crc, expected_crc);
+        boot_state_set_verdict(slot, BOOT_VERDICT_FAILED);
+        return -1;
+    }
+
+    OTA_LOG_INFO("%s: CRC32 OK in %lu ms\r\n", name, elapsed);
+
+    // A stale fingerprint can't be overwritten; we just re-verify next time
+    if (verdict == BOOT_VERDICT_NONE && boot_state_set_verdict(slot, fingerprint) != 0) {
+        OTA_LOG_ERROR("WARNING: could not cache verdict for %s\r\n", name);
+    }
+    return 0;
+}
@@ -18,12 +18,17 @@
 /* USER CODE END Header */
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "boot_console.h"
 #include "boot_state.h"
+#include "boot_verify.h"
+#include "image_header.h"
+#include "slot_select.h"
+#include "boot_trial.h"
+#include "boot_handoff.h"
+#include "sched.h"
 #include "ota_manager.h"
-#include "ota_uart.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+#include "ota_link.h"
+#include "ota_transport_uart.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
@@ -51,7 +56,10 @@ UART_HandleTypeDef huart1;
 TIM_HandleTypeDef htim1;
 
 /* USER CODE BEGIN PV */
-
+#if BOOT_RECOVERY_OTA
+// Recovery OTA link, sharing USART1 with the console
+OTA_TRANSPORT_UART(ota_usart1, "USART1", &huart1, USART1_IRQn);
+#endif
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -67,12 +75,100 @@ static void MX_TIM1_Init(void);
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/**
+ * @brief SystemClock_Config() in registers: HSI / 8 * 72 / 2 = 72 MHz
+ *        SYSCLK and HCLK, 36 MHz APB1, 72 MHz APB2, 2 wait states
+ *
+ * Plus the flash prefetch and caches HAL_Init() turns on, and the CRC
+ * clock MX_CRC_Init() would. The application adopts this clock tree only
+ * if it is what it was generated for (boot_handoff.h), so keep it in step
+ * with the .ioc.
+ */
+static void boot_clock_init(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    (void)RCC->APB1ENR;
+    PWR->CR = (PWR->CR & ~PWR_CR_VOS) | PWR_CR_VOS_0;   // Scale 3, before the PLL starts
+
+    // HSI is running from reset; PLLQ /3 gives 48 MHz for USB
+    RCC->PLLCFGR = RCC_PLLCFGR_PLLSRC_HSI | (8U << RCC_PLLCFGR_PLLM_Pos) |
+                   (72U << RCC_PLLCFGR_PLLN_Pos) | (0U << RCC_PLLCFGR_PLLP_Pos) |
+                   (3U << RCC_PLLCFGR_PLLQ_Pos);
+    RCC->CR |= RCC_CR_PLLON;
+    while ((RCC->CR & RCC_CR_PLLRDY) == 0)
+    {
+    }
+
+    FLASH->ACR = FLASH_ACR_LATENCY_2WS | FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+    RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | RCC_CFGR_PPRE1_DIV2;
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+    while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL)
+    {
+    }
+    SystemCoreClockUpdate();
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+}
+
+/**
+ * @brief Bytes of flash this image takes: code and constants, then the
+ *        initial values of .data (symbols of the linker script)
+ */
+static uint32_t boot_image_size(void)
+{
+    extern uint32_t _sidata, _sdata, _edata;
+
+    return (uint32_t)&_sidata + ((uint32_t)&_edata - (uint32_t)&_sdata) - BOOTLOADER_ADDRESS;
+}
+
+#if BOOT_RECOVERY_OTA
+// printf() of the OTA modules goes to the console as well
 int _write(int file, char *ptr, int len)
 {
-    HAL_UART_Transmit(&huart1, (uint8_t*)ptr, len, 1000);
+    boot_console_write(ptr, len);
     return len;
 }
 
+// boot_console_set_guard(): let a queued OTA response finish before
+// console text follows it
+static void ota_link_guard(void)
+{
+    ota_transport_uart_flush(&ota_usart1, 100);
+}
+
+static void led_toggle(void *arg) {
+    HAL_GPIO_TogglePin(GPIOG, GPIO_PIN_13);
+}
+
+// ota_link.h: the recovery image is installed
+static void ota_recovery_done(void) {
+    static sched_timer_t led_timer;
+
+    boot_printf("\r\nOTA complete. Blinking LED...\r\n");
+    sched_timer_init(&led_timer, led_toggle, NULL);
+    sched_timer_start(&led_timer, 0, 1000);
+}
+
+// No slot booted: carry on into main()'s HAL init and recovery OTA
+static void boot_no_image(void)
+{
+    boot_printf("No bootable image. Entering OTA recovery.\r\n");
+}
+#else
+// No slot booted and nothing to receive one with: wait, asleep, for a
+// reset or a debugger. Not returning is what leaves main()'s HAL init,
+// and the drivers behind it, out of the image.
+static void __attribute__((noreturn)) boot_no_image(void)
+{
+    boot_printf("No bootable image\r\n");
+    boot_console_flush();
+    while (1)
+    {
+        __WFI();
+    }
+}
+#endif
+
 /**
  * @brief  Jump to application at specified address
  * @param  app_address: Start address of application (e.g., 0x08010000)
@@ -80,7 +176,7 @@ int _write(int file, char *ptr, int len)
  */
 void jump_to_application(uint32_t app_address)
 {
-    printf("Preparing to jump to application at 0x%08lX...\r\n", app_address);
+    boot_printf("Preparing to jump to application at 0x%08lX...\r\n", app_address);
 
     // 1. Read the application's vector table
     //    First entry: Initial Stack Pointer
@@ -88,25 +184,27 @@ void jump_to_application(uint32_t app_address)
     uint32_t app_stack_pointer = *((__IO uint32_t*)app_address);
     uint32_t app_entry_point = *((__IO uint32_t*)(app_address + 4));
 
-    printf("  App Stack Pointer: 0x%08lX\r\n", app_stack_pointer);
-    printf("  App Entry Point:   0x%08lX\r\n", app_entry_point);
+    boot_printf("  App Stack Pointer: 0x%08lX\r\n", app_stack_pointer);
+    boot_printf("  App Entry Point:   0x%08lX\r\n", app_entry_point);
 
     // 2. Sanity check: Is the stack pointer valid?
     //    It should point to RAM (0x20000000 - 0x20030000 for STM32F429)
     if ((app_stack_pointer < 0x20000000) || (app_stack_pointer > 0x20030000))
     {
-        printf("ERROR: Invalid stack pointer! Application may not be valid.\r\n");
+        boot_printf("ERROR: Invalid stack pointer! Application may not be valid.\r\n");
         return;  // Don't jump to invalid application
     }
 
-    printf("Jumping to application NOW!\r\n\r\n");
-    HAL_Delay(100);  // Give UART time to send the message
+    boot_printf("Jumping to application NOW!\r\n\r\n");
+
+    // USART1 stays up for the application, so just let the last byte go
+    boot_console_flush();
 
     // 3. Disable interrupts
     __disable_irq();
 
-    // 4. Disable all peripheral clocks (important!)
-	__HAL_RCC_GPIOA_CLK_DISABLE();
+    // 4. Disable the peripheral clocks we don't hand over. GPIOA (USART1
+    //    pins), USART1 and CRC keep running; see boot_handoff.h
 	__HAL_RCC_GPIOB_CLK_DISABLE();
 	__HAL_RCC_GPIOC_CLK_DISABLE();
 	__HAL_RCC_GPIOD_CLK_DISABLE();
@@ -114,29 +212,39 @@ void jump_to_application(uint32_t app_address)
 	__HAL_RCC_GPIOF_CLK_DISABLE();
     __HAL_RCC_GPIOG_CLK_DISABLE();
 	__HAL_RCC_GPIOH_CLK_DISABLE();
-	__HAL_RCC_USART1_CLK_DISABLE();
 	__HAL_RCC_USB_OTG_FS_CLK_DISABLE();
 	__HAL_RCC_USB_OTG_HS_CLK_DISABLE();  // Add this!
 
 
 	__HAL_RCC_DMA2D_CLK_DISABLE();
+	__HAL_RCC_DMA2_CLK_DISABLE();   // CRC feed (ota_crc.c)
 	__HAL_RCC_LTDC_CLK_DISABLE();
 	__HAL_RCC_FMC_CLK_DISABLE();
 
-	// 5. Deinitialize HAL
-	HAL_DeInit();
+	// 5. Reset what we used and don't hand over. HAL_DeInit() would also
+	//    reset USART1 and CRC, which the application now adopts.
+	__HAL_RCC_TIM1_FORCE_RESET();
+	__HAL_RCC_TIM1_RELEASE_RESET();
+	__HAL_RCC_TIM1_CLK_DISABLE();
+	__HAL_RCC_DMA2_FORCE_RESET();
+	__HAL_RCC_DMA2_RELEASE_RESET();
 
     // 6. Disable SysTick
     SysTick->CTRL = 0;
     SysTick->LOAD = 0;
     SysTick->VAL = 0;
 
-    // 7. Clear all interrupt pending flags
+    // 7. Disable and clear all interrupts we may have enabled
 	for (int i = 0; i < 8; i++)
 	{
+		NVIC->ICER[i] = 0xFFFFFFFF;
 		NVIC->ICPR[i] = 0xFFFFFFFF;
 	}
 
+	// Describe the clock tree and what is still running (last, so the
+	// cycle stamp is as close to the jump as possible)
+	boot_handoff_commit(BOOT_HANDOFF_PERIPH_CRC | BOOT_HANDOFF_PERIPH_USART1, BOOT_CONSOLE_BAUD);
+
 	// 8. Set the vector table address to the application's vector table
 	SCB->VTOR = app_address;
 
@@ -155,155 +263,99 @@ void jump_to_application(uint32_t app_address)
 }
 
 /**
- * @brief Simulate OTA update with fake firmware
- */
-void test_ota_simulation(void) {
-    printf("\r\n");
-    printf("========================================\r\n");
-    printf("    OTA SIMULATION TEST\r\n");
-    printf("========================================\r\n");
-
-    // Step 1: Create fake firmware data
-    printf("\n--- Step 1: Creating fake firmware ---\r\n");
-
-    #define TEST_FIRMWARE_SIZE  (5 * 1024)  // 5KB test firmware
-    uint8_t *test_firmware = malloc(TEST_FIRMWARE_SIZE);
-
-    if (test_firmware == NULL) {
-        printf("ERROR: Failed to allocate memory for test firmware\r\n");
-        return;
-    }
-
-    // Fill with recognizable pattern
-    for (int i = 0; i < TEST_FIRMWARE_SIZE; i++) {
-        test_firmware[i] = (uint8_t)(i & 0xFF);  // 0x00, 0x01, 0x02... 0xFF, 0x00...
-    }
-
-    printf("Test firmware created: %d bytes\r\n", TEST_FIRMWARE_SIZE);
-
-    // Calculate CRC32 of test firmware
-    uint32_t firmware_crc = calculate_crc32(test_firmware, TEST_FIRMWARE_SIZE);
-    printf("Test firmware CRC32: 0x%08lX\r\n", firmware_crc);
-
-    // Step 2: Initialize OTA context
-    printf("\n--- Step 2: Initializing OTA ---\r\n");
-    ota_context_t ota_ctx;
-    ota_init(&ota_ctx);
-    printf("OTA context initialized\r\n");
-
-    // Step 3: Send START packet
-    printf("\n--- Step 3: Sending START packet ---\r\n");
-
-    uint32_t total_chunks = (TEST_FIRMWARE_SIZE + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
-
-    ota_start_packet_t start_pkt = {
-        .magic = OTA_MAGIC_START,
-        .packet_type = OTA_PKT_START,
-        .firmware_size = TEST_FIRMWARE_SIZE,
-        .firmware_version = 0x02000100,  // Version 2.0.1 (Major.Minor.Patch)
-        .firmware_crc32 = firmware_crc,
-        .total_chunks = total_chunks,
-        .target_bank = BANK_B  // We're running from Bank A, update Bank B
-    };
-
-    ota_process_start_packet(&ota_ctx, &start_pkt);
-
-    if (ota_ctx.state != OTA_STATE_RECEIVING_DATA) {
-        printf("ERROR: START packet failed! State: %d\r\n", ota_ctx.state);
-        free(test_firmware);
-        return;
-    }
-
-    printf("START packet accepted. Ready to receive %lu chunks\r\n", total_chunks);
-
-    // Step 4: Send DATA packets
-    printf("\n--- Step 4: Sending DATA packets ---\r\n");
-
-    for (uint32_t chunk_num = 0; chunk_num < total_chunks; chunk_num++) {
-        ota_data_packet_t data_pkt;
-
-        data_pkt.magic = OTA_MAGIC_DATA;
-        data_pkt.packet_type = OTA_PKT_DATA;
-        data_pkt.chunk_number = chunk_num;
-
-        // Calculate chunk size (last chunk might be smaller)
-        uint32_t offset = chunk_num * OTA_CHUNK_SIZE;
-        uint32_t remaining = TEST_FIRMWARE_SIZE - offset;
-        data_pkt.chunk_size = (remaining > OTA_CHUNK_SIZE) ? OTA_CHUNK_SIZE : remaining;
-
-        // Copy chunk data
-        memcpy(data_pkt.data, test_firmware + offset, data_pkt.chunk_size);
-
-        // Calculate chunk CRC
-        data_pkt.chunk_crc32 = calculate_crc32(data_pkt.data, data_pkt.chunk_size);
-
-        // Process the packet
-        ota_process_data_packet(&ota_ctx, &data_pkt);
+  * @brief Boot the highest-versioned slot whose image header verifies
+  * @param state Empty boot state record (no record could be read)
+  * @note  Returns only if no headered image passes boot_verify_slot()
+  */
+static void boot_select_by_header(const boot_state_t *state)
+{
+    uint32_t rejected = 0;
 
-        if (ota_ctx.state == OTA_STATE_ERROR) {
-            printf("ERROR: DATA packet %lu failed!\r\n", chunk_num);
-            free(test_firmware);
+    for (;;)
+    {
+        int best = -1;
+        uint32_t best_version = 0;
+
+        for (uint32_t slot = 0; slot < BOOT_MAX_SLOTS; slot++)
+        {
+            uint32_t address = flash_slot_address(slot);
+            const image_header_t *hdr = image_header_get(address);
+
+            if ((rejected & (1UL << slot)) || hdr == NULL)
+            {
+                continue;
+            }
+            if (best < 0 || hdr->fw_version > best_version)
+            {
+                best = (int)slot;
+                best_version = hdr->fw_version;
+            }
+        }
+        if (best < 0)
+        {
             return;
         }
 
-        // Print progress every 10 chunks
-        if ((chunk_num + 1) % 10 == 0 || chunk_num == total_chunks - 1) {
-            printf("Progress: %lu/%lu chunks (%lu%%)\r\n",
-                   chunk_num + 1,
-                   total_chunks,
-                   ((chunk_num + 1) * 100) / total_chunks);
+        boot_printf("Trying slot %d by header\r\n", best);
+        if (boot_verify_slot(state, best) == 0)
+        {
+            boot_handoff_set_slot(best, BANK_STATUS_INVALID, 0);  // Not in any record
+            jump_to_application(flash_slot_address(best));
         }
+        rejected |= 1UL << best;
     }
+}
 
-    if (ota_ctx.state != OTA_STATE_VERIFYING) {
-        printf("ERROR: Not in VERIFYING state after all chunks! State: %d\r\n", ota_ctx.state);
-        free(test_firmware);
-        return;
-    }
-
-    printf("All DATA packets sent successfully!\r\n");
-
-    // Step 5: Send END packet
-    printf("\n--- Step 5: Sending END packet ---\r\n");
-
-    ota_end_packet_t end_pkt = {
-        .magic = OTA_MAGIC_START,
-        .packet_type = OTA_PKT_END
-    };
-
-    ota_process_end_packet(&ota_ctx, &end_pkt);
+/**
+ * @brief Pick a slot from boot state, verify it and jump to it
+ * @retval None (returns only if no slot could be booted)
+ *
+ * Slots are tried newest install first. Each pass is one scan of the
+ * slot table; a slot that fails boot_verify_slot() or has used up its
+ * trial boots (boot_trial.h) is excluded and the next newest is tried,
+ * so every bootable slot is a fallback.
+ */
+void boot_select_and_jump(void)
+{
+    boot_state_t state;
 
-    if (ota_ctx.state != OTA_STATE_COMPLETE) {
-        printf("ERROR: END packet failed! State: %d\r\n", ota_ctx.state);
-        free(test_firmware);
+    if (boot_state_read(&state) != 0)
+    {
+        // Factory image loaded with a debugger, or power lost between
+        // erasing and rewriting the record: any slot whose header and
+        // CRC check out will do, newest firmware first. A headerless
+        // bank A only gets the vector table check.
+        boot_printf("No valid boot state, scanning slots\r\n");
+        boot_state_init(&state);
+        boot_select_by_header(&state);
+
+        if (image_header_get(BANK_A_ADDRESS) == NULL &&
+            boot_vector_table_valid(BANK_A_ADDRESS, BANK_A_SIZE))
+        {
+            boot_printf("Bank A has no image header, booting unverified\r\n");
+            boot_handoff_set_slot(BANK_A, BANK_STATUS_INVALID, 0);  // Not in any record
+            jump_to_application(BANK_A_ADDRESS);
+        }
         return;
     }
 
-    printf("END packet processed successfully!\r\n");
+    uint32_t rejected = 0;
+    int slot;
 
-    // Step 6: Verify boot state was updated
-    printf("\n--- Step 6: Verifying boot state ---\r\n");
-
-    boot_state_t state;
-    if (boot_state_read(&state) == 0) {
-        printf("Boot state updated:\r\n");
-        printf("  Active bank: %s\r\n", state.active_bank == BANK_A ? "Bank A" : "Bank B");
-        printf("  Bank A status: %s\r\n", state.bank_a_status == BANK_STATUS_VALID ? "VALID" : "INVALID");
-        printf("  Bank B status: %s\r\n", state.bank_b_status == BANK_STATUS_VALID ? "VALID" : "INVALID");
-    } else {
-        printf("ERROR: Failed to read boot state\r\n");
-    }
+    while ((slot = slot_select_newest(state.slots, BOOT_MAX_SLOTS, rejected)) >= 0)
+    {
+        boot_printf("Trying slot %d (seq %lu)\r\n", slot, state.slots[slot].sequence);
 
-    // Cleanup
-    free(test_firmware);
+        if (boot_verify_slot(&state, slot) == 0 && boot_trial_begin(&state, slot) == 0)
+        {
+            uint32_t status = state.slots[slot].status;
+            int on_trial = (status == BANK_STATUS_TESTING && !boot_state_is_confirmed(slot));
 
-    printf("\r\n========================================\r\n");
-    printf("✓ OTA SIMULATION TEST COMPLETE!\r\n");
-    printf("========================================\r\n");
-    printf("\nNext steps:\r\n");
-    printf("1. Reset the device\r\n");
-    printf("2. Bootloader should boot from Bank B\r\n");
-    printf("3. Verify new firmware is running\r\n");
+            boot_handoff_set_slot(slot, status, on_trial ? boot_state_get_attempts(slot) : 0);
+            jump_to_application(flash_slot_address(slot));
+        }
+        rejected |= 1UL << slot;
+    }
 }
 /* USER CODE END 0 */
 
@@ -315,7 +367,25 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
+  // Before anything else: latch the reset reason and start the cycle counter
+  uint32_t boot_reason = boot_handoff_begin();
+
+  // The boot path runs on registers and jumps without the HAL; only
+  // recovery OTA (BOOT_RECOVERY_OTA) goes on to the init below
+  boot_clock_init();
+  boot_console_init();
+
+  uint32_t image_size = boot_image_size();
+  boot_printf("\r\nBootloader: %lu of %lu bytes, %s reset\r\n", image_size,
+              (uint32_t)BOOTLOADER_SIZE, boot_handoff_reason_name(boot_reason));
+  if (image_size > BOOTLOADER_SIZE)
+  {
+    boot_printf("WARNING: bootloader runs past its partition\r\n");
+  }
 
+  // Normal boot: only returns if no slot passed verification
+  boot_select_and_jump();
+  boot_no_image();
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -331,7 +401,8 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  // Timers and idle sleep; HAL_Delay() now sleeps too (sched_port.c)
+  sched_init();
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -341,47 +412,19 @@ int main(void)
   MX_USART1_UART_Init();
 
   /* USER CODE BEGIN 2 */
-  printf("========================================\r\n");
-  printf("    BOOTLOADER v1.0                    \r\n");
-  printf("========================================\r\n");
-  printf("Running at address: 0x%08lX\r\n", (uint32_t)&main);
-  printf("\r\n");
-
-  // Blink LED a few times to show bootloader is running
-  printf("Bootloader running... (LED blinks 3 times)\r\n");
-  for (int i = 0; i < 3; i++)
-  {
-	HAL_GPIO_WritePin(GPIOG, GPIO_PIN_13, GPIO_PIN_SET);
-	HAL_Delay(200);
-	HAL_GPIO_WritePin(GPIOG, GPIO_PIN_13, GPIO_PIN_RESET);
-	HAL_Delay(200);
-  }
-
-  // Note: We're running from bootloader (0x08000000), not from Bank A or B
-  // The OTA simulation will assume we're running from Bank A for testing purposes
-  printf("Note: Running OTA simulation (pretending to run from Bank A)\r\n");
-
-  // Run OTA simulation test
-  test_ota_simulation();
-
-  printf("Running from: 0x%08lX\r\n", SCB->VTOR);
-  printf("Current bank: %s\r\n",
-		 (SCB->VTOR == 0x08010000) ? "Bank A" : "Bank B");
-  // Initialize OTA context
-  ota_context_t ota_ctx;
-  ota_init(&ota_ctx);
-
-  // Enter OTA receive mode
-  printf("\r\nEntering OTA mode...\r\n");
-  ota_uart_receive_loop(&ota_ctx);
-
-  // If we return from OTA (successful or aborted), just blink LED
-  printf("\r\nOTA complete. Blinking LED...\r\n");
-
-  while (1) {
-	  HAL_GPIO_TogglePin(GPIOG, GPIO_PIN_13);
-	  HAL_Delay(1000);
-  }
+#if BOOT_RECOVERY_OTA
+  // Receive on USART1 from the event loop; a failed transfer can simply
+  // be sent again, and ota_recovery_done() runs once one is installed
+  boot_console_set_guard(ota_link_guard);
+
+  static ota_context_t ota_ctx;
+  boot_printf("(Send firmware using: python ota_sender.py app.bin %s)\r\n", "/dev/ttyACM0");
+  ota_link_start(&ota_ctx, &ota_usart1, ota_recovery_done);
+
+  // Sleeps between packets, then between LED toggles until someone
+  // resets the board
+  sched_run();
+#endif
 }
 
 /**
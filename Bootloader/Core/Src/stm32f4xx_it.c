@@ -22,6 +22,9 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "flash_layout.h"
+#include "ota_crc.h"
+#include "ota_transport_uart.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -59,7 +62,9 @@ extern HCD_HandleTypeDef hhcd_USB_OTG_HS;
 extern TIM_HandleTypeDef htim6;
 
 /* USER CODE BEGIN EV */
-
+#if BOOT_RECOVERY_OTA
+extern ota_transport_t ota_usart1;
+#endif
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -206,11 +211,14 @@ void SysTick_Handler(void)
 void TIM6_DAC_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM6_DAC_IRQn 0 */
-
+  // HAL timebase, started by HAL_Init() for recovery OTA only. Without
+  // it the boot path never enables this interrupt, and the guard keeps
+  // the TIM driver out of the image.
+#if BOOT_RECOVERY_OTA
   /* USER CODE END TIM6_DAC_IRQn 0 */
   HAL_TIM_IRQHandler(&htim6);
   /* USER CODE BEGIN TIM6_DAC_IRQn 1 */
-
+#endif
   /* USER CODE END TIM6_DAC_IRQn 1 */
 }
 
@@ -220,14 +228,33 @@ void TIM6_DAC_IRQHandler(void)
 void OTG_HS_IRQHandler(void)
 {
   /* USER CODE BEGIN OTG_HS_IRQn 0 */
-
+  // The bootloader never starts the USB host; as for TIM6
+#if BOOT_RECOVERY_OTA
   /* USER CODE END OTG_HS_IRQn 0 */
   HAL_HCD_IRQHandler(&hhcd_USB_OTG_HS);
   /* USER CODE BEGIN OTG_HS_IRQn 1 */
-
+#endif
   /* USER CODE END OTG_HS_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA2 stream0 global interrupt (OTA CRC feed).
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  ota_crc_irq_handler();
+}
+
+#if BOOT_RECOVERY_OTA
+/**
+  * @brief This function handles USART1 global interrupt (recovery OTA link).
+  */
+void USART1_IRQHandler(void)
+{
+  ota_transport_uart_irq(&ota_usart1);
+}
+#endif
+
 /* USER CODE END 1 */
@@ -0,0 +1,114 @@
+/*
+ * boot_handoff.h
+ *
+ * Bootloader -> application handoff block.
+ *
+ * The bootloader already runs the clock tree both images use (HSI PLL,
+ * 72 MHz, see the .ioc files), the CRC unit and the debug USART1. Rather
+ * than tear that down in jump_to_application() and have the application
+ * build it again, the bootloader leaves them running and describes them
+ * here, together with why and what it booted. The application adopts
+ * whatever it can verify against the live registers and initialises the
+ * rest as before; a missing or stale block just means a full init.
+ *
+ * The block sits in the top BOOT_HANDOFF_RESERVED bytes of CCM RAM,
+ * which neither linker script places anything in and no startup code
+ * clears. The bootloader invalidates it on entry, so only a jump (never
+ * a reset straight into the application) sees a valid block.
+ *
+ * Layout rules: append fields only, bump BOOT_HANDOFF_VERSION when a
+ * field changes meaning, readers check `size` before using new fields.
+ */
+
+#ifndef INC_BOOT_HANDOFF_H_
+#define INC_BOOT_HANDOFF_H_
+
+#include <stdint.h>
+
+#define BOOT_HANDOFF_ADDRESS    0x1000FF80  // CCM RAM, last 128 bytes
+#define BOOT_HANDOFF_RESERVED   128
+#define BOOT_HANDOFF_MAGIC      0x48414E44  // "HAND"
+#define BOOT_HANDOFF_VERSION    1
+
+// Peripherals left configured and running
+#define BOOT_HANDOFF_PERIPH_CRC     (1U << 0)
+#define BOOT_HANDOFF_PERIPH_USART1  (1U << 1)  // 8N1, TX/RX, PA9/PA10
+
+// Why the bootloader ran (decoded from RCC->CSR)
+#define BOOT_REASON_UNKNOWN     0
+#define BOOT_REASON_POWER_ON    1
+#define BOOT_REASON_PIN         2   // NRST / debugger
+#define BOOT_REASON_SOFTWARE    3   // NVIC_SystemReset(), e.g. after OTA
+#define BOOT_REASON_WATCHDOG    4   // IWDG, e.g. a trial boot hung
+#define BOOT_REASON_BROWNOUT    5
+
+typedef struct {
+    uint32_t magic;             // BOOT_HANDOFF_MAGIC
+    uint16_t version;           // BOOT_HANDOFF_VERSION
+    uint16_t size;              // sizeof(boot_handoff_t) of the writer
+
+    // Clock tree at the jump
+    uint32_t sysclk_hz;
+    uint32_t hclk_hz;
+    uint32_t pclk1_hz;
+    uint32_t pclk2_hz;
+    uint32_t rcc_pllcfgr;       // RCC->PLLCFGR
+    uint32_t rcc_cfgr;          // RCC->CFGR
+    uint32_t flash_acr;         // FLASH->ACR (wait states, caches)
+
+    // Peripherals handed over
+    uint32_t peripherals;       // BOOT_HANDOFF_PERIPH_*
+    uint32_t usart1_baud;
+
+    // Boot
+    uint32_t reset_flags;       // RCC->CSR reset flags at bootloader entry
+    uint32_t boot_reason;       // BOOT_REASON_*
+    uint32_t slot;              // Slot booted
+    uint32_t slot_status;       // BANK_STATUS_* in the boot record
+    uint32_t trial_attempt;     // 1..BOOT_TRIAL_MAX_ATTEMPTS, 0 if not on trial
+    uint32_t jump_cycles;       // DWT->CYCCNT at the jump (counted from reset)
+
+    uint32_t check;             // ~XOR of every word above
+} boot_handoff_t;
+
+_Static_assert(sizeof(boot_handoff_t) <= BOOT_HANDOFF_RESERVED, "handoff block outgrew its reservation");
+
+/* ---- Bootloader side ---- */
+
+/**
+ * @brief Invalidate the block, latch and clear the reset flags, start
+ *        the cycle counter. Call first thing in main().
+ * @return BOOT_REASON_*
+ */
+uint32_t boot_handoff_begin(void);
+
+/**
+ * @brief Record which slot is being booted
+ */
+void boot_handoff_set_slot(uint32_t slot, uint32_t slot_status, uint32_t trial_attempt);
+
+/**
+ * @brief Describe the clocks/peripherals left running and seal the block
+ * @param peripherals BOOT_HANDOFF_PERIPH_* mask
+ * @param usart1_baud Baud rate USART1 is running at (if handed over)
+ */
+void boot_handoff_commit(uint32_t peripherals, uint32_t usart1_baud);
+
+/* ---- Application side ---- */
+
+/**
+ * @brief Get the handoff block if the bootloader left a valid one
+ * @return Block, or NULL (no bootloader jump, or unknown layout)
+ */
+const boot_handoff_t *boot_handoff_get(void);
+
+/**
+ * @brief Keep the bootloader's clock tree instead of SystemClock_Config()
+ * @param sysclk_hz SYSCLK the application was built for
+ * @return 0 if adopted (SystemCoreClock and SysTick updated), -1 otherwise
+ */
+int boot_handoff_adopt_clocks(const boot_handoff_t *handoff, uint32_t sysclk_hz);
+
+const char *boot_handoff_reason_name(uint32_t reason);
+
+#endif /* INC_BOOT_HANDOFF_H_ */
@@ -0,0 +1,79 @@
+/*
+ * boot_state.h
+ *
+ *  Created on: Dec 29, 2025
+ *      Author: sean-shk
+ */
+
+#ifndef INC_BOOT_STATE_H_
+#define INC_BOOT_STATE_H_
+
+#include <stdint.h>
+#include "flash_layout.h"  // BANK_A_ADDRESS, BANK_B_ADDRESS, BOOT_STATE_ADDRESS
+
+// Slot selection (now uint32_t for word alignment); the two original
+// banks are slots 0 and 1 of the slot table
+#define BANK_A              0x00000000
+#define BANK_B              0x00000001
+#define BANK_INVALID        0xFFFFFFFF
+
+#define BOOT_MAX_SLOTS      FLASH_NUM_SLOTS
+
+// Bank status values (now uint32_t for word alignment)
+#define BANK_STATUS_INVALID 0x00000000
+#define BANK_STATUS_VALID   0x00000001
+#define BANK_STATUS_TESTING 0x00000002
+
+// Magic number to identify valid boot state (changed with each slot
+// layout so an older record is never read as the current one)
+#define BOOT_STATE_MAGIC    0xB0075108
+
+// Verification verdict words, one per slot, kept just past the record and
+// outside its CRC. They start erased after boot_state_erase() and are
+// programmed once by the bootloader (1 -> 0 bits only, no erase), so the
+// verdict for an image lives exactly as long as the record that describes it.
+#define BOOT_VERDICT_ADDRESS    (BOOT_STATE_ADDRESS + 0x100)
+#define BOOT_VERDICT_NONE       0xFFFFFFFF  // Not checked since last update
+#define BOOT_VERDICT_FAILED     0x00000000  // CRC mismatch, never boot
+                                            // Anything else: image fingerprint
+
+// Trial boot words, one per slot, same erase/program rules as the
+// verdicts (see boot_trial.h). Each boot of an unconfirmed TESTING slot
+// clears one attempt bit; the application clears the confirm word.
+#define BOOT_ATTEMPTS_ADDRESS   (BOOT_STATE_ADDRESS + 0x140)
+#define BOOT_CONFIRM_ADDRESS    (BOOT_STATE_ADDRESS + 0x180)
+#define BOOT_CONFIRMED          0x00000000
+#define BOOT_TRIAL_MAX_ATTEMPTS 2   // A reset before confirming is not a failure
+
+typedef struct {
+    uint32_t status;            // 4 bytes - BANK_STATUS_*
+    uint32_t sequence;          // 4 bytes - install order, higher is newer
+    uint32_t fw_version;        // 4 bytes - Major<<24 | Minor<<16 | Patch
+    uint32_t image_size;        // 4 bytes - installed image size
+    uint32_t image_crc32;       // 4 bytes - CRC32 of installed image
+    uint32_t stream_crc32;      // 4 bytes - CRC32 of the stream it came in
+} boot_slot_t;  // 24 bytes = 6 words
+
+typedef struct {
+    uint32_t magic_number;      // 4 bytes
+    uint32_t active_slot;       // 4 bytes - slot of the last install
+    uint32_t next_sequence;     // 4 bytes - sequence for the next install
+    boot_slot_t slots[BOOT_MAX_SLOTS];
+    uint32_t crc32;             // 4 bytes
+} boot_state_t;  // 16 + 24 * BOOT_MAX_SLOTS bytes
+
+// Function prototypes
+int boot_state_read(boot_state_t *state);
+int boot_state_write(const boot_state_t *state);
+int boot_state_erase(void);
+void boot_state_init(boot_state_t *state);
+void boot_state_settle(boot_state_t *state);
+uint32_t boot_state_get_verdict(uint32_t slot);
+int boot_state_set_verdict(uint32_t slot, uint32_t verdict);
+uint32_t boot_state_get_attempts(uint32_t slot);
+int boot_state_add_attempt(uint32_t slot);
+int boot_state_is_confirmed(uint32_t slot);
+int boot_state_set_confirmed(uint32_t slot);
+
+
+#endif /* INC_BOOT_STATE_H_ */
@@ -0,0 +1,62 @@
+/*
+ * boot_trial.h
+ *
+ * Trial boot of a freshly installed image, with rollback by reset.
+ *
+ * ota_update_boot_state() records a new image as BANK_STATUS_TESTING and
+ * leaves the older slots alone. Each time the bootloader picks an
+ * unconfirmed TESTING slot it spends one attempt (a bit in the slot's
+ * attempt word) and starts the IWDG before jumping. A healthy application
+ * calls boot_trial_confirm() and keeps kicking the watchdog. If the image
+ * hangs or resets BOOT_TRIAL_MAX_ATTEMPTS times (two) without confirming,
+ * the bootloader fails its verdict and falls through to the next newest
+ * slot, i.e. the previous image. Recovery needs no re-download: at most
+ * two BOOT_WATCHDOG_TIMEOUT_MS of a hung image. The second attempt is
+ * there for an ordinary reset (power, debugger, user) inside the
+ * application's confirm delay, which must not roll back a good image.
+ *
+ * An application that installs an update before confirming is confirmed
+ * by ota_update_boot_state(): it ran long enough to receive the image.
+ *
+ * Attempts, confirmation and the verdict are all 1 -> 0 bit programs in
+ * the boot state sector; the next record rewrite folds them into the slot
+ * status (boot_state_settle()).
+ */
+
+#ifndef INC_BOOT_TRIAL_H_
+#define INC_BOOT_TRIAL_H_
+
+#include <stdint.h>
+#include "boot_state.h"
+
+// Must cover the longest stretch the application can't kick: a sector
+// erase in the bank it runs from, or the boot state rewrite
+#define BOOT_WATCHDOG_TIMEOUT_MS  20000
+
+/**
+ * @brief Bootloader: account for a boot of a verified slot
+ * @param state Boot state record
+ * @param slot  Slot about to be booted
+ * @return 0 to go ahead (watchdog armed if this is a trial), -1 if the
+ *         trial is used up and the slot has been failed
+ */
+int boot_trial_begin(const boot_state_t *state, uint32_t slot);
+
+/**
+ * @brief Application: mark the running image as good
+ * @return 0 on success or if there was nothing to confirm, -1 on flash error
+ */
+int boot_trial_confirm(void);
+
+/**
+ * @brief Start the IWDG (cannot be stopped until reset)
+ * @param timeout_ms Approximate timeout (LSI is 17-47 kHz), max ~32 s
+ */
+void boot_watchdog_start(uint32_t timeout_ms);
+
+/**
+ * @brief Reload the IWDG; harmless if it was never started
+ */
+void boot_watchdog_kick(void);
+
+#endif /* INC_BOOT_TRIAL_H_ */
@@ -0,0 +1,196 @@
+/*
+ * flash_layout.h
+ *
+ * Compile-time partition map for the STM32F429ZI (2MB, dual bank).
+ *
+ * Every partition is a run of whole sectors. Addresses and sizes are
+ * derived from the sector geometry, so resizing a partition means
+ * changing its PART_*_FIRST_SECTOR / _NUM_SECTORS and nothing else. Erase,
+ * bounds checks and bank addresses all come from here.
+ *
+ * Sector geometry (per 1MB bank):
+ *   sectors 0-3   16KB
+ *   sector  4     64KB
+ *   sectors 5-11  128KB
+ * Bank 2 repeats the pattern as sectors 12-23 from 0x08100000.
+ *
+ * Image slots are numbered in address order: bank A and bank B keep
+ * their historical place as slots 0 and 1, the rest of the 2MB holds
+ * slots 2..FLASH_NUM_SLOTS-1.
+ *
+ * Recovery OTA is off by default: the production bootloader fits sector
+ * 0 and sectors 1-3 stay outside the table, unused, until something
+ * needs them (sector 11 is unused too). A bootloader built with
+ * BOOT_RECOVERY_OTA carries the OTA link to reinstall an image when no
+ * slot boots, and needs all four sectors. The linker script does not
+ * enforce either size: the bootloader's post-build step runs
+ * "ota_image_tool.py size" to fail the build on an overflow.
+ */
+
+#ifndef INC_FLASH_LAYOUT_H_
+#define INC_FLASH_LAYOUT_H_
+
+#include <stdint.h>
+
+#define FLASH_BASE_ADDRESS      0x08000000
+#define FLASH_TOTAL_SIZE        (2 * 1024 * 1024)
+#define FLASH_SECTORS_PER_BANK  12
+#define FLASH_NUM_SECTORS       24
+
+// Offset/size of sector i within its 1MB bank
+#define FLASH_BANK_SECTOR_OFFSET(i) \
+    ((i) < 4 ? (i) * 0x4000U : (i) == 4 ? 0x10000U : 0x20000U * ((i) - 4))
+#define FLASH_BANK_SECTOR_SIZE(i) \
+    ((i) < 4 ? 0x4000U : (i) == 4 ? 0x10000U : 0x20000U)
+
+// Absolute start/size of sector n (0-23); FLASH_SECTOR_START(24) is the end of flash
+#define FLASH_SECTOR_START(n) \
+    (FLASH_BASE_ADDRESS + ((n) / FLASH_SECTORS_PER_BANK) * 0x100000U + \
+     FLASH_BANK_SECTOR_OFFSET((n) % FLASH_SECTORS_PER_BANK))
+#define FLASH_SECTOR_SIZE(n)    FLASH_BANK_SECTOR_SIZE((n) % FLASH_SECTORS_PER_BANK)
+
+/* ---- Partition table ---- */
+
+// 1: the bootloader falls back to receiving an image over USART1.
+// Both images must be built with the same value, so it lives here.
+#define BOOT_RECOVERY_OTA            0
+
+#if BOOT_RECOVERY_OTA
+#define PART_BOOTLOADER_FIRST_SECTOR 0   // 64KB
+#define PART_BOOTLOADER_NUM_SECTORS  4
+#else
+#define PART_BOOTLOADER_FIRST_SECTOR 0   // 16KB
+#define PART_BOOTLOADER_NUM_SECTORS  1   // Sectors 1-3 unused
+#endif
+
+#define PART_BANK_A_FIRST_SECTOR     4   // 64KB + 128KB
+#define PART_BANK_A_NUM_SECTORS      2
+
+#define PART_BANK_B_FIRST_SECTOR     6   // 2 x 128KB
+#define PART_BANK_B_NUM_SECTORS      2
+
+#define PART_BOOT_STATE_FIRST_SECTOR 8   // 128KB
+#define PART_BOOT_STATE_NUM_SECTORS  1
+
+#define PART_SLOT2_FIRST_SECTOR      9   // 2 x 128KB
+#define PART_SLOT2_NUM_SECTORS       2
+
+#define PART_SLOT3_FIRST_SECTOR      12  // 4 x 16KB + 64KB + 128KB (bank 2)
+#define PART_SLOT3_NUM_SECTORS       6
+
+#define PART_SLOT4_FIRST_SECTOR      18  // 2 x 128KB
+#define PART_SLOT4_NUM_SECTORS       2
+
+#define PART_SLOT5_FIRST_SECTOR      20  // 2 x 128KB
+#define PART_SLOT5_NUM_SECTORS       2
+
+#define PART_SLOT6_FIRST_SECTOR      22  // 2 x 128KB
+#define PART_SLOT6_NUM_SECTORS       2
+
+#define PARTITION_ADDRESS(p)    FLASH_SECTOR_START(p##_FIRST_SECTOR)
+#define PARTITION_END(p)        FLASH_SECTOR_START(p##_FIRST_SECTOR + p##_NUM_SECTORS)
+#define PARTITION_SIZE(p)       (PARTITION_END(p) - PARTITION_ADDRESS(p))
+
+#define BOOTLOADER_ADDRESS      PARTITION_ADDRESS(PART_BOOTLOADER)
+#define BOOTLOADER_SIZE         PARTITION_SIZE(PART_BOOTLOADER)
+#define BANK_A_ADDRESS          PARTITION_ADDRESS(PART_BANK_A)
+#define BANK_A_SIZE             PARTITION_SIZE(PART_BANK_A)
+#define BANK_B_ADDRESS          PARTITION_ADDRESS(PART_BANK_B)
+#define BANK_B_SIZE             PARTITION_SIZE(PART_BANK_B)
+#define BOOT_STATE_ADDRESS      PARTITION_ADDRESS(PART_BOOT_STATE)
+#define BOOT_STATE_SIZE         PARTITION_SIZE(PART_BOOT_STATE)
+#define SLOT2_ADDRESS           PARTITION_ADDRESS(PART_SLOT2)
+#define SLOT3_ADDRESS           PARTITION_ADDRESS(PART_SLOT3)
+#define SLOT4_ADDRESS           PARTITION_ADDRESS(PART_SLOT4)
+#define SLOT5_ADDRESS           PARTITION_ADDRESS(PART_SLOT5)
+#define SLOT6_ADDRESS           PARTITION_ADDRESS(PART_SLOT6)
+
+// Image slots, bank A and bank B included
+#define FLASH_NUM_SLOTS         7
+
+// Largest image any slot can hold (for buffer sizing only; per-slot
+// limits come from flash_slot_size())
+#define SLOT_MAX_SIZE           (BANK_A_SIZE > BANK_B_SIZE ? BANK_A_SIZE : BANK_B_SIZE)
+
+// Partitions must be in order, non-overlapping and inside flash
+_Static_assert(PARTITION_END(PART_BOOTLOADER) <= BANK_A_ADDRESS, "bootloader overlaps bank A");
+_Static_assert(PARTITION_END(PART_BANK_A) <= BANK_B_ADDRESS, "bank A overlaps bank B");
+_Static_assert(PARTITION_END(PART_BANK_B) <= BOOT_STATE_ADDRESS, "bank B overlaps boot state");
+_Static_assert(PARTITION_END(PART_BOOT_STATE) <= SLOT2_ADDRESS, "boot state overlaps slot 2");
+_Static_assert(PARTITION_END(PART_SLOT2) <= SLOT3_ADDRESS, "slot 2 overlaps slot 3");
+_Static_assert(PARTITION_END(PART_SLOT3) <= SLOT4_ADDRESS, "slot 3 overlaps slot 4");
+_Static_assert(PARTITION_END(PART_SLOT4) <= SLOT5_ADDRESS, "slot 4 overlaps slot 5");
+_Static_assert(PARTITION_END(PART_SLOT5) <= SLOT6_ADDRESS, "slot 5 overlaps slot 6");
+_Static_assert(PART_SLOT6_FIRST_SECTOR + PART_SLOT6_NUM_SECTORS <= FLASH_NUM_SECTORS,
+               "partition table runs past the end of flash");
+// SLOT_MAX_SIZE sizes the relocation bitmap, so no slot may exceed it
+_Static_assert(PARTITION_SIZE(PART_SLOT2) <= SLOT_MAX_SIZE && PARTITION_SIZE(PART_SLOT3) <= SLOT_MAX_SIZE &&
+               PARTITION_SIZE(PART_SLOT4) <= SLOT_MAX_SIZE && PARTITION_SIZE(PART_SLOT5) <= SLOT_MAX_SIZE &&
+               PARTITION_SIZE(PART_SLOT6) <= SLOT_MAX_SIZE, "slot larger than SLOT_MAX_SIZE");
+// The bootloader must own sector 0 (reset vector)
+_Static_assert(PART_BOOTLOADER_FIRST_SECTOR == 0, "bootloader must start at sector 0");
+// VTOR needs the vector table (107 entries) on a 512-byte boundary
+_Static_assert(((BANK_A_ADDRESS | BANK_B_ADDRESS | SLOT2_ADDRESS | SLOT3_ADDRESS |
+                 SLOT4_ADDRESS | SLOT5_ADDRESS | SLOT6_ADDRESS) & 0x1FF) == 0,
+               "image slots must be 512-byte aligned for VTOR");
+
+typedef struct {
+    const char *name;
+    uint32_t address;
+    uint32_t size;
+    uint8_t first_sector;
+    uint8_t num_sectors;
+    uint8_t image_slot;         // 1 if this partition holds a bootable image
+} flash_partition_t;
+
+extern const flash_partition_t flash_partitions[];
+extern const uint32_t flash_partition_count;
+
+/**
+ * @brief Find the partition that starts at an address
+ * @return Partition entry, or NULL if none starts there
+ */
+const flash_partition_t *flash_partition_at(uint32_t address);
+
+/**
+ * @brief Capacity of the image slot starting at an address
+ * @return Size in bytes, or 0 if address is not the start of an image slot
+ */
+uint32_t flash_slot_size(uint32_t address);
+
+/**
+ * @brief Start address of an image slot
+ * @param slot Slot index, 0..FLASH_NUM_SLOTS-1 (0 = bank A, 1 = bank B)
+ * @return Address, or 0 if slot is out of range
+ */
+uint32_t flash_slot_address(uint32_t slot);
+
+/**
+ * @brief Slot index of the image slot starting at an address
+ * @return Slot index, or -1 if address is not the start of an image slot
+ */
+int flash_slot_index(uint32_t address);
+
+/**
+ * @brief Erase the sectors of a partition covering its first `size` bytes
+ * @param part Partition to erase
+ * @param size Bytes that will be programmed (clamped to the partition)
+ * @return 0 on success, -1 on a flash error
+ *
+ * Only the sectors the data will land in are erased; a 40KB image in
+ * bank A erases the 64KB sector and leaves the 128KB one alone.
+ */
+int flash_erase_partition(const flash_partition_t *part, uint32_t size);
+
+/**
+ * @brief Program erased flash, a word at a time
+ * @param address Word-aligned destination
+ * @param size    Bytes; a partial last word is padded with 0xFF
+ * @return 0 on success, -1 on a flash error
+ *
+ * Through the HAL or the registers, as OTA_HAL_DRIVERS (ota_config.h)
+ * says; blocking either way.
+ */
+int flash_program(uint32_t address, const void *data, uint32_t size);
+
+#endif /* INC_FLASH_LAYOUT_H_ */
@@ -0,0 +1,84 @@
+/*
+ * image_header.h
+ *
+ * Self-describing firmware image header.
+ *
+ * The header sits at a fixed offset just past the vector table, so the
+ * bootloader can read size, CRC, version and load address from any bank
+ * in O(1). The application defines one image_header_t in the
+ * .image_header section; ota_image_tool.py patches the size, CRCs and
+ * load address into the .bin after link. The linker script must pin the
+ * section to IMAGE_HEADER_OFFSET:
+ *
+ *   .isr_vector :
+ *   {
+ *     . = ALIGN(4);
+ *     KEEP(*(.isr_vector))
+ *     . = ORIGIN(FLASH) + 0x200;
+ *     KEEP(*(.image_header))
+ *     . = ALIGN(4);
+ *   } >FLASH
+ *
+ * The install_* words are left erased by the tool and programmed once by
+ * the OTA code after the image is verified in flash. They describe the
+ * bytes as installed, which differ from the built image when a
+ * relocatable container was rebased into the other bank.
+ */
+
+#ifndef INC_IMAGE_HEADER_H_
+#define INC_IMAGE_HEADER_H_
+
+#include <stdint.h>
+
+#define IMAGE_HEADER_OFFSET     0x200       // After the 107-entry vector table
+#define IMAGE_HEADER_MAGIC      0x474D4953  // "SIMG"
+
+// Feature flags
+#define IMAGE_FLAG_RELOCATABLE  0x00000001  // Shipped as an ota_reloc container
+
+typedef struct {
+    uint32_t magic;             // IMAGE_HEADER_MAGIC
+    uint32_t header_size;       // sizeof(image_header_t)
+    uint32_t image_size;        // Whole image, vector table included
+    uint32_t image_crc32;       // Built image with this header cut out
+    uint32_t fw_version;        // Major << 24 | Minor << 16 | Patch
+    uint32_t load_address;      // Address the image was linked for
+    uint32_t flags;             // IMAGE_FLAG_*
+    uint32_t header_crc32;      // CRC32 of the 7 words above
+
+    // Erased in the .bin; programmed by image_header_install()
+    uint32_t install_address;   // Bank the image was programmed into
+    uint32_t install_crc32;     // Installed image with this header cut out
+    uint32_t install_check;     // ~(install_address ^ install_crc32)
+    uint32_t reserved;
+} image_header_t;  // 48 bytes
+
+/**
+ * @brief Locate and validate the header of the image in a bank
+ * @param bank_address Bank base address
+ * @return Pointer into flash, or NULL if missing or corrupted
+ */
+const image_header_t *image_header_get(uint32_t bank_address);
+
+/**
+ * @brief Check that the install words are set and name this bank
+ * @return 1 if installed at bank_address, 0 otherwise
+ */
+int image_header_is_installed(const image_header_t *hdr, uint32_t bank_address);
+
+/**
+ * @brief CRC32 of the image in a bank with the header cut out
+ * @param address Bank base address
+ * @param size    Image size in bytes (header included)
+ * @return CRC32 value (DMA-fed)
+ */
+uint32_t image_crc32(uint32_t address, uint32_t size);
+
+/**
+ * @brief Program the install words of a freshly written image
+ * @param bank_address Bank the image was programmed into
+ * @return 0 on success, -1 on missing header or flash error
+ */
+int image_header_install(uint32_t bank_address);
+
+#endif /* INC_IMAGE_HEADER_H_ */
@@ -0,0 +1,103 @@
+/*
+ * ota_crc.h
+ *
+ * DMA-fed CRC32 service.
+ *
+ * DMA2 Stream0 runs in memory-to-memory mode with the image as source
+ * (incrementing) and CRC->DR as destination (fixed), so the CRC unit is
+ * fed straight from flash or SDRAM without the CPU touching each word.
+ * Only the zero-padded trailing word (size % 4) is written by the CPU,
+ * which keeps results identical to calculate_crc32().
+ *
+ * DMA2_Stream0_IRQHandler() must call ota_crc_irq_handler().
+ *
+ * An image built without OTA_HAL_DRIVERS (ota_config.h) has no DMA: the
+ * blocking calls feed the unit from the CPU, ota_crc_start() fails and
+ * ota_crc_benchmark() is not there.
+ */
+
+#ifndef INC_OTA_CRC_H_
+#define INC_OTA_CRC_H_
+
+#include <stdint.h>
+
+// NDTR is 16 bits; long images are fed in segments of this many words
+#define OTA_CRC_DMA_SEGMENT_WORDS   16384  // 64KB
+
+// status 0: crc is the result. -1: the DMA failed and crc means nothing;
+// redo the range with ota_crc_calculate_cpu() outside the interrupt.
+typedef void (*ota_crc_callback_t)(uint32_t crc, int status, void *arg);
+
+/**
+ * @brief Configure DMA2 Stream0 for CRC feeding (called lazily)
+ * @return 0 on success, -1 on HAL error
+ */
+int ota_crc_init(void);
+
+/**
+ * @brief Start an asynchronous CRC32 over a memory range
+ * @param address Start address (word aligned)
+ * @param size    Size in bytes
+ * @param cb      Called from the DMA interrupt with the final CRC or a
+ *                DMA error
+ * @param arg     Passed through to cb
+ * @return 0 if started, -1 if busy or DMA unavailable
+ */
+int ota_crc_start(uint32_t address, uint32_t size, ota_crc_callback_t cb, void *arg);
+
+/**
+ * @brief Check whether a DMA CRC is in flight
+ * @return 1 if busy, 0 if idle
+ */
+int ota_crc_busy(void);
+
+/**
+ * @brief Blocking CRC32 over a memory range
+ * @return CRC32 value
+ *
+ * Uses DMA and sleeps in WFI until completion. Falls back to the CPU
+ * loop, in the caller's context, if the DMA cannot be started or fails.
+ */
+uint32_t ota_crc_calculate(uint32_t address, uint32_t size);
+
+/**
+ * @brief Blocking CRC32 continued from the previous result (no DR reset)
+ * @return CRC32 value
+ *
+ * Lets one CRC cover several ranges, e.g. an image with its header cut
+ * out. Every range except the last must be a multiple of 4 bytes.
+ */
+uint32_t ota_crc_accumulate(uint32_t address, uint32_t size);
+
+/**
+ * @brief CPU-fed CRC32
+ * @return CRC32 value
+ */
+uint32_t ota_crc_calculate_cpu(uint32_t address, uint32_t size);
+
+/**
+ * @brief Feed whole words to the CRC unit from the CPU
+ * @param reset 1 to start a new CRC, 0 to continue the last one
+ * @return CRC32 so far
+ *
+ * HAL_CRC_Calculate() / HAL_CRC_Accumulate() without a handle, for
+ * short runs such as a header or the boot state record.
+ */
+uint32_t ota_crc_words(const uint32_t *words, uint32_t count, int reset);
+
+/**
+ * @brief Interrupt handler hook for DMA2 Stream0
+ */
+void ota_crc_irq_handler(void);
+
+/**
+ * @brief Compare CPU and DMA CRC cost over a memory range
+ * @param address Start address
+ * @param size    Size in bytes
+ *
+ * Prints wall-clock and CPU-busy cycles per KB for both methods
+ * (DWT cycle counter).
+ */
+void ota_crc_benchmark(uint32_t address, uint32_t size);
+
+#endif /* INC_OTA_CRC_H_ */
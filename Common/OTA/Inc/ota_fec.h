@@ -0,0 +1,72 @@
+/*
+ * ota_fec.h
+ *
+ * Parity repair of DATA packets for ota_link.c (OTA_PKT_PARITY in
+ * ota_protocol.h). Once the sender has sent a PARITY packet, a chunk
+ * that is lost or fails its CRC no longer costs a NACK, a resend and a
+ * round trip:
+ *
+ *   - the chunks after it in the same group are held here and answered
+ *     with an ACK that does not move last_chunk_received
+ *   - when the group's PARITY arrives, the missing chunk is the XOR of
+ *     the parity and every other chunk of the group; it and the held
+ *     chunks then go to ota_manager in order, as if they had just come
+ *     in, and one response covers them all
+ *
+ * Two losses in one group, a damaged PARITY, or a chunk of the next
+ * group turning up first (the PARITY was lost) end in the NACK
+ * OTA_ERR_SEQUENCE the sender would have had without FEC, and it resends
+ * from last_chunk_received.
+ *
+ * RAM is fixed: OTA_FEC_MAX_GROUP DATA packets (the held chunks and the
+ * running XOR), about OTA_FEC_MAX_GROUP KB. Chunks go to flash in order
+ * as before, so the manager needs no changes. Packets of either wire
+ * layout come here as ota_data_packet_v2_t, data word aligned.
+ */
+
+#ifndef INC_OTA_FEC_H_
+#define INC_OTA_FEC_H_
+
+#include "ota_manager.h"
+
+#define OTA_FEC_PASS    0   // Hand the DATA packet to the manager
+#define OTA_FEC_HOLD    1   // Taken for repair; answer with an ACK
+
+typedef struct {
+    uint32_t held;              // DATA packets held past a gap
+    uint32_t repaired;          // Chunks rebuilt from parity
+    uint32_t unrepairable;      // Groups that fell back to a NACK
+} ota_fec_stats_t;
+
+/**
+ * @brief Forget any group in progress; FEC is off until the next PARITY
+ */
+void ota_fec_reset(void);
+
+/**
+ * @brief Look at a DATA packet before the manager does
+ * @return OTA_FEC_HOLD if it was damaged or past a gap while FEC is on
+ */
+int ota_fec_data(const ota_context_t *ctx, const ota_data_packet_v2_t *pkt);
+
+/**
+ * @brief The manager has written pkt; count it towards its group's parity
+ */
+void ota_fec_written(const ota_data_packet_v2_t *pkt);
+
+/**
+ * @brief A PARITY packet
+ * @return Packets to hand to the manager via ota_fec_replay(), 0 if there
+ *         is nothing to repair (answer with an ACK), -1 if the group
+ *         cannot be repaired (answer with NACK OTA_ERR_SEQUENCE)
+ */
+int ota_fec_parity(const ota_context_t *ctx, const ota_data_packet_v2_t *pkt);
+
+/**
+ * @brief i-th packet of a repair: the held chunks and the rebuilt one, in order
+ */
+const ota_data_packet_v2_t *ota_fec_replay(uint32_t i);
+
+void ota_fec_get_stats(ota_fec_stats_t *out);
+
+#endif /* INC_OTA_FEC_H_ */
@@ -0,0 +1,63 @@
+/*
+ * ota_fountain.h
+ *
+ * Broadcast updates for ota_link.c: OTA_PKT_SYMBOL packets (see
+ * ota_protocol.h) sent to any number of devices at once, with no
+ * responses. The first symbol heard while the manager is idle starts a
+ * session: a START is made up from the symbol's header (target slot
+ * chosen by the device) and the link stops answering until it ends.
+ *
+ * Each segment of the image is decoded by Gaussian elimination over
+ * GF(2) as symbols arrive, in any order; the segment after the last one
+ * written is the only one kept, so RAM is fixed at OTA_FOUNTAIN_SEGMENT
+ * chunks plus two packet buffers. Once a segment has as many
+ * independent symbols as chunks, its chunks go to ota_manager in order,
+ * as DATA packets would, and are written straight to the target slot;
+ * after the last segment an END is made up and the manager verifies and
+ * installs the image as usual.
+ *
+ * A device that already has a slot record of the image (installed, or
+ * fallen back from) ignores the broadcast, so a carousel that keeps
+ * going does not install it again after the reset.
+ */
+
+#ifndef INC_OTA_FOUNTAIN_H_
+#define INC_OTA_FOUNTAIN_H_
+
+#include "ota_manager.h"
+
+typedef struct {
+    uint32_t symbols;           // SYMBOL packets with a good CRC
+    uint32_t innovative;        // ...that added a row to the segment being decoded
+    uint32_t redundant;         // ...already spanned by the rows held
+    uint32_t other_segment;     // ...for a segment other than the next one to write
+    uint32_t bad_crc;           // SYMBOL packets dropped for their CRC
+    uint32_t segments;          // Decoded and written
+} ota_fountain_stats_t;
+
+/**
+ * @brief End any broadcast session (a START or ABORT takes the manager over)
+ */
+void ota_fountain_reset(void);
+
+/**
+ * @brief Non-zero while a broadcast session owns the manager (no responses)
+ */
+int ota_fountain_active(void);
+
+/**
+ * @brief A SYMBOL packet; starts a session, decodes, writes and installs
+ */
+void ota_fountain_symbol(ota_context_t *ctx, const ota_symbol_packet_t *pkt);
+
+/**
+ * @brief Chunks of a segment XORed into a symbol (ota_protocol.h)
+ * @param symbol_id Segment << 16 | sequence
+ * @param chunks    Chunks in the segment, 1..OTA_FOUNTAIN_SEGMENT
+ * @return Bit i set for the segment's chunk i
+ */
+uint32_t ota_fountain_mask(uint32_t symbol_id, uint32_t chunks);
+
+void ota_fountain_get_stats(ota_fountain_stats_t *out);
+
+#endif /* INC_OTA_FOUNTAIN_H_ */
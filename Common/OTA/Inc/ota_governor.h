@@ -0,0 +1,126 @@
+/*
+ * ota_governor.h
+ *
+ * Resource governor for background OTA. It keeps the update inside a
+ * budget the application can live with:
+ *
+ *   CPU share        OTA work (framing, chunk CRCs, flash steps) spends
+ *                    from a token bucket that refills at cpu_permille of
+ *                    real time and holds at most cpu_window_ms of it, so
+ *                    a burst is bounded as well as the average.
+ *   Flash busy       back-to-back flash work (a chunk written inline, a
+ *                    program step, a sector erase) may run for at most
+ *                    flash_busy_max_ms before flash is left alone for
+ *                    flash_rest_ms.
+ *   Erase rate       at most erase_per_sec sector erases in any second.
+ *
+ * Over budget, the governor pushes back two ways: the flash task waits
+ * before its next step or sector (ota_gov_flash_delay()), and the
+ * receiver answers DATA/END with NACK OTA_ERR_BUSY without processing
+ * them, which tells the sender to resend after OTA_BUSY_RETRY_MS.
+ *
+ * Granularity is one unit of work: a single sector erase or chunk is
+ * never cut short, so flash_busy_max_ms bounds the run of work that
+ * follows it, not the stall of one sector (16-128 KB take 0.25-2 s).
+ *
+ * Until ota_gov_init() is called nothing is limited, only counted; the
+ * bootloader, which has nothing else to protect, never calls it. Time
+ * comes from sched_port.h; the module has no HAL dependency.
+ */
+
+#ifndef INC_OTA_GOVERNOR_H_
+#define INC_OTA_GOVERNOR_H_
+
+#include <stdint.h>
+
+// Defaults, used when ota_gov_init() is given NULL
+#define OTA_GOV_CPU_PERMILLE        250   // 25% of the CPU on average
+#define OTA_GOV_CPU_WINDOW_MS       100   // Burst allowance
+#define OTA_GOV_FLASH_BUSY_MAX_MS   20
+#define OTA_GOV_FLASH_REST_MS       10
+#define OTA_GOV_ERASE_PER_SEC       4
+
+#define OTA_GOV_ERASE_HISTORY       8     // Upper limit for erase_per_sec
+
+typedef struct {
+    uint16_t cpu_permille;          // Long-run CPU share (1000 = no limit)
+    uint16_t cpu_window_ms;         // Bucket depth, in ms of allowance
+    uint16_t flash_busy_max_ms;     // Longest run of flash work
+    uint16_t flash_rest_ms;         // Flash-free gap after such a run
+    uint8_t erase_per_sec;          // Sector erases per second (0 = no limit)
+} ota_gov_budget_t;
+
+typedef enum {
+    OTA_GOV_CPU,
+    OTA_GOV_FLASH,
+    OTA_GOV_ERASE,
+    OTA_GOV_NUM_LIMITS
+} ota_gov_limit_t;
+
+typedef struct {
+    uint32_t elapsed_ms;                        // Length of the window
+    uint32_t cpu_ms;                            // OTA CPU time
+    uint32_t flash_ms;                          // Flash busy time
+    uint32_t erases;
+    uint32_t longest_flash_run_ms;
+    uint32_t throttled[OTA_GOV_NUM_LIMITS];     // Times each budget held work back
+    uint32_t busy_nacks;                        // Packets refused with OTA_ERR_BUSY
+    uint32_t deferred_ms;                       // Flash task time spent waiting
+} ota_gov_stats_t;
+
+/**
+ * @brief Set the budget and start with a full bucket
+ * @param budget Limits to apply, or NULL for the defaults above
+ */
+void ota_gov_init(const ota_gov_budget_t *budget);
+
+/**
+ * @brief Start timing a piece of OTA work
+ * @return Cycle stamp for ota_gov_end_cpu()/ota_gov_end_flash()
+ */
+uint32_t ota_gov_begin(void);
+
+/**
+ * @brief Charge the CPU time since start to the OTA budget
+ */
+void ota_gov_end_cpu(uint32_t start);
+
+/**
+ * @brief Add the time since start to the current run of flash work
+ *
+ * Does not charge CPU; the caller's enclosing ota_gov_end_cpu() does.
+ */
+void ota_gov_end_flash(uint32_t start);
+
+/**
+ * @brief A sector erase started / finished (interrupt-driven, no CPU)
+ */
+void ota_gov_erase_begin(void);
+void ota_gov_erase_end(void);
+
+/**
+ * @brief May the receiver process a packet now?
+ * @param needs_flash Non-zero if the packet writes flash inline
+ * @return 1 to process it, 0 to answer NACK OTA_ERR_BUSY (counted)
+ */
+int ota_gov_admit(int needs_flash);
+
+/**
+ * @brief Milliseconds the flash task should wait before its next step
+ * @param erase Non-zero if the next step is a sector erase
+ * @return 0 to go ahead; otherwise the wait is counted as throttling
+ */
+uint32_t ota_gov_flash_delay(int erase);
+
+/**
+ * @brief Counters since the last reset
+ * @param reset Non-zero to start a new window
+ */
+void ota_gov_get_stats(ota_gov_stats_t *stats, int reset);
+
+/**
+ * @brief Print and reset the counters if there was any OTA work
+ */
+void ota_gov_report(void);
+
+#endif /* INC_OTA_GOVERNOR_H_ */
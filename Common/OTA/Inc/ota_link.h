@@ -0,0 +1,98 @@
+/*
+ * ota_link.h
+ *
+ * The OTA engine's link side, shared by the bootloader and the
+ * application: it reads bytes from a transport (ota_transport.h), frames
+ * them into packets, hands those to ota_manager and writes the
+ * manager's responses back. It runs on the event loop (sched.h), so the
+ * caller keeps running sched_run() and the update happens around it.
+ *
+ * Which link carries the update is the caller's choice, per deployment:
+ * ota_link_pick() takes the fastest of a list that opens.
+ */
+
+#ifndef INC_OTA_LINK_H_
+#define INC_OTA_LINK_H_
+
+#include "ota_manager.h"
+#include "ota_transport.h"
+
+/* A partial packet is dropped after a silence learnt from the pauses
+   inside packets that arrive whole (ota_link.c), within these bounds;
+   the ceiling holds until the first packet. The floor is under the
+   senders' smallest retransmit timeout, so on a link that does not
+   pause, a resend does not land on the remains of the packet it
+   replaces. */
+#define OTA_LINK_GAP_MIN_MS      100
+#define OTA_LINK_GAP_MAX_MS     2000
+#define OTA_LINK_SEND_TIMEOUT_MS 200   // Give up on a response the link will not take
+
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t packets;
+    uint32_t resync_bytes;      // Skipped while looking for a packet start
+    uint32_t stalled_packets;   // Partial packets dropped after the gap
+    uint32_t broken_frames;     // Cut short by lost bytes; reframed at the next packet
+    uint32_t send_timeouts;     // Responses the transport did not take in time
+    uint32_t gap_ms;            // Stalled-packet gap now in use
+    uint32_t v2_packets;        // In the aligned v2 layout (ota_protocol.h)
+    uint32_t data_packets;      // DATA and PARITY packets handed on
+    uint64_t data_cycles;       // CPU cycles spent on them, framed to answered
+} ota_link_stats_t;
+
+/**
+ * @brief Open a transport and start receiving OTA packets from it
+ * @param ctx         OTA context (initialised here, owned by the link)
+ * @param t           Transport to use
+ * @param on_complete Called once an update has been installed; the
+ *                    caller decides when to reset into it
+ * @return 0 on success, -1 if the transport did not open
+ */
+int ota_link_start(ota_context_t *ctx, ota_transport_t *t, void (*on_complete)(void));
+
+/**
+ * @brief Open the fastest transport that opens and start on it
+ * @param list Candidates; ones whose rate is only known once open (0)
+ *             are tried last, in list order
+ * @return The transport in use, or NULL if none opened
+ */
+ota_transport_t *ota_link_pick(ota_context_t *ctx, ota_transport_t *const *list, uint32_t count,
+                               void (*on_complete)(void));
+
+/**
+ * @brief Stop receiving and close the transport
+ */
+void ota_link_stop(void);
+
+/**
+ * @brief Non-zero while a transfer is in progress
+ */
+int ota_link_busy(void);
+
+/**
+ * @brief Write bytes to the link (ota_send_response())
+ *
+ * Splits at the transport's MTU and sleeps while its buffer is full;
+ * dropped silently when no link is running (the bootloader's OTA
+ * simulation drives the manager directly).
+ */
+void ota_link_send(const void *data, uint16_t size);
+
+/**
+ * @brief Credit grant for an ACK (ota_protocol.h): the DATA packets the
+ *        transport can hold while the one before is processed
+ */
+uint8_t ota_link_credits(void);
+
+/**
+ * @brief ota_manager: the update in ctx is installed
+ */
+void ota_link_on_complete(ota_context_t *ctx);
+
+/**
+ * @brief Counters since start
+ */
+void ota_link_get_stats(ota_link_stats_t *stats);
+
+#endif /* INC_OTA_LINK_H_ */
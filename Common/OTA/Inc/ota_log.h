@@ -0,0 +1,52 @@
+/*
+ * ota_log.h
+ *
+ * Console output of the shared OTA modules, by level. OTA_LOG_LEVEL
+ * (ota_config.h) picks what an image prints; a message above it is not
+ * compiled in, so its format string stays out of flash and its printf
+ * never runs. That matters on the link: _write() blocks on USART1 at
+ * 115200 baud (about 87 us a character), and in the bootloader it also
+ * waits for the OTA response queued ahead of it.
+ *
+ * Messages go to OTA_LOG_PRINTF, printf unless ota_config.h names
+ * another function with its signature.
+ */
+
+#ifndef INC_OTA_LOG_H_
+#define INC_OTA_LOG_H_
+
+#include <stdio.h>
+#include "ota_config.h"
+
+#define OTA_LOG_NONE        0
+#define OTA_LOG_ERRORS      1     // Failures only
+#define OTA_LOG_PROGRESS    2     // Plus one line per step of a transfer
+#define OTA_LOG_PACKETS     3     // Plus every chunk and every response
+
+#ifndef OTA_LOG_LEVEL
+#define OTA_LOG_LEVEL       OTA_LOG_PROGRESS
+#endif
+
+#ifndef OTA_LOG_PRINTF
+#define OTA_LOG_PRINTF      printf
+#endif
+
+#if OTA_LOG_LEVEL >= OTA_LOG_ERRORS
+#define OTA_LOG_ERROR(...)  OTA_LOG_PRINTF(__VA_ARGS__)
+#else
+#define OTA_LOG_ERROR(...)  ((void)0)
+#endif
+
+#if OTA_LOG_LEVEL >= OTA_LOG_PROGRESS
+#define OTA_LOG_INFO(...)   OTA_LOG_PRINTF(__VA_ARGS__)
+#else
+#define OTA_LOG_INFO(...)   ((void)0)
+#endif
+
+#if OTA_LOG_LEVEL >= OTA_LOG_PACKETS
+#define OTA_LOG_DEBUG(...)  OTA_LOG_PRINTF(__VA_ARGS__)
+#else
+#define OTA_LOG_DEBUG(...)  ((void)0)
+#endif
+
+#endif /* INC_OTA_LOG_H_ */
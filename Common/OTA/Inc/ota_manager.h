@@ -9,6 +9,7 @@
 #define INC_OTA_MANAGER_H_
 
 #include "ota_protocol.h"
+#include "ota_reloc.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -16,6 +17,7 @@
 typedef enum {
     OTA_STATE_IDLE,
     OTA_STATE_RECEIVING_HEADER,
+    OTA_STATE_ERASING,          // OTA_BACKGROUND_FLASH: START accepted, ACK once erased
     OTA_STATE_RECEIVING_DATA,
     OTA_STATE_VERIFYING,
     OTA_STATE_FINALIZING,
@@ -27,6 +29,7 @@ typedef enum {
 typedef struct {
     ota_state_t state;
     uint32_t target_bank_address;
+    uint32_t target_slot;       // Slot index of target_bank_address
     uint32_t firmware_size;
     uint32_t firmware_version;
     uint32_t firmware_crc32;
@@ -35,16 +38,23 @@ typedef struct {
     uint32_t expected_chunk_number;
     uint32_t bytes_written;
     uint8_t error_code;
+    uint8_t staging;            // 1 = chunks staged in SDRAM, flash programmed at END
+    uint32_t link_start_tick;   // HAL tick when START was accepted
+    uint32_t link_time_ms;      // START ACK -> last DATA ACK
+    uint32_t flash_time_ms;     // Time spent erasing/programming flash
+    ota_reloc_state_t reloc;    // Rebase state for relocatable images
 } ota_context_t;
 
 // Public API
 void ota_init(ota_context_t *ctx);
 uint32_t calculate_crc32(const void *data, size_t length);
 void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt);
-void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_t *pkt);
+// Chunks come in the aligned v2 layout, whichever layout they arrived in (ota_link.c)
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt);
 void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt);
 void ota_send_response(const ota_context_t *ctx, uint8_t packet_type);
-int ota_erase_bank(uint32_t bank_address);
+int ota_erase_bank(uint32_t bank_address, uint32_t size);  // Blocking; without OTA_BACKGROUND_FLASH (ota_config.h)
 int ota_update_boot_state(const ota_context_t *ctx);
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32);
 
 #endif /* INC_OTA_MANAGER_H_ */
@@ -0,0 +1,168 @@
+/*
+ * ota_protocol.h
+ *
+ *  Created on: Jan 2, 2026
+ *      Author: sean-shk
+ */
+
+#ifndef INC_OTA_PROTOCOL_H_
+#define INC_OTA_PROTOCOL_H_
+
+#include <stdint.h>
+
+// Every packet's offsets and sizes are listed, and checked against the
+// structs below, in ota_wire.h
+
+// Protocol magic numbers
+#define OTA_MAGIC_START     0xAA55AA55
+#define OTA_MAGIC_DATA      0x55AA55AA
+
+// Packet types
+#define OTA_PKT_START       0x01  // Initial handshake with firmware info
+#define OTA_PKT_DATA        0x02  // Data chunk
+#define OTA_PKT_END         0x03  // Transfer complete
+#define OTA_PKT_ACK         0x04  // Acknowledgment
+#define OTA_PKT_NACK        0x05  // Negative acknowledgment (error)
+#define OTA_PKT_ABORT       0x06  // Abort transfer
+#define OTA_PKT_PARITY      0x07  // XOR of a group of DATA chunks (forward error correction)
+#define OTA_PKT_SYMBOL      0x08  // Fountain-coded chunks of a broadcast image (no responses)
+#define OTA_PKT_V2          0x80  // Flag: START, DATA or PARITY in the aligned v2 layout
+#define OTA_PKT_START_V2    (OTA_PKT_START | OTA_PKT_V2)
+#define OTA_PKT_DATA_V2     (OTA_PKT_DATA | OTA_PKT_V2)
+#define OTA_PKT_PARITY_V2   (OTA_PKT_PARITY | OTA_PKT_V2)
+
+// Error codes
+#define OTA_ERR_NONE        0x00
+#define OTA_ERR_CRC         0x01
+#define OTA_ERR_SIZE        0x02
+#define OTA_ERR_FLASH       0x03
+#define OTA_ERR_SEQUENCE    0x04
+#define OTA_ERR_TIMEOUT     0x05
+#define OTA_ERR_BUSY        0x06  // Over budget, packet dropped: resend it later
+
+// Configuration
+#define OTA_CHUNK_SIZE      1024  // 1KB chunks
+#define OTA_MAX_RETRIES     3
+#define OTA_TIMEOUT_MS      5000
+#define OTA_BUSY_RETRY_MS   100   // Sender's wait after NACK OTA_ERR_BUSY
+#define OTA_MAX_CREDITS     8     // Most DATA packets an ACK lets the sender have in flight
+#define OTA_FEC_MAX_GROUP   8     // Most chunks one PARITY packet covers (device RAM: this many KB)
+#define OTA_FOUNTAIN_SEGMENT 16   // Chunks per broadcast segment, at most 32 (device RAM: this many KB)
+
+// START target_bank: a slot index (0 = bank A, 1 = bank B, ...) or
+// let the device pick the least valuable slot
+#define OTA_TARGET_AUTO     0xFF
+
+// START packet: Sent by host to begin transfer
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_START
+    uint8_t packet_type;         // OTA_PKT_START
+    uint32_t firmware_size;      // Total size in bytes
+    uint32_t firmware_version;   // Version number
+    uint32_t firmware_crc32;     // CRC32 of entire firmware
+    uint32_t total_chunks;       // Number of data chunks to expect
+    uint8_t target_bank;         // Slot index or OTA_TARGET_AUTO
+} __attribute__((packed)) ota_start_packet_t;
+
+// DATA packet: Contains one chunk of firmware
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_DATA
+    uint8_t packet_type;         // OTA_PKT_DATA
+    uint32_t chunk_number;       // Sequential chunk number (0-based)
+    uint16_t chunk_size;         // Size of data in this chunk (≤ OTA_CHUNK_SIZE)
+    uint32_t chunk_crc32;        // CRC32 of this chunk's data
+    uint8_t data[OTA_CHUNK_SIZE]; // Actual firmware data
+} __attribute__((packed)) ota_data_packet_t;
+
+// PARITY packet: an ota_data_packet_t with packet_type OTA_PKT_PARITY,
+// sent after each group of chunk_size DATA chunks:
+//   chunk_number  first chunk of the group (a multiple of chunk_size)
+//   chunk_size    chunks per group, 2..OTA_FEC_MAX_GROUP (the last
+//                 group of an image may have fewer)
+//   chunk_crc32   CRC32 of all OTA_CHUNK_SIZE bytes of data
+//   data          XOR of the group's DATA data fields, as sent (padded)
+// The device rebuilds one lost or damaged chunk per group from it
+// instead of NACKing; until it has seen one it works as before.
+
+// SYMBOL packet: broadcast, to any number of devices and never answered.
+// The image is cut into segments of OTA_FOUNTAIN_SEGMENT chunks (the
+// last may be short, K chunks); each symbol is the XOR of a subset of
+// one segment's chunks, padded with 0xFF to OTA_CHUNK_SIZE:
+//   symbol_id    segment << 16 | sequence
+//   sequence < K the chunk itself (mask 1 << sequence)
+//   otherwise    mask from xorshift32 seeded with symbol_id * 0x9E3779B1
+//                (1 if that is 0): x ^= x << 13; x ^= x >> 17;
+//                x ^= x << 5; mask = x & ((1 << K) - 1), again until
+//                the mask is not 0
+// Bit i of the mask is chunk segment * OTA_FOUNTAIN_SEGMENT + i. Any K
+// independent symbols of a segment rebuild it, in any order; a device
+// writes segments in image order and ignores the others until the
+// broadcaster comes round to them again.
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_DATA
+    uint8_t packet_type;         // OTA_PKT_SYMBOL
+    uint32_t firmware_size;      // As in START: the image being broadcast
+    uint32_t firmware_version;
+    uint32_t firmware_crc32;
+    uint32_t symbol_id;          // Segment and sequence, see above
+    uint8_t data[OTA_CHUNK_SIZE];
+    uint32_t packet_crc32;       // CRC32 of all the bytes above
+} __attribute__((packed)) ota_symbol_packet_t;
+
+// v2 layouts: the fields of START and DATA/PARITY, naturally aligned,
+// with packet_type still at byte 4 so one framer reads both versions.
+// Received into an 8-byte aligned buffer, a v2 DATA packet has its data
+// on an 8-byte boundary, where the CRC unit and flash programming take
+// it a word at a time where it lies; v1 data sits at byte 15 and is
+// copied out before anything reads it by the word.
+//
+// A sender offers v2 with START_V2. A device that knows the layout
+// answers it as it would a START; an older one drops the unknown type
+// as line noise and stays silent, and the sender goes back to a v1 START
+// and v1 DATA. Either way the responses are the same, and a device takes
+// packets of both layouts at any time.
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_START
+    uint8_t packet_type;         // OTA_PKT_START_V2
+    uint8_t target_bank;         // Slot index or OTA_TARGET_AUTO
+    uint16_t reserved;           // 0
+    uint32_t firmware_size;
+    uint32_t firmware_version;
+    uint32_t firmware_crc32;
+    uint32_t total_chunks;
+} ota_start_packet_v2_t;
+
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_DATA
+    uint8_t packet_type;         // OTA_PKT_DATA_V2 or OTA_PKT_PARITY_V2
+    uint8_t reserved;            // 0
+    uint16_t chunk_size;         // As in ota_data_packet_t, and for PARITY
+    uint32_t chunk_number;
+    uint32_t chunk_crc32;
+    uint8_t data[OTA_CHUNK_SIZE] __attribute__((aligned(8)));
+} ota_data_packet_v2_t;
+
+// END packet: Signals transfer complete
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_START
+    uint8_t packet_type;         // OTA_PKT_END
+} __attribute__((packed)) ota_end_packet_t;
+
+// ACK/NACK packet: Device response
+//
+// An ACK's second byte is a credit grant: how many DATA packets the
+// sender may have sent and not yet seen answered (at least 1). The
+// device still answers every packet in order, and last_chunk_received
+// is cumulative, so a sender running a window rewinds to it on a NACK.
+// Stop-and-wait senders never look at the byte on an ACK.
+typedef struct {
+    uint32_t magic;              // OTA_MAGIC_START
+    uint8_t packet_type;         // OTA_PKT_ACK or OTA_PKT_NACK
+    union {
+        uint8_t error_code;      // OTA_ERR_* if NACK
+        uint8_t credits;         // DATA packets allowed in flight if ACK
+    };
+    uint32_t last_chunk_received; // Chunks received in order so far
+} __attribute__((packed)) ota_response_packet_t;
+
+#endif /* INC_OTA_PROTOCOL_H_ */
@@ -0,0 +1,94 @@
+/*
+ * ota_reloc.h
+ *
+ * Relocatable image container for OTA.
+ *
+ * The application is linked once (for Bank A). The post-link tool
+ * (ota_image_tool.py reloc) wraps the .bin in a container that carries a
+ * bitmap of every payload word holding an absolute address inside the
+ * image. While chunks stream in, words flagged in the bitmap are rebased
+ * by (target bank - link address) before they are programmed, so the
+ * same artifact runs from either bank.
+ *
+ * Stream layout (what the host sends as "firmware"):
+ *
+ *   ota_reloc_header_t   16 bytes
+ *   bitmap               bitmap_size bytes, bit n = payload word n
+ *   payload              image_size bytes, linked at link_address
+ *
+ * bitmap_size is a multiple of 4, so the payload starts word aligned in
+ * the stream and no patched word ever straddles two OTA chunks.
+ *
+ * Plain .bin files (first word = initial stack pointer) are still
+ * accepted and written unmodified.
+ */
+
+#ifndef INC_OTA_RELOC_H_
+#define INC_OTA_RELOC_H_
+
+#include <stdint.h>
+#include "boot_state.h"
+
+#define OTA_RELOC_MAGIC         0x434C4552  // "RELC"
+
+// One bit per 32-bit word of the largest bank
+#define OTA_RELOC_MAX_BITMAP    (SLOT_MAX_SIZE / 32)
+
+typedef struct {
+    uint32_t magic;          // OTA_RELOC_MAGIC
+    uint32_t link_address;   // Address the payload was linked for
+    uint32_t image_size;     // Payload size in bytes
+    uint32_t bitmap_size;    // Bitmap size in bytes (multiple of 4)
+} ota_reloc_header_t;  // 16 bytes
+
+// Largest stream START may announce: full bank plus header and bitmap
+#define OTA_MAX_STREAM_FOR(slot_size) \
+    ((slot_size) + sizeof(ota_reloc_header_t) + (slot_size) / 32)
+#define OTA_MAX_STREAM_SIZE     OTA_MAX_STREAM_FOR(SLOT_MAX_SIZE)
+
+// Streaming relocation state, one per transfer
+typedef struct {
+    uint8_t  active;         // 1 = stream is a relocatable container
+    ota_reloc_header_t header;
+    uint32_t prefix_size;    // sizeof(header) + bitmap_size
+    uint32_t target_address; // Bank the payload is programmed into
+    uint32_t delta;          // target_address - link_address (mod 2^32)
+    uint32_t words_patched;
+} ota_reloc_state_t;
+
+// Programs size bytes at a flash address; returns 0 on success
+typedef int (*ota_reloc_write_fn)(uint32_t address, const void *data, uint16_t size);
+
+/**
+ * @brief Reset relocation state for a new transfer
+ * @param st             State to reset
+ * @param target_address Bank the image will be programmed into
+ */
+void ota_reloc_init(ota_reloc_state_t *st, uint32_t target_address);
+
+/**
+ * @brief Feed one chunk of the incoming stream
+ * @param st            Relocation state
+ * @param stream_offset Offset of data within the transmitted stream
+ * @param data          Chunk data (word aligned length except the last chunk)
+ * @param size          Chunk size in bytes (<= OTA_CHUNK_SIZE)
+ * @param write         Flash write function used for payload bytes
+ * @return 0 on success, -1 on malformed container or write failure
+ *
+ * Chunks must be fed in order. Header and bitmap bytes are captured in
+ * RAM; payload bytes are rebased and written at target + payload offset.
+ */
+int ota_reloc_feed(ota_reloc_state_t *st, uint32_t stream_offset,
+                   const uint8_t *data, uint16_t size, ota_reloc_write_fn write);
+
+/**
+ * @brief CRC32 of the stream as transmitted, reconstructed from flash
+ * @param st Relocation state after the last chunk
+ * @return CRC32 (STM32 CRC unit) of header + bitmap + un-rebased payload
+ *
+ * Lets END compare against the CRC32 in the START packet even though
+ * flash now holds the rebased payload.
+ */
+uint32_t ota_reloc_stream_crc32(const ota_reloc_state_t *st);
+
+#endif /* INC_OTA_RELOC_H_ */
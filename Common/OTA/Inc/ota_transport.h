@@ -0,0 +1,52 @@
+/*
+ * ota_transport.h
+ *
+ * Byte-stream link under the OTA engine (ota_link.h). A transport moves
+ * bytes and nothing else; framing, the protocol and flash all live in
+ * the engine, which is written once against this interface.
+ *
+ * Both directions are non-blocking:
+ *
+ *   send()  queue up to size bytes; returns how many were taken (0 when
+ *           the driver's buffer is full), -1 if the link is down
+ *   recv()  copy out up to size received bytes; returns how many (0 when
+ *           nothing is waiting), -1 if the link is down
+ *
+ * A driver that can tell when data arrives (an RX interrupt, a USB
+ * callback) calls rx_ready(), which the engine sets at open; one that
+ * cannot sets polled and the engine calls recv() every millisecond.
+ *
+ * mtu and bytes_per_sec describe the link so the engine can size its
+ * writes and timeouts, and so links can be compared side by side;
+ * rx_window is how many packets the engine lets a sender queue up.
+ *
+ * Drivers:
+ *   ota_transport_uart.h   USART1/USART2, interrupt-driven (both images)
+ *   ota_transport_usb.h    USB CDC through the OTG HS host (application)
+ *   Host/ota_transport_fd  Linux pty and socketpair loopback (host bench)
+ */
+
+#ifndef INC_OTA_TRANSPORT_H_
+#define INC_OTA_TRANSPORT_H_
+
+#include <stdint.h>
+
+typedef struct ota_transport ota_transport_t;
+
+struct ota_transport {
+    const char *name;
+    uint16_t mtu;                   // Largest single send() (0 = no limit)
+    uint32_t bytes_per_sec;         // Nominal line rate (0 = unknown)
+    uint8_t polled;                 // No rx_ready(): poll recv() every ms
+    uint32_t rx_window;             // Bytes the driver buffers before it drops (0 = one packet)
+
+    int (*open)(ota_transport_t *t);
+    void (*close)(ota_transport_t *t);
+    int (*send)(ota_transport_t *t, const void *data, uint16_t size);
+    int (*recv)(ota_transport_t *t, void *buf, uint16_t size);
+
+    void (*rx_ready)(void);         // Set by the engine; may be called from an ISR
+    void *priv;                     // Driver state
+};
+
+#endif /* INC_OTA_TRANSPORT_H_ */
@@ -0,0 +1,79 @@
+/*
+ * ota_transport_uart.h
+ *
+ * OTA transport over a HAL UART, interrupt-driven in both directions:
+ * RXNE fills a receive ring and calls rx_ready(), TXE drains a transmit
+ * ring. The UART must already be initialised (MX_USARTx_UART_Init());
+ * open() only enables its interrupts.
+ *
+ * Declare one per UART with OTA_TRANSPORT_UART() and call
+ * ota_transport_uart_irq() from its IRQ handler:
+ *
+ *   OTA_TRANSPORT_UART(ota_usart2, "USART2", &huart2, USART2_IRQn);
+ *   void USART2_IRQHandler(void) { ota_transport_uart_irq(&ota_usart2); }
+ *
+ * If the UART is also the printf console (the bootloader's USART1),
+ * call ota_transport_uart_flush() before writing to it, so console text
+ * never lands in the middle of a response.
+ */
+
+#ifndef INC_OTA_TRANSPORT_UART_H_
+#define INC_OTA_TRANSPORT_UART_H_
+
+#include "ota_transport.h"
+#include "main.h"
+
+#define OTA_UART_RX_RING_SIZE   4096   // Power of 2; DATA packets a sender may queue (3)
+#define OTA_UART_TX_RING_SIZE   64     // Power of 2, a few responses
+
+typedef struct {
+    UART_HandleTypeDef *huart;
+    IRQn_Type irq;
+
+    uint8_t rx_ring[OTA_UART_RX_RING_SIZE];
+    volatile uint32_t rx_head;
+    volatile uint32_t rx_tail;
+    volatile uint32_t rx_overruns;  // Byte lost in the UART (ORE)
+    volatile uint32_t rx_dropped;   // Byte lost to a full ring
+
+    uint8_t tx_ring[OTA_UART_TX_RING_SIZE];
+    volatile uint32_t tx_head;
+    volatile uint32_t tx_tail;
+} ota_uart_port_t;
+
+int ota_transport_uart_open(ota_transport_t *t);
+void ota_transport_uart_close(ota_transport_t *t);
+int ota_transport_uart_send(ota_transport_t *t, const void *data, uint16_t size);
+int ota_transport_uart_recv(ota_transport_t *t, void *buf, uint16_t size);
+
+/* 10 bits per byte on the wire; the rate is read from the handle at open() */
+#define OTA_TRANSPORT_UART(var, label, handle, irqn)                        \
+    static ota_uart_port_t var##_port = { .huart = (handle), .irq = (irqn) }; \
+    ota_transport_t var = {                                                 \
+        .name = (label),                                                    \
+        .mtu = OTA_UART_TX_RING_SIZE,                                       \
+        .rx_window = OTA_UART_RX_RING_SIZE,                                 \
+        .open = ota_transport_uart_open,                                    \
+        .close = ota_transport_uart_close,                                  \
+        .send = ota_transport_uart_send,                                    \
+        .recv = ota_transport_uart_recv,                                    \
+        .priv = &var##_port,                                                \
+    }
+
+/**
+ * @brief The UART's interrupt (call from USARTx_IRQHandler)
+ */
+void ota_transport_uart_irq(ota_transport_t *t);
+
+/**
+ * @brief Wait until everything queued has gone out
+ * @return 0 once empty, -1 after timeout_ms
+ */
+int ota_transport_uart_flush(ota_transport_t *t, uint32_t timeout_ms);
+
+/**
+ * @brief Report and clear the receive error counters
+ */
+void ota_transport_uart_report(ota_transport_t *t);
+
+#endif /* INC_OTA_TRANSPORT_UART_H_ */
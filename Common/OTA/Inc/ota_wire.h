@@ -0,0 +1,192 @@
+/*
+ * ota_wire.h
+ *
+ * The packets of ota_protocol.h as one table: every field of every
+ * packet, with its offset, kind and size on the wire. Everything else
+ * that knows the layout comes from it:
+ *
+ *   - compile-time checks that each C struct has exactly these offsets,
+ *     field sizes and total size, so a reordered field or a lost
+ *     packed attribute stops the build instead of the link
+ *   - ota_wire_get_<packet>_<field>() / ota_wire_put_<packet>_<field>(),
+ *     little-endian accessors on a byte buffer at any alignment, for
+ *     code that looks into a packet before it is known to be whole
+ *   - ota_wire_layout.py, the struct formats, sizes and constants the
+ *     Python tools use, written from this file and ota_protocol.h by
+ *     ota_wire_gen.py (run it after changing either; --check tells
+ *     whether the checked-in module is current)
+ *
+ * The accessors assemble values byte by byte, which is the wire order on
+ * any host; GCC merges that into a single load or store on a
+ * little-endian target (LDR/STR on the Cortex-M4, which takes unaligned
+ * words), so they cost what a cast would.
+ *
+ * Kinds are u8, u16, u32 and bytes (an array, size in bytes). Fields
+ * are listed in wire order with no gaps; ota_wire_gen.py checks that.
+ * Valid C11 and C++.
+ */
+
+#ifndef INC_OTA_WIRE_H_
+#define INC_OTA_WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ota_protocol.h"
+
+// P(packet, C type, size on the wire)
+#define OTA_WIRE_PACKETS(P) \
+    P(start,    ota_start_packet_t,     22) \
+    P(data,     ota_data_packet_t,      15 + OTA_CHUNK_SIZE) \
+    P(symbol,   ota_symbol_packet_t,    25 + OTA_CHUNK_SIZE) \
+    P(end,      ota_end_packet_t,       5) \
+    P(response, ota_response_packet_t,  10) \
+    P(start_v2, ota_start_packet_v2_t,  24) \
+    P(data_v2,  ota_data_packet_v2_t,   16 + OTA_CHUNK_SIZE)
+
+// F(packet, field, offset, kind, size)
+#define OTA_WIRE_FIELDS(F) \
+    F(start,    magic,                0,    u32,   4) \
+    F(start,    packet_type,          4,    u8,    1) \
+    F(start,    firmware_size,        5,    u32,   4) \
+    F(start,    firmware_version,     9,    u32,   4) \
+    F(start,    firmware_crc32,       13,   u32,   4) \
+    F(start,    total_chunks,         17,   u32,   4) \
+    F(start,    target_bank,          21,   u8,    1) \
+    F(data,     magic,                0,    u32,   4) \
+    F(data,     packet_type,          4,    u8,    1) \
+    F(data,     chunk_number,         5,    u32,   4) \
+    F(data,     chunk_size,           9,    u16,   2) \
+    F(data,     chunk_crc32,          11,   u32,   4) \
+    F(data,     data,                 15,   bytes, OTA_CHUNK_SIZE) \
+    F(symbol,   magic,                0,    u32,   4) \
+    F(symbol,   packet_type,          4,    u8,    1) \
+    F(symbol,   firmware_size,        5,    u32,   4) \
+    F(symbol,   firmware_version,     9,    u32,   4) \
+    F(symbol,   firmware_crc32,       13,   u32,   4) \
+    F(symbol,   symbol_id,            17,   u32,   4) \
+    F(symbol,   data,                 21,   bytes, OTA_CHUNK_SIZE) \
+    F(symbol,   packet_crc32,         21 + OTA_CHUNK_SIZE, u32, 4) \
+    F(end,      magic,                0,    u32,   4) \
+    F(end,      packet_type,          4,    u8,    1) \
+    F(response, magic,                0,    u32,   4) \
+    F(response, packet_type,          4,    u8,    1) \
+    F(response, error_code,           5,    u8,    1) \
+    F(response, last_chunk_received,  6,    u32,   4) \
+    F(start_v2, magic,                0,    u32,   4) \
+    F(start_v2, packet_type,          4,    u8,    1) \
+    F(start_v2, target_bank,          5,    u8,    1) \
+    F(start_v2, reserved,             6,    u16,   2) \
+    F(start_v2, firmware_size,        8,    u32,   4) \
+    F(start_v2, firmware_version,     12,   u32,   4) \
+    F(start_v2, firmware_crc32,       16,   u32,   4) \
+    F(start_v2, total_chunks,         20,   u32,   4) \
+    F(data_v2,  magic,                0,    u32,   4) \
+    F(data_v2,  packet_type,          4,    u8,    1) \
+    F(data_v2,  reserved,             5,    u8,    1) \
+    F(data_v2,  chunk_size,           6,    u16,   2) \
+    F(data_v2,  chunk_number,         8,    u32,   4) \
+    F(data_v2,  chunk_crc32,          12,   u32,   4) \
+    F(data_v2,  data,                 16,   bytes, OTA_CHUNK_SIZE)
+
+/* ---- Byte order ---- */
+
+typedef uint8_t ota_wire_u8_t;
+typedef uint16_t ota_wire_u16_t;
+typedef uint32_t ota_wire_u32_t;
+typedef const uint8_t *ota_wire_bytes_t;
+
+static inline uint8_t ota_wire_get_u8(const uint8_t *p) {
+    return p[0];
+}
+
+static inline uint16_t ota_wire_get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t ota_wire_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static inline void ota_wire_put_u8(uint8_t *p, uint8_t v) {
+    p[0] = v;
+}
+
+static inline void ota_wire_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void ota_wire_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* ---- Layout checks ---- */
+
+#ifdef __cplusplus
+#define OTA_WIRE_ASSERT static_assert
+#else
+#define OTA_WIRE_ASSERT _Static_assert
+#endif
+
+#define OTA_WIRE_TYPEDEF(pkt, type, size) typedef type ota_wire_##pkt##_t;
+OTA_WIRE_PACKETS(OTA_WIRE_TYPEDEF)
+#undef OTA_WIRE_TYPEDEF
+
+#define OTA_WIRE_CHECK_PACKET(pkt, type, size) \
+    OTA_WIRE_ASSERT(sizeof(type) == (size), #type " is not its size on the wire");
+OTA_WIRE_PACKETS(OTA_WIRE_CHECK_PACKET)
+#undef OTA_WIRE_CHECK_PACKET
+
+#define OTA_WIRE_CHECK_FIELD(pkt, field, offset, kind, size) \
+    OTA_WIRE_ASSERT(offsetof(ota_wire_##pkt##_t, field) == (offset), \
+                    #pkt "." #field " is not at its wire offset"); \
+    OTA_WIRE_ASSERT(sizeof(((ota_wire_##pkt##_t *)0)->field) == (size), \
+                    #pkt "." #field " is not its wire size");
+OTA_WIRE_FIELDS(OTA_WIRE_CHECK_FIELD)
+#undef OTA_WIRE_CHECK_FIELD
+
+/* ---- Offsets and accessors ---- */
+
+// OTA_WIRE_AT(data, chunk_size): the field's offset in the packet
+#define OTA_WIRE_AT(pkt, field) ota_wire_##pkt##_##field##_at
+
+#define OTA_WIRE_OFFSET(pkt, field, offset, kind, size) OTA_WIRE_AT(pkt, field) = (offset),
+enum {
+    OTA_WIRE_FIELDS(OTA_WIRE_OFFSET)
+};
+#undef OTA_WIRE_OFFSET
+
+// A bytes field's getter returns where it starts; it has no setter
+static inline ota_wire_bytes_t ota_wire_get_bytes(const uint8_t *p) {
+    return p;
+}
+
+#define OTA_WIRE_GETTER(pkt, field, offset, kind, size) \
+    static inline ota_wire_##kind##_t ota_wire_get_##pkt##_##field(const uint8_t *p) { \
+        return ota_wire_get_##kind(p + (offset)); \
+    }
+OTA_WIRE_FIELDS(OTA_WIRE_GETTER)
+#undef OTA_WIRE_GETTER
+
+#define OTA_WIRE_SETTER_u8(pkt, field, offset) \
+    static inline void ota_wire_put_##pkt##_##field(uint8_t *p, uint8_t v) { \
+        ota_wire_put_u8(p + (offset), v); \
+    }
+#define OTA_WIRE_SETTER_u16(pkt, field, offset) \
+    static inline void ota_wire_put_##pkt##_##field(uint8_t *p, uint16_t v) { \
+        ota_wire_put_u16(p + (offset), v); \
+    }
+#define OTA_WIRE_SETTER_u32(pkt, field, offset) \
+    static inline void ota_wire_put_##pkt##_##field(uint8_t *p, uint32_t v) { \
+        ota_wire_put_u32(p + (offset), v); \
+    }
+#define OTA_WIRE_SETTER_bytes(pkt, field, offset)
+#define OTA_WIRE_SETTER(pkt, field, offset, kind, size) OTA_WIRE_SETTER_##kind(pkt, field, offset)
+OTA_WIRE_FIELDS(OTA_WIRE_SETTER)
+#undef OTA_WIRE_SETTER
+
+#endif /* INC_OTA_WIRE_H_ */
@@ -0,0 +1,124 @@
+/*
+ * sched.h
+ *
+ * Event loop for the bootloader and application: millisecond timers on a
+ * hashed timer wheel, a deferred work queue, and sleep (WFI) whenever
+ * neither has anything to do.
+ *
+ *   sched_timer_start()  run fn after delay_ms, then every period_ms (0 =
+ *                        one-shot). Timers live in the caller's storage;
+ *                        starting an armed timer re-arms it.
+ *   sched_post()         run fn once from the main loop as soon as
+ *                        possible. Safe from interrupts; this is how an
+ *                        ISR hands work to thread level.
+ *   sched_run()          dispatch forever, sleeping between events.
+ *
+ * Callbacks run to completion on the main stack, one at a time, so they
+ * need no locking against each other; anything long should be split into
+ * steps that re-post themselves.
+ *
+ * The core is HAL-free: time, cycle counting, interrupt masking and the
+ * sleep instruction come from sched_port.h, so the same sched.c builds on
+ * the host (Host/sched_sim.c).
+ *
+ * CPU accounting: every cycle outside sched_sleep() counts as busy
+ * (callbacks, ISRs, blocking code that has not been converted yet);
+ * utilisation is busy cycles over wall-clock time since the last report.
+ */
+
+#ifndef INC_SCHED_H_
+#define INC_SCHED_H_
+
+#include <stdint.h>
+
+#define SCHED_WHEEL_SLOTS   64  // Power of 2; one slot per ms
+#define SCHED_WORK_DEPTH    16  // Power of 2; pending sched_post() items
+
+typedef void (*sched_fn_t)(void *arg);
+
+typedef struct sched_timer {
+    struct sched_timer *next;   // Wheel bucket chain
+    sched_fn_t fn;
+    void *arg;
+    uint32_t expires;           // Absolute ms
+    uint32_t period;            // 0 = one-shot
+    uint8_t armed;
+} sched_timer_t;
+
+typedef struct {
+    uint32_t elapsed_ms;        // Wall-clock length of the window
+    uint32_t busy_ms;           // Time not spent in sched_sleep()
+    uint32_t busy_permille;
+    uint32_t wakeups;           // Sleeps that ended in an interrupt
+    uint32_t timers_fired;
+    uint32_t work_run;
+    uint32_t work_dropped;      // sched_post() with the queue full
+    uint32_t work_high_water;   // Deepest the work queue got
+    uint32_t longest_cycles;    // Longest single callback
+} sched_stats_t;
+
+/**
+ * @brief Reset timers, work queue and statistics
+ */
+void sched_init(void);
+
+/**
+ * @brief Set up a timer (does not arm it)
+ */
+void sched_timer_init(sched_timer_t *t, sched_fn_t fn, void *arg);
+
+/**
+ * @brief Arm a timer, re-arming it if it is already running
+ * @param delay_ms  First expiry, from now
+ * @param period_ms Repeat interval, 0 for one-shot
+ */
+void sched_timer_start(sched_timer_t *t, uint32_t delay_ms, uint32_t period_ms);
+
+/**
+ * @brief Disarm a timer; harmless if it is not running
+ */
+void sched_timer_stop(sched_timer_t *t);
+
+/**
+ * @brief Queue fn(arg) for the main loop (ISR-safe)
+ * @return 0 on success, -1 if the queue is full (counted as dropped)
+ */
+int sched_post(sched_fn_t fn, void *arg);
+
+/**
+ * @brief Run expired timers and queued work once
+ * @return Number of callbacks run
+ */
+uint32_t sched_run_once(void);
+
+/**
+ * @brief Sleep until the next interrupt unless work is already queued
+ *
+ * Also the building block for blocking waits (HAL_Delay() is routed
+ * here on target), so time spent waiting is counted as idle.
+ */
+void sched_sleep(void);
+
+/**
+ * @brief Dispatch timers and work forever, sleeping when idle
+ */
+void sched_run(void) __attribute__((noreturn));
+
+/**
+ * @brief Milliseconds until the next timer expires
+ * @return 0 if one is already due, UINT32_MAX if none is armed
+ */
+uint32_t sched_next_expiry(void);
+
+/**
+ * @brief Statistics since the last reset
+ * @param reset Non-zero to start a new window
+ */
+void sched_get_stats(sched_stats_t *stats, int reset);
+
+/**
+ * @brief Print and reset the statistics window
+ */
+void sched_report(void);
+
+#endif /* INC_SCHED_H_ */
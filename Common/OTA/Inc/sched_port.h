@@ -0,0 +1,51 @@
+/*
+ * sched_port.h
+ *
+ * What sched.c needs from the platform. sched_port.c implements it for
+ * the STM32 (HAL tick, DWT, PRIMASK, WFI); Host/sched_sim.c implements it
+ * over a simulated clock.
+ */
+
+#ifndef INC_SCHED_PORT_H_
+#define INC_SCHED_PORT_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Start whatever the cycle counter needs
+ */
+void sched_port_init(void);
+
+/**
+ * @brief Free-running millisecond tick
+ */
+uint32_t sched_port_now_ms(void);
+
+/**
+ * @brief Free-running cycle counter (wraps)
+ */
+uint32_t sched_port_cycles(void);
+
+/**
+ * @brief Cycle counter rate, for turning cycles into time
+ */
+uint32_t sched_port_cycles_per_ms(void);
+
+/**
+ * @brief Mask interrupts
+ * @return State to hand back to sched_port_irq_restore()
+ */
+uint32_t sched_port_irq_save(void);
+
+void sched_port_irq_restore(uint32_t state);
+
+/**
+ * @brief Sleep until an interrupt is pending
+ *
+ * Called with interrupts masked, so an interrupt that arrives between
+ * the caller's last check and the sleep still ends it; the handler runs
+ * once the caller restores the mask.
+ */
+void sched_port_wait(void);
+
+#endif /* INC_SCHED_PORT_H_ */
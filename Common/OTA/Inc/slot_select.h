@@ -0,0 +1,49 @@
+/*
+ * slot_select.h
+ *
+ * Slot ranking over the boot state slot table. Pure functions over
+ * boot_slot_t records (no HAL, no flash access), shared by the
+ * bootloader, the OTA manager and the host simulation in Host/.
+ *
+ * "Newest" is the bootable slot with the highest install sequence, so a
+ * deliberate downgrade is honoured like any other install. The OTA target
+ * is the least valuable slot that fits: an empty/invalid one if there is
+ * one, otherwise the oldest install.
+ */
+
+#ifndef INC_SLOT_SELECT_H_
+#define INC_SLOT_SELECT_H_
+
+#include <stdint.h>
+#include "boot_state.h"
+
+// Exclusion masks are one bit per slot
+#define SLOT_SELECT_MAX_SLOTS   32
+
+/**
+ * @brief Is this slot a boot candidate (VALID or TESTING)?
+ */
+int slot_is_bootable(const boot_slot_t *slot);
+
+/**
+ * @brief Pick the newest bootable slot in one pass
+ * @param slots     Slot table
+ * @param count     Entries in the table (<= SLOT_SELECT_MAX_SLOTS)
+ * @param skip_mask Bit i set = slot i already rejected
+ * @return Slot index, or -1 if nothing is left to try
+ */
+int slot_select_newest(const boot_slot_t *slots, uint32_t count, uint32_t skip_mask);
+
+/**
+ * @brief Pick the slot an update should overwrite
+ * @param slots     Slot table
+ * @param capacity  Largest stream each slot accepts, in bytes
+ * @param count     Entries in the table (<= SLOT_SELECT_MAX_SLOTS)
+ * @param skip_mask Bit i set = slot i must not be touched (e.g. running)
+ * @param size      Size of the incoming stream
+ * @return Slot index, or -1 if no slot fits
+ */
+int slot_select_target(const boot_slot_t *slots, const uint32_t *capacity, uint32_t count,
+                       uint32_t skip_mask, uint32_t size);
+
+#endif /* INC_SLOT_SELECT_H_ */
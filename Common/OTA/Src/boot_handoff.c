@@ -0,0 +1,111 @@
+/*
+ * boot_handoff.c
+ * Writing (bootloader) and adopting (application) the handoff block
+ */
+
+#include "boot_handoff.h"
+#include "main.h"
+#include <stddef.h>
+#include <string.h>
+
+#define HANDOFF ((boot_handoff_t*)BOOT_HANDOFF_ADDRESS)
+
+static uint32_t handoff_check(const boot_handoff_t *handoff) {
+    const uint32_t *words = (const uint32_t*)handoff;
+    uint32_t x = 0;
+
+    for (uint32_t i = 0; i < offsetof(boot_handoff_t, check) / 4; i++) {
+        x ^= words[i];
+    }
+    return ~x;
+}
+
+static uint32_t decode_reset_reason(uint32_t csr) {
+    // Several flags can be set at once (POR also sets PIN and BOR); the
+    // most specific one wins
+    if (csr & RCC_CSR_IWDGRSTF) return BOOT_REASON_WATCHDOG;
+    if (csr & RCC_CSR_SFTRSTF)  return BOOT_REASON_SOFTWARE;
+    if (csr & RCC_CSR_PORRSTF)  return BOOT_REASON_POWER_ON;
+    if (csr & RCC_CSR_BORRSTF)  return BOOT_REASON_BROWNOUT;
+    if (csr & RCC_CSR_PINRSTF)  return BOOT_REASON_PIN;
+    return BOOT_REASON_UNKNOWN;
+}
+
+uint32_t boot_handoff_begin(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    uint32_t csr = RCC->CSR;
+    RCC->CSR |= RCC_CSR_RMVF;
+
+    memset(HANDOFF, 0, sizeof(boot_handoff_t));  // magic = 0: invalid
+    HANDOFF->reset_flags = csr & 0xFE000000;
+    HANDOFF->boot_reason = decode_reset_reason(csr);
+    return HANDOFF->boot_reason;
+}
+
+void boot_handoff_set_slot(uint32_t slot, uint32_t slot_status, uint32_t trial_attempt) {
+    HANDOFF->slot = slot;
+    HANDOFF->slot_status = slot_status;
+    HANDOFF->trial_attempt = trial_attempt;
+}
+
+void boot_handoff_commit(uint32_t peripherals, uint32_t usart1_baud) {
+    boot_handoff_t *handoff = HANDOFF;
+    uint32_t cfgr = RCC->CFGR;
+
+    // From the registers, as the HAL_RCC_Get*Freq() calls would
+    SystemCoreClockUpdate();
+
+    handoff->version = BOOT_HANDOFF_VERSION;
+    handoff->size = sizeof(boot_handoff_t);
+    handoff->hclk_hz = SystemCoreClock;
+    handoff->sysclk_hz = SystemCoreClock << AHBPrescTable[(cfgr & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+    handoff->pclk1_hz = SystemCoreClock >> APBPrescTable[(cfgr & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+    handoff->pclk2_hz = SystemCoreClock >> APBPrescTable[(cfgr & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos];
+    handoff->rcc_pllcfgr = RCC->PLLCFGR;
+    handoff->rcc_cfgr = cfgr;
+    handoff->flash_acr = FLASH->ACR;
+    handoff->peripherals = peripherals;
+    handoff->usart1_baud = usart1_baud;
+    handoff->jump_cycles = DWT->CYCCNT;
+    handoff->magic = BOOT_HANDOFF_MAGIC;
+    handoff->check = handoff_check(handoff);
+}
+
+const boot_handoff_t *boot_handoff_get(void) {
+    const boot_handoff_t *handoff = HANDOFF;
+
+    if (handoff->magic != BOOT_HANDOFF_MAGIC || handoff->version != BOOT_HANDOFF_VERSION ||
+        handoff->size < sizeof(boot_handoff_t) || handoff->check != handoff_check(handoff)) {
+        return NULL;
+    }
+    return handoff;
+}
+
+int boot_handoff_adopt_clocks(const boot_handoff_t *handoff, uint32_t sysclk_hz) {
+    if (handoff == NULL || handoff->sysclk_hz != sysclk_hz) {
+        return -1;
+    }
+
+    // Only trust the description if the hardware still matches it
+    if (RCC->PLLCFGR != handoff->rcc_pllcfgr || RCC->CFGR != handoff->rcc_cfgr ||
+        FLASH->ACR != handoff->flash_acr || (RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) {
+        return -1;
+    }
+
+    SystemCoreClockUpdate();
+    return (HAL_InitTick(TICK_INT_PRIORITY) == HAL_OK) ? 0 : -1;
+}
+
+const char *boot_handoff_reason_name(uint32_t reason) {
+    switch (reason) {
+    case BOOT_REASON_POWER_ON: return "power-on";
+    case BOOT_REASON_PIN:      return "reset pin";
+    case BOOT_REASON_SOFTWARE: return "software";
+    case BOOT_REASON_WATCHDOG: return "watchdog";
+    case BOOT_REASON_BROWNOUT: return "brown-out";
+    default:                   return "unknown";
+    }
+}
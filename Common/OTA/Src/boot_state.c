@@ -0,0 +1,209 @@
+/*
+ * boot_state.c
+ *
+ *  Created on: Dec 29, 2025
+ *      Author: sean-shk
+ */
+#include "boot_state.h"
+#include "ota_crc.h"
+#include "ota_log.h"
+#include "main.h"
+#include <string.h>
+
+// Record and verdict words must share the boot state partition
+_Static_assert(sizeof(boot_state_t) <= BOOT_VERDICT_ADDRESS - BOOT_STATE_ADDRESS,
+               "boot state record overlaps the verdict words");
+_Static_assert(BOOT_VERDICT_ADDRESS + BOOT_MAX_SLOTS * 4 <= BOOT_ATTEMPTS_ADDRESS,
+               "verdict words overlap the attempt words");
+_Static_assert(BOOT_ATTEMPTS_ADDRESS + BOOT_MAX_SLOTS * 4 <= BOOT_CONFIRM_ADDRESS,
+               "attempt words overlap the confirm words");
+_Static_assert(BOOT_CONFIRM_ADDRESS + BOOT_MAX_SLOTS * 4 <= BOOT_STATE_ADDRESS + BOOT_STATE_SIZE,
+               "confirm words outside the boot state partition");
+_Static_assert(BOOT_TRIAL_MAX_ATTEMPTS <= 32, "attempts are counted in one word");
+
+static uint32_t calculate_crc32(const void *data, size_t length) {
+    return ota_crc_words((const uint32_t*)data, length / 4, 1);
+}
+
+/**
+ * @brief Read boot state from flash
+ * @param state Pointer to structure to fill
+ * @return 0 on success, -1 if invalid magic, -2 if CRC mismatch
+ */
+int boot_state_read(boot_state_t *state) {
+    // Step 1: Read from flash
+    memcpy(state, (void*)BOOT_STATE_ADDRESS, sizeof(boot_state_t));
+
+    // Step 2: Check magic number
+    if (state->magic_number != BOOT_STATE_MAGIC) {
+        return -1;  // Invalid or erased
+    }
+
+    // Step 3: Verify CRC32
+    uint32_t saved_crc = state->crc32;
+    state->crc32 = 0;
+    uint32_t calculated_crc = calculate_crc32(state, sizeof(boot_state_t));
+
+    OTA_LOG_DEBUG("  calculated CRC32: 0x%08lX\r\n", calculated_crc);
+
+    state->crc32 = saved_crc;  // Restore it
+
+    if (calculated_crc != saved_crc) {
+        return -2;  // Corrupted
+    }
+
+    return 0;  // Success!
+}
+
+int boot_state_write(const boot_state_t *state) {
+    // Create a local copy so we can calculate CRC without modifying input
+    boot_state_t state_copy;
+    memcpy(&state_copy, state, sizeof(boot_state_t));
+
+    // Calculate CRC32 (excluding the crc32 field itself)
+    state_copy.crc32 = 0;
+    state_copy.crc32 = calculate_crc32(&state_copy, sizeof(boot_state_t));
+
+    OTA_LOG_DEBUG("DEBUG: Writing to flash:\r\n");
+    OTA_LOG_DEBUG("  magic_number: 0x%08lX\r\n", state_copy.magic_number);
+    OTA_LOG_DEBUG("  active_slot: %lu\r\n", state_copy.active_slot);
+    for (uint32_t i = 0; i < BOOT_MAX_SLOTS; i++) {
+        const boot_slot_t *slot = &state_copy.slots[i];
+        if (slot->status == BANK_STATUS_INVALID && slot->sequence == 0) {
+            continue;
+        }
+        OTA_LOG_DEBUG("  slot %lu: status %lu, seq %lu, v0x%08lX, %lu bytes, CRC32 0x%08lX\r\n",
+                      i, slot->status, slot->sequence, slot->fw_version,
+                      slot->image_size, slot->image_crc32);
+    }
+    OTA_LOG_DEBUG("  CRC32: 0x%08lX\r\n", state_copy.crc32);
+
+    if (flash_program(BOOT_STATE_ADDRESS, &state_copy, sizeof(boot_state_t)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int boot_state_erase(void) {
+	// Erase the whole boot state partition (record + verdict words)
+	return flash_erase_partition(flash_partition_at(BOOT_STATE_ADDRESS), BOOT_STATE_SIZE);
+}
+
+/**
+ * @brief Empty record: every slot invalid, first install gets sequence 1
+ */
+void boot_state_init(boot_state_t *state) {
+    memset(state, 0, sizeof(boot_state_t));
+    state->magic_number = BOOT_STATE_MAGIC;
+    state->next_sequence = 1;
+}
+
+/**
+ * @brief Fold the per-slot verdict/trial words back into slot status
+ *
+ * Call before rewriting the record: the rewrite erases those words, so
+ * what they say has to survive in the record itself. A confirmed trial
+ * becomes VALID; a failed image or an exhausted trial becomes INVALID.
+ */
+void boot_state_settle(boot_state_t *state) {
+    for (uint32_t i = 0; i < BOOT_MAX_SLOTS; i++) {
+        boot_slot_t *slot = &state->slots[i];
+
+        if (slot->status == BANK_STATUS_INVALID) {
+            continue;
+        }
+        if (boot_state_get_verdict(i) == BOOT_VERDICT_FAILED) {
+            slot->status = BANK_STATUS_INVALID;
+        } else if (slot->status == BANK_STATUS_TESTING) {
+            if (boot_state_is_confirmed(i)) {
+                slot->status = BANK_STATUS_VALID;
+            } else if (boot_state_get_attempts(i) >= BOOT_TRIAL_MAX_ATTEMPTS) {
+                slot->status = BANK_STATUS_INVALID;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Read the cached verification verdict for a slot
+ * @return BOOT_VERDICT_NONE, BOOT_VERDICT_FAILED or the image fingerprint
+ */
+uint32_t boot_state_get_verdict(uint32_t slot) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return BOOT_VERDICT_FAILED;
+    }
+    return *(volatile uint32_t*)(BOOT_VERDICT_ADDRESS + slot * 4);
+}
+
+/**
+ * @brief Program the verdict word for a slot without erasing the sector
+ * @return 0 on success, -1 if the word can't take the new value
+ *
+ * Flash can only clear bits, so a verdict can go NONE -> fingerprint and
+ * anything -> FAILED, but a fingerprint is never rewritten.
+ */
+int boot_state_set_verdict(uint32_t slot, uint32_t verdict) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return -1;
+    }
+
+    uint32_t current = boot_state_get_verdict(slot);
+    if ((current & verdict) != verdict) {
+        return -1;
+    }
+    if (current == verdict) {
+        return 0;
+    }
+
+    return flash_program(BOOT_VERDICT_ADDRESS + slot * 4, &verdict, sizeof(verdict));
+}
+
+/**
+ * @brief Trial boots of a slot since the record was written
+ */
+uint32_t boot_state_get_attempts(uint32_t slot) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return BOOT_TRIAL_MAX_ATTEMPTS;
+    }
+    uint32_t word = *(volatile uint32_t*)(BOOT_ATTEMPTS_ADDRESS + slot * 4);
+    return 32 - __builtin_popcount(word);
+}
+
+/**
+ * @brief Count one more trial boot by clearing the lowest set bit
+ * @return 0 on success, -1 if the word is exhausted or can't be programmed
+ */
+int boot_state_add_attempt(uint32_t slot) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return -1;
+    }
+
+    uint32_t address = BOOT_ATTEMPTS_ADDRESS + slot * 4;
+    uint32_t word = *(volatile uint32_t*)address;
+    if (word == 0) {
+        return -1;
+    }
+
+    word &= word - 1;
+    return flash_program(address, &word, sizeof(word));
+}
+
+int boot_state_is_confirmed(uint32_t slot) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return 0;
+    }
+    return *(volatile uint32_t*)(BOOT_CONFIRM_ADDRESS + slot * 4) == BOOT_CONFIRMED;
+}
+
+int boot_state_set_confirmed(uint32_t slot) {
+    if (slot >= BOOT_MAX_SLOTS) {
+        return -1;
+    }
+    if (boot_state_is_confirmed(slot)) {
+        return 0;
+    }
+
+    uint32_t word = BOOT_CONFIRMED;
+    return flash_program(BOOT_CONFIRM_ADDRESS + slot * 4, &word, sizeof(word));
+}
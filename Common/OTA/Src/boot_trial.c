@@ -0,0 +1,79 @@
+/*
+ * boot_trial.c
+ * Trial boot accounting and the independent watchdog
+ */
+
+#include "boot_trial.h"
+#include "ota_log.h"
+#include "main.h"
+
+#define IWDG_KEY_RELOAD  0xAAAA
+#define IWDG_KEY_ACCESS  0x5555
+#define IWDG_KEY_START   0xCCCC
+#define IWDG_TICK_MS     8       // LSI 32 kHz / 256
+
+int boot_trial_begin(const boot_state_t *state, uint32_t slot) {
+    if (state->slots[slot].status != BANK_STATUS_TESTING || boot_state_is_confirmed(slot)) {
+        return 0;
+    }
+
+    uint32_t attempts = boot_state_get_attempts(slot);
+    if (attempts >= BOOT_TRIAL_MAX_ATTEMPTS) {
+        OTA_LOG_ERROR("Slot %lu: not confirmed after %lu trial boots, rolling back\r\n", slot, attempts);
+        boot_state_set_verdict(slot, BOOT_VERDICT_FAILED);
+        return -1;
+    }
+
+    if (boot_state_add_attempt(slot) != 0) {
+        OTA_LOG_ERROR("Slot %lu: could not record trial boot\r\n", slot);
+        return -1;
+    }
+
+    OTA_LOG_INFO("Slot %lu: trial boot %lu of %d, watchdog %d ms\r\n",
+                 slot, attempts + 1, BOOT_TRIAL_MAX_ATTEMPTS, BOOT_WATCHDOG_TIMEOUT_MS);
+    boot_watchdog_start(BOOT_WATCHDOG_TIMEOUT_MS);
+    return 0;
+}
+
+int boot_trial_confirm(void) {
+    int slot = flash_slot_index(SCB->VTOR);
+    boot_state_t state;
+
+    if (slot < 0 || boot_state_read(&state) != 0) {
+        return 0;
+    }
+    if (state.slots[slot].status != BANK_STATUS_TESTING || boot_state_is_confirmed(slot)) {
+        return 0;
+    }
+
+    if (boot_state_set_confirmed(slot) != 0) {
+        OTA_LOG_ERROR("ERROR: Could not confirm slot %d\r\n", slot);
+        return -1;
+    }
+
+    OTA_LOG_INFO("Slot %d confirmed\r\n", slot);
+    return 0;
+}
+
+void boot_watchdog_start(uint32_t timeout_ms) {
+    uint32_t reload = timeout_ms / IWDG_TICK_MS;
+    if (reload > IWDG_RLR_RL) {
+        reload = IWDG_RLR_RL;
+    }
+
+    // Keep the counter still while halted in the debugger
+    DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;
+
+    IWDG->KR = IWDG_KEY_START;             // Also starts the LSI
+    IWDG->KR = IWDG_KEY_ACCESS;
+    IWDG->PR = IWDG_PR_PR_2 | IWDG_PR_PR_1;  // /256
+    IWDG->RLR = reload;
+    while (IWDG->SR != 0) {
+        // Wait for PR/RLR to reach the LSI domain
+    }
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+void boot_watchdog_kick(void) {
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
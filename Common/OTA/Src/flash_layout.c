@@ -0,0 +1,209 @@
+/*
+ * flash_layout.c
+ * Runtime view of the partition table in flash_layout.h
+ */
+
+#include "flash_layout.h"
+#include "ota_config.h"
+#include "ota_log.h"
+#include "main.h"
+#include <string.h>
+
+#define PARTITION_ENTRY(p, label, slot) \
+    { label, PARTITION_ADDRESS(p), PARTITION_SIZE(p), p##_FIRST_SECTOR, p##_NUM_SECTORS, slot }
+
+const flash_partition_t flash_partitions[] = {
+    PARTITION_ENTRY(PART_BOOTLOADER, "bootloader", 0),
+    PARTITION_ENTRY(PART_BANK_A,     "bank A",     1),
+    PARTITION_ENTRY(PART_BANK_B,     "bank B",     1),
+    PARTITION_ENTRY(PART_BOOT_STATE, "boot state", 0),
+    PARTITION_ENTRY(PART_SLOT2,      "slot 2",     1),
+    PARTITION_ENTRY(PART_SLOT3,      "slot 3",     1),
+    PARTITION_ENTRY(PART_SLOT4,      "slot 4",     1),
+    PARTITION_ENTRY(PART_SLOT5,      "slot 5",     1),
+    PARTITION_ENTRY(PART_SLOT6,      "slot 6",     1),
+};
+
+const uint32_t flash_partition_count = sizeof(flash_partitions) / sizeof(flash_partitions[0]);
+
+// Slot index -> address, in the same order as the image slots above
+static const uint32_t slot_addresses[FLASH_NUM_SLOTS] = {
+    BANK_A_ADDRESS, BANK_B_ADDRESS, SLOT2_ADDRESS, SLOT3_ADDRESS,
+    SLOT4_ADDRESS, SLOT5_ADDRESS, SLOT6_ADDRESS,
+};
+
+const flash_partition_t *flash_partition_at(uint32_t address) {
+    for (uint32_t i = 0; i < flash_partition_count; i++) {
+        if (flash_partitions[i].address == address) {
+            return &flash_partitions[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t flash_slot_size(uint32_t address) {
+    const flash_partition_t *part = flash_partition_at(address);
+    return (part != NULL && part->image_slot) ? part->size : 0;
+}
+
+uint32_t flash_slot_address(uint32_t slot) {
+    return (slot < FLASH_NUM_SLOTS) ? slot_addresses[slot] : 0;
+}
+
+int flash_slot_index(uint32_t address) {
+    for (int i = 0; i < FLASH_NUM_SLOTS; i++) {
+        if (slot_addresses[i] == address) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if OTA_HAL_DRIVERS
+
+static void flash_unlock(void) {
+    HAL_FLASH_Unlock();
+}
+
+static void flash_lock(void) {
+    HAL_FLASH_Lock();
+}
+
+static int flash_program_word(uint32_t address, uint32_t word) {
+    return (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address, word) == HAL_OK) ? 0 : -1;
+}
+
+static int flash_erase_sectors(uint32_t first, uint32_t count, uint32_t *failed) {
+    FLASH_EraseInitTypeDef erase_config;
+    erase_config.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase_config.VoltageRange = FLASH_VOLTAGE_RANGE_3;  // 2.7V to 3.6V
+    erase_config.Sector = first;
+    erase_config.NbSectors = count;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase_config, failed);
+    HAL_FLASH_Lock();
+
+    return (status == HAL_OK) ? 0 : -1;
+}
+
+#else
+
+#define FLASH_SR_ERRORS (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | \
+                         FLASH_SR_PGPERR | FLASH_SR_PGSERR | FLASH_SR_RDERR)
+
+static void flash_unlock(void) {
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+static void flash_lock(void) {
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+// As the HAL: wait out the last operation, clear its flags, then set up
+// this one with x32 parallelism (2.7V to 3.6V)
+static void flash_begin(uint32_t cr) {
+    while (FLASH->SR & FLASH_SR_BSY) {
+    }
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_ERRORS;
+    FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB | FLASH_CR_SER | FLASH_CR_PG)) |
+                FLASH_CR_PSIZE_1 | cr;
+}
+
+static int flash_end(void) {
+    while (FLASH->SR & FLASH_SR_BSY) {
+    }
+    int status = (FLASH->SR & FLASH_SR_ERRORS) ? -1 : 0;
+    FLASH->CR &= ~(FLASH_CR_SNB | FLASH_CR_SER | FLASH_CR_PG);
+    return status;
+}
+
+static int flash_program_word(uint32_t address, uint32_t word) {
+    flash_begin(FLASH_CR_PG);
+    *(volatile uint32_t*)address = word;
+    __DSB();
+    return flash_end();
+}
+
+// Erased sectors may still sit in the ART caches; reset them, as
+// HAL_FLASHEx_Erase() does
+static void flash_flush_caches(void) {
+    if (FLASH->ACR & FLASH_ACR_ICEN) {
+        FLASH->ACR &= ~FLASH_ACR_ICEN;
+        FLASH->ACR |= FLASH_ACR_ICRST;
+        FLASH->ACR &= ~FLASH_ACR_ICRST;
+        FLASH->ACR |= FLASH_ACR_ICEN;
+    }
+    if (FLASH->ACR & FLASH_ACR_DCEN) {
+        FLASH->ACR &= ~FLASH_ACR_DCEN;
+        FLASH->ACR |= FLASH_ACR_DCRST;
+        FLASH->ACR &= ~FLASH_ACR_DCRST;
+        FLASH->ACR |= FLASH_ACR_DCEN;
+    }
+}
+
+static int flash_erase_sectors(uint32_t first, uint32_t count, uint32_t *failed) {
+    int status = 0;
+
+    flash_unlock();
+    for (uint32_t sector = first; sector < first + count && status == 0; sector++) {
+        // Bank 2's sectors 12-23 are numbered 16-27 in SNB
+        uint32_t snb = (sector < FLASH_SECTORS_PER_BANK) ? sector : sector + 4;
+
+        flash_begin(FLASH_CR_SER | (snb << FLASH_CR_SNB_Pos));
+        FLASH->CR |= FLASH_CR_STRT;
+        status = flash_end();
+        if (status != 0) {
+            *failed = sector;
+        }
+    }
+    flash_lock();
+    flash_flush_caches();
+
+    return status;
+}
+
+#endif /* OTA_HAL_DRIVERS */
+
+int flash_erase_partition(const flash_partition_t *part, uint32_t size) {
+    if (size == 0 || size > part->size) {
+        size = part->size;
+    }
+
+    // Count sectors until the data is covered
+    uint32_t num_sectors = 0;
+    uint32_t covered = 0;
+    while (covered < size) {
+        covered += FLASH_SECTOR_SIZE(part->first_sector + num_sectors);
+        num_sectors++;
+    }
+
+    OTA_LOG_INFO("Erasing %s: sectors %u-%lu (%lu KB)\r\n", part->name, part->first_sector,
+                 part->first_sector + num_sectors - 1, covered / 1024);
+
+    uint32_t sector_error = 0;
+    if (flash_erase_sectors(part->first_sector, num_sectors, &sector_error) != 0) {
+        OTA_LOG_ERROR("ERROR: Erase failed! Sector error: %lu\r\n", sector_error);
+        return -1;
+    }
+
+    return 0;
+}
+
+int flash_program(uint32_t address, const void *data, uint32_t size) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    int status = 0;
+
+    flash_unlock();
+    for (uint32_t offset = 0; offset < size && status == 0; offset += 4) {
+        uint32_t word = 0xFFFFFFFF;
+        memcpy(&word, bytes + offset, (size - offset < 4) ? size - offset : 4);
+        status = flash_program_word(address + offset, word);
+    }
+    flash_lock();
+
+    return status;
+}
@@ -0,0 +1,72 @@
+/*
+ * image_header.c
+ * Lookup, CRC and install-time patching of the image header
+ */
+
+#include "image_header.h"
+#include "boot_state.h"
+#include "ota_crc.h"
+#include "ota_log.h"
+#include "main.h"
+
+#define IMAGE_HEADER_TOOL_WORDS  7  // Words covered by header_crc32
+
+_Static_assert(IMAGE_HEADER_OFFSET + sizeof(image_header_t) <= BANK_A_SIZE &&
+               IMAGE_HEADER_OFFSET + sizeof(image_header_t) <= BANK_B_SIZE,
+               "image header does not fit in a slot");
+
+const image_header_t *image_header_get(uint32_t bank_address) {
+    const image_header_t *hdr = (const image_header_t*)(bank_address + IMAGE_HEADER_OFFSET);
+
+    if (hdr->magic != IMAGE_HEADER_MAGIC || hdr->header_size != sizeof(image_header_t)) {
+        return NULL;
+    }
+
+    if (ota_crc_words((const uint32_t*)hdr, IMAGE_HEADER_TOOL_WORDS, 1) != hdr->header_crc32) {
+        return NULL;
+    }
+
+    if (hdr->image_size < IMAGE_HEADER_OFFSET + sizeof(image_header_t) ||
+        hdr->image_size > flash_slot_size(bank_address)) {
+        return NULL;
+    }
+
+    return hdr;
+}
+
+int image_header_is_installed(const image_header_t *hdr, uint32_t bank_address) {
+    return hdr->install_address == bank_address &&
+           hdr->install_check == ~(hdr->install_address ^ hdr->install_crc32);
+}
+
+uint32_t image_crc32(uint32_t address, uint32_t size) {
+    uint32_t tail = IMAGE_HEADER_OFFSET + sizeof(image_header_t);
+
+    ota_crc_calculate(address, IMAGE_HEADER_OFFSET);
+    return ota_crc_accumulate(address + tail, size - tail);
+}
+
+int image_header_install(uint32_t bank_address) {
+    const image_header_t *hdr = image_header_get(bank_address);
+    if (hdr == NULL) {
+        return -1;
+    }
+
+    if (image_header_is_installed(hdr, bank_address)) {
+        return 0;
+    }
+
+    uint32_t words[3];
+    words[0] = bank_address;
+    words[1] = image_crc32(bank_address, hdr->image_size);
+    words[2] = ~(words[0] ^ words[1]);
+
+    // Erased in the .bin, so these program without an erase
+    uint32_t address = (uint32_t)&hdr->install_address;
+
+    if (flash_program(address, words, sizeof(words)) != 0) {
+        OTA_LOG_ERROR("ERROR: Program failed at 0x%08lX\r\n", address);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * ota_fec.c
+ * Parity repair of DATA packets (see ota_fec.h)
+ */
+
+#include "ota_fec.h"
+#include <string.h>
+
+static struct {
+    uint32_t group;             // Chunks per PARITY; 0 = FEC off
+    uint32_t first;             // First chunk of the group being collected
+    uint32_t present;           // Bit per chunk of the group: in acc
+    uint32_t held;              // Bit per chunk: in slot[] (a subset of present)
+    uint8_t partial;            // Chunks were written before tracking began
+    uint8_t gap;                // Position of the rebuilt chunk
+    uint8_t replay[OTA_FEC_MAX_GROUP];  // Positions to hand to the manager, in order
+    ota_data_packet_v2_t acc;      // XOR of the present chunks; then the rebuilt one
+    ota_data_packet_v2_t slot[OTA_FEC_MAX_GROUP - 1];  // By position - 1
+} fec;
+
+static ota_fec_stats_t stats;
+
+// A word at a time: v2 packets keep their data 8-byte aligned
+static void xor_into(uint8_t *dst, const uint8_t *src) {
+    uint32_t *d = (uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+
+    for (uint32_t i = 0; i < OTA_CHUNK_SIZE / 4; i++) {
+        d[i] ^= s[i];
+    }
+}
+
+static uint32_t popcount(uint32_t bits) {
+    uint32_t n = 0;
+    for (; bits != 0; bits &= bits - 1) {
+        n++;
+    }
+    return n;
+}
+
+/* Track the group holding the next chunk the manager wants */
+static void sync(const ota_context_t *ctx) {
+    uint32_t first = ctx->chunks_received - ctx->chunks_received % fec.group;
+
+    if (first == fec.first) {
+        return;
+    }
+    fec.first = first;
+    fec.held = 0;
+    fec.present = (1UL << (ctx->chunks_received - first)) - 1;
+    fec.partial = (fec.present != 0);
+    memset(fec.acc.data, 0, sizeof(fec.acc.data));
+}
+
+/* Give up on the held chunks; the sender will resend them */
+static void drop_held(void) {
+    for (uint32_t pos = 1; pos < fec.group; pos++) {
+        if (fec.held & (1UL << pos)) {
+            xor_into(fec.acc.data, fec.slot[pos - 1].data);
+        }
+    }
+    fec.present &= ~fec.held;
+    fec.held = 0;
+}
+
+static int chunk_intact(const ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    return pkt->magic == OTA_MAGIC_DATA &&
+           pkt->chunk_size != 0 && pkt->chunk_size <= OTA_CHUNK_SIZE &&
+           pkt->chunk_number * OTA_CHUNK_SIZE + pkt->chunk_size <= ctx->firmware_size &&
+           calculate_crc32(pkt->data, pkt->chunk_size) == pkt->chunk_crc32;
+}
+
+void ota_fec_reset(void) {
+    memset(&fec, 0, sizeof(fec));
+    memset(&stats, 0, sizeof(stats));
+}
+
+int ota_fec_data(const ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    if (fec.group == 0 || ctx->state != OTA_STATE_RECEIVING_DATA ||
+        pkt->chunk_number < ctx->chunks_received) {
+        return OTA_FEC_PASS;
+    }
+    sync(ctx);
+
+    uint32_t pos = pkt->chunk_number - fec.first;
+    if (pos >= fec.group) {
+        // The next group before this one's parity: the manager NACKs it
+        drop_held();
+        return OTA_FEC_PASS;
+    }
+
+    if (!chunk_intact(ctx, pkt)) {
+        return OTA_FEC_HOLD;    // Missing, as far as the parity is concerned
+    }
+    if (pkt->chunk_number == ctx->chunks_received) {
+        return OTA_FEC_PASS;    // In order and whole: the usual path
+    }
+
+    if (!(fec.present & (1UL << pos))) {
+        memcpy(&fec.slot[pos - 1], pkt, sizeof(*pkt));
+        xor_into(fec.acc.data, pkt->data);
+        fec.present |= 1UL << pos;
+        fec.held |= 1UL << pos;
+        stats.held++;
+    }
+    return OTA_FEC_HOLD;
+}
+
+void ota_fec_written(const ota_data_packet_v2_t *pkt) {
+    uint32_t pos = pkt->chunk_number - fec.first;
+
+    if (fec.group == 0 || pos >= fec.group) {
+        return;
+    }
+    // A resend can overtake the held copy, which is already in acc
+    if (!(fec.present & (1UL << pos))) {
+        xor_into(fec.acc.data, pkt->data);
+        fec.present |= 1UL << pos;
+    }
+    fec.held &= ~(1UL << pos);
+}
+
+int ota_fec_parity(const ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    uint32_t group = pkt->chunk_size;
+
+    if (ctx->state != OTA_STATE_RECEIVING_DATA) {
+        return 0;
+    }
+    if (group < 2 || group > OTA_FEC_MAX_GROUP || pkt->chunk_number % group != 0) {
+        return -1;
+    }
+    if (group != fec.group) {
+        // Switched on (or the sender changed its mind): start tracking
+        memset(&fec, 0, sizeof(fec));
+        fec.group = group;
+        fec.first = UINT32_MAX;
+    }
+    sync(ctx);
+
+    if (pkt->chunk_number != fec.first) {
+        return 0;               // A group already written, or not started
+    }
+    uint32_t count = ctx->total_chunks - fec.first;
+    if (count > group) {
+        count = group;
+    }
+    uint32_t missing = count - popcount(fec.present);
+    if (missing == 0) {
+        return 0;
+    }
+
+    if (missing > 1 || fec.partial ||
+        calculate_crc32(pkt->data, OTA_CHUNK_SIZE) != pkt->chunk_crc32) {
+        stats.unrepairable++;
+        drop_held();
+        return -1;
+    }
+
+    // Everything but the missing chunk is in acc
+    uint32_t gap = 0;
+    while (fec.present & (1UL << gap)) {
+        gap++;
+    }
+    uint32_t number = fec.first + gap;
+    uint32_t size = ctx->firmware_size - number * OTA_CHUNK_SIZE;
+    xor_into(fec.acc.data, pkt->data);
+    fec.acc.magic = OTA_MAGIC_DATA;
+    fec.acc.packet_type = OTA_PKT_DATA;
+    fec.acc.chunk_number = number;
+    fec.acc.chunk_size = (size > OTA_CHUNK_SIZE) ? OTA_CHUNK_SIZE : size;
+    fec.acc.chunk_crc32 = calculate_crc32(fec.acc.data, fec.acc.chunk_size);
+    fec.gap = gap;
+    stats.repaired++;
+
+    // The rest of the group in order: held chunks and the rebuilt one
+    uint32_t n = 0;
+    for (uint32_t pos = ctx->chunks_received - fec.first; pos < count; pos++) {
+        fec.replay[n++] = pos;
+    }
+    fec.held = 0;
+    return n;
+}
+
+const ota_data_packet_v2_t *ota_fec_replay(uint32_t i) {
+    uint32_t pos = fec.replay[i];
+    return (pos == fec.gap) ? &fec.acc : &fec.slot[pos - 1];
+}
+
+void ota_fec_get_stats(ota_fec_stats_t *out) {
+    *out = stats;
+}
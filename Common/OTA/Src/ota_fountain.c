@@ -0,0 +1,213 @@
+/*
+ * ota_fountain.c
+ * Broadcast updates from fountain-coded symbols (see ota_fountain.h)
+ */
+
+#include "ota_fountain.h"
+#include "ota_log.h"
+#include <stddef.h>
+#include <string.h>
+
+#define CHUNK_WORDS (OTA_CHUNK_SIZE / 4)
+
+#if OTA_FOUNTAIN_SEGMENT > 32
+#error "OTA_FOUNTAIN_SEGMENT is limited by the 32-bit symbol masks"
+#endif
+
+static struct {
+    uint8_t active;
+    uint32_t firmware_crc32;    // The image being received
+    uint32_t segment;           // Being decoded: the next to write
+    uint32_t chunks;            // In that segment
+    uint32_t rank;              // Rows held
+    uint32_t have;              // Bit per row held; row i has its lowest bit at i
+    uint32_t mask[OTA_FOUNTAIN_SEGMENT];
+    uint32_t data[OTA_FOUNTAIN_SEGMENT][CHUNK_WORDS];
+} fountain;
+
+static uint32_t scratch[CHUNK_WORDS];   // The symbol being reduced
+static ota_data_packet_v2_t out;        // A decoded chunk on its way to the manager
+static ota_fountain_stats_t stats;
+
+static void xor_words(uint32_t *dst, const uint32_t *src) {
+    for (uint32_t i = 0; i < CHUNK_WORDS; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+uint32_t ota_fountain_mask(uint32_t symbol_id, uint32_t chunks) {
+    uint32_t sequence = symbol_id & 0xFFFF;
+    if (sequence < chunks) {
+        return 1UL << sequence;
+    }
+
+    uint32_t all = (chunks >= 32) ? 0xFFFFFFFF : (1UL << chunks) - 1;
+    uint32_t x = symbol_id * 0x9E3779B1;
+    uint32_t mask;
+    if (x == 0) {
+        x = 1;
+    }
+    do {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        mask = x & all;
+    } while (mask == 0);
+    return mask;
+}
+
+/* Start on the segment holding the manager's next chunk */
+static void next_segment(const ota_context_t *ctx) {
+    fountain.segment = ctx->chunks_received / OTA_FOUNTAIN_SEGMENT;
+    fountain.chunks = ctx->total_chunks - fountain.segment * OTA_FOUNTAIN_SEGMENT;
+    if (fountain.chunks > OTA_FOUNTAIN_SEGMENT) {
+        fountain.chunks = OTA_FOUNTAIN_SEGMENT;
+    }
+    fountain.rank = 0;
+    fountain.have = 0;
+}
+
+/* Take a session's START from the first symbol heard */
+static void begin(ota_context_t *ctx, const ota_symbol_packet_t *pkt) {
+    if (pkt->firmware_size == 0 || pkt->firmware_size > OTA_MAX_STREAM_SIZE) {
+        return;
+    }
+    if (ota_image_recorded(pkt->firmware_version, pkt->firmware_crc32)) {
+        return;
+    }
+
+    ota_start_packet_t start = {
+        .magic = OTA_MAGIC_START,
+        .packet_type = OTA_PKT_START,
+        .firmware_size = pkt->firmware_size,
+        .firmware_version = pkt->firmware_version,
+        .firmware_crc32 = pkt->firmware_crc32,
+        .total_chunks = (pkt->firmware_size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE,
+        .target_bank = OTA_TARGET_AUTO,
+    };
+
+    OTA_LOG_INFO("Broadcast of a %lu byte image (CRC32 0x%08lX) heard\r\n",
+                 pkt->firmware_size, pkt->firmware_crc32);
+    fountain.active = 1;        // The START's response goes nowhere
+    ota_process_start_packet(ctx, &start);
+    if (ctx->state == OTA_STATE_ERROR) {
+        fountain.active = 0;
+        return;
+    }
+    fountain.firmware_crc32 = pkt->firmware_crc32;
+    next_segment(ctx);
+}
+
+/* Reduce the symbol against the rows held; keep it if anything is left */
+static void absorb(const ota_symbol_packet_t *pkt) {
+    uint32_t mask = ota_fountain_mask(pkt->symbol_id, fountain.chunks);
+
+    memcpy(scratch, pkt->data, OTA_CHUNK_SIZE);
+    for (uint32_t i = 0; i < fountain.chunks; i++) {
+        if ((mask & fountain.have) & (1UL << i)) {
+            mask ^= fountain.mask[i];
+            xor_words(scratch, fountain.data[i]);
+        }
+    }
+    if (mask == 0) {
+        stats.redundant++;
+        return;
+    }
+
+    uint32_t lead = 0;
+    while (!(mask & (1UL << lead))) {
+        lead++;
+    }
+    // Keep the rows reduced: no other row carries the new row's bit
+    for (uint32_t i = 0; i < fountain.chunks; i++) {
+        if ((fountain.have & (1UL << i)) && (fountain.mask[i] & (1UL << lead))) {
+            fountain.mask[i] ^= mask;
+            xor_words(fountain.data[i], scratch);
+        }
+    }
+    fountain.mask[lead] = mask;
+    memcpy(fountain.data[lead], scratch, OTA_CHUNK_SIZE);
+    fountain.have |= 1UL << lead;
+    fountain.rank++;
+    stats.innovative++;
+}
+
+/* A full-rank segment is its chunks, in order: write them */
+static void flush(ota_context_t *ctx) {
+    if (fountain.chunks == 0 || fountain.rank < fountain.chunks ||
+        ctx->state != OTA_STATE_RECEIVING_DATA) {
+        return;
+    }
+
+    uint32_t first = fountain.segment * OTA_FOUNTAIN_SEGMENT;
+    for (uint32_t i = 0; i < fountain.chunks; i++) {
+        uint32_t number = first + i;
+        uint32_t size = ctx->firmware_size - number * OTA_CHUNK_SIZE;
+
+        out.magic = OTA_MAGIC_DATA;
+        out.packet_type = OTA_PKT_DATA;
+        out.chunk_number = number;
+        out.chunk_size = (size > OTA_CHUNK_SIZE) ? OTA_CHUNK_SIZE : size;
+        memcpy(out.data, fountain.data[i], OTA_CHUNK_SIZE);
+        out.chunk_crc32 = calculate_crc32(out.data, out.chunk_size);
+        ota_process_data_packet(ctx, &out);
+        if (ctx->chunks_received != number + 1) {
+            OTA_LOG_ERROR("Broadcast: chunk %lu refused, giving up\r\n", number);
+            fountain.active = 0;
+            return;
+        }
+    }
+    stats.segments++;
+    next_segment(ctx);
+
+    if (ctx->state == OTA_STATE_VERIFYING) {
+        ota_end_packet_t end = { .magic = OTA_MAGIC_START, .packet_type = OTA_PKT_END };
+        ota_process_end_packet(ctx, &end);
+        if (ctx->state == OTA_STATE_ERROR) {
+            fountain.active = 0;
+        }
+    }
+}
+
+void ota_fountain_reset(void) {
+    memset(&fountain, 0, sizeof(fountain));
+    memset(&stats, 0, sizeof(stats));
+}
+
+int ota_fountain_active(void) {
+    return fountain.active;
+}
+
+void ota_fountain_symbol(ota_context_t *ctx, const ota_symbol_packet_t *pkt) {
+    if (calculate_crc32(pkt, offsetof(ota_symbol_packet_t, packet_crc32)) != pkt->packet_crc32) {
+        stats.bad_crc++;
+        return;
+    }
+    stats.symbols++;
+
+    if (!fountain.active) {
+        if (ctx->state != OTA_STATE_IDLE) {
+            return;             // A transfer of its own, or one that failed
+        }
+        begin(ctx, pkt);
+        if (!fountain.active) {
+            return;
+        }
+    }
+    if (pkt->firmware_crc32 != fountain.firmware_crc32) {
+        return;
+    }
+
+    // A segment decoded while the slot was still erasing goes now
+    flush(ctx);
+    if ((pkt->symbol_id >> 16) != fountain.segment || fountain.rank == fountain.chunks) {
+        stats.other_segment++;
+        return;
+    }
+    absorb(pkt);
+    flush(ctx);
+}
+
+void ota_fountain_get_stats(ota_fountain_stats_t *out_stats) {
+    *out_stats = stats;
+}
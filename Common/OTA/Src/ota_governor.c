@@ -0,0 +1,242 @@
+/*
+ * ota_governor.c
+ * CPU, flash-busy and erase-rate budgets for background OTA (see ota_governor.h)
+ */
+
+#include "ota_governor.h"
+#include "sched_port.h"
+#include "ota_log.h"
+#include <string.h>
+
+static const ota_gov_budget_t default_budget = {
+    .cpu_permille = OTA_GOV_CPU_PERMILLE,
+    .cpu_window_ms = OTA_GOV_CPU_WINDOW_MS,
+    .flash_busy_max_ms = OTA_GOV_FLASH_BUSY_MAX_MS,
+    .flash_rest_ms = OTA_GOV_FLASH_REST_MS,
+    .erase_per_sec = OTA_GOV_ERASE_PER_SEC,
+};
+
+static ota_gov_budget_t budget;
+static uint8_t active;              // No limits until ota_gov_init()
+
+// CPU token bucket, in cycles; negative while OTA owes time
+static int32_t tokens;
+static int32_t tokens_max;
+static uint32_t refill_per_ms;
+static uint32_t refill_ms;
+
+// Current run of flash work
+static uint32_t flash_run_ms;
+static uint32_t flash_end_ms;
+static uint32_t erase_start_ms;
+
+// Start times of the most recent erases
+static uint32_t erase_history[OTA_GOV_ERASE_HISTORY];
+static uint32_t erase_count;
+
+static ota_gov_stats_t stats;
+static uint64_t stats_cpu_cycles;
+static uint64_t stats_flash_cycles;
+static uint32_t stats_start_ms;
+
+static void refill(void) {
+    uint32_t now = sched_port_now_ms();
+    uint32_t elapsed = now - refill_ms;
+    refill_ms = now;
+
+    int64_t t = (int64_t)tokens + (int64_t)elapsed * refill_per_ms;
+    tokens = (t > tokens_max) ? tokens_max : (int32_t)t;
+}
+
+static int cpu_unlimited(void) {
+    return budget.cpu_permille >= 1000;
+}
+
+static void flash_run_add(uint32_t start_ms, uint32_t now, uint32_t busy_ms) {
+    // A long enough gap since the last flash work starts a new run
+    if ((int32_t)(start_ms - flash_end_ms) >= (int32_t)budget.flash_rest_ms) {
+        flash_run_ms = 0;
+    }
+    flash_run_ms += busy_ms;
+    flash_end_ms = now;
+
+    if (flash_run_ms > stats.longest_flash_run_ms) {
+        stats.longest_flash_run_ms = flash_run_ms;
+    }
+}
+
+// Milliseconds until the current flash run has rested, 0 if it need not
+static uint32_t flash_rest_due(void) {
+    uint32_t since = sched_port_now_ms() - flash_end_ms;
+
+    if (flash_run_ms < budget.flash_busy_max_ms || since >= budget.flash_rest_ms) {
+        return 0;
+    }
+    return budget.flash_rest_ms - since;
+}
+
+// Milliseconds until another erase fits in the rate, 0 if it does now
+static uint32_t erase_due(void) {
+    if (budget.erase_per_sec == 0 || erase_count < budget.erase_per_sec) {
+        return 0;
+    }
+
+    uint32_t oldest = erase_history[(erase_count - budget.erase_per_sec) % OTA_GOV_ERASE_HISTORY];
+    uint32_t since = sched_port_now_ms() - oldest;
+    return (since >= 1000) ? 0 : 1000 - since;
+}
+
+// Milliseconds until the bucket is back above zero
+static uint32_t cpu_due(void) {
+    if (cpu_unlimited() || tokens >= 0) {
+        return 0;
+    }
+    return (uint32_t)(-(int64_t)tokens / refill_per_ms) + 1;
+}
+
+void ota_gov_init(const ota_gov_budget_t *b) {
+    budget = (b != NULL) ? *b : default_budget;
+    if (budget.erase_per_sec > OTA_GOV_ERASE_HISTORY) {
+        budget.erase_per_sec = OTA_GOV_ERASE_HISTORY;
+    }
+
+    uint32_t cycles_per_ms = sched_port_cycles_per_ms();
+    refill_per_ms = (uint32_t)((uint64_t)cycles_per_ms * budget.cpu_permille / 1000);
+    if (refill_per_ms == 0) {
+        refill_per_ms = 1;
+    }
+    tokens_max = (int32_t)((uint64_t)refill_per_ms * budget.cpu_window_ms);
+    tokens = tokens_max;
+    refill_ms = sched_port_now_ms();
+
+    flash_run_ms = 0;
+    flash_end_ms = refill_ms - budget.flash_rest_ms;
+    erase_count = 0;
+
+    ota_gov_get_stats(NULL, 1);
+    active = 1;
+
+    OTA_LOG_INFO("OTA budget: %u.%u%% CPU (%u ms burst), flash runs %u ms + %u ms rest, %u erases/s\r\n",
+                 budget.cpu_permille / 10, budget.cpu_permille % 10, budget.cpu_window_ms,
+                 budget.flash_busy_max_ms, budget.flash_rest_ms, budget.erase_per_sec);
+}
+
+uint32_t ota_gov_begin(void) {
+    return sched_port_cycles();
+}
+
+void ota_gov_end_cpu(uint32_t start) {
+    uint32_t cycles = sched_port_cycles() - start;
+
+    refill();
+    int64_t t = (int64_t)tokens - cycles;
+    tokens = (t < INT32_MIN) ? INT32_MIN : (int32_t)t;
+    stats_cpu_cycles += cycles;
+}
+
+void ota_gov_end_flash(uint32_t start) {
+    uint32_t cycles = sched_port_cycles() - start;
+    uint32_t busy_ms = cycles / sched_port_cycles_per_ms();
+    uint32_t now = sched_port_now_ms();
+
+    flash_run_add(now - busy_ms, now, busy_ms);
+    stats_flash_cycles += cycles;
+}
+
+void ota_gov_erase_begin(void) {
+    erase_start_ms = sched_port_now_ms();
+    erase_history[erase_count % OTA_GOV_ERASE_HISTORY] = erase_start_ms;
+    erase_count++;
+    stats.erases++;
+}
+
+void ota_gov_erase_end(void) {
+    uint32_t now = sched_port_now_ms();
+    uint32_t busy_ms = now - erase_start_ms;
+
+    flash_run_add(erase_start_ms, now, busy_ms);
+    stats_flash_cycles += (uint64_t)busy_ms * sched_port_cycles_per_ms();
+}
+
+int ota_gov_admit(int needs_flash) {
+    if (!active) {
+        return 1;
+    }
+    refill();
+
+    if (cpu_due() != 0) {
+        stats.throttled[OTA_GOV_CPU]++;
+    } else if (needs_flash && flash_rest_due() != 0) {
+        stats.throttled[OTA_GOV_FLASH]++;
+    } else {
+        return 1;
+    }
+
+    stats.busy_nacks++;
+    return 0;
+}
+
+uint32_t ota_gov_flash_delay(int erase) {
+    if (!active) {
+        return 0;
+    }
+    refill();
+
+    uint32_t cpu = cpu_due();
+    uint32_t rest = flash_rest_due();
+    uint32_t rate = erase ? erase_due() : 0;
+
+    // Count the limit that holds the work back longest
+    uint32_t delay = cpu;
+    ota_gov_limit_t limit = OTA_GOV_CPU;
+    if (rest > delay) {
+        delay = rest;
+        limit = OTA_GOV_FLASH;
+    }
+    if (rate > delay) {
+        delay = rate;
+        limit = OTA_GOV_ERASE;
+    }
+
+    if (delay != 0) {
+        stats.throttled[limit]++;
+        stats.deferred_ms += delay;
+    }
+    return delay;
+}
+
+void ota_gov_get_stats(ota_gov_stats_t *out, int reset) {
+    uint32_t cycles_per_ms = sched_port_cycles_per_ms();
+    uint32_t now = sched_port_now_ms();
+
+    stats.elapsed_ms = now - stats_start_ms;
+    stats.cpu_ms = (uint32_t)(stats_cpu_cycles / cycles_per_ms);
+    stats.flash_ms = (uint32_t)(stats_flash_cycles / cycles_per_ms);
+
+    if (out != NULL) {
+        *out = stats;
+    }
+
+    if (reset) {
+        memset(&stats, 0, sizeof(stats));
+        stats_cpu_cycles = 0;
+        stats_flash_cycles = 0;
+        stats_start_ms = now;
+    }
+}
+
+void ota_gov_report(void) {
+    ota_gov_stats_t s;
+    ota_gov_get_stats(&s, 1);
+
+    if (s.cpu_ms == 0 && s.flash_ms == 0 && s.busy_nacks == 0) {
+        return;
+    }
+
+    uint32_t share = s.elapsed_ms ? s.cpu_ms * 1000 / s.elapsed_ms : 0;
+    OTA_LOG_INFO("OTA: %lu.%lu%% CPU, flash busy %lu ms (longest run %lu ms), %lu erases\r\n",
+                 share / 10, share % 10, s.flash_ms, s.longest_flash_run_ms, s.erases);
+    OTA_LOG_INFO("OTA throttled: cpu %lu, flash %lu, erase %lu; %lu BUSY NACKs, flash held %lu ms\r\n",
+                 s.throttled[OTA_GOV_CPU], s.throttled[OTA_GOV_FLASH], s.throttled[OTA_GOV_ERASE],
+                 s.busy_nacks, s.deferred_ms);
+}
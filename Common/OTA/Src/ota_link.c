@@ -0,0 +1,691 @@
+/*
+ * ota_link.c
+ * OTA packets over any transport (see ota_link.h).
+ *
+ * transport -> rx_task (event loop) -> packet framer -> ota_manager,
+ * and ota_send_response() -> ota_link_send() -> transport. Nothing here
+ * touches a peripheral, so the same file runs in the bootloader, the
+ * application and the host benchmark.
+ */
+
+#include "ota_link.h"
+#include "ota_protocol.h"
+#include "ota_wire.h"
+#include "ota_governor.h"
+#include "ota_fec.h"
+#include "ota_fountain.h"
+#include "flash_layout.h"
+#include "sched.h"
+#include "sched_port.h"
+#include "ota_log.h"
+#include <stddef.h>
+#include <string.h>
+
+static ota_transport_t *link;
+static ota_context_t *ota;
+static void (*complete_cb)(void);
+
+static volatile uint8_t rx_task_posted;
+static volatile uint32_t rx_signal_tick;   // When rx_ready() posted rx_task
+static sched_timer_t poll_timer;
+static ota_link_stats_t stats;
+
+// Packet being framed
+// The largest; aligned so a v2 DATA packet's data can be read where it lies
+static uint8_t packet[sizeof(ota_symbol_packet_t)] __attribute__((aligned(8)));
+static uint32_t packet_len;
+static uint32_t packet_tick;    // When its last bytes were read
+static uint32_t packet_pause;   // Longest wait for its next bytes so far
+
+/* Stalled-packet gap, learnt as TCP learns its RTO: the longest pause
+   inside each packet that comes through whole is smoothed (gap_srtt, ms
+   << 3) with its mean deviation (gap_rttvar, ms << 2), and a partial
+   packet is given up after srtt + 4 * rttvar of silence. Each stall
+   doubles the gap until a packet comes through whole; gap_max_ms bounds
+   it, and holds until the first sample. */
+static uint32_t gap_srtt;
+static uint32_t gap_rttvar;
+static uint32_t gap_samples;
+static uint32_t gap_backoff;
+static uint32_t gap_max_ms;
+static uint32_t packet_gap_ms;
+static sched_timer_t stall_timer;
+
+// While a parity repair replays chunks, the manager's responses land
+// here and only the last goes out
+static uint8_t replaying;
+static ota_response_packet_t replay_response;
+
+/* ---- Stalled-packet gap ---- */
+
+static void gap_update(void) {
+    uint32_t gap = gap_max_ms;
+
+    if (gap_samples != 0) {
+        gap = (gap_srtt >> 3) + gap_rttvar;
+        if (gap < OTA_LINK_GAP_MIN_MS) {
+            gap = OTA_LINK_GAP_MIN_MS;
+        }
+        for (uint32_t i = 0; i < gap_backoff && gap < gap_max_ms; i++) {
+            gap <<= 1;
+        }
+        if (gap > gap_max_ms) {
+            gap = gap_max_ms;
+        }
+    }
+    packet_gap_ms = gap;
+}
+
+/* A packet came through whole after waiting pause_ms at most for its bytes */
+static void gap_sample(uint32_t pause_ms) {
+    if (gap_samples++ == 0) {
+        gap_srtt = pause_ms << 3;
+        gap_rttvar = pause_ms << 1;
+    } else {
+        int32_t err = (int32_t)pause_ms - (int32_t)(gap_srtt >> 3);
+        gap_srtt += err;
+        if (err < 0) {
+            err = -err;
+        }
+        gap_rttvar += err - (gap_rttvar >> 2);
+    }
+    gap_backoff = 0;
+    gap_update();
+}
+
+/* ---- Framing ---- */
+
+static uint32_t packet_length(uint8_t packet_type) {
+    switch (packet_type) {
+        case OTA_PKT_START: return sizeof(ota_start_packet_t);
+        case OTA_PKT_DATA:  return sizeof(ota_data_packet_t);
+        case OTA_PKT_PARITY: return sizeof(ota_data_packet_t);
+        case OTA_PKT_END:   return sizeof(ota_end_packet_t);
+        case OTA_PKT_ABORT: return 5;
+        case OTA_PKT_SYMBOL: return sizeof(ota_symbol_packet_t);
+        case OTA_PKT_START_V2: return sizeof(ota_start_packet_v2_t);
+        case OTA_PKT_DATA_V2: return sizeof(ota_data_packet_v2_t);
+        case OTA_PKT_PARITY_V2: return sizeof(ota_data_packet_v2_t);
+        default:            return 0;
+    }
+}
+
+/* Could the n bytes at p still be the start of a packet? The magic must
+   suit the type, and the size field of the long packets is checked as
+   soon as it is in, so a false start is dropped before the framer waits
+   on a kilobyte of body for it */
+static int prefix_valid(const uint8_t *p, uint32_t n) {
+    static const uint32_t magics[] = { OTA_MAGIC_START, OTA_MAGIC_DATA };
+    uint32_t m;
+
+    for (m = 0; m < 2; m++) {
+        if (memcmp(p, &magics[m], (n < 4) ? n : 4) == 0) {
+            break;
+        }
+    }
+    if (m == 2) {
+        return 0;
+    }
+    if (n < 5) {
+        return 1;
+    }
+
+    switch (p[4]) {
+        case OTA_PKT_START:
+        case OTA_PKT_START_V2:
+        case OTA_PKT_END:
+            return magics[m] == OTA_MAGIC_START;
+        case OTA_PKT_ABORT:
+            return 1;
+        case OTA_PKT_DATA:
+        case OTA_PKT_PARITY:
+        case OTA_PKT_DATA_V2:
+        case OTA_PKT_PARITY_V2: {
+            uint32_t at = (p[4] & OTA_PKT_V2) ? OTA_WIRE_AT(data_v2, chunk_size)
+                                              : OTA_WIRE_AT(data, chunk_size);
+            uint16_t size;
+            if (magics[m] != OTA_MAGIC_DATA) {
+                return 0;
+            }
+            if (n < at + sizeof(size)) {
+                return 1;
+            }
+            size = ota_wire_get_u16(p + at);
+            return size != 0 &&
+                   size <= (((p[4] & ~OTA_PKT_V2) == OTA_PKT_DATA) ? OTA_CHUNK_SIZE : OTA_FEC_MAX_GROUP);
+        }
+        case OTA_PKT_SYMBOL: {
+            uint32_t size;
+            if (magics[m] != OTA_MAGIC_DATA) {
+                return 0;
+            }
+            if (n < OTA_WIRE_AT(symbol, firmware_version)) {
+                return 1;
+            }
+            size = ota_wire_get_symbol_firmware_size(p);
+            return size != 0 && size <= OTA_MAX_STREAM_SIZE;
+        }
+        default:
+            return 0;
+    }
+}
+
+/* Does the whole frame pass the check its packet type carries? */
+static int frame_intact(void) {
+    const ota_data_packet_t *data = (const ota_data_packet_t *)packet;
+    const ota_data_packet_v2_t *data_v2 = (const ota_data_packet_v2_t *)packet;
+    const ota_symbol_packet_t *symbol = (const ota_symbol_packet_t *)packet;
+
+    switch (packet[4]) {
+        case OTA_PKT_DATA:
+            return calculate_crc32(data->data, data->chunk_size) == data->chunk_crc32;
+        case OTA_PKT_PARITY:
+            return calculate_crc32(data->data, OTA_CHUNK_SIZE) == data->chunk_crc32;
+        case OTA_PKT_DATA_V2:
+            return calculate_crc32(data_v2->data, data_v2->chunk_size) == data_v2->chunk_crc32;
+        case OTA_PKT_PARITY_V2:
+            return calculate_crc32(data_v2->data, OTA_CHUNK_SIZE) == data_v2->chunk_crc32;
+        case OTA_PKT_SYMBOL:
+            return calculate_crc32(symbol, offsetof(ota_symbol_packet_t, packet_crc32)) ==
+                   symbol->packet_crc32;
+        default:
+            return 1;
+    }
+}
+
+/* Where a packet start shows up inside the frame, or 0 */
+static uint32_t next_start(void) {
+    for (uint32_t off = 1; off < packet_len; off++) {
+        if (prefix_valid(packet + off, packet_len - off)) {
+            return off;
+        }
+    }
+    return 0;
+}
+
+/* Drop n bytes from the front of the frame */
+static void skip(uint32_t n) {
+    memmove(packet, packet + n, packet_len - n);
+    packet_len -= n;
+    stats.resync_bytes += n;
+}
+
+static void send_nack(uint8_t error_code) {
+    ota->error_code = error_code;
+    ota_send_response(ota, OTA_PKT_NACK);
+}
+
+// Refused for now, not failed: the error code does not stick to later ACKs
+static void send_busy(void) {
+    send_nack(OTA_ERR_BUSY);
+    ota->error_code = OTA_ERR_NONE;
+}
+
+/* Packets that cost real work wait for the governor; one sent in the
+   wrong state goes through so the manager reports the error */
+static int admitted(uint8_t packet_type) {
+    if ((packet_type == OTA_PKT_DATA || packet_type == OTA_PKT_PARITY ||
+         packet_type == OTA_PKT_SYMBOL) && ota->state == OTA_STATE_RECEIVING_DATA) {
+        return ota_gov_admit(!ota->staging);
+    }
+    if (packet_type == OTA_PKT_END && ota->state == OTA_STATE_VERIFYING) {
+        return ota_gov_admit(0);
+    }
+    return 1;
+}
+
+static void handle_start(const ota_start_packet_t *pkt) {
+    /* A sender of its own takes over from any broadcast, and hears why
+       if the manager cannot start yet */
+    ota_fountain_reset();
+
+    if (ota->state == OTA_STATE_ERASING || ota->state == OTA_STATE_FINALIZING ||
+        ota->state == OTA_STATE_COMPLETE) {
+        OTA_LOG_ERROR("START ignored: previous update still %s\r\n",
+                      ota->state == OTA_STATE_COMPLETE ? "waiting to activate" : "writing flash");
+        send_nack(OTA_ERR_SEQUENCE);
+        return;
+    }
+
+    /* --- Validate firmware_size and total_chunks --- */
+    uint32_t expected_chunks = (pkt->firmware_size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
+    if (pkt->firmware_size == 0 || pkt->firmware_size > OTA_MAX_STREAM_SIZE ||
+        pkt->total_chunks != expected_chunks) {
+        OTA_LOG_ERROR("Invalid START: %lu bytes in %lu chunks\r\n", pkt->firmware_size, pkt->total_chunks);
+        send_nack(OTA_ERR_SIZE);
+        return;
+    }
+
+    /* --- Validate target slot (the manager rejects the running one) --- */
+    if (pkt->target_bank >= FLASH_NUM_SLOTS && pkt->target_bank != OTA_TARGET_AUTO) {
+        OTA_LOG_ERROR("Invalid target slot: 0x%02X\r\n", pkt->target_bank);
+        send_nack(OTA_ERR_SEQUENCE);
+        return;
+    }
+
+    /* A fresh START restarts a transfer the sender has given up on */
+    if (ota->state != OTA_STATE_IDLE) {
+        OTA_LOG_INFO("Restarting OTA transfer\r\n");
+        ota_init(ota);
+    }
+    ota_fec_reset();
+    ota_process_start_packet(ota, pkt);
+}
+
+static void handle_data(const ota_data_packet_v2_t *pkt) {
+    if (ota_fec_data(ota, pkt) == OTA_FEC_HOLD) {
+        ota_send_response(ota, OTA_PKT_ACK);
+        return;
+    }
+
+    uint32_t before = ota->chunks_received;
+    ota_process_data_packet(ota, pkt);
+    if (ota->chunks_received != before) {
+        ota_fec_written(pkt);
+    }
+}
+
+/* Rebuild the group's missing chunk and write it and the held ones */
+static void handle_parity(const ota_data_packet_v2_t *pkt) {
+    int count = ota_fec_parity(ota, pkt);
+
+    if (count < 0) {
+        send_nack(OTA_ERR_SEQUENCE);
+        return;
+    }
+    if (count == 0) {
+        ota_send_response(ota, OTA_PKT_ACK);
+        return;
+    }
+
+    OTA_LOG_DEBUG("FEC: group at chunk %lu repaired from parity\r\n", pkt->chunk_number);
+    replaying = 1;
+    for (int i = 0; i < count; i++) {
+        uint32_t before = ota->chunks_received;
+        ota_process_data_packet(ota, ota_fec_replay(i));
+        if (ota->chunks_received == before) {
+            break;              // Its NACK is the answer
+        }
+    }
+    replaying = 0;
+    ota_link_send(&replay_response, sizeof(replay_response));
+}
+
+/* A v1 DATA or PARITY packet in the v2 layout the engine reads by the word */
+static const ota_data_packet_v2_t *realign(void) {
+    static ota_data_packet_v2_t out;    // 1 KB, kept off the stack
+    const ota_data_packet_t *in = (const ota_data_packet_t *)packet;
+
+    out.magic = in->magic;
+    out.packet_type = in->packet_type;
+    out.reserved = 0;
+    out.chunk_size = in->chunk_size;
+    out.chunk_number = in->chunk_number;
+    out.chunk_crc32 = in->chunk_crc32;
+    memcpy(out.data, in->data, OTA_CHUNK_SIZE);
+    return &out;
+}
+
+static void start_v2(void) {
+    const ota_start_packet_v2_t *in = (const ota_start_packet_v2_t *)packet;
+    ota_start_packet_t pkt = {
+        .magic = in->magic,
+        .packet_type = OTA_PKT_START,
+        .firmware_size = in->firmware_size,
+        .firmware_version = in->firmware_version,
+        .firmware_crc32 = in->firmware_crc32,
+        .total_chunks = in->total_chunks,
+        .target_bank = in->target_bank,
+    };
+
+    OTA_LOG_INFO("START in the v2 layout\r\n");
+    handle_start(&pkt);
+}
+
+static void dispatch(void) {
+    uint8_t type = packet[4] & ~OTA_PKT_V2;
+    uint32_t cycles = sched_port_cycles();
+
+    stats.packets++;
+    if (packet[4] & OTA_PKT_V2) {
+        stats.v2_packets++;
+    }
+
+    if (!admitted(type)) {
+        if (type != OTA_PKT_SYMBOL) {
+            send_busy();        // A broadcaster hears nothing; a later pass covers it
+        }
+        return;
+    }
+
+    // A broadcast owns the manager until a START or ABORT takes it back
+    if (ota_fountain_active() && type != OTA_PKT_SYMBOL &&
+        type != OTA_PKT_START && type != OTA_PKT_ABORT) {
+        return;
+    }
+
+    switch (packet[4]) {
+        case OTA_PKT_START: {
+            ota_start_packet_t pkt;
+            memcpy(&pkt, packet, sizeof(pkt));
+            handle_start(&pkt);
+            break;
+        }
+
+        case OTA_PKT_START_V2:
+            start_v2();
+            break;
+
+        case OTA_PKT_DATA:
+            handle_data(realign());
+            break;
+
+        case OTA_PKT_PARITY:
+            handle_parity(realign());
+            break;
+
+        // Already aligned: read in place
+        case OTA_PKT_DATA_V2:
+            handle_data((const ota_data_packet_v2_t *)packet);
+            break;
+
+        case OTA_PKT_PARITY_V2:
+            handle_parity((const ota_data_packet_v2_t *)packet);
+            break;
+
+        case OTA_PKT_END: {
+            ota_end_packet_t pkt;
+            memcpy(&pkt, packet, sizeof(pkt));
+            ota_process_end_packet(ota, &pkt);
+            break;
+        }
+
+        case OTA_PKT_ABORT:
+            /* Any flash job in flight finishes, but its result is ignored;
+               the target slot's verdict was failed before it was erased */
+            OTA_LOG_INFO("ABORT received — stopping OTA\r\n");
+            ota_init(ota);
+            ota_fec_reset();
+            ota_fountain_reset();
+            break;
+
+        case OTA_PKT_SYMBOL:
+            // Packed, so it is read in place
+            ota_fountain_symbol(ota, (const ota_symbol_packet_t *)packet);
+            break;
+    }
+
+    if (type == OTA_PKT_DATA || type == OTA_PKT_PARITY) {
+        stats.data_packets++;
+        stats.data_cycles += sched_port_cycles() - cycles;
+    }
+}
+
+static void frame_byte(uint8_t byte) {
+    packet[packet_len++] = byte;
+
+    // Resynchronise on a bad header by dropping bytes from the front
+    while (packet_len > 0 && !prefix_valid(packet, packet_len)) {
+        skip(1);
+    }
+
+    while (packet_len >= 5 && packet_len == packet_length(packet[4])) {
+        /* A packet that lost bytes runs on into the next one. It still
+           goes to the manager, which answers for the damage as before,
+           but if a packet start turns up inside a frame that fails its
+           check, framing carries on from there: only the short packet
+           is lost, not the one after it too. */
+        uint32_t off = next_start();
+        int broken = (off != 0 && !frame_intact());
+
+        dispatch();
+        if (!broken) {
+            gap_sample(packet_pause);
+            packet_len = 0;
+            packet_pause = 0;
+            break;
+        }
+        memmove(packet, packet + off, packet_len - off);
+        packet_len -= off;
+        packet_pause = 0;
+        stats.broken_frames++;  // What is left may be a whole packet
+    }
+}
+
+static void packet_stalled(uint32_t silent_ms) {
+    OTA_LOG_ERROR("OTA: dropped %lu bytes of a packet stalled for %lu ms\r\n", packet_len, silent_ms);
+    packet_len = 0;
+    packet_pause = 0;
+    stats.stalled_packets++;
+    if (packet_gap_ms < gap_max_ms) {
+        gap_backoff++;
+        gap_update();
+    }
+}
+
+static void rx_task(void *arg) {
+    uint8_t buf[64];
+    uint32_t got = 0;
+    int n;
+
+    if (link == NULL) {
+        return;
+    }
+    uint32_t start = ota_gov_begin();
+    int signalled = rx_task_posted;
+    rx_task_posted = 0;
+
+    /* New bytes were heard when rx_ready() fired, however late the loop
+       got to them; if that was a gap after the partial packet's last
+       bytes, they do not continue it */
+    uint32_t now = sched_port_now_ms();
+    uint32_t heard = signalled ? rx_signal_tick : now;
+    if (signalled && packet_len > 0 && heard - packet_tick >= packet_gap_ms) {
+        packet_stalled(heard - packet_tick);
+    }
+
+    while (link != NULL && (n = link->recv(link, buf, sizeof(buf))) > 0) {
+        stats.rx_bytes += n;
+        if (got == 0 && packet_len > 0 && heard - packet_tick > packet_pause) {
+            packet_pause = heard - packet_tick;
+        }
+        got += n;
+        packet_tick = now;
+        for (int i = 0; i < n; i++) {
+            frame_byte(buf[i]);
+        }
+    }
+
+    /* Otherwise only a run that found nothing gives a packet up: bytes a
+       polled transport held while the loop was busy are late, not lost */
+    if (link != NULL && packet_len > 0) {
+        if (got == 0 && now - packet_tick >= packet_gap_ms) {
+            packet_stalled(now - packet_tick);
+        } else if (!link->polled) {
+            sched_timer_start(&stall_timer, packet_tick + packet_gap_ms - now, 0);
+        }
+    }
+
+    ota_gov_end_cpu(start);
+}
+
+// The transport's receive notification; may run in an ISR
+static void rx_ready(void) {
+    if (!rx_task_posted) {
+        rx_signal_tick = sched_port_now_ms();
+        rx_task_posted = 1;
+        sched_post(rx_task, NULL);
+    }
+}
+
+/* ---- Sending ---- */
+
+void ota_link_send(const void *data, uint16_t size) {
+    const uint8_t *bytes = data;
+    uint32_t start = sched_port_now_ms();
+
+    if (link == NULL) {
+        return;
+    }
+    if (ota_fountain_active()) {
+        return;                 // Broadcast receivers keep quiet
+    }
+    if (replaying) {
+        memcpy(&replay_response, data, (size < sizeof(replay_response)) ? size : sizeof(replay_response));
+        return;
+    }
+
+    while (size > 0) {
+        uint16_t piece = (link->mtu != 0 && size > link->mtu) ? link->mtu : size;
+        int n = link->send(link, bytes, piece);
+
+        if (n < 0) {
+            return;
+        }
+        if (n == 0) {
+            if (sched_port_now_ms() - start > OTA_LINK_SEND_TIMEOUT_MS) {
+                OTA_LOG_ERROR("ERROR: OTA response dropped (%s stuck)\r\n", link->name);
+                stats.send_timeouts++;
+                return;
+            }
+            sched_sleep();
+            continue;
+        }
+        bytes += n;
+        size -= n;
+        stats.tx_bytes += n;
+    }
+}
+
+/* ---- Control ---- */
+
+int ota_link_start(ota_context_t *ctx, ota_transport_t *t, void (*on_complete)(void)) {
+    ota_link_stop();
+
+    t->rx_ready = rx_ready;
+    if (t->open(t) != 0) {
+        t->rx_ready = NULL;
+        return -1;
+    }
+
+    ota = ctx;
+    complete_cb = on_complete;
+    ota_init(ota);
+    ota_fec_reset();
+    ota_fountain_reset();
+
+    memset(&stats, 0, sizeof(stats));
+    packet_len = 0;
+    packet_pause = 0;
+    rx_task_posted = 0;
+
+    // Twice the time the largest packet takes on the wire, and never less than the ceiling
+    gap_max_ms = OTA_LINK_GAP_MAX_MS;
+    if (t->bytes_per_sec != 0) {
+        uint32_t wire_ms = (uint32_t)(2ULL * sizeof(packet) * 1000 / t->bytes_per_sec);
+        if (wire_ms > gap_max_ms) {
+            gap_max_ms = wire_ms;
+        }
+    }
+    gap_samples = 0;
+    gap_backoff = 0;
+    gap_update();
+    sched_timer_init(&stall_timer, rx_task, NULL);
+
+    link = t;
+    if (t->polled) {
+        sched_timer_init(&poll_timer, rx_task, NULL);
+        sched_timer_start(&poll_timer, 1, 1);
+    }
+
+    OTA_LOG_INFO("OTA receiver listening on %s (%lu B/s, MTU %u)\r\n", t->name, t->bytes_per_sec, t->mtu);
+    return 0;
+}
+
+ota_transport_t *ota_link_pick(ota_context_t *ctx, ota_transport_t *const *list, uint32_t count,
+                               void (*on_complete)(void)) {
+    uint32_t tried = 0;  // Bit per list entry
+
+    for (uint32_t attempt = 0; attempt < count && attempt < 32; attempt++) {
+        int best = -1;
+        for (uint32_t i = 0; i < count && i < 32; i++) {
+            if (!(tried & (1UL << i)) &&
+                (best < 0 || list[i]->bytes_per_sec > list[best]->bytes_per_sec)) {
+                best = i;
+            }
+        }
+
+        tried |= 1UL << best;
+        if (ota_link_start(ctx, list[best], on_complete) == 0) {
+            return list[best];
+        }
+        OTA_LOG_ERROR("OTA link %s unavailable\r\n", list[best]->name);
+    }
+    return NULL;
+}
+
+void ota_link_stop(void) {
+    if (link == NULL) {
+        return;
+    }
+    if (link->polled) {
+        sched_timer_stop(&poll_timer);
+    }
+    sched_timer_stop(&stall_timer);
+    link->close(link);
+    link->rx_ready = NULL;
+    link = NULL;
+}
+
+int ota_link_busy(void) {
+    return link != NULL && ota->state != OTA_STATE_IDLE && ota->state != OTA_STATE_ERROR;
+}
+
+uint8_t ota_link_credits(void) {
+    uint32_t credits = 1;
+
+    /* A governor-throttled link still gets one; BUSY NACKs push back */
+    if (link != NULL && link->rx_window > sizeof(ota_data_packet_t)) {
+        credits = link->rx_window / sizeof(ota_data_packet_t);
+    }
+    return (credits > OTA_MAX_CREDITS) ? OTA_MAX_CREDITS : (uint8_t)credits;
+}
+
+void ota_link_on_complete(ota_context_t *ctx) {
+    if (link != NULL) {
+        OTA_LOG_INFO("OTA link %s: %lu packets, %lu bytes in, %lu out, %lu resync bytes, %lu broken frames\r\n",
+                     link->name, stats.packets, stats.rx_bytes, stats.tx_bytes, stats.resync_bytes,
+                     stats.broken_frames);
+        if (stats.data_packets != 0) {
+            OTA_LOG_INFO("OTA link %s: %lu DATA/PARITY packets (%lu v2), %lu cycles each\r\n", link->name,
+                         stats.data_packets, stats.v2_packets, (uint32_t)(stats.data_cycles / stats.data_packets));
+        }
+        if (stats.stalled_packets != 0 || gap_samples != 0) {
+            OTA_LOG_INFO("OTA link %s: %lu stalled packets, gap %lu ms (pauses %lu +/- %lu ms)\r\n",
+                         link->name, stats.stalled_packets, packet_gap_ms, gap_srtt >> 3, gap_rttvar >> 2);
+        }
+
+        ota_fec_stats_t fec;
+        ota_fec_get_stats(&fec);
+        if (fec.repaired != 0 || fec.unrepairable != 0) {
+            OTA_LOG_INFO("OTA FEC: %lu chunks rebuilt from parity, %lu held, %lu groups resent\r\n",
+                         fec.repaired, fec.held, fec.unrepairable);
+        }
+
+        ota_fountain_stats_t fountain;
+        ota_fountain_get_stats(&fountain);
+        if (fountain.symbols != 0) {
+            OTA_LOG_INFO("OTA broadcast: %lu symbols, %lu used, %lu redundant, %lu for other segments, "
+                         "%lu bad CRC, %lu segments\r\n", fountain.symbols, fountain.innovative,
+                         fountain.redundant, fountain.other_segment, fountain.bad_crc, fountain.segments);
+        }
+    }
+    if (complete_cb != NULL) {
+        complete_cb();
+    }
+}
+
+void ota_link_get_stats(ota_link_stats_t *out) {
+    *out = stats;
+    out->gap_ms = packet_gap_ms;
+}
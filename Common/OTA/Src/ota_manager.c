@@ -0,0 +1,658 @@
+/*
+ * ota_manager.c
+ *
+ *  Created on: Jan 2, 2026
+ *      Author: sean-shk
+ */
+
+#include "ota_manager.h"
+#include "boot_state.h"
+#include "ota_crc.h"
+#include "image_header.h"
+#include "slot_select.h"
+#include "boot_trial.h"
+#include "ota_link.h"
+#include "ota_governor.h"
+#include "ota_config.h"
+#include "ota_log.h"
+#include "main.h"
+#include <string.h>
+#if OTA_BACKGROUND_FLASH
+#include "flash_task.h"
+#endif
+#if OTA_STAGING_ENABLED
+#include "ota_staging.h"
+#endif
+
+/* The same file builds into both images; ota_config.h says which */
+#if OTA_STAGING_ENABLED && !OTA_BACKGROUND_FLASH
+#error "SDRAM staging programs flash through flash_task.h (OTA_BACKGROUND_FLASH)"
+#endif
+#if OTA_BACKGROUND_FLASH && !OTA_HAL_DRIVERS
+#error "flash_task.h drives flash through the HAL (OTA_HAL_DRIVERS)"
+#endif
+
+void ota_init(ota_context_t *ctx) {
+    ctx->state = OTA_STATE_IDLE;
+    ctx->target_bank_address = 0;
+    ctx->target_slot = 0;
+    ctx->firmware_size = 0;
+    ctx->firmware_version = 0;
+    ctx->firmware_crc32 = 0;
+    ctx->total_chunks = 0;
+    ctx->chunks_received = 0;
+    ctx->expected_chunk_number = 0;
+    ctx->bytes_written = 0;
+    ctx->error_code = OTA_ERR_NONE;
+    ctx->staging = 0;
+    ctx->link_start_tick = 0;
+    ctx->link_time_ms = 0;
+    ctx->flash_time_ms = 0;
+}
+
+uint32_t calculate_crc32(const void *data, size_t length) {
+    size_t num_words = length / 4;
+    uint32_t crc = ota_crc_words((const uint32_t*)data, num_words, 1);
+
+    size_t remaining = length % 4;
+    if (remaining > 0) {
+        uint32_t last_word = 0;
+        memcpy(&last_word, (uint8_t*)data + num_words * 4, remaining);
+        crc = ota_crc_words(&last_word, 1, 0);
+    }
+
+    return crc;
+}
+
+/* Slot we are executing from, or -1 if none: the bootloader runs from
+   its own sector and may write any slot */
+static int ota_get_running_slot(void) {
+#if OTA_ROLE_BOOTLOADER
+    return -1;
+#else
+    return flash_slot_index(SCB->VTOR);
+#endif
+}
+
+/* Explicit slot from the START packet, or the least valuable one that
+   fits. Returns -1 if nothing fits, -2 for a bad explicit slot. */
+static int ota_choose_target_slot(const ota_start_packet_t *pkt) {
+    boot_state_t state;
+    uint32_t capacity[FLASH_NUM_SLOTS];
+
+    if (boot_state_read(&state) != 0) {
+        boot_state_init(&state);
+    }
+
+    int running = ota_get_running_slot();
+    uint32_t skip = (running >= 0) ? (1UL << running) : 0;
+
+    for (uint32_t i = 0; i < FLASH_NUM_SLOTS; i++) {
+        capacity[i] = OTA_MAX_STREAM_FOR(flash_slot_size(flash_slot_address(i)));
+    }
+
+    if (pkt->target_bank == OTA_TARGET_AUTO) {
+        return slot_select_target(state.slots, capacity, FLASH_NUM_SLOTS, skip, pkt->firmware_size);
+    }
+
+    if (pkt->target_bank >= FLASH_NUM_SLOTS || (skip & (1UL << pkt->target_bank))) {
+        OTA_LOG_ERROR("ERROR: Slot %u is running or does not exist\r\n", pkt->target_bank);
+        return -2;
+    }
+    if (pkt->firmware_size > capacity[pkt->target_bank]) {
+        OTA_LOG_ERROR("ERROR: Image (%lu bytes) does not fit slot %u (%lu bytes)\r\n",
+                      pkt->firmware_size, pkt->target_bank,
+                      flash_slot_size(flash_slot_address(pkt->target_bank)));
+        return -1;
+    }
+    return pkt->target_bank;
+}
+
+/* Start of the flash job in progress, for ctx->flash_time_ms */
+static uint32_t flash_job_tick;
+
+#if OTA_BACKGROUND_FLASH
+/* Queue the erase of the target slot; done() runs when it has finished */
+static int ota_start_erase(ota_context_t *ctx, uint32_t size, flash_task_done_t done) {
+    const flash_partition_t *part = flash_partition_at(ctx->target_bank_address);
+    if (part == NULL || !part->image_slot) {
+        return -1;
+    }
+
+    /* The old image is about to go; fail its verdict (a bit-clear, no
+       erase) so an interrupted transfer is never booted from this slot */
+    boot_state_set_verdict(ctx->target_slot, BOOT_VERDICT_FAILED);
+
+    flash_job_tick = HAL_GetTick();
+    return flash_task_erase(part, size, done, ctx);
+}
+#else
+/* Erase the sectors of a slot that size bytes will occupy (0 = all of
+   it), blocking. Returns 0 on success, -1 on failure. */
+int ota_erase_bank(uint32_t bank_address, uint32_t size) {
+    const flash_partition_t *part = flash_partition_at(bank_address);
+    if (part == NULL || !part->image_slot) {
+        return -1;
+    }
+
+    /* As ota_start_erase(): never boot a half-written slot */
+    boot_state_set_verdict(flash_slot_index(bank_address), BOOT_VERDICT_FAILED);
+
+    /* The erase stalls the CPU for seconds; start with a full watchdog period */
+    boot_watchdog_kick();
+
+    return flash_erase_partition(part, size);
+}
+#endif
+
+/* Responses go out on whichever link ota_link_start() was given */
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+    ota_response_packet_t response;
+
+    response.magic = OTA_MAGIC_START;
+    response.packet_type = packet_type;
+    if (packet_type == OTA_PKT_ACK) {
+        response.credits = ota_link_credits();
+    } else {
+        response.error_code = ctx->error_code;
+    }
+    response.last_chunk_received = ctx->chunks_received;
+
+    ota_link_send(&response, sizeof(response));
+
+    if (packet_type == OTA_PKT_ACK) {
+        OTA_LOG_DEBUG("Sent ACK (chunks received: %lu)\r\n", ctx->chunks_received);
+    } else {
+        OTA_LOG_INFO("Sent NACK (error code: %d)\r\n", ctx->error_code);
+    }
+}
+
+static void ota_start_receiving(ota_context_t *ctx) {
+    ctx->state = OTA_STATE_RECEIVING_DATA;
+
+    OTA_LOG_INFO("Ready to receive %lu chunks (%lu bytes)!\r\n",
+                 ctx->total_chunks, ctx->firmware_size);
+
+    ota_send_response(ctx, OTA_PKT_ACK);
+    ctx->link_start_tick = HAL_GetTick();
+}
+
+#if OTA_BACKGROUND_FLASH
+static void ota_start_erased(int status, void *arg) {
+    ota_context_t *ctx = arg;
+
+    if (ctx->state != OTA_STATE_ERASING) {
+        return;  /* Aborted while erasing */
+    }
+    ctx->flash_time_ms += HAL_GetTick() - flash_job_tick;
+
+    if (status != 0) {
+        OTA_LOG_ERROR("ERROR: Failed to erase target bank\r\n");
+        ctx->error_code = OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    OTA_LOG_INFO("Bank erased successfully!\r\n");
+    ota_start_receiving(ctx);
+}
+#endif
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+    OTA_LOG_INFO("\r\n=== OTA START Packet ===\r\n");
+
+    if (ctx->state != OTA_STATE_IDLE) {
+        OTA_LOG_ERROR("ERROR: Not in IDLE state (current: %d)\r\n", ctx->state);
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    if (pkt->magic != OTA_MAGIC_START) {
+        OTA_LOG_ERROR("ERROR: Invalid magic number\r\n");
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    if (pkt->firmware_size == 0 || pkt->firmware_size > OTA_MAX_STREAM_SIZE) {
+        OTA_LOG_ERROR("ERROR: Invalid firmware size: %lu\r\n", pkt->firmware_size);
+        ctx->error_code = OTA_ERR_SIZE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    int slot = ota_choose_target_slot(pkt);
+    if (slot < 0) {
+        OTA_LOG_ERROR("ERROR: No slot can take this image\r\n");
+        ctx->error_code = (slot == -2) ? OTA_ERR_SEQUENCE : OTA_ERR_SIZE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    ctx->target_slot = slot;
+    ctx->target_bank_address = flash_slot_address(slot);
+    OTA_LOG_INFO("Target slot %d: 0x%08lX\r\n", slot, ctx->target_bank_address);
+
+    ota_reloc_init(&ctx->reloc, ctx->target_bank_address);
+
+    ctx->flash_time_ms = 0;
+
+    ctx->firmware_size = pkt->firmware_size;
+    ctx->firmware_version = pkt->firmware_version;
+    ctx->firmware_crc32 = pkt->firmware_crc32;
+    ctx->total_chunks = pkt->total_chunks;
+    ctx->chunks_received = 0;
+    ctx->expected_chunk_number = 0;
+    ctx->bytes_written = 0;
+
+#if OTA_STAGING_ENABLED
+    /* With SDRAM staging the bank is erased at END, after the image has
+       been verified; a failed transfer leaves flash untouched. */
+    ctx->staging = (ota_staging_init() == 0) ? 1 : 0;
+    if (ctx->staging) {
+        OTA_LOG_INFO("Staging image in SDRAM (flash programmed after verify)\r\n");
+        ota_start_receiving(ctx);
+        return;
+    }
+#endif
+
+#if OTA_BACKGROUND_FLASH
+    /* Write-through: the slot is erased in the background and the ACK
+       goes out once it is blank. The sender waits for it either way. */
+    ctx->state = OTA_STATE_ERASING;
+    if (ota_start_erase(ctx, ctx->firmware_size, ota_start_erased) != 0) {
+        OTA_LOG_ERROR("ERROR: Failed to erase target bank\r\n");
+        ctx->error_code = OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+    }
+#else
+    /* Nothing else runs until the slot is blank; the sender allows for it */
+    flash_job_tick = HAL_GetTick();
+    if (ota_erase_bank(ctx->target_bank_address, ctx->firmware_size) != 0) {
+        OTA_LOG_ERROR("ERROR: Failed to erase target bank\r\n");
+        ctx->error_code = OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+    ctx->flash_time_ms += HAL_GetTick() - flash_job_tick;
+
+    OTA_LOG_INFO("Bank erased successfully!\r\n");
+    ota_start_receiving(ctx);
+#endif
+}
+
+/* ota_reloc_feed()'s writer */
+static int write_to_flash_unified(uint32_t address, const void *data, uint16_t size) {
+    return flash_program(address, data, size);
+}
+
+/* Put a checked chunk where the transfer keeps it: SDRAM when staging,
+   otherwise the target slot. Returns OTA_ERR_NONE or the NACK code. */
+static uint8_t ota_store_chunk(ota_context_t *ctx, uint32_t offset,
+                               const ota_data_packet_v2_t *pkt) {
+#if OTA_STAGING_ENABLED
+    if (ctx->staging) {
+        OTA_LOG_DEBUG("Chunk %lu/%lu: staging %u bytes\r\n",
+                      pkt->chunk_number + 1, ctx->total_chunks, pkt->chunk_size);
+
+        if (ota_staging_write(offset, pkt->data, pkt->chunk_size) != 0) {
+            OTA_LOG_ERROR("ERROR: Staging write failed\r\n");
+            return OTA_ERR_SIZE;
+        }
+        return OTA_ERR_NONE;
+    }
+#endif
+
+    OTA_LOG_DEBUG("Chunk %lu/%lu: writing %u bytes to 0x%08lX\r\n",
+                  pkt->chunk_number + 1, ctx->total_chunks, pkt->chunk_size,
+                  ctx->target_bank_address + offset);
+
+    uint32_t write_start = HAL_GetTick();
+    uint32_t gov_start = ota_gov_begin();
+    int write_status = ota_reloc_feed(&ctx->reloc, offset, pkt->data, pkt->chunk_size,
+                                      write_to_flash_unified);
+    ota_gov_end_flash(gov_start);
+    if (write_status != 0) {
+        OTA_LOG_ERROR("ERROR: Flash write failed\r\n");
+        return OTA_ERR_FLASH;
+    }
+    ctx->flash_time_ms += HAL_GetTick() - write_start;
+    return OTA_ERR_NONE;
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    /* A sender running a window resends what it has not yet seen
+       acknowledged; answer again rather than fail the transfer */
+    if ((ctx->state == OTA_STATE_RECEIVING_DATA || ctx->state == OTA_STATE_VERIFYING) &&
+        pkt->chunk_number < ctx->chunks_received) {
+        ota_send_response(ctx, OTA_PKT_ACK);
+        return;
+    }
+
+    if (ctx->state != OTA_STATE_RECEIVING_DATA) {
+        OTA_LOG_ERROR("ERROR: Not in RECEIVING_DATA state\r\n");
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    if (pkt->magic != OTA_MAGIC_DATA) {
+        OTA_LOG_ERROR("ERROR: Invalid data packet magic\r\n");
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    if (pkt->chunk_number != ctx->expected_chunk_number) {
+        OTA_LOG_ERROR("ERROR: Wrong chunk (expected %lu, got %lu)\r\n",
+                      ctx->expected_chunk_number, pkt->chunk_number);
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    if (pkt->chunk_size == 0 || pkt->chunk_size > OTA_CHUNK_SIZE) {
+        OTA_LOG_ERROR("ERROR: Invalid chunk size: %u\r\n", pkt->chunk_size);
+        ctx->error_code = OTA_ERR_SIZE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    uint32_t calculated_crc = calculate_crc32(pkt->data, pkt->chunk_size);
+    if (calculated_crc != pkt->chunk_crc32) {
+        OTA_LOG_ERROR("ERROR: Chunk CRC mismatch (got 0x%08lX, expected 0x%08lX)\r\n",
+                      calculated_crc, pkt->chunk_crc32);
+        ctx->error_code = OTA_ERR_CRC;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    uint32_t offset = pkt->chunk_number * OTA_CHUNK_SIZE;
+
+    if (offset + pkt->chunk_size > ctx->firmware_size) {
+        OTA_LOG_ERROR("ERROR: Chunk %lu overruns firmware size\r\n", pkt->chunk_number);
+        ctx->error_code = OTA_ERR_SIZE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    uint8_t error = ota_store_chunk(ctx, offset, pkt);
+    if (error != OTA_ERR_NONE) {
+        ctx->error_code = error;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    ctx->chunks_received++;
+    ctx->expected_chunk_number++;
+    ctx->bytes_written += pkt->chunk_size;
+
+    ota_send_response(ctx, OTA_PKT_ACK);
+
+    if (ctx->chunks_received == ctx->total_chunks) {
+        OTA_LOG_INFO("All chunks received! Transitioning to VERIFYING...\r\n");
+        ctx->link_time_ms = HAL_GetTick() - ctx->link_start_tick;
+        ctx->state = OTA_STATE_VERIFYING;
+    }
+}
+
+uint32_t ota_calculate_firmware_crc32(uint32_t address, uint32_t size) {
+    return ota_crc_calculate(address, size);
+}
+
+/* CRC32 of the stream as sent, computed from what is now in the target bank */
+static uint32_t ota_installed_crc32(const ota_context_t *ctx) {
+    if (ctx->reloc.active) {
+        OTA_LOG_INFO("  Rebased %lu words\r\n", ctx->reloc.words_patched);
+        return ota_reloc_stream_crc32(&ctx->reloc);
+    }
+    return ota_calculate_firmware_crc32(ctx->target_bank_address, ctx->firmware_size);
+}
+
+/* CRC32 of the stream as received. In staging mode the image is
+   verified in SDRAM, before flash is erased. */
+static uint32_t ota_received_crc32(const ota_context_t *ctx) {
+#if OTA_STAGING_ENABLED
+    if (ctx->staging) {
+        return ota_calculate_firmware_crc32(OTA_STAGING_ADDRESS, ctx->firmware_size);
+    }
+#endif
+    return ota_installed_crc32(ctx);
+}
+
+/* Check the image header against the transfer and stamp where it landed */
+static int ota_install_image_header(const ota_context_t *ctx) {
+    const image_header_t *hdr = image_header_get(ctx->target_bank_address);
+    if (hdr == NULL) {
+        OTA_LOG_INFO("  No image header (legacy image)\r\n");
+        return 0;
+    }
+
+    uint32_t image_size = ctx->reloc.active ? ctx->reloc.header.image_size : ctx->firmware_size;
+    if (hdr->image_size != image_size) {
+        OTA_LOG_ERROR("ERROR: Header size %lu != image size %lu\r\n", hdr->image_size, image_size);
+        return -1;
+    }
+    if (hdr->load_address != ctx->target_bank_address && !(hdr->flags & IMAGE_FLAG_RELOCATABLE)) {
+        OTA_LOG_ERROR("ERROR: Image linked for 0x%08lX and not relocatable\r\n", hdr->load_address);
+        return -1;
+    }
+
+    OTA_LOG_INFO("  Image v%lu.%lu.%lu, linked for 0x%08lX\r\n",
+                 (hdr->fw_version >> 24) & 0xFF, (hdr->fw_version >> 16) & 0xFF,
+                 hdr->fw_version & 0xFFFF, hdr->load_address);
+
+    return (image_header_install(ctx->target_bank_address) == 0) ? 0 : -2;
+}
+
+int ota_update_boot_state(const ota_context_t *ctx) {
+    boot_state_t new_state;
+
+    /* Other slots keep their entries; they stay as fallbacks. Their
+       trial/verdict words are erased with the record, so fold them in. */
+    if (boot_state_read(&new_state) != 0) {
+        boot_state_init(&new_state);
+    }
+
+    /* The image doing this install is running well enough to receive
+       one: confirm it first, or settling would fail a trial it has not
+       finished and leave the new image without its fallback */
+    int running = ota_get_running_slot();
+    if (running >= 0 && new_state.slots[running].status == BANK_STATUS_TESTING &&
+        boot_state_set_confirmed(running) != 0) {
+        return -1;
+    }
+    boot_state_settle(&new_state);
+
+    /* The bootloader verifies the bytes in flash, which differ from the
+       stream the sender's CRC covers if the image was rebased or its
+       header stamped */
+    const image_header_t *hdr = image_header_get(ctx->target_bank_address);
+    uint32_t image_size = ctx->reloc.active ? ctx->reloc.header.image_size : ctx->firmware_size;
+    uint32_t image_crc = (ctx->reloc.active || hdr != NULL)
+        ? ota_calculate_firmware_crc32(ctx->target_bank_address, image_size)
+        : ctx->firmware_crc32;
+
+    boot_slot_t *slot = &new_state.slots[ctx->target_slot];
+    slot->status = BANK_STATUS_TESTING;  /* Until the image confirms itself */
+    slot->sequence = new_state.next_sequence++;
+    slot->fw_version = hdr ? hdr->fw_version : ctx->firmware_version;
+    slot->image_size = image_size;
+    slot->image_crc32 = image_crc;
+    slot->stream_crc32 = ctx->firmware_crc32;  /* What ota_image_recorded() matches */
+    new_state.active_slot = ctx->target_slot;
+
+    if (boot_state_erase() != 0) return -1;
+    if (boot_state_write(&new_state) != 0) return -1;
+
+    return 0;
+}
+
+/* Non-zero if a slot record names this image, installed or fallen back
+   from; broadcasts repeat and must not install it again. The sender's
+   CRC covers the stream, so it is matched against stream_crc32: a
+   headered or relocated image's image_crc32 is the CRC of flash. */
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    boot_state_t state;
+
+    if (boot_state_read(&state) != 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < FLASH_NUM_SLOTS; i++) {
+        const boot_slot_t *slot = &state.slots[i];
+        if (slot->sequence == 0) {
+            continue;  /* Never installed */
+        }
+        if (slot->stream_crc32 == firmware_crc32 ||
+            (firmware_version != 0 && slot->fw_version == firmware_version)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Stamp the header and record the new slot; the image is in flash */
+static void ota_finish_install(ota_context_t *ctx) {
+    OTA_LOG_INFO("  Link time:  %lu ms\r\n", ctx->link_time_ms);
+    OTA_LOG_INFO("  Flash time: %lu ms (%s)\r\n", ctx->flash_time_ms,
+                 ctx->staging ? "staged, link idle" : "inline with link");
+    int header_status = ota_install_image_header(ctx);
+    if (header_status != 0) {
+        ctx->error_code = (header_status == -1) ? OTA_ERR_SIZE : OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    ctx->state = OTA_STATE_FINALIZING;
+
+    if (ota_update_boot_state(ctx) != 0) {
+        OTA_LOG_ERROR("ERROR: Failed to update boot state\r\n");
+        ctx->error_code = OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    OTA_LOG_INFO("Boot state updated!\r\n");
+    OTA_LOG_INFO("OTA complete! New firmware at 0x%08lX\r\n", ctx->target_bank_address);
+
+    ctx->state = OTA_STATE_COMPLETE;
+    ota_send_response(ctx, OTA_PKT_ACK);
+    ota_link_on_complete(ctx);
+}
+
+#if OTA_STAGING_ENABLED
+static void ota_commit_programmed(int status, void *arg) {
+    ota_context_t *ctx = arg;
+
+    if (ctx->state != OTA_STATE_FINALIZING) {
+        return;  /* Aborted while programming */
+    }
+    ctx->flash_time_ms += HAL_GetTick() - flash_job_tick;
+
+    if (status != 0 || ota_installed_crc32(ctx) != ctx->firmware_crc32) {
+        OTA_LOG_ERROR("ERROR: Programming staged image failed\r\n");
+        ctx->error_code = OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    ota_finish_install(ctx);
+}
+
+static void ota_commit_erased(int status, void *arg) {
+    ota_context_t *ctx = arg;
+
+    if (ctx->state != OTA_STATE_FINALIZING) {
+        return;
+    }
+    ctx->flash_time_ms += HAL_GetTick() - flash_job_tick;
+
+    flash_job_tick = HAL_GetTick();
+    if (status != 0 ||
+        ota_staging_commit(&ctx->reloc, ctx->firmware_size, ota_commit_programmed, ctx) != 0) {
+        OTA_LOG_ERROR("ERROR: Programming staged image failed\r\n");
+        ctx->error_code = OTA_ERR_FLASH;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+    }
+}
+#endif
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+    OTA_LOG_INFO("\r\n=== OTA END Packet ===\r\n");
+
+    if (ctx->state != OTA_STATE_VERIFYING) {
+        OTA_LOG_ERROR("ERROR: Not in VERIFYING state (current: %d)\r\n", ctx->state);
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    if (pkt->magic != OTA_MAGIC_START) {
+        OTA_LOG_ERROR("ERROR: Invalid END packet magic\r\n");
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    OTA_LOG_INFO("Verifying firmware...\r\n");
+    OTA_LOG_INFO("  Expected: %lu bytes, CRC32: 0x%08lX\r\n",
+                 ctx->firmware_size, ctx->firmware_crc32);
+    OTA_LOG_INFO("  Written:  %lu bytes\r\n", ctx->bytes_written);
+
+    if (ctx->bytes_written != ctx->firmware_size) {
+        OTA_LOG_ERROR("ERROR: Size mismatch!\r\n");
+        ctx->error_code = OTA_ERR_SIZE;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    uint32_t calculated_crc = ota_received_crc32(ctx);
+    OTA_LOG_INFO("  Calculated CRC32: 0x%08lX\r\n", calculated_crc);
+
+    if (calculated_crc != ctx->firmware_crc32) {
+        OTA_LOG_ERROR("ERROR: CRC32 mismatch! Firmware corrupted.\r\n");
+        ctx->error_code = OTA_ERR_CRC;
+        ctx->state = OTA_STATE_ERROR;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    OTA_LOG_INFO("Firmware verification PASSED!\r\n");
+
+#if OTA_STAGING_ENABLED
+    if (ctx->staging) {
+        /* Erase and program in the background; the ACK waits for the install */
+        OTA_LOG_INFO("Programming staged image into 0x%08lX...\r\n", ctx->target_bank_address);
+        ctx->state = OTA_STATE_FINALIZING;
+        if (ota_start_erase(ctx, ctx->firmware_size, ota_commit_erased) != 0) {
+            OTA_LOG_ERROR("ERROR: Programming staged image failed\r\n");
+            ctx->error_code = OTA_ERR_FLASH;
+            ctx->state = OTA_STATE_ERROR;
+            ota_send_response(ctx, OTA_PKT_NACK);
+        }
+        return;
+    }
+#endif
+
+    ota_finish_install(ctx);
+}
@@ -0,0 +1,143 @@
+/*
+ * ota_reloc.c
+ * Streaming rebase of relocatable OTA images
+ */
+
+#include "ota_reloc.h"
+#include "ota_protocol.h"
+#include "ota_crc.h"
+#include "ota_log.h"
+#include <string.h>
+
+// Bitmap of payload words to rebase; only one transfer runs at a time
+static uint32_t reloc_bitmap[OTA_RELOC_MAX_BITMAP / 4];
+
+static inline int reloc_bit_set(uint32_t word_index) {
+    return (reloc_bitmap[word_index / 32] >> (word_index % 32)) & 1U;
+}
+
+void ota_reloc_init(ota_reloc_state_t *st, uint32_t target_address) {
+    memset(st, 0, sizeof(*st));
+    st->target_address = target_address;
+}
+
+static int reloc_validate_header(ota_reloc_state_t *st) {
+    const ota_reloc_header_t *h = &st->header;
+    uint32_t words = (h->image_size + 3) / 4;
+    uint32_t expected_bitmap = (((words + 7) / 8) + 3) & ~3U;
+
+    if (h->image_size == 0 || h->image_size > flash_slot_size(st->target_address) ||
+        h->bitmap_size != expected_bitmap || h->bitmap_size > OTA_RELOC_MAX_BITMAP) {
+        OTA_LOG_ERROR("ERROR: Bad relocation header (size %lu, bitmap %lu)\r\n",
+                      h->image_size, h->bitmap_size);
+        return -1;
+    }
+
+    st->prefix_size = sizeof(ota_reloc_header_t) + h->bitmap_size;
+    st->delta = st->target_address - h->link_address;
+
+    OTA_LOG_INFO("Relocatable image: linked at 0x%08lX, rebasing to 0x%08lX\r\n",
+                 h->link_address, st->target_address);
+    return 0;
+}
+
+int ota_reloc_feed(ota_reloc_state_t *st, uint32_t stream_offset,
+                   const uint8_t *data, uint16_t size, ota_reloc_write_fn write) {
+    if (stream_offset == 0) {
+        uint32_t magic = 0;
+        if (size >= 4) {
+            memcpy(&magic, data, 4);
+        }
+        st->active = (magic == OTA_RELOC_MAGIC);
+        st->prefix_size = st->active ? sizeof(ota_reloc_header_t) : 0;
+        st->words_patched = 0;
+    }
+
+    // Plain image: program as-is
+    if (!st->active) {
+        if (stream_offset + size > flash_slot_size(st->target_address)) {
+            return -1;
+        }
+        return write(st->target_address + stream_offset, data, size);
+    }
+
+    uint32_t pos = stream_offset;
+    uint32_t end = stream_offset + size;
+
+    // Capture header bytes (always inside chunk 0)
+    while (pos < end && pos < sizeof(ota_reloc_header_t)) {
+        ((uint8_t*)&st->header)[pos] = data[pos - stream_offset];
+        pos++;
+        if (pos == sizeof(ota_reloc_header_t) && reloc_validate_header(st) != 0) {
+            return -1;
+        }
+    }
+
+    // Capture bitmap bytes
+    while (pos < end && pos < st->prefix_size) {
+        ((uint8_t*)reloc_bitmap)[pos - sizeof(ota_reloc_header_t)] = data[pos - stream_offset];
+        pos++;
+    }
+
+    if (pos == end) {
+        return 0;
+    }
+
+    // Payload: rebase flagged words into a bounce buffer, then program
+    uint32_t payload_offset = pos - st->prefix_size;
+    uint32_t n = end - pos;
+
+    if (payload_offset + n > st->header.image_size) {
+        return -1;
+    }
+
+    uint32_t buffer[OTA_CHUNK_SIZE / 4];
+    memcpy(buffer, &data[pos - stream_offset], n);
+
+    uint32_t first_word = payload_offset / 4;
+    for (uint32_t i = 0; i < n / 4; i++) {
+        if (reloc_bit_set(first_word + i)) {
+            buffer[i] += st->delta;
+            st->words_patched++;
+        }
+    }
+
+    return write(st->target_address + payload_offset, buffer, (uint16_t)n);
+}
+
+uint32_t ota_reloc_stream_crc32(const ota_reloc_state_t *st) {
+    // Header and bitmap are whole words and still in RAM
+    uint32_t crc = ota_crc_words((const uint32_t*)&st->header, sizeof(ota_reloc_header_t) / 4, 1);
+    crc = ota_crc_words(reloc_bitmap, st->header.bitmap_size / 4, 0);
+
+    // Payload: undo the rebase one 1KB block at a time
+    uint32_t buffer[OTA_CHUNK_SIZE / 4];
+    uint32_t offset = 0;
+
+    while (offset < st->header.image_size) {
+        uint32_t remaining = st->header.image_size - offset;
+        uint32_t n = (remaining > OTA_CHUNK_SIZE) ? OTA_CHUNK_SIZE : remaining;
+        uint32_t num_words = n / 4;
+
+        memcpy(buffer, (const void*)(st->target_address + offset), n);
+
+        for (uint32_t i = 0; i < num_words; i++) {
+            if (reloc_bit_set(offset / 4 + i)) {
+                buffer[i] -= st->delta;
+            }
+        }
+
+        crc = ota_crc_words(buffer, num_words, 0);
+
+        // Trailing bytes are zero padded, matching calculate_crc32()
+        if (n % 4) {
+            uint32_t last_word = 0;
+            memcpy(&last_word, (uint8_t*)buffer + num_words * 4, n % 4);
+            crc = ota_crc_words(&last_word, 1, 0);
+        }
+
+        offset += n;
+    }
+
+    return crc;
+}
@@ -0,0 +1,114 @@
+/*
+ * ota_transport_uart.c
+ * Interrupt-driven OTA transport over a HAL UART (see ota_transport_uart.h)
+ */
+
+#include "ota_transport_uart.h"
+#include "ota_log.h"
+
+int ota_transport_uart_open(ota_transport_t *t) {
+    ota_uart_port_t *port = t->priv;
+
+    port->rx_head = port->rx_tail = 0;
+    port->tx_head = port->tx_tail = 0;
+    port->rx_overruns = port->rx_dropped = 0;
+    t->bytes_per_sec = port->huart->Init.BaudRate / 10;
+
+    HAL_NVIC_SetPriority(port->irq, 5, 0);
+    HAL_NVIC_EnableIRQ(port->irq);
+    __HAL_UART_ENABLE_IT(port->huart, UART_IT_RXNE);
+    return 0;
+}
+
+void ota_transport_uart_close(ota_transport_t *t) {
+    ota_uart_port_t *port = t->priv;
+
+    ota_transport_uart_flush(t, 100);
+    __HAL_UART_DISABLE_IT(port->huart, UART_IT_RXNE);
+    __HAL_UART_DISABLE_IT(port->huart, UART_IT_TXE);
+    HAL_NVIC_DisableIRQ(port->irq);
+}
+
+int ota_transport_uart_send(ota_transport_t *t, const void *data, uint16_t size) {
+    ota_uart_port_t *port = t->priv;
+    const uint8_t *bytes = data;
+    uint16_t n = 0;
+
+    while (n < size && port->tx_head - port->tx_tail < OTA_UART_TX_RING_SIZE) {
+        port->tx_ring[port->tx_head % OTA_UART_TX_RING_SIZE] = bytes[n++];
+        port->tx_head++;
+    }
+    if (n > 0) {
+        __HAL_UART_ENABLE_IT(port->huart, UART_IT_TXE);
+    }
+    return n;
+}
+
+int ota_transport_uart_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    ota_uart_port_t *port = t->priv;
+    uint8_t *bytes = buf;
+    uint16_t n = 0;
+
+    while (n < size && port->rx_tail != port->rx_head) {
+        bytes[n++] = port->rx_ring[port->rx_tail % OTA_UART_RX_RING_SIZE];
+        port->rx_tail++;
+    }
+    return n;
+}
+
+void ota_transport_uart_irq(ota_transport_t *t) {
+    ota_uart_port_t *port = t->priv;
+    USART_TypeDef *uart = port->huart->Instance;
+    uint32_t sr = uart->SR;
+
+    if (sr & (USART_SR_RXNE | USART_SR_ORE)) {
+        uint8_t byte = (uint8_t)uart->DR;  // SR then DR also clears ORE/FE/NE
+
+        if (sr & USART_SR_ORE) {
+            port->rx_overruns++;
+        }
+        if (port->rx_head - port->rx_tail < OTA_UART_RX_RING_SIZE) {
+            port->rx_ring[port->rx_head % OTA_UART_RX_RING_SIZE] = byte;
+            port->rx_head++;
+        } else {
+            port->rx_dropped++;
+        }
+
+        if (t->rx_ready != NULL) {
+            t->rx_ready();
+        }
+    }
+
+    if ((sr & USART_SR_TXE) && (uart->CR1 & USART_CR1_TXEIE)) {
+        if (port->tx_tail != port->tx_head) {
+            uart->DR = port->tx_ring[port->tx_tail % OTA_UART_TX_RING_SIZE];
+            port->tx_tail++;
+        } else {
+            uart->CR1 &= ~USART_CR1_TXEIE;
+        }
+    }
+}
+
+int ota_transport_uart_flush(ota_transport_t *t, uint32_t timeout_ms) {
+    ota_uart_port_t *port = t->priv;
+    uint32_t start = HAL_GetTick();
+
+    // The last byte may still be shifting out; HAL_UART_Transmit() waits
+    // for TXE itself, so the order on the wire is kept
+    while (port->tx_tail != port->tx_head) {
+        if (HAL_GetTick() - start > timeout_ms) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void ota_transport_uart_report(ota_transport_t *t) {
+    ota_uart_port_t *port = t->priv;
+
+    if (port->rx_overruns || port->rx_dropped) {
+        OTA_LOG_INFO("%s: %lu overruns, %lu bytes dropped\r\n", t->name,
+                     port->rx_overruns, port->rx_dropped);
+    }
+    port->rx_overruns = port->rx_dropped = 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * sched.c
+ * Timer wheel, deferred work queue and idle accounting (see sched.h)
+ */
+
+#include "sched.h"
+#include "sched_port.h"
+#include "ota_log.h"
+#include <string.h>
+
+#define WHEEL_MASK  (SCHED_WHEEL_SLOTS - 1)
+#define WORK_MASK   (SCHED_WORK_DEPTH - 1)
+
+_Static_assert((SCHED_WHEEL_SLOTS & WHEEL_MASK) == 0, "SCHED_WHEEL_SLOTS must be a power of 2");
+_Static_assert((SCHED_WORK_DEPTH & WORK_MASK) == 0, "SCHED_WORK_DEPTH must be a power of 2");
+
+typedef struct {
+    sched_fn_t fn;
+    void *arg;
+} sched_work_t;
+
+// A timer sits in bucket (expires % SCHED_WHEEL_SLOTS) however far out it
+// is; each ms visits one bucket and fires what is due, so a timer more
+// than one turn away is simply passed over until its turn comes round.
+static sched_timer_t *wheel[SCHED_WHEEL_SLOTS];
+static uint32_t wheel_now;      // Last ms whose bucket has been run
+
+// Written by sched_post() (any context), drained by the main loop
+static sched_work_t work[SCHED_WORK_DEPTH];
+static volatile uint32_t work_head;
+static volatile uint32_t work_tail;
+
+static uint32_t window_start_ms;
+static uint32_t mark;           // Cycle count when busy time was last booked
+static uint64_t busy_cycles;
+static uint32_t wakeups;
+static uint32_t timers_fired;
+static uint32_t work_run;
+static uint32_t work_dropped;
+static uint32_t work_high_water;
+static uint32_t longest_cycles;
+
+static void account_busy(void) {
+    uint32_t now = sched_port_cycles();
+    busy_cycles += now - mark;
+    mark = now;
+}
+
+static void reset_stats(void) {
+    window_start_ms = sched_port_now_ms();
+    mark = sched_port_cycles();
+    busy_cycles = 0;
+    wakeups = 0;
+    timers_fired = 0;
+    work_run = 0;
+    work_dropped = 0;
+    work_high_water = 0;
+    longest_cycles = 0;
+}
+
+void sched_init(void) {
+    sched_port_init();
+    memset(wheel, 0, sizeof(wheel));
+    wheel_now = sched_port_now_ms();
+    work_head = 0;
+    work_tail = 0;
+    reset_stats();
+}
+
+static void timer_link(sched_timer_t *t) {
+    sched_timer_t **bucket = &wheel[t->expires & WHEEL_MASK];
+    t->next = *bucket;
+    *bucket = t;
+    t->armed = 1;
+}
+
+static void timer_unlink(sched_timer_t *t) {
+    sched_timer_t **link = &wheel[t->expires & WHEEL_MASK];
+    while (*link != NULL) {
+        if (*link == t) {
+            *link = t->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    t->next = NULL;
+    t->armed = 0;
+}
+
+void sched_timer_init(sched_timer_t *t, sched_fn_t fn, void *arg) {
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+}
+
+void sched_timer_start(sched_timer_t *t, uint32_t delay_ms, uint32_t period_ms) {
+    if (t->armed) {
+        timer_unlink(t);
+    }
+    t->expires = sched_port_now_ms() + delay_ms;
+    t->period = period_ms;
+
+    // The current ms may already have been run; a zero delay means next tick
+    if ((int32_t)(t->expires - wheel_now) <= 0) {
+        t->expires = wheel_now + 1;
+    }
+    timer_link(t);
+}
+
+void sched_timer_stop(sched_timer_t *t) {
+    if (t->armed) {
+        timer_unlink(t);
+    }
+}
+
+int sched_post(sched_fn_t fn, void *arg) {
+    uint32_t irq = sched_port_irq_save();
+    uint32_t depth = work_tail - work_head;
+
+    if (depth >= SCHED_WORK_DEPTH) {
+        work_dropped++;
+        sched_port_irq_restore(irq);
+        return -1;
+    }
+
+    work[work_tail & WORK_MASK].fn = fn;
+    work[work_tail & WORK_MASK].arg = arg;
+    work_tail++;
+
+    if (depth + 1 > work_high_water) {
+        work_high_water = depth + 1;
+    }
+    sched_port_irq_restore(irq);
+    return 0;
+}
+
+static void call(sched_fn_t fn, void *arg) {
+    uint32_t start = sched_port_cycles();
+    fn(arg);
+    uint32_t cycles = sched_port_cycles() - start;
+    if (cycles > longest_cycles) {
+        longest_cycles = cycles;
+    }
+}
+
+static uint32_t run_timers(uint32_t now) {
+    uint32_t fired = 0;
+
+    // After a stall longer than a turn, one turn still visits every bucket
+    if (now - wheel_now > SCHED_WHEEL_SLOTS) {
+        wheel_now = now - SCHED_WHEEL_SLOTS;
+    }
+
+    while (wheel_now != now) {
+        wheel_now++;
+
+        // Fire one at a time from the head: a callback may start or stop
+        // any timer, including ones in this bucket
+        for (;;) {
+            sched_timer_t *t = wheel[wheel_now & WHEEL_MASK];
+            while (t != NULL && (int32_t)(wheel_now - t->expires) < 0) {
+                t = t->next;
+            }
+            if (t == NULL) {
+                break;
+            }
+
+            timer_unlink(t);
+            if (t->period != 0) {
+                // Missed periods (a stall) are dropped, not replayed
+                t->expires += t->period;
+                if ((int32_t)(t->expires - now) <= 0) {
+                    t->expires = now + t->period;
+                }
+                timer_link(t);
+            }
+
+            call(t->fn, t->arg);
+            fired++;
+        }
+    }
+
+    timers_fired += fired;
+    return fired;
+}
+
+static uint32_t run_work(void) {
+    // Only what is queued now; work that re-posts itself waits a pass so
+    // timers are not starved
+    uint32_t count = work_tail - work_head;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t irq = sched_port_irq_save();
+        sched_work_t item = work[work_head & WORK_MASK];
+        work_head++;
+        sched_port_irq_restore(irq);
+
+        call(item.fn, item.arg);
+    }
+
+    work_run += count;
+    return count;
+}
+
+uint32_t sched_run_once(void) {
+    uint32_t ran = run_timers(sched_port_now_ms());
+    ran += run_work();
+    return ran;
+}
+
+void sched_sleep(void) {
+    uint32_t irq = sched_port_irq_save();
+
+    // Checked with interrupts masked: a post from here on still wakes us
+    if (work_tail == work_head) {
+        account_busy();
+        sched_port_wait();
+        mark = sched_port_cycles();
+        wakeups++;
+    }
+
+    sched_port_irq_restore(irq);
+}
+
+void sched_run(void) {
+    for (;;) {
+        sched_run_once();
+        sched_sleep();
+    }
+}
+
+uint32_t sched_next_expiry(void) {
+    uint32_t now = sched_port_now_ms();
+    uint32_t next = UINT32_MAX;
+
+    for (uint32_t i = 0; i < SCHED_WHEEL_SLOTS; i++) {
+        for (sched_timer_t *t = wheel[i]; t != NULL; t = t->next) {
+            int32_t delta = (int32_t)(t->expires - now);
+            if (delta <= 0) {
+                return 0;
+            }
+            if ((uint32_t)delta < next) {
+                next = (uint32_t)delta;
+            }
+        }
+    }
+    return next;
+}
+
+void sched_get_stats(sched_stats_t *stats, int reset) {
+    uint32_t irq = sched_port_irq_save();
+
+    account_busy();
+
+    uint32_t cycles_per_ms = sched_port_cycles_per_ms();
+    uint32_t elapsed = sched_port_now_ms() - window_start_ms;
+    uint64_t busy_ms = busy_cycles / cycles_per_ms;
+    uint64_t permille = elapsed ? (busy_cycles * 1000) / ((uint64_t)elapsed * cycles_per_ms) : 0;
+
+    stats->elapsed_ms = elapsed;
+    stats->busy_ms = (uint32_t)(busy_ms < elapsed ? busy_ms : elapsed);
+    stats->busy_permille = (uint32_t)(permille < 1000 ? permille : 1000);
+    stats->wakeups = wakeups;
+    stats->timers_fired = timers_fired;
+    stats->work_run = work_run;
+    stats->work_dropped = work_dropped;
+    stats->work_high_water = work_high_water;
+    stats->longest_cycles = longest_cycles;
+
+    if (reset) {
+        reset_stats();
+    }
+
+    sched_port_irq_restore(irq);
+}
+
+void sched_report(void) {
+    sched_stats_t s;
+    sched_get_stats(&s, 1);
+
+    OTA_LOG_INFO("CPU: %lu.%lu%% busy over %lu ms, idle %lu ms, %lu wakeups\r\n",
+                 (unsigned long)(s.busy_permille / 10), (unsigned long)(s.busy_permille % 10),
+                 (unsigned long)s.elapsed_ms, (unsigned long)(s.elapsed_ms - s.busy_ms),
+                 (unsigned long)s.wakeups);
+    OTA_LOG_INFO("     %lu timers, %lu work (%lu dropped, max depth %lu), longest %lu cycles\r\n",
+                 (unsigned long)s.timers_fired, (unsigned long)s.work_run,
+                 (unsigned long)s.work_dropped, (unsigned long)s.work_high_water,
+                 (unsigned long)s.longest_cycles);
+}
@@ -0,0 +1,66 @@
+/*
+ * sched_port.c
+ * STM32 side of sched_port.h, and a sleeping HAL_Delay()
+ */
+
+#include "sched_port.h"
+#include "sched.h"
+#include "main.h"
+
+void sched_port_init(void) {
+    // The bootloader starts DWT at reset; an image loaded by a debugger
+    // may not have it running
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+}
+
+uint32_t sched_port_now_ms(void) {
+    return HAL_GetTick();
+}
+
+uint32_t sched_port_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return SystemCoreClock / 1000;
+}
+
+uint32_t sched_port_irq_save(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    __set_PRIMASK(state);
+}
+
+void sched_port_wait(void) {
+    // The 1 ms HAL tick bounds every sleep, so timers never oversleep
+    __DSB();
+    __WFI();
+}
+
+/**
+ * @brief Overrides the HAL's weak HAL_Delay(): same timing, but the core
+ *        sleeps between ticks instead of polling uwTick
+ *
+ * Blocking code that still calls HAL_Delay() (SDRAM bring-up, the
+ * bootloader's LED blinks) is then idle time, not busy time.
+ */
+void HAL_Delay(uint32_t Delay) {
+    uint32_t start = HAL_GetTick();
+    uint32_t wait = Delay;
+
+    // Same minimum-wait guarantee as the HAL version
+    if (wait < HAL_MAX_DELAY) {
+        wait += (uint32_t)uwTickFreq;
+    }
+
+    while ((HAL_GetTick() - start) < wait) {
+        sched_sleep();
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * slot_select.c
+ * Newest-bootable and least-valuable slot selection
+ */
+
+#include "slot_select.h"
+
+int slot_is_bootable(const boot_slot_t *slot) {
+    return slot->status == BANK_STATUS_VALID || slot->status == BANK_STATUS_TESTING;
+}
+
+int slot_select_newest(const boot_slot_t *slots, uint32_t count, uint32_t skip_mask) {
+    int best = -1;
+    uint32_t best_sequence = 0;
+
+    if (count > SLOT_SELECT_MAX_SLOTS) {
+        count = SLOT_SELECT_MAX_SLOTS;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if ((skip_mask & (1UL << i)) || !slot_is_bootable(&slots[i])) {
+            continue;
+        }
+        if (best < 0 || slots[i].sequence > best_sequence) {
+            best = (int)i;
+            best_sequence = slots[i].sequence;
+        }
+    }
+
+    return best;
+}
+
+int slot_select_target(const boot_slot_t *slots, const uint32_t *capacity, uint32_t count,
+                       uint32_t skip_mask, uint32_t size) {
+    int best = -1;
+    uint32_t best_value = 0;
+
+    if (count > SLOT_SELECT_MAX_SLOTS) {
+        count = SLOT_SELECT_MAX_SLOTS;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if ((skip_mask & (1UL << i)) || capacity[i] < size) {
+            continue;
+        }
+
+        // An unused slot is worth nothing; otherwise older is worth less.
+        // Sequences start at 1, so 0 never collides with an install.
+        uint32_t value = slot_is_bootable(&slots[i]) ? slots[i].sequence : 0;
+
+        if (best < 0 || value < best_value) {
+            best = (int)i;
+            best_value = value;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,670 @@
+/*
+ * ota_fec_bench.c
+ *
+ * Host benchmark of DATA goodput against packet loss, with and without
+ * PARITY packets (ota_fec.c), on a simulated slow link.
+ *
+ * The "device" is the real ota_link.c and ota_fec.c on a virtual-time
+ * port of sched_port.h, with a stand-in ota_manager that checks chunks
+ * like ota_manager.c does and writes them to a RAM image, checked
+ * against the image CRC at END. The "sender" runs the credit window the
+ * device grants (ota_link_credits()) and rewinds to last_chunk_received
+ * on a NACK or a timeout; with FEC it follows every group of K chunks
+ * with that group's PARITY packet.
+ *
+ * The link is a BLE UART bridge by default: the sender's bytes go out at
+ * the bridge's line rate in 20-byte writes and arrive after a fixed
+ * latency; responses are never lost. Two loss models, each damaging the
+ * given fraction of DATA/PARITY packets:
+ *   corrupt  one byte of the data field flipped (a chunk CRC failure)
+ *   drop     one 20-byte write lost (a short packet, which the framer
+ *            gives up at the start of the next one)
+ *
+ * Goodput is image bytes over the time from START's ACK to the last
+ * chunk's ACK, in B/s, averaged over several seeds, next to the number
+ * of packets sent again. Time is simulated, so a sweep takes moments and
+ * the numbers are the protocol's, with flash time taken out.
+ *
+ * PARITY costs 1/K of the line whatever the loss; what it saves is the
+ * resend of everything in flight behind a lost chunk. So the trade turns
+ * on the window: with the UART ring's 3 credits little is in flight, and
+ * it takes a deeper rx window (the last argument), stranding more
+ * packets behind each loss, before parity pays.
+ *
+ * Build and run from the repository root:
+ * (-iquote, not -I: Common/OTA/Inc/sched.h would hide the system <sched.h>)
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -iquote Common/OTA/Inc \
+ *       -iquote Application/Core/Inc Host/ota_fec_bench.c Common/OTA/Src/ota_link.c \
+ *       Common/OTA/Src/ota_fec.c Common/OTA/Src/ota_fountain.c \
+ *       Common/OTA/Src/ota_governor.c Common/OTA/Src/sched.c -o ota_fec_bench \
+ *     && ./ota_fec_bench [-v] [image KB] [B/s] [latency ms] [rx window bytes]
+ * (-v shows the device's console output)
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ota_link.h"
+#include "ota_protocol.h"
+#include "sched.h"
+#include "sched_port.h"
+
+#define DEFAULT_IMAGE_KB    64
+#define DEFAULT_RATE        960     // HM-10 bridge at 9600 baud
+#define DEFAULT_LATENCY_MS  30      // About one connection interval
+#define WRITE_SIZE          20      // BLE write without response
+#define DEFAULT_RX_WINDOW   4096    // The UART driver's ring: 3 credits
+#define MAX_RX_WINDOW       (OTA_MAX_CREDITS * sizeof(ota_data_packet_t))
+#define SEEDS               5
+#define QUEUE_LEN           64
+
+static const double loss_rates[] = { 0.0, 0.005, 0.01, 0.02, 0.05, 0.10, 0.20 };
+static const int groups[] = { 0, 8, 4, 2 };   // 0 = no PARITY
+
+static FILE *out;               // Results; stdout is the device's console
+
+static uint32_t crc32_le(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// ota_manager.c's, for ota_fec.c
+uint32_t calculate_crc32(const void *data, size_t length) {
+    return crc32_le(data, (uint32_t)length);
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int chance(double p) {
+    return (rng() & 0xFFFFFF) < p * 0x1000000;
+}
+
+/* ---- sched_port.h in virtual time ---- */
+
+static uint64_t now_us;
+
+void sched_port_init(void) {
+}
+
+uint32_t sched_port_now_ms(void) {
+    return (uint32_t)(now_us / 1000);
+}
+
+// Microseconds stand in for cycles
+uint32_t sched_port_cycles(void) {
+    return (uint32_t)now_us;
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return 1000;
+}
+
+uint32_t sched_port_irq_save(void) {
+    return 0;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+// Nothing else happens until the bench moves the clock
+void sched_port_wait(void) {
+}
+
+/* ---- The link: timed byte queues both ways ---- */
+
+typedef struct {
+    uint64_t at;
+    uint16_t len;
+    uint8_t bytes[sizeof(ota_data_packet_t)];
+} flight_t;
+
+typedef struct {
+    flight_t slot[QUEUE_LEN];
+    uint32_t head, count;
+} queue_t;
+
+static queue_t to_device, to_host;
+static uint8_t device_rx[MAX_RX_WINDOW];
+static uint32_t device_rx_len;
+static uint32_t latency_us;
+
+static int queue_push(queue_t *q, uint64_t at, const void *data, uint16_t len) {
+    if (q->count == QUEUE_LEN) {
+        return -1;
+    }
+    flight_t *f = &q->slot[(q->head + q->count++) % QUEUE_LEN];
+    f->at = at;
+    f->len = len;
+    memcpy(f->bytes, data, len);
+    return 0;
+}
+
+static flight_t *queue_due(queue_t *q, uint64_t now) {
+    if (q->count == 0 || q->slot[q->head].at > now) {
+        return NULL;
+    }
+    flight_t *f = &q->slot[q->head];
+    q->head = (q->head + 1) % QUEUE_LEN;
+    q->count--;
+    return f;
+}
+
+static uint64_t queue_next(const queue_t *q) {
+    return (q->count != 0) ? q->slot[q->head].at : UINT64_MAX;
+}
+
+static int air_open(ota_transport_t *t) {
+    (void)t;
+    return 0;
+}
+
+static void air_close(ota_transport_t *t) {
+    (void)t;
+}
+
+static int air_send(ota_transport_t *t, const void *data, uint16_t size) {
+    uint64_t airtime = (uint64_t)size * 1000000 / t->bytes_per_sec;
+    return (queue_push(&to_host, now_us + airtime + latency_us, data, size) == 0) ? size : 0;
+}
+
+static int air_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    (void)t;
+    if (size > device_rx_len) {
+        size = device_rx_len;
+    }
+    memcpy(buf, device_rx, size);
+    memmove(device_rx, device_rx + size, device_rx_len - size);
+    device_rx_len -= size;
+    return size;
+}
+
+static ota_transport_t air = {
+    .name = "ble-sim",
+    .mtu = WRITE_SIZE,
+    .open = air_open,
+    .close = air_close,
+    .send = air_send,
+    .recv = air_recv,
+};
+
+static void device_deliver(const flight_t *f) {
+    uint32_t n = f->len;
+    if (n > air.rx_window - device_rx_len) {
+        n = air.rx_window - device_rx_len;          // Overrun: the ring drops
+    }
+    memcpy(device_rx + device_rx_len, f->bytes, n);
+    device_rx_len += n;
+    air.rx_ready();
+    while (sched_run_once() != 0) {
+    }
+}
+
+/* ---- Stand-in ota_manager: ota_manager.c's checks, a RAM image ---- */
+
+static uint8_t *device_image;
+
+void ota_init(ota_context_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->state = OTA_STATE_IDLE;
+}
+
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+    ota_response_packet_t response;
+
+    response.magic = OTA_MAGIC_START;
+    response.packet_type = packet_type;
+    if (packet_type == OTA_PKT_ACK) {
+        response.credits = ota_link_credits();
+    } else {
+        response.error_code = ctx->error_code;
+    }
+    response.last_chunk_received = ctx->chunks_received;
+    ota_link_send(&response, sizeof(response));
+}
+
+static void nack(ota_context_t *ctx, uint8_t error, int fatal) {
+    ctx->error_code = error;
+    if (fatal) {
+        ctx->state = OTA_STATE_ERROR;
+    }
+    ota_send_response(ctx, OTA_PKT_NACK);
+}
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+    ctx->firmware_size = pkt->firmware_size;
+    ctx->firmware_crc32 = pkt->firmware_crc32;
+    ctx->total_chunks = pkt->total_chunks;
+    ctx->state = OTA_STATE_RECEIVING_DATA;
+    ota_send_response(ctx, OTA_PKT_ACK);
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    if ((ctx->state == OTA_STATE_RECEIVING_DATA || ctx->state == OTA_STATE_VERIFYING) &&
+        pkt->chunk_number < ctx->chunks_received) {
+        ota_send_response(ctx, OTA_PKT_ACK);
+        return;
+    }
+    if (ctx->state != OTA_STATE_RECEIVING_DATA || pkt->magic != OTA_MAGIC_DATA) {
+        nack(ctx, OTA_ERR_SEQUENCE, 1);
+        return;
+    }
+    if (pkt->chunk_number != ctx->expected_chunk_number) {
+        nack(ctx, OTA_ERR_SEQUENCE, 0);
+        return;
+    }
+    if (pkt->chunk_size == 0 || pkt->chunk_size > OTA_CHUNK_SIZE) {
+        nack(ctx, OTA_ERR_SIZE, 1);
+        return;
+    }
+    if (crc32_le(pkt->data, pkt->chunk_size) != pkt->chunk_crc32) {
+        nack(ctx, OTA_ERR_CRC, 0);
+        return;
+    }
+    uint32_t offset = pkt->chunk_number * OTA_CHUNK_SIZE;
+    if (offset + pkt->chunk_size > ctx->firmware_size) {
+        nack(ctx, OTA_ERR_SIZE, 1);
+        return;
+    }
+
+    memcpy(device_image + offset, pkt->data, pkt->chunk_size);
+    ctx->chunks_received++;
+    ctx->expected_chunk_number++;
+    ctx->bytes_written += pkt->chunk_size;
+    ota_send_response(ctx, OTA_PKT_ACK);
+
+    if (ctx->chunks_received == ctx->total_chunks) {
+        ctx->state = OTA_STATE_VERIFYING;
+    }
+}
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+    (void)pkt;
+    if (ctx->state != OTA_STATE_VERIFYING ||
+        crc32_le(device_image, ctx->firmware_size) != ctx->firmware_crc32) {
+        nack(ctx, OTA_ERR_CRC, 1);
+        return;
+    }
+    ctx->state = OTA_STATE_COMPLETE;
+    ota_send_response(ctx, OTA_PKT_ACK);
+    ota_link_on_complete(ctx);
+}
+
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    return 0;
+}
+
+/* ---- Sender ---- */
+
+typedef struct {
+    const uint8_t *image;
+    uint32_t size;
+    uint32_t total;             // Chunks
+    int group;                  // Chunks per PARITY, 0 = none
+    int model;                  // 0 = corrupt, 1 = drop
+    double loss;
+    uint32_t rate;              // Line rate, B/s
+
+    int32_t *items;             // Send order: chunk number, or -1 - first chunk for PARITY
+    uint32_t *item_of;          // Chunk number -> index in items
+    uint32_t count;
+
+    uint32_t resent;            // Packets sent again
+} sender_t;
+
+static void sender_plan(sender_t *s) {
+    s->items = malloc(sizeof(int32_t) * 2 * (s->total + 1));
+    s->item_of = malloc(sizeof(uint32_t) * (s->total + 1));
+    s->count = 0;
+
+    for (uint32_t c = 0; c < s->total; c++) {
+        s->item_of[c] = s->count;
+        s->items[s->count++] = (int32_t)c;
+        if (s->group != 0 && ((c + 1) % s->group == 0 || c + 1 == s->total)) {
+            s->items[s->count++] = -1 - (int32_t)(c - c % s->group);
+        }
+    }
+    s->item_of[s->total] = s->count;
+}
+
+static void build_data(const sender_t *s, uint32_t chunk, ota_data_packet_t *pkt) {
+    uint32_t offset = chunk * OTA_CHUNK_SIZE;
+    uint32_t n = (s->size - offset < OTA_CHUNK_SIZE) ? s->size - offset : OTA_CHUNK_SIZE;
+
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->magic = OTA_MAGIC_DATA;
+    pkt->packet_type = OTA_PKT_DATA;
+    pkt->chunk_number = chunk;
+    pkt->chunk_size = n;
+    memcpy(pkt->data, s->image + offset, n);
+    pkt->chunk_crc32 = crc32_le(pkt->data, n);
+}
+
+static void build_parity(const sender_t *s, uint32_t first, ota_data_packet_t *pkt) {
+    ota_data_packet_t chunk;
+
+    memset(pkt, 0, sizeof(*pkt));
+    for (uint32_t c = first; c < first + s->group && c < s->total; c++) {
+        build_data(s, c, &chunk);
+        for (uint32_t i = 0; i < OTA_CHUNK_SIZE; i++) {
+            pkt->data[i] ^= chunk.data[i];
+        }
+    }
+    pkt->magic = OTA_MAGIC_DATA;
+    pkt->packet_type = OTA_PKT_PARITY;
+    pkt->chunk_number = first;
+    pkt->chunk_size = s->group;
+    pkt->chunk_crc32 = crc32_le(pkt->data, OTA_CHUNK_SIZE);
+}
+
+/* Put one packet on the wire from start_us; returns when the line is free */
+static uint64_t transmit(sender_t *s, const void *pkt, uint16_t len, uint64_t start_us, int lossy) {
+    uint8_t bytes[sizeof(ota_data_packet_t)];
+    uint16_t n = len;
+    uint64_t done_us = start_us + (uint64_t)len * 1000000 / s->rate;
+
+    memcpy(bytes, pkt, len);
+    if (lossy && chance(s->loss)) {
+        if (s->model == 0) {
+            uint32_t at = offsetof(ota_data_packet_t, data) + rng() % OTA_CHUNK_SIZE;
+            bytes[at] ^= 1 + rng() % 255;
+        } else {
+            uint32_t write = rng() % ((len + WRITE_SIZE - 1) / WRITE_SIZE);
+            uint32_t at = write * WRITE_SIZE;
+            uint32_t cut = (len - at < WRITE_SIZE) ? len - at : WRITE_SIZE;
+            memmove(bytes + at, bytes + at + cut, len - at - cut);
+            n = len - cut;
+        }
+    }
+    queue_push(&to_device, done_us + latency_us, bytes, n);
+    return done_us;
+}
+
+static int read_response(ota_response_packet_t *resp) {
+    static uint8_t buf[64];
+    static uint32_t len;
+    flight_t *f;
+
+    while ((f = queue_due(&to_host, now_us)) != NULL) {
+        memcpy(buf + len, f->bytes, f->len);
+        len += f->len;
+    }
+    if (len < sizeof(*resp)) {
+        return 0;
+    }
+    memcpy(resp, buf, sizeof(*resp));
+    memmove(buf, buf + sizeof(*resp), len - sizeof(*resp));
+    len -= sizeof(*resp);
+    return resp->magic == OTA_MAGIC_START;
+}
+
+/* Step the device until the response to a lossless packet is in */
+static int exchange(sender_t *s, const void *pkt, uint16_t len, ota_response_packet_t *resp) {
+    flight_t *f;
+
+    transmit(s, pkt, len, now_us, 0);
+    while (queue_next(&to_device) != UINT64_MAX || queue_next(&to_host) != UINT64_MAX) {
+        now_us = (queue_next(&to_device) < queue_next(&to_host)) ? queue_next(&to_device)
+                                                                  : queue_next(&to_host);
+        while ((f = queue_due(&to_device, now_us)) != NULL) {
+            device_deliver(f);
+        }
+        if (read_response(resp)) {
+            return 1;
+        }
+    }
+    return 0;                   // Swallowed by a partial packet
+}
+
+/* Send the image; returns microseconds from START's ACK to the last chunk's, 0 on failure */
+static uint64_t run(sender_t *s) {
+    ota_context_t ctx;
+    ota_response_packet_t resp;
+
+    memset(&to_device, 0, sizeof(to_device));
+    memset(&to_host, 0, sizeof(to_host));
+    device_rx_len = 0;
+    now_us = 0;
+    memset(device_image, 0xFF, s->size);
+    air.bytes_per_sec = s->rate;
+    if (ota_link_start(&ctx, &air, NULL) != 0) {
+        return 0;
+    }
+
+    ota_start_packet_t start = {
+        .magic = OTA_MAGIC_START,
+        .packet_type = OTA_PKT_START,
+        .firmware_size = s->size,
+        .firmware_crc32 = crc32_le(s->image, s->size),
+        .total_chunks = s->total,
+    };
+    if (!exchange(s, &start, sizeof(start), &resp) || resp.packet_type != OTA_PKT_ACK) {
+        return 0;
+    }
+
+    uint64_t begin_us = now_us;
+    uint64_t line_free_us = now_us;
+    uint64_t heard_us = now_us;
+    uint64_t rto_us = 3ULL * sizeof(ota_data_packet_t) * 1000000 / s->rate + 4ULL * latency_us;
+    uint64_t limit_us = begin_us + 200ULL * s->size * 1000000 / s->rate;
+    uint32_t window = resp.credits ? resp.credits : 1;
+    uint32_t next = 0;          // Index into items
+    uint32_t base = 0;          // Chunks acknowledged
+    uint32_t sent_to = 0;       // Highest index sent so far, for counting resends
+    uint32_t unanswered = 0;
+    uint32_t stale = 0;         // Responses still due for packets sent before a rewind
+    ota_data_packet_t pkt;
+    flight_t *f;
+
+    s->resent = 0;
+
+    while (base < s->total) {
+        if (next < s->count && unanswered < window && line_free_us <= now_us) {
+            int32_t item = s->items[next];
+            if (item >= 0) {
+                build_data(s, (uint32_t)item, &pkt);
+            } else {
+                build_parity(s, (uint32_t)(-1 - item), &pkt);
+            }
+            if (unanswered == 0) {
+                heard_us = now_us;
+            }
+            line_free_us = transmit(s, &pkt, sizeof(pkt), now_us, 1);
+            if (next < sent_to) {
+                s->resent++;
+            }
+            next++;
+            if (next > sent_to) {
+                sent_to = next;
+            }
+            unanswered++;
+            continue;
+        }
+
+        uint64_t t = queue_next(&to_device);
+        if (queue_next(&to_host) < t) {
+            t = queue_next(&to_host);
+        }
+        if (next < s->count && unanswered < window && line_free_us < t) {
+            t = line_free_us;
+        }
+        if (unanswered > 0 && heard_us + rto_us < t) {
+            t = heard_us + rto_us;
+        }
+        if (t == UINT64_MAX || t > limit_us) {
+            return 0;
+        }
+        if (t > now_us) {
+            now_us = t;
+        }
+
+        while ((f = queue_due(&to_device, now_us)) != NULL) {
+            device_deliver(f);
+        }
+
+        while (read_response(&resp)) {
+            heard_us = now_us;
+            if (unanswered > 0) {
+                unanswered--;
+            }
+            if (resp.last_chunk_received > base) {
+                base = resp.last_chunk_received;
+                if (next < s->item_of[base]) {
+                    next = s->item_of[base];
+                }
+            }
+            if (stale > 0) {
+                stale--;
+                continue;
+            }
+            if (resp.packet_type == OTA_PKT_ACK) {
+                window = resp.credits ? resp.credits : 1;
+            } else if (resp.error_code != OTA_ERR_BUSY) {
+                next = s->item_of[base];
+                stale = unanswered;
+            }
+        }
+
+        if (unanswered > 0 && now_us >= heard_us + rto_us) {
+            // Nothing heard: whatever is outstanding was lost or swallowed
+            next = s->item_of[base];
+            unanswered = 0;
+            stale = 0;
+            heard_us = now_us;
+        }
+    }
+    uint64_t elapsed_us = now_us - begin_us;
+
+    // Let what is still on the wire land and its responses drain, then END
+    while (queue_next(&to_device) != UINT64_MAX) {
+        now_us = queue_next(&to_device);
+        f = queue_due(&to_device, now_us);
+        device_deliver(f);
+    }
+    now_us += rto_us;
+    while (read_response(&resp)) {
+    }
+    ota_end_packet_t end = { .magic = OTA_MAGIC_START, .packet_type = OTA_PKT_END };
+    int ended = 0;
+    for (int attempt = 0; attempt < 2 && !ended; attempt++) {
+        ended = exchange(s, &end, sizeof(end), &resp);
+        now_us += OTA_LINK_GAP_MAX_MS * 1000ULL;  // Past any partial packet it landed in
+    }
+    if (!ended || resp.packet_type != OTA_PKT_ACK) {
+        return 0;
+    }
+    ota_link_stop();
+    return elapsed_us;
+}
+
+/* ---- Sweep ---- */
+
+int main(int argc, char **argv) {
+    int verbose = 0;
+    int arg = 1;
+
+    if (argc > arg && strcmp(argv[arg], "-v") == 0) {
+        verbose = 1;
+        arg++;
+    }
+    uint32_t size = ((argc > arg) ? (uint32_t)atoi(argv[arg]) : DEFAULT_IMAGE_KB) * 1024;
+    uint32_t rate = (argc > arg + 1) ? (uint32_t)atoi(argv[arg + 1]) : DEFAULT_RATE;
+    latency_us = ((argc > arg + 2) ? (uint32_t)atoi(argv[arg + 2]) : DEFAULT_LATENCY_MS) * 1000;
+    air.rx_window = (argc > arg + 3) ? (uint32_t)atoi(argv[arg + 3]) : DEFAULT_RX_WINDOW;
+    if (size == 0 || rate == 0 || air.rx_window < sizeof(ota_data_packet_t) ||
+        air.rx_window > MAX_RX_WINDOW) {
+        fprintf(stderr, "usage: %s [-v] [image KB] [B/s] [latency ms] [rx window bytes, %u..%u]\n",
+                argv[0], (unsigned)sizeof(ota_data_packet_t), (unsigned)MAX_RX_WINDOW);
+        return 1;
+    }
+
+    // The engine prints to stdout as it would to the board's console
+    out = fdopen(dup(fileno(stdout)), "w");
+    if (!verbose) {
+        freopen("/dev/null", "w", stdout);
+    }
+
+    uint8_t *image = malloc(size);
+    device_image = malloc(size);
+    rng_state = 0x12345678;
+    for (uint32_t i = 0; i < size; i++) {
+        image[i] = (uint8_t)rng();
+    }
+    sched_init();
+
+    fprintf(out, "%lu KB image, %lu B/s line, %lu ms latency, %lu byte window (%u credits), %d seeds per cell\n",
+            (unsigned long)(size / 1024), (unsigned long)rate, (unsigned long)(latency_us / 1000),
+            (unsigned long)air.rx_window, (unsigned)(air.rx_window / sizeof(ota_data_packet_t)), SEEDS);
+    fprintf(out, "goodput B/s / packets resent per run\n");
+
+    int failures = 0;
+    for (int model = 0; model < 2; model++) {
+        fprintf(out, "\n%-8s", model ? "drop" : "corrupt");
+        for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+            char label[16];
+            if (groups[g] == 0) {
+                snprintf(label, sizeof(label), "no FEC");
+            } else {
+                snprintf(label, sizeof(label), "K=%d", groups[g]);
+            }
+            fprintf(out, "  %14s", label);
+        }
+        fprintf(out, "\n");
+
+        for (size_t l = 0; l < sizeof(loss_rates) / sizeof(loss_rates[0]); l++) {
+            fprintf(out, "%6.1f%% ", loss_rates[l] * 100);
+            for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+                sender_t s = {
+                    .image = image, .size = size,
+                    .total = (size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE,
+                    .group = groups[g], .model = model, .loss = loss_rates[l], .rate = rate,
+                };
+                sender_plan(&s);
+
+                double goodput = 0, resent = 0;
+                int ok = 0;
+                for (int seed = 1; seed <= SEEDS; seed++) {
+                    rng_state = 0x9E3779B9u * seed;
+                    uint64_t us = run(&s);
+                    if (us == 0) {
+                        failures++;
+                        continue;
+                    }
+                    goodput += (double)size * 1000000 / us;
+                    resent += s.resent;
+                    ok++;
+                }
+                if (ok == 0) {
+                    fprintf(out, "  %14s", "FAILED");
+                } else {
+                    char cell[32];
+                    snprintf(cell, sizeof(cell), "%.0f / %.1f", goodput / ok, resent / ok);
+                    fprintf(out, "  %14s", cell);
+                }
+                free(s.items);
+                free(s.item_of);
+            }
+            fprintf(out, "\n");
+        }
+    }
+
+    fprintf(out, "\n%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    free(image);
+    free(device_image);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * ota_fountain_sim.c
+ *
+ * Host simulation of a broadcast update (OTA_PKT_SYMBOL, ota_fountain.c)
+ * to many devices at once, against updating them one at a time.
+ *
+ * The broadcaster runs a carousel with no feedback: each pass sends,
+ * segment by segment, the segment's chunks plus R repair symbols, with
+ * sequence numbers carrying on from pass to pass so no symbol repeats
+ * (the first pass starts with the chunks themselves). Every receiver is
+ * the real ota_fountain.c in front of a stand-in ota_manager that checks
+ * chunks like ota_manager.c and writes them to a RAM image, checked
+ * against the image CRC at END. Receivers lose symbols independently at
+ * the given rate; they are run one after another over the same carousel,
+ * which is the same thing since nothing flows back.
+ *
+ * Airtime is counted in packets, the cost that matters on a shared
+ * radio: for the broadcast, the symbols sent until the last receiver has
+ * installed the image; point to point, the DATA packets a sender with an
+ * ideal resend (no timeouts, no round trips) puts on the air for each
+ * device in turn. The second is the floor for any point-to-point scheme,
+ * so the ratio is on the unicast side's favour.
+ *
+ * A receiver that misses too much of a segment in one pass finishes it
+ * on the next and carries on from there, so R trades airtime per pass
+ * against the passes the worst receiver needs: too few repair symbols
+ * and the carousel runs long waiting for it.
+ *
+ * With -f, the symbols are read from a file instead (ota_broadcast.py
+ * --output) and played round until one receiver has the image, as a
+ * check of the host encoder.
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -ICommon/OTA/Inc -IApplication/Core/Inc \
+ *       Host/ota_fountain_sim.c Common/OTA/Src/ota_fountain.c -o ota_fountain_sim \
+ *     && ./ota_fountain_sim [image KB] [receivers] [repair symbols per segment]
+ *   ./ota_fountain_sim -f symbols.bin [loss %]
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ota_fountain.h"
+
+#define DEFAULT_IMAGE_KB    64
+#define DEFAULT_RECEIVERS   100
+#define DEFAULT_REPAIR      4
+#define MAX_PASSES          100
+
+static const double loss_rates[] = { 0.0, 0.01, 0.02, 0.05, 0.10, 0.20, 0.30 };
+
+static FILE *out;               // Results; stdout is the devices' console
+
+static uint32_t crc32_le(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// ota_manager.c's, for ota_fountain.c
+uint32_t calculate_crc32(const void *data, size_t length) {
+    return crc32_le(data, (uint32_t)length);
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int chance(double p) {
+    return (rng() & 0xFFFFFF) < p * 0x1000000;
+}
+
+/* ---- Stand-in ota_manager: ota_manager.c's checks, a RAM image ---- */
+
+static uint8_t *device_image;
+
+void ota_init(ota_context_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->state = OTA_STATE_IDLE;
+}
+
+// Broadcast receivers answer nothing; ota_link.c drops it
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+}
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+    ctx->firmware_size = pkt->firmware_size;
+    ctx->firmware_version = pkt->firmware_version;
+    ctx->firmware_crc32 = pkt->firmware_crc32;
+    ctx->total_chunks = pkt->total_chunks;
+    ctx->state = OTA_STATE_RECEIVING_DATA;
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    if (ctx->state != OTA_STATE_RECEIVING_DATA || pkt->magic != OTA_MAGIC_DATA ||
+        pkt->chunk_number != ctx->expected_chunk_number ||
+        pkt->chunk_size == 0 || pkt->chunk_size > OTA_CHUNK_SIZE ||
+        crc32_le(pkt->data, pkt->chunk_size) != pkt->chunk_crc32 ||
+        pkt->chunk_number * OTA_CHUNK_SIZE + pkt->chunk_size > ctx->firmware_size) {
+        ctx->state = OTA_STATE_ERROR;
+        return;
+    }
+
+    memcpy(device_image + pkt->chunk_number * OTA_CHUNK_SIZE, pkt->data, pkt->chunk_size);
+    ctx->chunks_received++;
+    ctx->expected_chunk_number++;
+    ctx->bytes_written += pkt->chunk_size;
+    if (ctx->chunks_received == ctx->total_chunks) {
+        ctx->state = OTA_STATE_VERIFYING;
+    }
+}
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+    if (ctx->state != OTA_STATE_VERIFYING || pkt->magic != OTA_MAGIC_START ||
+        crc32_le(device_image, ctx->firmware_size) != ctx->firmware_crc32) {
+        ctx->state = OTA_STATE_ERROR;
+        return;
+    }
+    ctx->state = OTA_STATE_COMPLETE;
+}
+
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    return 0;
+}
+
+/* ---- Broadcaster ---- */
+
+typedef struct {
+    const uint8_t *image;
+    uint32_t size;
+    uint32_t crc;
+    uint32_t total;             // Chunks
+    uint32_t segments;
+    uint32_t repair;            // Symbols per segment per pass past its chunks
+} carousel_t;
+
+static uint32_t segment_chunks(const carousel_t *c, uint32_t segment) {
+    uint32_t n = c->total - segment * OTA_FOUNTAIN_SEGMENT;
+    return (n > OTA_FOUNTAIN_SEGMENT) ? OTA_FOUNTAIN_SEGMENT : n;
+}
+
+static void make_symbol(const carousel_t *c, uint32_t segment, uint32_t sequence,
+                        ota_symbol_packet_t *pkt) {
+    uint32_t chunks = segment_chunks(c, segment);
+    uint32_t mask;
+
+    pkt->magic = OTA_MAGIC_DATA;
+    pkt->packet_type = OTA_PKT_SYMBOL;
+    pkt->firmware_size = c->size;
+    pkt->firmware_version = 0x01000000;
+    pkt->firmware_crc32 = c->crc;
+    pkt->symbol_id = segment << 16 | sequence;
+    mask = ota_fountain_mask(pkt->symbol_id, chunks);
+
+    memset(pkt->data, 0, OTA_CHUNK_SIZE);
+    for (uint32_t i = 0; i < chunks; i++) {
+        if (!(mask & (1UL << i))) {
+            continue;
+        }
+        uint32_t offset = (segment * OTA_FOUNTAIN_SEGMENT + i) * OTA_CHUNK_SIZE;
+        for (uint32_t b = 0; b < OTA_CHUNK_SIZE; b++) {
+            pkt->data[b] ^= (offset + b < c->size) ? c->image[offset + b] : 0xFF;
+        }
+    }
+    pkt->packet_crc32 = crc32_le((const uint8_t *)pkt, offsetof(ota_symbol_packet_t, packet_crc32));
+}
+
+/* ---- Receivers ---- */
+
+typedef struct {
+    uint32_t airtime;           // Symbols sent when the last receiver finished
+    uint32_t passes;            // Of the carousel, for the last receiver
+    uint32_t failed;            // Receivers that did not finish, or installed garbage
+    uint64_t redundant;         // Symbols heard and not used, over all receivers
+    uint64_t heard;
+} result_t;
+
+/* One receiver over the carousel; symbols on air until it finished, 0 if never */
+static uint32_t receive(const carousel_t *c, double loss, ota_fountain_stats_t *st) {
+    static ota_symbol_packet_t pkt;
+    ota_context_t ctx;
+    uint32_t sent = 0;
+
+    ota_init(&ctx);
+    ota_fountain_reset();
+    memset(device_image, 0, c->size);
+
+    for (uint32_t pass = 0; pass < MAX_PASSES; pass++) {
+        for (uint32_t s = 0; s < c->segments; s++) {
+            uint32_t per_pass = segment_chunks(c, s) + c->repair;
+            for (uint32_t j = 0; j < per_pass; j++) {
+                sent++;
+                if (chance(loss)) {
+                    continue;
+                }
+                make_symbol(c, s, pass * per_pass + j, &pkt);
+                ota_fountain_symbol(&ctx, &pkt);
+                if (ctx.state == OTA_STATE_COMPLETE || ctx.state == OTA_STATE_ERROR) {
+                    ota_fountain_get_stats(st);
+                    return (ctx.state == OTA_STATE_COMPLETE) ? sent : 0;
+                }
+            }
+        }
+    }
+    ota_fountain_get_stats(st);
+    return 0;
+}
+
+static result_t broadcast(const carousel_t *c, uint32_t receivers, double loss) {
+    result_t r = { 0 };
+    uint32_t per_pass = c->total + c->segments * c->repair;
+
+    for (uint32_t n = 0; n < receivers; n++) {
+        ota_fountain_stats_t st;
+        rng_state = 0x9E3779B9 * (n + 1);
+        uint32_t sent = receive(c, loss, &st);
+        if (sent == 0) {
+            r.failed++;
+            continue;
+        }
+        if (sent > r.airtime) {
+            r.airtime = sent;
+            r.passes = (sent + per_pass - 1) / per_pass;
+        }
+        r.heard += st.symbols;
+        r.redundant += st.redundant + st.other_segment;
+    }
+    return r;
+}
+
+/* DATA packets for one device at a time, every loss resent at once */
+static uint64_t point_to_point(const carousel_t *c, uint32_t receivers, double loss) {
+    uint64_t sent = 0;
+
+    for (uint32_t n = 0; n < receivers; n++) {
+        rng_state = 0x7F4A7C15 * (n + 1);
+        for (uint32_t i = 0; i < c->total; i++) {
+            do {
+                sent++;
+            } while (chance(loss));
+        }
+    }
+    return sent;
+}
+
+/* ---- A symbol stream from ota_broadcast.py ---- */
+
+static int decode_file(const char *path, double loss) {
+    FILE *f = fopen(path, "rb");
+    static ota_symbol_packet_t pkt;
+    ota_context_t ctx;
+    uint32_t read_count = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    if (fread(&pkt, sizeof(pkt), 1, f) != 1) {
+        fprintf(out, "%s: no symbols\n", path);
+        return 1;
+    }
+    device_image = malloc(pkt.firmware_size);
+    rewind(f);
+
+    ota_init(&ctx);
+    ota_fountain_reset();
+    rng_state = 0x2545F491;
+    for (int round = 0; round < MAX_PASSES && ctx.state != OTA_STATE_COMPLETE &&
+                        ctx.state != OTA_STATE_ERROR; round++) {
+        rewind(f);
+        while (fread(&pkt, sizeof(pkt), 1, f) == 1) {
+            read_count++;
+            if (chance(loss)) {
+                continue;
+            }
+            ota_fountain_symbol(&ctx, &pkt);
+            if (ctx.state == OTA_STATE_COMPLETE || ctx.state == OTA_STATE_ERROR) {
+                break;
+            }
+        }
+    }
+    fclose(f);
+
+    ota_fountain_stats_t st;
+    ota_fountain_get_stats(&st);
+    fprintf(out, "%s: %lu byte image, %lu symbols read, %lu used, %lu redundant, %lu bad CRC: %s\n",
+            path, ctx.firmware_size, read_count, st.innovative, st.redundant, st.bad_crc,
+            ctx.state == OTA_STATE_COMPLETE ? "installed" : "FAILED");
+    return ctx.state == OTA_STATE_COMPLETE ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    freopen("/dev/null", "w", stdout);
+
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        return decode_file(argv[2], (argc > 3) ? atof(argv[3]) / 100 : 0.0);
+    }
+
+    uint32_t kb = (argc > 1) ? (uint32_t)atoi(argv[1]) : DEFAULT_IMAGE_KB;
+    uint32_t receivers = (argc > 2) ? (uint32_t)atoi(argv[2]) : DEFAULT_RECEIVERS;
+    uint32_t repair = (argc > 3) ? (uint32_t)atoi(argv[3]) : DEFAULT_REPAIR;
+    uint32_t size = kb * 1024 - 77;     // A short last chunk
+    uint8_t *image = malloc(size);
+    int failures = 0;
+
+    rng_state = 12345;
+    for (uint32_t i = 0; i < size; i++) {
+        image[i] = (uint8_t)rng();
+    }
+    device_image = malloc(size);
+
+    carousel_t c = {
+        .image = image,
+        .size = size,
+        .crc = crc32_le(image, size),
+        .total = (size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE,
+        .repair = repair,
+    };
+    c.segments = (c.total + OTA_FOUNTAIN_SEGMENT - 1) / OTA_FOUNTAIN_SEGMENT;
+
+    fprintf(out, "%lu byte image, %lu chunks in %lu segments of up to %d; "
+            "%lu receivers, %lu repair symbols per segment per pass\n\n",
+            size, c.total, c.segments, OTA_FOUNTAIN_SEGMENT, receivers, repair);
+    fprintf(out, "  loss   broadcast pkts  passes  unused   point-to-point pkts   ratio\n");
+
+    for (size_t l = 0; l < sizeof(loss_rates) / sizeof(loss_rates[0]); l++) {
+        result_t r = broadcast(&c, receivers, loss_rates[l]);
+        uint64_t p2p = point_to_point(&c, receivers, loss_rates[l]);
+
+        if (r.failed != 0) {
+            fprintf(out, "%5.1f%%   %lu of %lu receivers unfinished after %d passes\n",
+                    loss_rates[l] * 100, r.failed, receivers, MAX_PASSES);
+            failures++;
+            continue;
+        }
+        fprintf(out, "%5.1f%%   %14lu  %6lu  %5.1f%%   %19llu  %5.1fx\n", loss_rates[l] * 100,
+                r.airtime, r.passes, r.heard ? 100.0 * r.redundant / r.heard : 0.0,
+                (unsigned long long)p2p, (double)p2p / r.airtime);
+    }
+
+    fprintf(out, "\n%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,326 @@
+/*
+ * ota_framer_bench.c
+ *
+ * Host benchmark of the packet framer in ota_link.c against bytes lost
+ * from or added to the stream, as a UART overrun or line noise does.
+ *
+ * A run of DATA packets is edited at random, byte by byte: deleted,
+ * inserted (a random byte before it), or either. The edited stream goes
+ * through the real ota_link.c on a virtual-time port of sched_port.h, in
+ * the reads the UART driver would hand it, into a stand-in ota_manager
+ * that only records which packets arrived exactly as sent. Next to it,
+ * the same stream goes through a framer that commits to a packet's body
+ * once its 5-byte header is in, as the link did before it could reframe;
+ * with it, a short packet swallows the start of the next one.
+ *
+ * For each edit rate (per byte) the table shows the packets that were
+ * edited, and of the packets that were not, how many each framer lost
+ * anyway ("collateral"); for ota_link.c also the frames it gave up at a
+ * packet start inside them. A framer that resynchronises well loses the
+ * edited packets and nothing more. The stream never pauses, so the
+ * stalled-packet gap (ota_link.h) plays no part; on a link that
+ * goes quiet after a short packet, the next packet to arrive reframes it
+ * just the same.
+ *
+ * Build and run from the repository root:
+ * (-iquote, not -I: Common/OTA/Inc/sched.h would hide the system <sched.h>)
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -iquote Common/OTA/Inc \
+ *       -iquote Application/Core/Inc Host/ota_framer_bench.c Common/OTA/Src/ota_link.c \
+ *       Common/OTA/Src/ota_fec.c Common/OTA/Src/ota_fountain.c \
+ *       Common/OTA/Src/ota_governor.c Common/OTA/Src/sched.c -o ota_framer_bench \
+ *     && ./ota_framer_bench [packets]
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ota_link.h"
+#include "ota_protocol.h"
+#include "sched.h"
+#include "sched_port.h"
+
+#define DEFAULT_PACKETS     2000
+#define READ_SIZE           64      // What rx_task takes from the driver at a time
+#define SEEDS               3
+
+static const double edit_rates[] = { 1e-5, 1e-4, 1e-3, 3e-3 };
+static const char *const models[] = { "delete", "insert", "both" };
+
+static FILE *out;               // Results; stdout is the device's console
+
+static uint32_t crc32_le(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// ota_manager.c's, for ota_link.c and ota_fec.c
+uint32_t calculate_crc32(const void *data, size_t length) {
+    return crc32_le(data, (uint32_t)length);
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int chance(double p) {
+    return (rng() & 0xFFFFFF) < p * 0x1000000;
+}
+
+/* ---- sched_port.h in virtual time; the clock never moves ---- */
+
+void sched_port_init(void) {
+}
+
+uint32_t sched_port_now_ms(void) {
+    return 0;
+}
+
+uint32_t sched_port_cycles(void) {
+    return 0;
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return 1000;
+}
+
+uint32_t sched_port_irq_save(void) {
+    return 0;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+void sched_port_wait(void) {
+}
+
+/* ---- The link: the edited stream, READ_SIZE bytes at a time ---- */
+
+static const uint8_t *wire;
+static size_t wire_len, wire_pos;
+
+static int wire_open(ota_transport_t *t) {
+    return 0;
+}
+
+static void wire_close(ota_transport_t *t) {
+}
+
+static int wire_send(ota_transport_t *t, const void *data, uint16_t size) {
+    return size;                // Responses are not looked at
+}
+
+static int wire_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    size_t n = wire_len - wire_pos;
+    if (n > size) {
+        n = size;
+    }
+    memcpy(buf, wire + wire_pos, n);
+    wire_pos += n;
+    return (int)n;
+}
+
+static ota_transport_t wire_transport = {
+    .name = "wire",
+    .open = wire_open,
+    .close = wire_close,
+    .send = wire_send,
+    .recv = wire_recv,
+};
+
+/* ---- Stand-in ota_manager: which packets came through whole ---- */
+
+static const uint8_t *sent;     // The packets as sent, back to back
+static uint32_t packet_count;
+static uint8_t *arrived;        // Per packet: came through exactly as sent
+
+static void record(uint32_t n, uint16_t size, uint32_t crc, const uint8_t *data, uint8_t *mark) {
+    const ota_data_packet_t *as_sent;
+
+    if (n >= packet_count) {
+        return;
+    }
+    as_sent = (const ota_data_packet_t *)(sent + n * sizeof(ota_data_packet_t));
+    if (size == as_sent->chunk_size && crc == as_sent->chunk_crc32 &&
+        memcmp(data, as_sent->data, OTA_CHUNK_SIZE) == 0) {
+        mark[n] = 1;
+    }
+}
+
+void ota_init(ota_context_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->state = OTA_STATE_IDLE;
+}
+
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+}
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    record(pkt->chunk_number, pkt->chunk_size, pkt->chunk_crc32, pkt->data, arrived);
+}
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+}
+
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    return 0;
+}
+
+/* ---- The framer the link had: commit once the header is in ---- */
+
+static void committed_framer(const uint8_t *stream, size_t len, uint8_t *mark) {
+    static uint8_t packet[sizeof(ota_data_packet_t)];
+    static const uint32_t magics[] = { OTA_MAGIC_START, OTA_MAGIC_DATA };
+    uint32_t packet_len = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        packet[packet_len++] = stream[i];
+        for (;;) {
+            uint32_t n = (packet_len < 4) ? packet_len : 4;
+            int ok = packet_len == 0 || memcmp(packet, &magics[0], n) == 0 ||
+                     memcmp(packet, &magics[1], n) == 0;
+            if (ok && packet_len >= 5) {
+                ok = packet[4] == OTA_PKT_DATA;
+            }
+            if (ok) {
+                break;
+            }
+            memmove(packet, packet + 1, --packet_len);
+        }
+        if (packet_len == sizeof(ota_data_packet_t)) {
+            const ota_data_packet_t *pkt = (const ota_data_packet_t *)packet;
+            record(pkt->chunk_number, pkt->chunk_size, pkt->chunk_crc32, pkt->data, mark);
+            packet_len = 0;
+        }
+    }
+}
+
+/* ---- Bench ---- */
+
+/* Copy src to dst with random edits; marks the packets touched */
+static size_t edit(const uint8_t *src, size_t len, uint8_t *dst, int model, double rate,
+                   uint8_t *edited) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        uint32_t p = (uint32_t)(i / sizeof(ota_data_packet_t));
+        if (model != 0 && chance(rate)) {
+            dst[n++] = (uint8_t)rng();
+            edited[p] = 1;
+        }
+        if (model != 1 && chance(rate)) {
+            edited[p] = 1;
+            continue;
+        }
+        dst[n++] = src[i];
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+    uint32_t count = (argc > 1) ? (uint32_t)atoi(argv[1]) : DEFAULT_PACKETS;
+    size_t len = (size_t)count * sizeof(ota_data_packet_t);
+    uint8_t *stream = malloc(len);
+    uint8_t *edited_stream = malloc(len * 2);
+    uint8_t *edited = malloc(count);
+    uint8_t *baseline = malloc(count);
+    ota_context_t ctx;
+    int failures = 0;
+
+    if (count == 0) {
+        fprintf(stderr, "usage: %s [packets]\n", argv[0]);
+        return 1;
+    }
+
+    // The engine prints to stdout as it would to the board's console
+    out = fdopen(dup(fileno(stdout)), "w");
+    freopen("/dev/null", "w", stdout);
+
+    rng_state = 0x12345678;
+    for (uint32_t c = 0; c < count; c++) {
+        ota_data_packet_t *pkt = (ota_data_packet_t *)(stream + c * sizeof(ota_data_packet_t));
+        pkt->magic = OTA_MAGIC_DATA;
+        pkt->packet_type = OTA_PKT_DATA;
+        pkt->chunk_number = c;
+        pkt->chunk_size = OTA_CHUNK_SIZE;
+        for (uint32_t i = 0; i < OTA_CHUNK_SIZE; i++) {
+            pkt->data[i] = (uint8_t)rng();
+        }
+        pkt->chunk_crc32 = crc32_le(pkt->data, OTA_CHUNK_SIZE);
+    }
+    sent = stream;
+    packet_count = count;
+    arrived = malloc(count);
+    sched_init();
+
+    fprintf(out, "%lu DATA packets, %d seeds per row; collateral = packets lost that were not edited\n\n",
+            (unsigned long)count, SEEDS);
+    fprintf(out, "%-7s %8s %8s   %-24s %s\n", "edits", "per byte", "edited",
+            "reframing (ota_link.c)", "committed header");
+    fprintf(out, "%-7s %8s %8s   %10s %13s %10s\n", "", "", "", "collateral", "broken frames",
+            "collateral");
+
+    for (int model = 0; model < 3; model++) {
+        for (size_t r = 0; r < sizeof(edit_rates) / sizeof(edit_rates[0]); r++) {
+            uint32_t hit = 0, lost = 0, lost_before = 0;
+            uint64_t broken = 0;
+
+            for (int seed = 0; seed < SEEDS; seed++) {
+                rng_state = 0x9E3779B9 * (seed + 1) + (uint32_t)r * 7919 + model;
+                memset(edited, 0, count);
+                memset(arrived, 0, count);
+                memset(baseline, 0, count);
+                wire = edited_stream;
+                wire_len = edit(stream, len, edited_stream, model, edit_rates[r], edited);
+                wire_pos = 0;
+
+                ota_link_stats_t ls;
+                wire_transport.rx_window = READ_SIZE;
+                ota_link_start(&ctx, &wire_transport, NULL);
+                while (wire_pos < wire_len) {
+                    wire_transport.rx_ready();
+                    while (sched_run_once() != 0) {
+                    }
+                }
+                ota_link_get_stats(&ls);
+                ota_link_stop();
+                broken += ls.broken_frames;
+                committed_framer(edited_stream, wire_len, baseline);
+
+                for (uint32_t c = 0; c < count; c++) {
+                    hit += edited[c];
+                    if (!edited[c]) {
+                        lost += !arrived[c];
+                        lost_before += !baseline[c];
+                    }
+                    // An edited packet can only come through if the edit cancelled out
+                    if (edited[c] && arrived[c] && !baseline[c]) {
+                        failures++;
+                    }
+                }
+            }
+            fprintf(out, "%-7s %8.0e %8.1f   %10.1f %13.1f %10.1f\n", models[model],
+                    edit_rates[r], (double)hit / SEEDS, (double)lost / SEEDS,
+                    (double)broken / SEEDS, (double)lost_before / SEEDS);
+        }
+    }
+
+    fprintf(out, "\n%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
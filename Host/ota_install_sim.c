@@ -0,0 +1,256 @@
+/*
+ * ota_install_sim.c
+ *
+ * Host run of the install path (ota_manager.c, boot_state.c,
+ * image_header.c) against a RAM flash: a headered image is sent as
+ * START / DATA / END, then offered again the way a broadcast repeats it.
+ *
+ * Installing stamps the header's install words, so the CRC of the slot
+ * no longer matches the CRC the sender announced. The receiver decides
+ * whether to take a broadcast with ota_image_recorded() on the sender's
+ * CRC alone (version 0, as a sender without one sends it), which must
+ * still recognise the image it has just installed.
+ *
+ * Flash is 2MB mapped at FLASH_BASE_ADDRESS so the modules' uint32_t
+ * addresses work as pointers; erase sets 0xFF and programming can only
+ * clear bits, as on the chip. Host/target stands in for main.h and
+ * ota_config.h.
+ *
+ * Build and run from the repository root:
+ *   S=Common/OTA/Src
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast \
+ *       -iquote Host/target -iquote Common/OTA/Inc Host/ota_install_sim.c \
+ *       $S/ota_manager.c $S/boot_state.c $S/image_header.c $S/flash_layout.c \
+ *       $S/slot_select.c $S/ota_reloc.c -o ota_install_sim && ./ota_install_sim
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "main.h"
+#include "ota_manager.h"
+#include "ota_crc.h"
+#include "ota_link.h"
+#include "ota_governor.h"
+#include "boot_state.h"
+#include "boot_trial.h"
+#include "image_header.h"
+#include "flash_layout.h"
+
+#define IMAGE_SIZE      (20 * 1024 + 100)
+#define IMAGE_VERSION   0x01020003
+
+static int failures;
+
+#define CHECK(cond, ...) do {                   \
+    if (!(cond)) {                              \
+        printf("FAIL: " __VA_ARGS__);           \
+        printf("\n");                           \
+        failures++;                             \
+    }                                           \
+} while (0)
+
+/* ---- RAM flash behind the HAL calls flash_layout.c makes ---- */
+
+static int flash_locked = 1;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { flash_locked = 0; return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASH_Lock(void) { flash_locked = 1; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t type, uint32_t address, uint64_t data) {
+    if (flash_locked || type != FLASH_TYPEPROGRAM_WORD || (address & 3) ||
+        address < FLASH_BASE_ADDRESS || address >= FLASH_BASE_ADDRESS + FLASH_TOTAL_SIZE) {
+        return HAL_ERROR;
+    }
+    *(volatile uint32_t*)address &= (uint32_t)data;  // 1 -> 0 only
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *init, uint32_t *sector_error) {
+    if (flash_locked || init->Sector + init->NbSectors > FLASH_NUM_SECTORS) {
+        *sector_error = init->Sector;
+        return HAL_ERROR;
+    }
+    for (uint32_t n = init->Sector; n < init->Sector + init->NbSectors; n++) {
+        memset((void*)FLASH_SECTOR_START(n), 0xFF, FLASH_SECTOR_SIZE(n));
+    }
+    *sector_error = 0xFFFFFFFF;
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void) { return 0; }
+
+/* ---- ota_crc.h on the CPU: STM32 CRC32, one running value ---- */
+
+static uint32_t crc_value;
+
+static uint32_t crc_word(uint32_t crc, uint32_t word) {
+    crc ^= word;
+    for (int i = 0; i < 32; i++) {
+        crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+    }
+    return crc;
+}
+
+uint32_t ota_crc_words(const uint32_t *words, uint32_t count, int reset) {
+    if (reset) {
+        crc_value = 0xFFFFFFFF;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        crc_value = crc_word(crc_value, words[i]);
+    }
+    return crc_value;
+}
+
+uint32_t ota_crc_accumulate(uint32_t address, uint32_t size) {
+    ota_crc_words((const uint32_t*)address, size / 4, 0);
+    if (size % 4) {
+        uint32_t last_word = 0;
+        memcpy(&last_word, (const uint8_t*)address + size - size % 4, size % 4);
+        ota_crc_words(&last_word, 1, 0);
+    }
+    return crc_value;
+}
+
+uint32_t ota_crc_calculate(uint32_t address, uint32_t size) {
+    crc_value = 0xFFFFFFFF;
+    return ota_crc_accumulate(address, size);
+}
+
+uint32_t ota_crc_calculate_cpu(uint32_t address, uint32_t size) {
+    return ota_crc_calculate(address, size);
+}
+
+/* ---- What the install path calls besides ---- */
+
+static int completed;
+
+void ota_link_send(const void *data, uint16_t size) { (void)data; (void)size; }
+uint8_t ota_link_credits(void) { return 1; }
+void ota_link_on_complete(ota_context_t *ctx) { (void)ctx; completed++; }
+uint32_t ota_gov_begin(void) { return 0; }
+void ota_gov_end_flash(uint32_t start) { (void)start; }
+void boot_watchdog_kick(void) {}
+
+/* ---- The image and the sender ---- */
+
+/* A built .bin: vector table, header patched as ota_image_tool.py does
+   (install words left erased), then code */
+static void build_image(uint8_t *image, uint32_t size, uint32_t load_address) {
+    for (uint32_t i = 0; i < size; i++) {
+        image[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    image_header_t *hdr = (image_header_t*)(image + IMAGE_HEADER_OFFSET);
+    memset(hdr, 0xFF, sizeof(*hdr));
+    hdr->magic = IMAGE_HEADER_MAGIC;
+    hdr->header_size = sizeof(image_header_t);
+    hdr->image_size = size;
+    hdr->fw_version = IMAGE_VERSION;
+    hdr->load_address = load_address;
+    hdr->flags = 0;
+
+    uint32_t tail = IMAGE_HEADER_OFFSET + sizeof(image_header_t);
+    ota_crc_words((const uint32_t*)image, IMAGE_HEADER_OFFSET / 4, 1);
+    uint32_t last_word = 0;
+    uint32_t words = (size - tail) / 4;
+    ota_crc_words((const uint32_t*)(image + tail), words, 0);
+    memcpy(&last_word, image + tail + words * 4, (size - tail) % 4);
+    hdr->image_crc32 = ((size - tail) % 4) ? ota_crc_words(&last_word, 1, 0) : crc_value;
+
+    hdr->header_crc32 = ota_crc_words((const uint32_t*)hdr, 7, 1);
+}
+
+static uint32_t stream_crc32(const uint8_t *image, uint32_t size) {
+    uint32_t words = size / 4;
+    uint32_t crc = ota_crc_words((const uint32_t*)image, words, 1);
+    if (size % 4) {
+        uint32_t last_word = 0;
+        memcpy(&last_word, image + words * 4, size % 4);
+        crc = ota_crc_words(&last_word, 1, 0);
+    }
+    return crc;
+}
+
+/* One point-to-point transfer; returns the final state */
+static ota_state_t send_image(const uint8_t *image, uint32_t size, uint32_t crc, uint8_t slot) {
+    static ota_context_t ctx;
+    static ota_data_packet_v2_t data;
+    ota_start_packet_t start = {
+        .magic = OTA_MAGIC_START,
+        .packet_type = OTA_PKT_START,
+        .firmware_size = size,
+        .firmware_version = 0,
+        .firmware_crc32 = crc,
+        .total_chunks = (size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE,
+        .target_bank = slot,
+    };
+    ota_end_packet_t end = { .magic = OTA_MAGIC_START, .packet_type = OTA_PKT_END };
+
+    ota_init(&ctx);
+    ota_process_start_packet(&ctx, &start);
+
+    for (uint32_t n = 0; n < start.total_chunks && ctx.state == OTA_STATE_RECEIVING_DATA; n++) {
+        uint32_t offset = n * OTA_CHUNK_SIZE;
+        memset(&data, 0, sizeof(data));
+        data.magic = OTA_MAGIC_DATA;
+        data.packet_type = OTA_PKT_DATA_V2;
+        data.chunk_number = n;
+        data.chunk_size = (size - offset < OTA_CHUNK_SIZE) ? size - offset : OTA_CHUNK_SIZE;
+        memcpy(data.data, image + offset, data.chunk_size);
+        data.chunk_crc32 = calculate_crc32(data.data, data.chunk_size);
+        ota_process_data_packet(&ctx, &data);
+    }
+
+    if (ctx.state == OTA_STATE_VERIFYING) {
+        ota_process_end_packet(&ctx, &end);
+    }
+    return ctx.state;
+}
+
+int main(void) {
+    void *flash = mmap((void*)FLASH_BASE_ADDRESS, FLASH_TOTAL_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (flash != (void*)FLASH_BASE_ADDRESS) {
+        printf("cannot map flash at 0x%08X\n", FLASH_BASE_ADDRESS);
+        return 2;
+    }
+    memset(flash, 0xFF, FLASH_TOTAL_SIZE);
+
+    static uint8_t image[IMAGE_SIZE];
+    build_image(image, IMAGE_SIZE, BANK_A_ADDRESS);
+    uint32_t crc = stream_crc32(image, IMAGE_SIZE);
+    int installs = 0;
+
+    printf("Headered image: %u bytes, stream CRC32 0x%08X\n", IMAGE_SIZE, crc);
+
+    // The same broadcast arrives twice; only the first should install
+    for (int pass = 0; pass < 2; pass++) {
+        if (ota_image_recorded(0, crc)) {
+            printf("pass %d: already recorded, skipped\n", pass + 1);
+            continue;
+        }
+        ota_state_t state = send_image(image, IMAGE_SIZE, crc, BANK_A);
+        CHECK(state == OTA_STATE_COMPLETE, "pass %d: install ended in state %d", pass + 1, state);
+        printf("pass %d: installed\n", pass + 1);
+        installs++;
+    }
+
+    const image_header_t *hdr = image_header_get(BANK_A_ADDRESS);
+    boot_state_t state;
+
+    CHECK(installs == 1 && completed == 1, "image installed %d times", installs);
+    CHECK(hdr != NULL && image_header_is_installed(hdr, BANK_A_ADDRESS), "header not stamped");
+    CHECK(boot_state_read(&state) == 0, "no boot record");
+    CHECK(state.slots[BANK_A].image_crc32 == ota_crc_calculate(BANK_A_ADDRESS, IMAGE_SIZE),
+          "record does not hold the CRC of the slot");
+    CHECK(state.slots[BANK_A].image_crc32 != crc, "stamped image still has the stream CRC");
+    CHECK(ota_image_recorded(0, crc), "installed image not recognised");
+    CHECK(!ota_image_recorded(0, crc ^ 1), "another image taken as recorded");
+    CHECK(!ota_image_recorded(IMAGE_VERSION + 1, crc ^ 1), "another version taken as recorded");
+
+    printf("%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
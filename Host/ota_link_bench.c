@@ -0,0 +1,377 @@
+/*
+ * ota_link_bench.c
+ *
+ * Host benchmark of the OTA engine (ota_link.c) over each host transport
+ * (Host/ota_transport_fd.c), side by side.
+ *
+ * The "device" is the real ota_link.c, sched.c and ota_governor.c on a
+ * host port of sched_port.h, with a stand-in ota_manager that checks
+ * chunk CRCs and acknowledges instead of writing flash. The "sender" is
+ * a thread speaking ota_protocol.h stop-and-wait: START, every DATA
+ * chunk, END, each waiting for its response, with a few bytes of console
+ * noise in front of START for the framer to skip.
+ *
+ * Per transport it reports goodput and the response round trip, so the
+ * numbers are the engine and link cost with flash taken out; on the
+ * board, a UART's line rate (bytes_per_sec) is the ceiling on top.
+ *
+ * Build and run from the repository root:
+ * (-iquote, not -I: Common/OTA/Inc/sched.h would hide the system <sched.h>)
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -pthread -iquote Common/OTA/Inc \
+ *       -iquote Application/Core/Inc -iquote Host \
+ *       Host/ota_link_bench.c Host/ota_transport_fd.c Common/OTA/Src/ota_link.c \
+ *       Common/OTA/Src/ota_fec.c Common/OTA/Src/ota_fountain.c \
+ *       Common/OTA/Src/ota_governor.c Common/OTA/Src/sched.c -o ota_link_bench && ./ota_link_bench [image KB]
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "ota_link.h"
+#include "ota_protocol.h"
+#include "sched.h"
+#include "sched_port.h"
+#include "ota_transport_fd.h"
+
+#define DEFAULT_IMAGE_KB    256
+#define RESPONSE_TIMEOUT_MS 2000
+
+static const uint8_t console_noise[] = "Boot\r\n";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t crc32_le(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// ota_manager.c's, for ota_fec.c
+uint32_t calculate_crc32(const void *data, size_t length) {
+    return crc32_le(data, (uint32_t)length);
+}
+
+/* ---- sched_port.h on the host ---- */
+
+static ota_transport_t *waiting_on;     // Transport whose data ends a sleep
+
+void sched_port_init(void) {
+}
+
+uint32_t sched_port_now_ms(void) {
+    return (uint32_t)(now_ns() / 1000000);
+}
+
+// Nanoseconds stand in for cycles
+uint32_t sched_port_cycles(void) {
+    return (uint32_t)now_ns();
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return 1000000;
+}
+
+uint32_t sched_port_irq_save(void) {
+    return 0;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+// Where the board would WFI until the UART interrupt or the 1 ms tick
+void sched_port_wait(void) {
+    if (waiting_on != NULL && waiting_on->priv != NULL) {
+        ota_transport_fd_wait(waiting_on, 1);
+    } else {
+        usleep(1000);
+    }
+}
+
+/* ---- Stand-in ota_manager: checks and acknowledges, no flash ---- */
+
+static volatile int device_done;
+
+void ota_init(ota_context_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->state = OTA_STATE_IDLE;
+}
+
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+    ota_response_packet_t response;
+
+    response.magic = OTA_MAGIC_START;
+    response.packet_type = packet_type;
+    if (packet_type == OTA_PKT_ACK) {
+        response.credits = ota_link_credits();
+    } else {
+        response.error_code = ctx->error_code;
+    }
+    response.last_chunk_received = ctx->chunks_received;
+    ota_link_send(&response, sizeof(response));
+}
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+    ctx->firmware_size = pkt->firmware_size;
+    ctx->firmware_crc32 = pkt->firmware_crc32;
+    ctx->total_chunks = pkt->total_chunks;
+    ctx->state = OTA_STATE_RECEIVING_DATA;
+    ota_send_response(ctx, OTA_PKT_ACK);
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    if (ctx->state != OTA_STATE_RECEIVING_DATA || pkt->chunk_number != ctx->expected_chunk_number ||
+        pkt->chunk_size > OTA_CHUNK_SIZE) {
+        ctx->error_code = OTA_ERR_SEQUENCE;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+    if (crc32_le(pkt->data, pkt->chunk_size) != pkt->chunk_crc32) {
+        ctx->error_code = OTA_ERR_CRC;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+
+    ctx->error_code = OTA_ERR_NONE;
+    ctx->chunks_received++;
+    ctx->expected_chunk_number++;
+    ctx->bytes_written += pkt->chunk_size;
+    ota_send_response(ctx, OTA_PKT_ACK);
+
+    if (ctx->chunks_received == ctx->total_chunks) {
+        ctx->state = OTA_STATE_VERIFYING;
+    }
+}
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+    if (ctx->state != OTA_STATE_VERIFYING || ctx->bytes_written != ctx->firmware_size) {
+        ctx->error_code = OTA_ERR_SIZE;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+    ctx->state = OTA_STATE_COMPLETE;
+    ota_send_response(ctx, OTA_PKT_ACK);
+    ota_link_on_complete(ctx);
+}
+
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    return 0;
+}
+
+static void device_complete(void) {
+    device_done = 1;
+}
+
+/* ---- Sender thread ---- */
+
+typedef struct {
+    int fd;
+    const uint8_t *image;
+    uint32_t size;
+    int ok;
+    uint64_t elapsed_ns;
+    uint64_t rtt_total_ns;
+    uint64_t rtt_max_ns;
+    uint32_t packets;
+} sender_t;
+
+static int write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_response(int fd, ota_response_packet_t *resp) {
+    uint8_t *p = (uint8_t*)resp;
+    size_t got = 0;
+
+    while (got < sizeof(*resp)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, RESPONSE_TIMEOUT_MS) <= 0) {
+            return -1;
+        }
+        ssize_t n = read(fd, p + got, sizeof(*resp) - got);
+        if (n <= 0) {
+            return -1;
+        }
+        got += n;
+    }
+    return (resp->magic == OTA_MAGIC_START) ? 0 : -1;
+}
+
+// One packet, one response; returns 0 on ACK
+static int exchange(sender_t *s, const void *pkt, size_t len) {
+    ota_response_packet_t resp;
+    uint64_t start = now_ns();
+
+    if (write_all(s->fd, pkt, len) != 0 || read_response(s->fd, &resp) != 0) {
+        return -1;
+    }
+
+    uint64_t rtt = now_ns() - start;
+    s->rtt_total_ns += rtt;
+    if (rtt > s->rtt_max_ns) {
+        s->rtt_max_ns = rtt;
+    }
+    s->packets++;
+    return (resp.packet_type == OTA_PKT_ACK) ? 0 : -1;
+}
+
+static void *sender_main(void *arg) {
+    sender_t *s = arg;
+    uint32_t chunks = (s->size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
+    uint64_t start = now_ns();
+
+    ota_start_packet_t start_pkt = {
+        .magic = OTA_MAGIC_START,
+        .packet_type = OTA_PKT_START,
+        .firmware_size = s->size,
+        .firmware_version = 0x01000000,
+        .firmware_crc32 = crc32_le(s->image, s->size),
+        .total_chunks = chunks,
+        .target_bank = OTA_TARGET_AUTO,
+    };
+
+    s->ok = 0;
+    if (write_all(s->fd, console_noise, sizeof(console_noise) - 1) != 0 ||
+        exchange(s, &start_pkt, sizeof(start_pkt)) != 0) {
+        return NULL;
+    }
+
+    static ota_data_packet_t data_pkt;
+    for (uint32_t i = 0; i < chunks; i++) {
+        uint32_t offset = i * OTA_CHUNK_SIZE;
+        uint16_t n = (s->size - offset > OTA_CHUNK_SIZE) ? OTA_CHUNK_SIZE : s->size - offset;
+
+        data_pkt.magic = OTA_MAGIC_DATA;
+        data_pkt.packet_type = OTA_PKT_DATA;
+        data_pkt.chunk_number = i;
+        data_pkt.chunk_size = n;
+        memset(data_pkt.data, 0xFF, sizeof(data_pkt.data));
+        memcpy(data_pkt.data, s->image + offset, n);
+        data_pkt.chunk_crc32 = crc32_le(data_pkt.data, n);
+
+        if (exchange(s, &data_pkt, sizeof(data_pkt)) != 0) {
+            return NULL;
+        }
+    }
+
+    ota_end_packet_t end_pkt = { .magic = OTA_MAGIC_START, .packet_type = OTA_PKT_END };
+    if (exchange(s, &end_pkt, sizeof(end_pkt)) != 0) {
+        return NULL;
+    }
+
+    s->elapsed_ns = now_ns() - start;
+    s->ok = 1;
+    return NULL;
+}
+
+/* ---- Bench ---- */
+
+static int open_peer_pty(const char *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd >= 0) {
+        struct termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static int run(const char *kind, const uint8_t *image, uint32_t size) {
+    static ota_context_t ctx;
+    ota_transport_t t;
+    int peer = -1;
+
+    if (strcmp(kind, "pty") == 0) {
+        char path[64];
+        if (ota_transport_pty(&t, path, sizeof(path)) != 0 || (peer = open_peer_pty(path)) < 0) {
+            return -1;
+        }
+    } else if (ota_transport_loopback(&t, &peer) != 0) {
+        return -1;
+    }
+
+    device_done = 0;
+    waiting_on = &t;
+    if (ota_link_start(&ctx, &t, device_complete) != 0) {
+        return -1;
+    }
+
+    sender_t s = { .fd = peer, .image = image, .size = size };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sender_main, &s);
+
+    // The device's main loop, until the sender is done either way
+    uint64_t deadline = now_ns() + 60ULL * 1000000000ULL;
+    while (!device_done && now_ns() < deadline) {
+        sched_run_once();
+        sched_sleep();
+    }
+    pthread_join(thread, NULL);
+
+    ota_link_stats_t ls;
+    ota_link_get_stats(&ls);
+    ota_link_stop();
+    waiting_on = NULL;
+    close(peer);
+
+    if (!s.ok || !device_done) {
+        printf("%-9s FAILED after %u packets\n", kind, s.packets);
+        return -1;
+    }
+
+    double secs = s.elapsed_ns / 1e9;
+    printf("%-9s %8.1f KB/s %9.0f pkt/s %8.1f us avg %8.1f us max %6u resync\n",
+           kind, size / 1024.0 / secs, s.packets / secs,
+           s.rtt_total_ns / 1e3 / s.packets, s.rtt_max_ns / 1e3, ls.resync_bytes);
+
+    return (ls.resync_bytes == sizeof(console_noise) - 1) ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    uint32_t size = (argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_IMAGE_KB) * 1024 - 123;
+    uint8_t *image = malloc(size);
+    int failures = 0;
+
+    srand(1);
+    for (uint32_t i = 0; i < size; i++) {
+        image[i] = (uint8_t)rand();
+    }
+
+    sched_init();
+
+    printf("OTA engine over host transports, %u byte image, stop-and-wait\n\n", size);
+    printf("%-9s %13s %13s %19s %19s\n", "transport", "goodput", "packets", "response RTT", "");
+
+    failures += run("loopback", image, size) != 0;
+    failures += run("pty", image, size) != 0;
+
+    printf("\n%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    free(image);
+    return failures;
+}
@@ -0,0 +1,773 @@
+/*
+ * ota_rto_bench.c
+ *
+ * Host benchmark of retransmit timeouts: fixed ones against one learnt
+ * from measured round trips, over emulated links from good to bad.
+ *
+ * The "device" is the real ota_link.c on a virtual-time port of
+ * sched_port.h (its stall timer included), with a stand-in ota_manager
+ * that takes chunks in order into a RAM image, checked at the end. The
+ * "sender" is the go-back-N of ota_sender.py over the credit window,
+ * with one of three timeouts:
+ *   2 s        ota_sender.py's fixed DATA timeout before it learnt one
+ *   10 s       the uploaders' fixed timeout
+ *   adaptive   ota_sender.py's RttEstimator: SRTT/RTTVAR over chunks
+ *              sent once (Karn), RTO = SRTT + 4 * RTTVAR in 1 s..8 s,
+ *              doubled per timeout in a row, and never below the
+ *              longest stall (plus a quarter) that a timeout was found
+ *              to have fired into spuriously
+ * The timer runs from the last response heard (or the first packet sent
+ * into a quiet link), as in ota_sender.py.
+ *
+ * Each link has a line rate and write size, a latency with random extra
+ * delay per write (order kept), DATA packets that lose one write,
+ * responses lost outright, and now and then a stall (everything on the
+ * way is held up: a missed BLE connection event, a USB host that looks
+ * away) or an outage (everything on the way is lost: a radio fade).
+ *
+ * Per link and timeout: transfer time (START's ACK to the last chunk's),
+ * timeouts, how many of them were spurious (the oldest packet, or an
+ * answer, was still on its way when the timer fired), and dead air: the
+ * time the line sat idle waiting for timeouts that were not spurious,
+ * which a good timeout keeps short. The device's learnt stalled-packet
+ * gap is shown per link. Averages over several seeds; time is simulated.
+ *
+ * On links that stall, the learnt timeout must not fire spuriously more
+ * often than the fixed 2 s it replaced; the first stall of a transfer
+ * comes before there is anything to learn from, which is what the fixed
+ * 10 s avoids by waiting that long on every real loss.
+ *
+ * Build and run from the repository root:
+ * (-iquote, not -I: Common/OTA/Inc/sched.h would hide the system <sched.h>)
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -iquote Common/OTA/Inc \
+ *       -iquote Application/Core/Inc Host/ota_rto_bench.c Common/OTA/Src/ota_link.c \
+ *       Common/OTA/Src/ota_fec.c Common/OTA/Src/ota_fountain.c \
+ *       Common/OTA/Src/ota_governor.c Common/OTA/Src/sched.c -o ota_rto_bench \
+ *     && ./ota_rto_bench [-v] [image KB]
+ * (-v shows the device's console output)
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ota_link.h"
+#include "ota_protocol.h"
+#include "sched.h"
+#include "sched_port.h"
+
+#define DEFAULT_IMAGE_KB    128
+#define SEEDS               5
+#define QUEUE_LEN           256
+#define MAX_RX_WINDOW       (OTA_MAX_CREDITS * sizeof(ota_data_packet_t))
+
+// ota_sender.py's RttEstimator
+#define MIN_RTO_MS          1000
+#define INITIAL_RTO_MS      1000    // Plus a DATA packet's line time
+#define MAX_RTO_MS          8000
+
+typedef struct {
+    const char *name;
+    uint32_t rate;              // Line rate, B/s
+    uint16_t write_size;        // Unit of delay and loss
+    uint32_t rx_window;         // Device receive buffer, bytes
+    uint32_t latency_ms;
+    uint32_t jitter_ms;         // Extra delay per write, 0..jitter_ms
+    double loss;                // DATA packets that lose one write
+    double response_loss;
+    double stall_rate;          // Per DATA packet: the link holds everything for stall_ms
+    uint32_t stall_ms;
+    double outage_rate;         // Per DATA packet: the link loses everything for outage_ms
+    uint32_t outage_ms;
+} link_model_t;
+
+static const link_model_t links[] = {
+    //  name           B/s      write rx    lat jit  loss   resp   stalls       outages
+    { "usb",           1000000, 64,   8192, 1,  1,   0.0,   0.0,   0.0,  0,     0.0,  0    },
+    { "usb stalls",    1000000, 64,   8192, 1,  1,   0.005, 0.0,   0.02, 300,   0.0,  0    },
+    { "uart",          11520,   64,   4096, 1,  0,   0.005, 0.0,   0.0,  0,     0.0,  0    },
+    { "uart noisy",    11520,   64,   4096, 1,  0,   0.05,  0.02,  0.0,  0,     0.0,  0    },
+    { "uart outages",  11520,   64,   4096, 1,  0,   0.01,  0.0,   0.0,  0,     0.02, 500  },
+    { "ble",           960,     20,   4096, 30, 30,  0.005, 0.0,   0.0,  0,     0.0,  0    },
+    { "ble lossy",     960,     20,   4096, 30, 30,  0.05,  0.02,  0.0,  0,     0.0,  0    },
+    { "ble stalls",    960,     20,   4096, 30, 30,  0.01,  0.0,   0.02, 1500,  0.0,  0    },
+    { "ble outages",   960,     20,   4096, 30, 30,  0.01,  0.0,   0.0,  0,     0.02, 3000 },
+};
+
+static const uint32_t fixed_rto_ms[] = { 2000, 10000, 0 };    // 0 = adaptive
+#define BASELINE            0       // fixed_rto_ms[] entry the learnt one replaced
+#define ADAPTIVE            2
+
+static FILE *out;               // Results; stdout is the device's console
+
+static uint32_t crc32_le(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// ota_manager.c's, for ota_link.c and ota_fec.c
+uint32_t calculate_crc32(const void *data, size_t length) {
+    return crc32_le(data, (uint32_t)length);
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int chance(double p) {
+    return (rng() & 0xFFFFFF) < p * 0x1000000;
+}
+
+/* ---- sched_port.h in virtual time ---- */
+
+static uint64_t now_us;
+
+void sched_port_init(void) {
+}
+
+uint32_t sched_port_now_ms(void) {
+    return (uint32_t)(now_us / 1000);
+}
+
+// Microseconds stand in for cycles
+uint32_t sched_port_cycles(void) {
+    return (uint32_t)now_us;
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return 1000;
+}
+
+uint32_t sched_port_irq_save(void) {
+    return 0;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+// Nothing else happens until the bench moves the clock
+void sched_port_wait(void) {
+}
+
+/* ---- The link: timed writes both ways ---- */
+
+typedef struct {
+    uint64_t at;
+    int32_t chunk;              // Of a DATA packet, else -1
+    uint16_t len;
+    uint8_t bytes[64];
+} flight_t;
+
+typedef struct {
+    flight_t slot[QUEUE_LEN];
+    uint32_t head, count;
+    uint64_t last_at;           // Writes arrive in order
+} queue_t;
+
+static const link_model_t *model;
+static queue_t to_device, to_host;
+static uint8_t device_rx[MAX_RX_WINDOW];
+static uint32_t device_rx_len;
+static uint64_t stalled_until;  // The link delivers nothing before this
+static uint64_t outage_from, outage_until;  // ...and loses what would arrive in between
+
+static int queue_push(queue_t *q, uint64_t at, int32_t chunk, const void *data, uint16_t len) {
+    if (at >= outage_from && at < outage_until) {
+        return 0;               // Gone
+    }
+    if (q->count == QUEUE_LEN) {
+        return -1;
+    }
+    if (at < q->last_at) {
+        at = q->last_at;
+    }
+    q->last_at = at;
+    flight_t *f = &q->slot[(q->head + q->count++) % QUEUE_LEN];
+    f->at = at;
+    f->chunk = chunk;
+    f->len = len;
+    memcpy(f->bytes, data, len);
+    return 0;
+}
+
+static flight_t *queue_due(queue_t *q, uint64_t now) {
+    if (q->count == 0 || q->slot[q->head].at > now) {
+        return NULL;
+    }
+    flight_t *f = &q->slot[q->head];
+    q->head = (q->head + 1) % QUEUE_LEN;
+    q->count--;
+    return f;
+}
+
+static uint64_t queue_next(const queue_t *q) {
+    return (q->count != 0) ? q->slot[q->head].at : UINT64_MAX;
+}
+
+/* When a write finished on the line at done_us arrives at the far end */
+static uint64_t arrival(uint64_t done_us) {
+    uint64_t at = done_us + model->latency_ms * 1000ULL;
+    if (model->jitter_ms != 0) {
+        at += rng() % (model->jitter_ms * 1000 + 1);
+    }
+    return (at < stalled_until) ? stalled_until : at;
+}
+
+static int air_open(ota_transport_t *t) {
+    (void)t;
+    return 0;
+}
+
+static void air_close(ota_transport_t *t) {
+    (void)t;
+}
+
+static int lossless;             // While START is exchanged
+
+static int air_send(ota_transport_t *t, const void *data, uint16_t size) {
+    uint64_t done = now_us + (uint64_t)size * 1000000 / t->bytes_per_sec;
+    if (!lossless && chance(model->response_loss)) {
+        return size;
+    }
+    return (queue_push(&to_host, arrival(done), -1, data, size) == 0) ? size : 0;
+}
+
+static int air_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    (void)t;
+    if (size > device_rx_len) {
+        size = device_rx_len;
+    }
+    memcpy(buf, device_rx, size);
+    memmove(device_rx, device_rx + size, device_rx_len - size);
+    device_rx_len -= size;
+    return size;
+}
+
+static ota_transport_t air = {
+    .name = "emulated",
+    .open = air_open,
+    .close = air_close,
+    .send = air_send,
+    .recv = air_recv,
+};
+
+static void device_run(void) {
+    while (sched_run_once() != 0) {
+    }
+}
+
+static void device_deliver(const flight_t *f) {
+    uint32_t n = f->len;
+    if (n > air.rx_window - device_rx_len) {
+        n = air.rx_window - device_rx_len;          // Overrun: the ring drops
+    }
+    memcpy(device_rx + device_rx_len, f->bytes, n);
+    device_rx_len += n;
+    air.rx_ready();
+    device_run();
+}
+
+/* ---- Stand-in ota_manager: chunks in order into a RAM image ---- */
+
+static uint8_t *device_image;
+
+void ota_init(ota_context_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->state = OTA_STATE_IDLE;
+}
+
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+    ota_response_packet_t response;
+
+    response.magic = OTA_MAGIC_START;
+    response.packet_type = packet_type;
+    if (packet_type == OTA_PKT_ACK) {
+        response.credits = ota_link_credits();
+    } else {
+        response.error_code = ctx->error_code;
+    }
+    response.last_chunk_received = ctx->chunks_received;
+    ota_link_send(&response, sizeof(response));
+}
+
+static void nack(ota_context_t *ctx, uint8_t error) {
+    ctx->error_code = error;
+    ota_send_response(ctx, OTA_PKT_NACK);
+}
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+    ctx->firmware_size = pkt->firmware_size;
+    ctx->firmware_crc32 = pkt->firmware_crc32;
+    ctx->total_chunks = pkt->total_chunks;
+    ctx->state = OTA_STATE_RECEIVING_DATA;
+    ota_send_response(ctx, OTA_PKT_ACK);
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    if (pkt->chunk_number < ctx->chunks_received) {
+        ota_send_response(ctx, OTA_PKT_ACK);
+        return;
+    }
+    if (ctx->state != OTA_STATE_RECEIVING_DATA || pkt->chunk_number != ctx->chunks_received) {
+        nack(ctx, OTA_ERR_SEQUENCE);
+        return;
+    }
+    if (crc32_le(pkt->data, pkt->chunk_size) != pkt->chunk_crc32) {
+        nack(ctx, OTA_ERR_CRC);
+        return;
+    }
+
+    memcpy(device_image + pkt->chunk_number * OTA_CHUNK_SIZE, pkt->data, pkt->chunk_size);
+    ctx->chunks_received++;
+    ota_send_response(ctx, OTA_PKT_ACK);
+    if (ctx->chunks_received == ctx->total_chunks) {
+        ctx->state = OTA_STATE_VERIFYING;
+    }
+}
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+    (void)ctx;
+    (void)pkt;
+}
+
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    return 0;
+}
+
+/* ---- Sender ---- */
+
+typedef struct {
+    const uint8_t *image;
+    uint32_t size;
+    uint32_t total;             // Chunks
+    uint32_t fixed_ms;          // Fixed timeout, 0 = learnt
+
+    // Results of a run
+    uint64_t elapsed_us;
+    uint32_t timeouts;
+    uint32_t spurious;
+    uint64_t dead_us;
+    uint32_t resent;
+} sender_t;
+
+static void build_data(const sender_t *s, uint32_t chunk, ota_data_packet_t *pkt) {
+    uint32_t offset = chunk * OTA_CHUNK_SIZE;
+    uint32_t n = (s->size - offset < OTA_CHUNK_SIZE) ? s->size - offset : OTA_CHUNK_SIZE;
+
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->magic = OTA_MAGIC_DATA;
+    pkt->packet_type = OTA_PKT_DATA;
+    pkt->chunk_number = chunk;
+    pkt->chunk_size = n;
+    memcpy(pkt->data, s->image + offset, n);
+    pkt->chunk_crc32 = crc32_le(pkt->data, n);
+}
+
+/* Put one packet on the wire from start_us, write by write; returns when the line is free */
+static uint64_t transmit(const void *pkt, uint16_t len, int32_t chunk, uint64_t start_us, int lossy) {
+    const uint8_t *bytes = pkt;
+    uint32_t writes = (len + model->write_size - 1) / model->write_size;
+    uint32_t lost = (lossy && chance(model->loss)) ? rng() % writes : UINT32_MAX;
+    uint64_t t = start_us;
+
+    if (lossy && chance(model->stall_rate)) {
+        stalled_until = start_us + model->stall_ms * 1000ULL;
+    }
+    if (lossy && chance(model->outage_rate)) {
+        outage_from = start_us;
+        outage_until = start_us + model->outage_ms * 1000ULL;
+    }
+    for (uint32_t w = 0; w < writes; w++) {
+        uint16_t n = (len - w * model->write_size < model->write_size) ? len - w * model->write_size
+                                                                       : model->write_size;
+        t += (uint64_t)n * 1000000 / model->rate;
+        if (w != lost) {
+            queue_push(&to_device, arrival(t), chunk, bytes + w * model->write_size, n);
+        }
+    }
+    return t;
+}
+
+static int read_response(ota_response_packet_t *resp) {
+    static uint8_t buf[256];
+    static uint32_t len;
+    flight_t *f;
+
+    while (len + sizeof(f->bytes) <= sizeof(buf) && (f = queue_due(&to_host, now_us)) != NULL) {
+        memcpy(buf + len, f->bytes, f->len);
+        len += f->len;
+    }
+    if (len < sizeof(*resp)) {
+        return 0;
+    }
+    memcpy(resp, buf, sizeof(*resp));
+    memmove(buf, buf + sizeof(*resp), len - sizeof(*resp));
+    len -= sizeof(*resp);
+    return resp->magic == OTA_MAGIC_START;
+}
+
+/* Would an answer for chunk still come: is it, or any answer, in flight? */
+static int on_its_way(uint32_t chunk) {
+    if (to_host.count != 0) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < to_device.count; i++) {
+        if (to_device.slot[(to_device.head + i) % QUEUE_LEN].chunk == (int32_t)chunk) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t next_event(void) {
+    uint64_t t = queue_next(&to_device);
+    uint32_t timer_ms = sched_next_expiry();
+
+    if (queue_next(&to_host) < t) {
+        t = queue_next(&to_host);
+    }
+    if (timer_ms != UINT32_MAX) {
+        uint64_t at = ((uint64_t)sched_port_now_ms() + timer_ms) * 1000;
+        if (at < t) {
+            t = at;
+        }
+    }
+    return t;
+}
+
+static void advance(uint64_t t) {
+    flight_t *f;
+
+    if (t > now_us) {
+        now_us = t;
+    }
+    while ((f = queue_due(&to_device, now_us)) != NULL) {
+        device_deliver(f);
+    }
+    device_run();               // Timers due now
+}
+
+/* Send the image; 0 on success */
+static int run(sender_t *s) {
+    ota_context_t ctx;
+    ota_response_packet_t resp;
+
+    memset(&to_device, 0, sizeof(to_device));
+    memset(&to_host, 0, sizeof(to_host));
+    device_rx_len = 0;
+    stalled_until = outage_from = outage_until = 0;
+    now_us = 0;
+    memset(device_image, 0xFF, s->size);
+    air.bytes_per_sec = model->rate;
+    air.rx_window = model->rx_window;
+    air.mtu = model->write_size;
+    if (ota_link_start(&ctx, &air, NULL) != 0) {
+        return -1;
+    }
+
+    // START over a clean line: this is about the DATA phase
+    ota_start_packet_t start = {
+        .magic = OTA_MAGIC_START,
+        .packet_type = OTA_PKT_START,
+        .firmware_size = s->size,
+        .firmware_crc32 = crc32_le(s->image, s->size),
+        .total_chunks = s->total,
+    };
+    lossless = 1;
+    transmit(&start, sizeof(start), -1, now_us, 0);
+    resp.packet_type = OTA_PKT_NACK;
+    while (!read_response(&resp) && next_event() != UINT64_MAX) {
+        advance(next_event());
+    }
+    lossless = 0;
+    if (resp.packet_type != OTA_PKT_ACK) {
+        return -1;
+    }
+
+    uint64_t line_us = (uint64_t)sizeof(ota_data_packet_t) * 1000000 / model->rate;
+    uint64_t begin_us = now_us;
+    uint64_t line_free_us = now_us;
+    uint64_t heard_us = now_us;
+    uint64_t limit_us = begin_us + 100 * (line_us * s->total + 10000000ULL);
+    uint64_t rto_us = s->fixed_ms ? s->fixed_ms * 1000ULL : INITIAL_RTO_MS * 1000ULL + line_us;
+    uint64_t *sent_us = calloc(s->total, sizeof(uint64_t));   // 0 = resent (Karn)
+    double srtt = 0, rttvar = 0, min_rtt = 0;
+    int measured = 0;
+    uint64_t stall_floor_us = 0;    // Learnt from spurious timeouts
+    uint64_t silent_from_us = 0;    // Timer start of the last timeout, 0 = none pending
+    uint64_t resent_us = 0;         // ...when its resend went out, 0 = not yet
+    uint64_t quiet_us = 0;          // ...and the silence the link really had
+    uint32_t in_a_row = 0;          // Timeouts since the last progress
+    uint32_t window = resp.credits ? resp.credits : 1;
+    uint32_t next = 0, base = 0, sent_to = 0;
+    uint32_t unanswered = 0, stale = 0;
+    ota_data_packet_t pkt;
+
+    s->timeouts = s->spurious = s->resent = 0;
+    s->dead_us = 0;
+
+    while (base < s->total) {
+        if (next < s->total && unanswered < window && line_free_us <= now_us) {
+            build_data(s, next, &pkt);
+            if (unanswered == 0) {
+                heard_us = now_us;
+            }
+            line_free_us = transmit(&pkt, sizeof(pkt), (int32_t)next, now_us, 1);
+            if (next < sent_to) {
+                s->resent++;
+                sent_us[next] = 0;
+                if (next == base && silent_from_us != 0 && resent_us == 0) {
+                    resent_us = now_us;
+                }
+            } else {
+                sent_us[next] = now_us;
+                sent_to = next + 1;
+            }
+            next++;
+            unanswered++;
+            continue;
+        }
+
+        uint64_t t = next_event();
+        if (next < s->total && unanswered < window && line_free_us < t) {
+            t = line_free_us;
+        }
+        if (base < next && heard_us + rto_us < t) {
+            t = heard_us + rto_us;
+        }
+        if (t == UINT64_MAX || t > limit_us) {
+            free(sent_us);
+            return -1;
+        }
+        advance(t);
+
+        while (read_response(&resp)) {
+            // Progress sooner after a timeout than its resend could be
+            // answered comes from the originals: the silence was a stall
+            if (silent_from_us != 0 && quiet_us == 0 && resp.last_chunk_received > base) {
+                if (resent_us == 0 || now_us - resent_us < (uint64_t)min_rtt) {
+                    quiet_us = now_us - silent_from_us;
+                } else {
+                    silent_from_us = 0;
+                }
+            }
+            // An ACK that does not move base answers a chunk the device
+            // already had: the timeout's resend was spurious (RFC 3708)
+            if (s->fixed_ms == 0 && quiet_us != 0 && resp.packet_type == OTA_PKT_ACK &&
+                resp.last_chunk_received <= base) {
+                uint64_t floor_us = quiet_us + quiet_us / 4;
+                if (floor_us > MAX_RTO_MS * 1000ULL) {
+                    floor_us = MAX_RTO_MS * 1000ULL;
+                }
+                if (floor_us > stall_floor_us) {
+                    stall_floor_us = floor_us;
+                }
+                if (rto_us < stall_floor_us) {
+                    rto_us = stall_floor_us;
+                }
+                silent_from_us = quiet_us = 0;
+            }
+            heard_us = now_us;
+            if (unanswered > 0) {
+                unanswered--;
+            }
+            if (resp.last_chunk_received > base) {
+                uint32_t last = resp.last_chunk_received;
+                if (s->fixed_ms == 0 && sent_us[last - 1] != 0) {
+                    double rtt = (double)(now_us - sent_us[last - 1]);
+                    if (!measured || rtt < min_rtt) {
+                        min_rtt = rtt;
+                    }
+                    if (!measured) {
+                        srtt = rtt;
+                        rttvar = rtt / 2;
+                        measured = 1;
+                    } else {
+                        rttvar += ((rtt > srtt ? rtt - srtt : srtt - rtt) - rttvar) / 4;
+                        srtt += (rtt - srtt) / 8;
+                    }
+                    rto_us = (uint64_t)(srtt + 4 * rttvar);
+                    if (rto_us < MIN_RTO_MS * 1000ULL) {
+                        rto_us = MIN_RTO_MS * 1000ULL;
+                    }
+                    if (rto_us < stall_floor_us) {
+                        rto_us = stall_floor_us;
+                    }
+                    if (rto_us > MAX_RTO_MS * 1000ULL) {
+                        rto_us = MAX_RTO_MS * 1000ULL;
+                    }
+                }
+                base = last;
+                in_a_row = 0;
+                if (next < base) {
+                    next = base;
+                }
+            }
+            if (stale > 0) {
+                stale--;
+                continue;
+            }
+            if (resp.packet_type == OTA_PKT_ACK) {
+                window = resp.credits ? resp.credits : 1;
+            } else {
+                next = base;
+                stale = unanswered;
+            }
+        }
+
+        // As ota_sender.py: any chunk not yet acknowledged keeps the timer going
+        if (base < s->total && base < next && now_us >= heard_us + rto_us) {
+            s->timeouts++;
+            uint64_t idle_from = (line_free_us > heard_us) ? line_free_us : heard_us;
+            if (on_its_way(base)) {
+                s->spurious++;
+            } else if (now_us > idle_from) {
+                s->dead_us += now_us - idle_from;
+            }
+            next = base;
+            unanswered = 0;
+            stale = 0;
+            // Only the first timeout in a row can have fired into a stall
+            silent_from_us = (in_a_row++ == 0) ? heard_us : 0;
+            resent_us = 0;
+            quiet_us = 0;
+            heard_us = now_us;
+            if (s->fixed_ms == 0) {
+                rto_us = (rto_us * 2 > MAX_RTO_MS * 1000ULL) ? MAX_RTO_MS * 1000ULL : rto_us * 2;
+            }
+        }
+    }
+    s->elapsed_us = now_us - begin_us;
+    free(sent_us);
+
+    // Let what is still on the way land before the link goes
+    while (next_event() != UINT64_MAX && next_event() < now_us + 60000000ULL) {
+        advance(next_event());
+        while (read_response(&resp)) {
+        }
+    }
+    ota_link_stop();
+    return memcmp(device_image, s->image, s->size) == 0 ? 0 : -1;
+}
+
+/* ---- Sweep ---- */
+
+int main(int argc, char **argv) {
+    int verbose = 0;
+    int arg = 1;
+
+    if (argc > arg && strcmp(argv[arg], "-v") == 0) {
+        verbose = 1;
+        arg++;
+    }
+    uint32_t size = ((argc > arg) ? (uint32_t)atoi(argv[arg]) : DEFAULT_IMAGE_KB) * 1024;
+    if (size == 0) {
+        fprintf(stderr, "usage: %s [-v] [image KB]\n", argv[0]);
+        return 1;
+    }
+
+    // The engine prints to stdout as it would to the board's console
+    out = fdopen(dup(fileno(stdout)), "w");
+    if (!verbose) {
+        freopen("/dev/null", "w", stdout);
+    }
+
+    uint8_t *image = malloc(size);
+    device_image = malloc(size);
+    rng_state = 0x12345678;
+    for (uint32_t i = 0; i < size; i++) {
+        image[i] = (uint8_t)rng();
+    }
+    sched_init();
+
+    fprintf(out, "%lu KB image, %d seeds per cell\n", (unsigned long)(size / 1024), SEEDS);
+    fprintf(out, "transfer s / timeouts (spurious) / dead air s; device gap = learnt stalled-packet gap\n\n");
+    fprintf(out, "%-13s %8s %6s", "link", "B/s", "gap ms");
+    for (size_t p = 0; p < sizeof(fixed_rto_ms) / sizeof(fixed_rto_ms[0]); p++) {
+        char label[24];
+        if (fixed_rto_ms[p] == 0) {
+            snprintf(label, sizeof(label), "adaptive");
+        } else {
+            snprintf(label, sizeof(label), "fixed %lu s", (unsigned long)(fixed_rto_ms[p] / 1000));
+        }
+        fprintf(out, "  %22s", label);
+    }
+    fprintf(out, "\n");
+
+    int failures = 0;
+    for (size_t l = 0; l < sizeof(links) / sizeof(links[0]); l++) {
+        model = &links[l];
+        double gap = 0;
+        int gaps = 0;
+        char cells[3][48];
+        double spurious_avg[3] = { 0 };
+
+        for (size_t p = 0; p < sizeof(fixed_rto_ms) / sizeof(fixed_rto_ms[0]); p++) {
+            sender_t s = {
+                .image = image, .size = size,
+                .total = (size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE,
+                .fixed_ms = fixed_rto_ms[p],
+            };
+            double secs = 0, timeouts = 0, spurious = 0, dead = 0;
+            int ok = 0;
+
+            for (int seed = 1; seed <= SEEDS; seed++) {
+                // Same link events for every timeout, seed by seed
+                rng_state = 0x9E3779B9u * seed + (uint32_t)l * 7919;
+                if (run(&s) != 0) {
+                    failures++;
+                    continue;
+                }
+                ota_link_stats_t ls;
+                ota_link_get_stats(&ls);
+                if (s.fixed_ms == 0) {
+                    gap += ls.gap_ms;
+                    gaps++;
+                }
+                secs += s.elapsed_us / 1e6;
+                timeouts += s.timeouts;
+                spurious += s.spurious;
+                dead += s.dead_us / 1e6;
+                ok++;
+            }
+            if (ok == 0) {
+                snprintf(cells[p], sizeof(cells[p]), "FAILED");
+            } else {
+                snprintf(cells[p], sizeof(cells[p]), "%.1f / %.1f (%.1f) / %.1f", secs / ok,
+                         timeouts / ok, spurious / ok, dead / ok);
+                spurious_avg[p] = spurious / ok;
+            }
+        }
+
+        fprintf(out, "%-13s %8lu %6.0f", model->name, (unsigned long)model->rate,
+                gaps ? gap / gaps : 0.0);
+        for (size_t p = 0; p < sizeof(fixed_rto_ms) / sizeof(fixed_rto_ms[0]); p++) {
+            fprintf(out, "  %22s", cells[p]);
+        }
+        fprintf(out, "\n");
+
+        if (model->stall_rate > 0 && spurious_avg[ADAPTIVE] > spurious_avg[BASELINE]) {
+            fprintf(out, "FAIL: %s: %.1f spurious timeouts learnt, %.1f fixed\n", model->name,
+                    spurious_avg[ADAPTIVE], spurious_avg[BASELINE]);
+            failures++;
+        }
+    }
+
+    fprintf(out, "\n%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    free(image);
+    free(device_image);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * ota_transport_fd.c
+ * pty and socketpair OTA transports for the host (see ota_transport_fd.h)
+ */
+
+#define _GNU_SOURCE
+#include "ota_transport_fd.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef struct {
+    int fd;         // Engine's end
+    int hold_fd;    // pty slave, held open so the master never sees EIO
+} fd_port_t;
+
+static int fd_open(ota_transport_t *t) {
+    fd_port_t *port = t->priv;
+    int flags = fcntl(port->fd, F_GETFL);
+
+    return (flags < 0 || fcntl(port->fd, F_SETFL, flags | O_NONBLOCK) < 0) ? -1 : 0;
+}
+
+static void fd_close(ota_transport_t *t) {
+    fd_port_t *port = t->priv;
+
+    close(port->fd);
+    if (port->hold_fd >= 0) {
+        close(port->hold_fd);
+    }
+    free(port);
+    t->priv = NULL;
+}
+
+static int fd_send(ota_transport_t *t, const void *data, uint16_t size) {
+    fd_port_t *port = t->priv;
+    ssize_t n = write(port->fd, data, size);
+
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    }
+    return (int)n;
+}
+
+static int fd_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    fd_port_t *port = t->priv;
+    ssize_t n = read(port->fd, buf, size);
+
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    }
+    return (n == 0) ? -1 : (int)n;  // 0 = peer closed
+}
+
+static int fd_setup(ota_transport_t *t, const char *name, int fd, int hold_fd) {
+    fd_port_t *port = malloc(sizeof(*port));
+    if (port == NULL) {
+        return -1;
+    }
+    port->fd = fd;
+    port->hold_fd = hold_fd;
+
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->rx_window = 64 * 1024;   // Well inside the kernel's buffers
+    t->open = fd_open;
+    t->close = fd_close;
+    t->send = fd_send;
+    t->recv = fd_recv;
+    t->priv = port;
+    return 0;
+}
+
+int ota_transport_pty(ota_transport_t *t, char *peer_path, size_t len) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("pty");
+        return -1;
+    }
+
+    const char *slave_path = ptsname(master);
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(slave_path);
+        close(master);
+        return -1;
+    }
+
+    // Bytes, not lines: no echo, no CR/LF translation, no signals
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    snprintf(peer_path, len, "%s", slave_path);
+    return fd_setup(t, "pty", master, slave);
+}
+
+int ota_transport_loopback(ota_transport_t *t, int *peer_fd) {
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror("socketpair");
+        return -1;
+    }
+    *peer_fd = sv[1];
+    return fd_setup(t, "loopback", sv[0], -1);
+}
+
+void ota_transport_fd_wait(ota_transport_t *t, int timeout_ms) {
+    fd_port_t *port = t->priv;
+    struct pollfd pfd = { .fd = port->fd, .events = POLLIN };
+
+    if (poll(&pfd, 1, timeout_ms) > 0 && t->rx_ready != NULL) {
+        t->rx_ready();
+    }
+}
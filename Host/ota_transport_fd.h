@@ -0,0 +1,44 @@
+/*
+ * ota_transport_fd.h
+ *
+ * OTA transports for running the OTA engine on a Linux host, over a file
+ * descriptor:
+ *
+ *   pty       the engine owns the master; another process (an uploader
+ *             pointed at the slave path) is the other end, exactly as it
+ *             would be for a board on /dev/ttyACM0
+ *   loopback  a socketpair; the other end is a descriptor in the same
+ *             process, for benchmarking without the tty layer
+ *
+ * There is no receive interrupt on a host, so the event loop's port
+ * calls ota_transport_fd_wait() where the target would WFI: it sleeps in
+ * poll() and calls rx_ready() when bytes arrive, which is what the UART
+ * interrupt does on the board.
+ */
+
+#ifndef HOST_OTA_TRANSPORT_FD_H_
+#define HOST_OTA_TRANSPORT_FD_H_
+
+#include <stddef.h>
+#include "ota_transport.h"
+
+/**
+ * @brief Set t up as a pty
+ * @param peer_path Receives the slave path to hand to the other end
+ * @return 0 on success, -1 on error
+ */
+int ota_transport_pty(ota_transport_t *t, char *peer_path, size_t len);
+
+/**
+ * @brief Set t up as one end of a socketpair
+ * @param peer_fd Receives the other end (blocking)
+ * @return 0 on success, -1 on error
+ */
+int ota_transport_loopback(ota_transport_t *t, int *peer_fd);
+
+/**
+ * @brief Sleep until t has data or timeout_ms passes; calls rx_ready()
+ */
+void ota_transport_fd_wait(ota_transport_t *t, int timeout_ms);
+
+#endif /* HOST_OTA_TRANSPORT_FD_H_ */
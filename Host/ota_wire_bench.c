@@ -0,0 +1,345 @@
+/*
+ * ota_wire_bench.c
+ *
+ * Host benchmark of the per-chunk cost of the two DATA layouts in
+ * ota_protocol.h: v1 (packed, data at byte 15) and v2 (aligned, data at
+ * byte 16 of an 8-byte aligned frame).
+ *
+ * The same image goes through the real ota_link.c as v1 and as v2 DATA
+ * packets, on a virtual-time port of sched_port.h whose cycle counter
+ * runs in nanoseconds, into a stand-in ota_manager that does what the
+ * device does with a chunk: checks its CRC and programs it a word at a
+ * time (here into a RAM image, which is compared with the original at
+ * the end). A v1 chunk is copied into the aligned layout by the link
+ * first; a v2 chunk is read where it was framed.
+ *
+ * The table shows, per DATA packet and best of REPEATS runs, the time
+ * from the first byte read to the response (framing included), the
+ * part the link counts as handling the packet (ota_link_stats_t
+ * data_cycles: copy, CRC, write, response), and the bytes copied on the
+ * way. On the host an unaligned word load costs what an aligned one
+ * does, so this measures the copy, not the Cortex-M4's split accesses;
+ * on the board the link prints its own cycles per DATA packet at the
+ * end of each transfer, for whichever layout the sender used.
+ *
+ * Build and run from the repository root:
+ * (-iquote, not -I: Common/OTA/Inc/sched.h would hide the system <sched.h>)
+ *   gcc -O2 -std=gnu11 -Wall -Wno-format -iquote Common/OTA/Inc \
+ *       -iquote Application/Core/Inc Host/ota_wire_bench.c Common/OTA/Src/ota_link.c \
+ *       Common/OTA/Src/ota_fec.c Common/OTA/Src/ota_fountain.c \
+ *       Common/OTA/Src/ota_governor.c Common/OTA/Src/sched.c -o ota_wire_bench \
+ *     && ./ota_wire_bench [chunks]
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ota_link.h"
+#include "ota_protocol.h"
+#include "sched.h"
+#include "sched_port.h"
+
+#define DEFAULT_CHUNKS      256
+#define READ_SIZE           64      // What rx_task takes from the driver at a time
+#define REPEATS             15
+
+static FILE *out;               // Results; stdout is the device's console
+
+static uint32_t crc_table[4][256];
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+        crc_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 4; t++) {
+            crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xFF];
+        }
+    }
+}
+
+/* zlib's CRC32, four bytes a step: a word load, as the CRC unit is fed */
+static uint32_t crc32_le(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    uint32_t i = 0;
+
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, 4);
+        crc ^= word;
+        crc = crc_table[3][crc & 0xFF] ^ crc_table[2][(crc >> 8) & 0xFF] ^
+              crc_table[1][(crc >> 16) & 0xFF] ^ crc_table[0][crc >> 24];
+    }
+    for (; i < len; i++) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ data[i]) & 0xFF];
+    }
+    return ~crc;
+}
+
+// ota_manager.c's, for ota_link.c and ota_fec.c
+uint32_t calculate_crc32(const void *data, size_t length) {
+    return crc32_le(data, (uint32_t)length);
+}
+
+/* ---- sched_port.h: time stands still, cycles are nanoseconds ---- */
+
+void sched_port_init(void) {
+}
+
+uint32_t sched_port_now_ms(void) {
+    return 0;
+}
+
+uint32_t sched_port_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return 1000000;
+}
+
+uint32_t sched_port_irq_save(void) {
+    return 0;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+void sched_port_wait(void) {
+}
+
+/* ---- The link: a prepared stream, READ_SIZE bytes at a time ---- */
+
+static const uint8_t *wire;
+static size_t wire_len, wire_pos;
+
+static int wire_open(ota_transport_t *t) {
+    return 0;
+}
+
+static void wire_close(ota_transport_t *t) {
+}
+
+static int wire_send(ota_transport_t *t, const void *data, uint16_t size) {
+    return size;                // Responses are not looked at
+}
+
+static int wire_recv(ota_transport_t *t, void *buf, uint16_t size) {
+    size_t n = wire_len - wire_pos;
+    if (n > size) {
+        n = size;
+    }
+    memcpy(buf, wire + wire_pos, n);
+    wire_pos += n;
+    return (int)n;
+}
+
+static ota_transport_t wire_transport = {
+    .name = "wire",
+    .open = wire_open,
+    .close = wire_close,
+    .send = wire_send,
+    .recv = wire_recv,
+    .rx_window = READ_SIZE,
+};
+
+/* ---- Stand-in ota_manager: check and program each chunk ---- */
+
+static uint32_t *flash;         // The slot being written, by the word
+static uint32_t bad_chunks;
+
+void ota_init(ota_context_t *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->state = OTA_STATE_IDLE;
+}
+
+void ota_send_response(const ota_context_t *ctx, uint8_t packet_type) {
+    ota_response_packet_t response = {
+        .magic = OTA_MAGIC_START,
+        .packet_type = packet_type,
+        .last_chunk_received = ctx->chunks_received,
+    };
+    ota_link_send(&response, sizeof(response));
+}
+
+void ota_process_start_packet(ota_context_t *ctx, const ota_start_packet_t *pkt) {
+    ctx->firmware_size = pkt->firmware_size;
+    ctx->total_chunks = pkt->total_chunks;
+    ctx->state = OTA_STATE_RECEIVING_DATA;
+    ota_send_response(ctx, OTA_PKT_ACK);
+}
+
+void ota_process_data_packet(ota_context_t *ctx, const ota_data_packet_v2_t *pkt) {
+    const uint32_t *words = (const uint32_t *)pkt->data;
+    uint32_t *dst = flash + pkt->chunk_number * (OTA_CHUNK_SIZE / 4);
+
+    if (pkt->chunk_number != ctx->chunks_received ||
+        crc32_le(pkt->data, pkt->chunk_size) != pkt->chunk_crc32) {
+        bad_chunks++;
+        ota_send_response(ctx, OTA_PKT_NACK);
+        return;
+    }
+    for (uint32_t i = 0; i < (pkt->chunk_size + 3u) / 4; i++) {
+        dst[i] = words[i];
+    }
+    ctx->chunks_received++;
+    ota_send_response(ctx, OTA_PKT_ACK);
+}
+
+void ota_process_end_packet(ota_context_t *ctx, const ota_end_packet_t *pkt) {
+}
+
+int ota_image_recorded(uint32_t firmware_version, uint32_t firmware_crc32) {
+    return 0;
+}
+
+/* ---- Bench ---- */
+
+/* START, then every chunk, in one layout */
+static size_t build(uint8_t *stream, const uint8_t *image, uint32_t chunks, int v2) {
+    size_t n = 0;
+
+    if (v2) {
+        ota_start_packet_v2_t start = {
+            .magic = OTA_MAGIC_START,
+            .packet_type = OTA_PKT_START_V2,
+            .target_bank = OTA_TARGET_AUTO,
+            .firmware_size = chunks * OTA_CHUNK_SIZE,
+            .total_chunks = chunks,
+        };
+        memcpy(stream, &start, sizeof(start));
+        n += sizeof(start);
+    } else {
+        ota_start_packet_t start = {
+            .magic = OTA_MAGIC_START,
+            .packet_type = OTA_PKT_START,
+            .firmware_size = chunks * OTA_CHUNK_SIZE,
+            .total_chunks = chunks,
+            .target_bank = OTA_TARGET_AUTO,
+        };
+        memcpy(stream, &start, sizeof(start));
+        n += sizeof(start);
+    }
+
+    for (uint32_t c = 0; c < chunks; c++) {
+        const uint8_t *data = image + c * OTA_CHUNK_SIZE;
+        uint32_t crc = crc32_le(data, OTA_CHUNK_SIZE);
+
+        if (v2) {
+            ota_data_packet_v2_t pkt = {
+                .magic = OTA_MAGIC_DATA,
+                .packet_type = OTA_PKT_DATA_V2,
+                .chunk_size = OTA_CHUNK_SIZE,
+                .chunk_number = c,
+                .chunk_crc32 = crc,
+            };
+            memcpy(pkt.data, data, OTA_CHUNK_SIZE);
+            memcpy(stream + n, &pkt, sizeof(pkt));
+            n += sizeof(pkt);
+        } else {
+            ota_data_packet_t pkt = {
+                .magic = OTA_MAGIC_DATA,
+                .packet_type = OTA_PKT_DATA,
+                .chunk_number = c,
+                .chunk_size = OTA_CHUNK_SIZE,
+                .chunk_crc32 = crc,
+            };
+            memcpy(pkt.data, data, OTA_CHUNK_SIZE);
+            memcpy(stream + n, &pkt, sizeof(pkt));
+            n += sizeof(pkt);
+        }
+    }
+    return n;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    uint32_t chunks = (argc > 1) ? (uint32_t)atoi(argv[1]) : DEFAULT_CHUNKS;
+    size_t image_size = (size_t)chunks * OTA_CHUNK_SIZE;
+    uint8_t *image = malloc(image_size);
+    uint8_t *stream = malloc(sizeof(ota_start_packet_v2_t) + (size_t)chunks * sizeof(ota_data_packet_v2_t));
+    ota_context_t ctx;
+    int failures = 0;
+
+    if (chunks == 0) {
+        fprintf(stderr, "usage: %s [chunks]\n", argv[0]);
+        return 1;
+    }
+    flash = malloc(image_size);
+
+    // The engine prints to stdout as it would to the board's console
+    out = fdopen(dup(fileno(stdout)), "w");
+    freopen("/dev/null", "w", stdout);
+
+    crc_table_init();
+    srand(1);
+    for (size_t i = 0; i < image_size; i++) {
+        image[i] = (uint8_t)rand();
+    }
+    sched_init();
+
+    fprintf(out, "%lu chunks, best of %d runs; per DATA packet\n\n", (unsigned long)chunks, REPEATS);
+    fprintf(out, "%-6s %6s %14s %14s %12s\n", "layout", "bytes", "read->answer", "handling",
+            "copied");
+
+    for (int v2 = 0; v2 < 2; v2++) {
+        uint64_t best_total = UINT64_MAX, best_handling = UINT64_MAX;
+        uint32_t copied = v2 ? 0 : OTA_CHUNK_SIZE;
+
+        wire_len = build(stream, image, chunks, v2);
+        wire = stream;
+
+        for (int r = 0; r < REPEATS; r++) {
+            ota_link_stats_t ls;
+
+            memset(flash, 0, image_size);
+            bad_chunks = 0;
+            wire_pos = 0;
+            ota_link_start(&ctx, &wire_transport, NULL);
+
+            uint64_t t0 = now_ns();
+            while (wire_pos < wire_len) {
+                wire_transport.rx_ready();
+                while (sched_run_once() != 0) {
+                }
+            }
+            uint64_t total = now_ns() - t0;
+            ota_link_get_stats(&ls);
+            ota_link_stop();
+
+            if (ctx.chunks_received != chunks || bad_chunks != 0 ||
+                memcmp(flash, image, image_size) != 0 || ls.data_packets != chunks ||
+                ls.v2_packets != (v2 ? chunks + 1 : 0)) {
+                failures++;
+            }
+            if (total < best_total) {
+                best_total = total;
+            }
+            if (ls.data_packets != 0 && ls.data_cycles < best_handling) {
+                best_handling = ls.data_cycles;
+            }
+        }
+
+        fprintf(out, "%-6s %6u %11.0f ns %11.0f ns %10lu B\n", v2 ? "v2" : "v1",
+                (unsigned)(v2 ? sizeof(ota_data_packet_v2_t) : sizeof(ota_data_packet_t)),
+                (double)best_total / chunks, (double)best_handling / chunks, (unsigned long)copied);
+    }
+
+    fprintf(out, "\n%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * sched_sim.c
+ *
+ * Host run of the event loop in sched.c against a simulated 72 MHz core.
+ *
+ * The port below models time as a cycle counter: callbacks "cost" cycles
+ * by advancing it, sched_port_wait() skips to the next 1 ms tick, and the
+ * tick delivers simulated interrupts (a UART that posts work). The run
+ * mirrors the application's main loop (LED, watchdog kick, trial confirm,
+ * background peripheral steps) plus the awkward cases: a 1.5 s blocking
+ * flash erase, a timer that stops itself, timers further out than one
+ * turn of the wheel and an interrupt burst that overflows the queue.
+ *
+ * Each case is checked; the exit status is the number of failures. The
+ * statistics are compared against the busy time the simulator itself
+ * booked, so they validate sched_report() on the target too.
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -std=gnu11 -Wall -ICommon/OTA/Inc -IApplication/Core/Inc \
+ *       Host/sched_sim.c Common/OTA/Src/sched.c \
+ *       -o sched_sim && ./sched_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sched.h"
+#include "sched_port.h"
+
+#define CYCLES_PER_MS   72000
+#define RUN_MS          30000
+#define STALL_AT_MS     7000
+#define STALL_MS        1500
+#define BURST_AT_MS     12000
+#define BURST_POSTS     (SCHED_WORK_DEPTH + 4)
+
+static uint64_t sim_cycles;
+static uint64_t sim_busy;       // Cycles booked by callbacks/stalls
+static uint32_t sim_ms_seen;    // Last ms whose interrupts were delivered
+static int failures;
+
+#define CHECK(cond, ...) do {                   \
+        if (!(cond)) {                          \
+            printf("FAIL: " __VA_ARGS__);       \
+            printf("\n");                       \
+            failures++;                         \
+        }                                       \
+    } while (0)
+
+/* ---- Simulated interrupts ---- */
+
+static uint32_t rx_posted;
+static uint32_t rx_handled;
+static uint32_t burst_accepted;
+
+static void rx_work(void *arg);
+
+static void sim_isr(uint32_t ms) {
+    // UART: a packet every 20 ms
+    if (ms % 20 == 0 && sched_post(rx_work, NULL) == 0) {
+        rx_posted++;
+    }
+    // A burst more than the queue can take
+    if (ms == BURST_AT_MS) {
+        for (int i = 0; i < BURST_POSTS; i++) {
+            if (sched_post(rx_work, NULL) == 0) {
+                burst_accepted++;
+            }
+        }
+    }
+}
+
+static uint32_t now_ms(void) {
+    return (uint32_t)(sim_cycles / CYCLES_PER_MS);
+}
+
+static void deliver_interrupts(void) {
+    while (sim_ms_seen < now_ms()) {
+        sim_ms_seen++;
+        sim_isr(sim_ms_seen);
+    }
+}
+
+// Time spent doing work (interrupts for the skipped ticks still arrive)
+static void burn(uint64_t cycles) {
+    sim_cycles += cycles;
+    sim_busy += cycles;
+    deliver_interrupts();
+}
+
+/* ---- sched_port.h ---- */
+
+void sched_port_init(void) {
+}
+
+uint32_t sched_port_now_ms(void) {
+    return now_ms();
+}
+
+uint32_t sched_port_cycles(void) {
+    return (uint32_t)sim_cycles;
+}
+
+uint32_t sched_port_cycles_per_ms(void) {
+    return CYCLES_PER_MS;
+}
+
+uint32_t sched_port_irq_save(void) {
+    return 0;
+}
+
+void sched_port_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+void sched_port_wait(void) {
+    sim_cycles = (uint64_t)(now_ms() + 1) * CYCLES_PER_MS;
+    deliver_interrupts();
+}
+
+/* ---- Workload ---- */
+
+static sched_timer_t led_timer, watchdog_timer, confirm_timer, self_stop_timer;
+static sched_timer_t far_timer, stall_timer, during_stall_timer;
+
+static uint32_t led_fires, led_last_ms, led_min_gap = UINT32_MAX;
+static uint32_t watchdog_fires;
+static uint32_t confirm_fires, confirm_ms;
+static uint32_t self_stop_fires;
+static uint32_t far_ms;
+static uint32_t during_stall_ms;
+static uint32_t background_steps;
+
+static void rx_work(void *arg) {
+    rx_handled++;
+    burn(CYCLES_PER_MS / 10);  // 100 us per packet
+}
+
+static void led_toggle(void *arg) {
+    uint32_t now = now_ms();
+    if (led_fires > 0 && now - led_last_ms < led_min_gap) {
+        led_min_gap = now - led_last_ms;
+    }
+    led_last_ms = now;
+    led_fires++;
+    burn(200);
+}
+
+static void watchdog_kick(void *arg) {
+    watchdog_fires++;
+    burn(50);
+}
+
+static void confirm(void *arg) {
+    confirm_fires++;
+    confirm_ms = now_ms();
+    burn(CYCLES_PER_MS * 5);   // A flash word program
+}
+
+static void self_stop(void *arg) {
+    if (++self_stop_fires == 3) {
+        sched_timer_stop(&self_stop_timer);
+    }
+}
+
+static void far_expiry(void *arg) {
+    far_ms = now_ms();
+}
+
+static void during_stall(void *arg) {
+    during_stall_ms = now_ms();
+}
+
+// Blocking flash erase: no sleeping, so no timers, for STALL_MS
+static void flash_erase(void *arg) {
+    burn((uint64_t)STALL_MS * CYCLES_PER_MS);
+}
+
+// Re-posts itself like periph_init_background_step() in the application
+static void background_step(void *arg) {
+    burn(CYCLES_PER_MS * 2);
+    if (++background_steps < 6) {
+        sched_post(background_step, NULL);
+    }
+}
+
+int main(void) {
+    sched_init();
+
+    sched_timer_init(&led_timer, led_toggle, NULL);
+    sched_timer_init(&watchdog_timer, watchdog_kick, NULL);
+    sched_timer_init(&confirm_timer, confirm, NULL);
+    sched_timer_init(&self_stop_timer, self_stop, NULL);
+    sched_timer_init(&far_timer, far_expiry, NULL);
+    sched_timer_init(&stall_timer, flash_erase, NULL);
+    sched_timer_init(&during_stall_timer, during_stall, NULL);
+
+    sched_timer_start(&led_timer, 300, 300);
+    sched_timer_start(&watchdog_timer, 1000, 1000);
+    sched_timer_start(&confirm_timer, 10000, 0);
+    sched_timer_start(&self_stop_timer, 5, 5);
+    sched_timer_start(&far_timer, 12345, 0);          // ~193 turns of the wheel
+    sched_timer_start(&stall_timer, STALL_AT_MS, 0);
+    sched_timer_start(&during_stall_timer, STALL_AT_MS + 700, 0);
+    sched_post(background_step, NULL);
+
+    uint32_t next_report = 10000;
+    while (now_ms() < RUN_MS) {
+        sched_run_once();
+        sched_sleep();
+
+        if (now_ms() >= next_report) {
+            printf("[%5u ms] ", now_ms());
+            fflush(stdout);
+            sched_report();
+            next_report += 10000;
+        }
+    }
+
+    // Check the accounting over one window with no stall or burst in it
+    sim_busy = 0;
+    sched_stats_t s;
+    sched_get_stats(&s, 1);
+    uint32_t start_ms = now_ms();
+    while (now_ms() < start_ms + 5000) {
+        sched_run_once();
+        sched_sleep();
+    }
+    sched_get_stats(&s, 0);
+    uint64_t expect_permille = sim_busy * 1000 / ((uint64_t)s.elapsed_ms * CYCLES_PER_MS);
+    sched_run_once();  // Whatever the last tick posted
+
+    printf("\n");
+    printf("led %u (min gap %u ms), watchdog %u, confirm at %u ms, far timer at %u ms\n",
+           led_fires, led_min_gap, watchdog_fires, confirm_ms, far_ms);
+    printf("rx posted %u handled %u, burst accepted %u of %u\n",
+           rx_posted, rx_handled, burst_accepted, BURST_POSTS);
+    printf("final window: %u.%u%% busy (simulator booked %u.%u%%)\n",
+           s.busy_permille / 10, s.busy_permille % 10,
+           (unsigned)(expect_permille / 10), (unsigned)(expect_permille % 10));
+
+    CHECK(confirm_fires == 1 && confirm_ms == 10000, "one-shot fired %u times, at %u ms", confirm_fires, confirm_ms);
+    CHECK(far_ms == 12345, "far timer fired at %u ms, expected 12345", far_ms);
+    CHECK(self_stop_fires == 3, "self-stopping timer fired %u times", self_stop_fires);
+    // Periods keep their phase, so a late fire makes the next gap a little
+    // short; what must not happen is a burst replaying the stall
+    CHECK(led_min_gap >= 290, "periodic timer fired %u ms after the last one", led_min_gap);
+    CHECK(led_fires >= (RUN_MS + 5000 - STALL_MS) / 300 - 1, "periodic timer fired only %u times", led_fires);
+    // Late by the queued UART work at most, not by another turn of the wheel
+    CHECK(during_stall_ms >= STALL_AT_MS + STALL_MS && during_stall_ms <= STALL_AT_MS + STALL_MS + 5,
+          "timer due during the stall fired at %u ms, expected %u", during_stall_ms, STALL_AT_MS + STALL_MS);
+    CHECK(background_steps == 6, "background chain ran %u steps", background_steps);
+    CHECK(burst_accepted == SCHED_WORK_DEPTH - 1 || burst_accepted == SCHED_WORK_DEPTH,
+          "burst accepted %u, queue depth %u", burst_accepted, SCHED_WORK_DEPTH);
+    CHECK(rx_handled == rx_posted + burst_accepted, "posted %u, handled %u", rx_posted + burst_accepted, rx_handled);
+    CHECK(s.busy_permille + 1 >= expect_permille && s.busy_permille <= expect_permille + 1,
+          "busy %u permille, simulator booked %u", s.busy_permille, (unsigned)expect_permille);
+    CHECK(sched_next_expiry() <= 300, "next expiry %u ms with a 300 ms timer armed", sched_next_expiry());
+
+    printf("%s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    return failures;
+}
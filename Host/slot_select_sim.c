@@ -0,0 +1,121 @@
+/*
+ * slot_select_sim.c
+ *
+ * Host simulation of boot slot selection cost versus slot count.
+ *
+ * Runs the same slot_select.c the bootloader links against over random
+ * slot tables and reports, per table size:
+ *   - newest:   one slot_select_newest() call (the normal boot path)
+ *   - fallback: walk every bootable slot newest-first, as the bootloader
+ *               does when each candidate fails verification (worst case)
+ *   - target:   one slot_select_target() call (OTA auto-targeting)
+ *
+ * Times are host nanoseconds, useful for the shape of the curve (linear
+ * for one pass, quadratic for the full fallback walk), not as target
+ * numbers. The metadata column is the record size the bootloader scans.
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -std=gnu11 -ICommon/OTA/Inc -IApplication/Core/Inc \
+ *       Host/slot_select_sim.c Common/OTA/Src/slot_select.c \
+ *       -o slot_select_sim && ./slot_select_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "slot_select.h"
+
+#define ITERATIONS  200000
+#define TABLES      64
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Random table: ~3/4 of slots bootable, install order shuffled */
+static void fill_table(boot_slot_t *slots, uint32_t count) {
+    memset(slots, 0, count * sizeof(boot_slot_t));
+    for (uint32_t i = 0; i < count; i++) {
+        slots[i].sequence = i + 1;
+    }
+    for (uint32_t i = count - 1; i > 0; i--) {
+        uint32_t j = rng() % (i + 1);
+        uint32_t tmp = slots[i].sequence;
+        slots[i].sequence = slots[j].sequence;
+        slots[j].sequence = tmp;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t r = rng() % 8;
+        slots[i].status = (r < 5) ? BANK_STATUS_VALID : (r < 6) ? BANK_STATUS_TESTING : BANK_STATUS_INVALID;
+        slots[i].fw_version = 0x01000000 + slots[i].sequence;
+    }
+}
+
+static int fallback_walk(const boot_slot_t *slots, uint32_t count) {
+    uint32_t rejected = 0;
+    int slot;
+    int tried = 0;
+
+    while ((slot = slot_select_newest(slots, count, rejected)) >= 0) {
+        rejected |= 1UL << slot;
+        tried++;
+    }
+    return tried;
+}
+
+int main(void) {
+    static const uint32_t counts[] = { 2, 4, 7, 8, 12, 16, 24, 32 };
+    static boot_slot_t tables[TABLES][SLOT_SELECT_MAX_SLOTS];
+    uint32_t capacity[SLOT_SELECT_MAX_SLOTS];
+    volatile int sink = 0;
+
+    for (uint32_t i = 0; i < SLOT_SELECT_MAX_SLOTS; i++) {
+        capacity[i] = (i == 0) ? 192 * 1024 : 256 * 1024;
+    }
+
+    printf("%6s %10s %12s %14s %12s\n", "slots", "metadata", "newest ns", "fallback ns", "target ns");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t count = counts[c];
+
+        for (int t = 0; t < TABLES; t++) {
+            fill_table(tables[t], count);
+        }
+
+        double start = now_ns();
+        for (int i = 0; i < ITERATIONS; i++) {
+            sink += slot_select_newest(tables[i % TABLES], count, 0);
+        }
+        double newest = (now_ns() - start) / ITERATIONS;
+
+        start = now_ns();
+        for (int i = 0; i < ITERATIONS; i++) {
+            sink += fallback_walk(tables[i % TABLES], count);
+        }
+        double fallback = (now_ns() - start) / ITERATIONS;
+
+        start = now_ns();
+        for (int i = 0; i < ITERATIONS; i++) {
+            sink += slot_select_target(tables[i % TABLES], capacity, count, 1, 200 * 1024);
+        }
+        double target = (now_ns() - start) / ITERATIONS;
+
+        printf("%6u %9zuB %12.1f %14.1f %12.1f\n", count,
+               16 + count * sizeof(boot_slot_t), newest, fallback, target);
+    }
+
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * main.h
+ *
+ * What the shared OTA modules take from main.h and the HAL, for a host
+ * build. Flash is RAM the simulator maps at FLASH_BASE_ADDRESS, so the
+ * modules' uint32_t addresses work as pointers; the HAL flash calls,
+ * HAL_GetTick() and the CRC entry points of ota_crc.h are implemented by
+ * the simulator.
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum { HAL_OK = 0, HAL_ERROR = 1 } HAL_StatusTypeDef;
+
+typedef struct {
+    uint32_t TypeErase, Banks, Sector, NbSectors, VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_SECTORS     0
+#define FLASH_TYPEPROGRAM_WORD      2
+#define FLASH_VOLTAGE_RANGE_3       2
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t type, uint32_t address, uint64_t data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *init, uint32_t *sector_error);
+uint32_t HAL_GetTick(void);
+
+#endif /* __MAIN_H */
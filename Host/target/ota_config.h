@@ -0,0 +1,18 @@
+/*
+ * ota_config.h
+ *
+ * Host build of the shared OTA modules (Host/ota_install_sim.c): the
+ * bootloader's blocking, unstaged install path, with the flash HAL calls
+ * served by the simulator's RAM flash (Host/target/main.h).
+ */
+
+#ifndef INC_OTA_CONFIG_H_
+#define INC_OTA_CONFIG_H_
+
+#define OTA_ROLE_BOOTLOADER     1
+#define OTA_BACKGROUND_FLASH    0
+#define OTA_STAGING_ENABLED     0
+#define OTA_HAL_DRIVERS         1
+#define OTA_LOG_LEVEL           1
+
+#endif /* INC_OTA_CONFIG_H_ */